@@ -1,109 +1,397 @@
 #include "base_connection.hpp"
 #include "connection_manager.hpp"
+#include "date_clock.hpp"
 #include "request.hpp"
 #include "request_handler.hpp"
 #include "request_parser.hpp"
 #include "response.hpp"
 #include "string_utils.hpp"
 
+#include <algorithm>
+#include <charconv>
+#include <cstring>
 #include <spdlog/spdlog.h>
 
 namespace http {
 namespace server {
-base_connection::base_connection(std::shared_ptr<connection_manager> manager,
-                                 std::shared_ptr<request_handler> handler)
-    : m_manager(manager), m_handler(handler),
-      m_parser(std::make_shared<request_parser>()),
-      m_request(std::make_shared<request>()),
-      m_response(std::make_shared<response>()) {}
-
-void base_connection::on_data_received(asio::error_code err,
-                                       size_t bytes_transferred) {
-  if (err) {
+
+namespace {
+
+// room for the chunk size line in front of a piece of a streamed body and for
+// the CRLF behind it, a piece of a chunk_buffer has at most 4 hex digits
+constexpr std::size_t CHUNK_PREFIX = 8;
+constexpr std::size_t CHUNK_SUFFIX = 2;
+constexpr std::string_view LAST_CHUNK = "0\r\n\r\n";
+
+} // namespace
+
+base_connection::base_connection(asio::any_io_executor executor,
+                                 std::shared_ptr<connection_manager> manager,
+                                 std::shared_ptr<request_handler> handler,
+                                 std::shared_ptr<timer_wheel> wheel,
+                                 parser_backend backend,
+                                 const header_limits &limits,
+                                 clock::duration timeout)
+    : m_manager(manager), m_handler(handler), m_parser(backend, limits),
+      m_executor(std::move(executor)),
+      m_wheel(std::move(wheel)), m_deadline(&base_connection::on_expired, this),
+      m_timeout(timeout) {}
+
+base_connection::~base_connection() {
+  // only reached without stop() when the io_context is torn down with the
+  // connection loop still suspended
+  m_manager->remove(this);
+}
+
+void base_connection::stop() {
+  // stop() is called by the connection_manager from other threads, the loop
+  // runs on the executor of the stream
+  asio::dispatch(m_executor, [this, self = shared_from_this()]() {
+    m_wheel->cancel(m_deadline);
+    close();
+  });
+}
+
+void base_connection::on_loop_exit(std::exception_ptr e) {
+  if (!e) {
+    return;
+  }
+  try {
+    std::rethrow_exception(e);
+  } catch (const std::exception &ex) {
+    spdlog::error("connection loop failed: {}", ex.what());
+  }
+}
+
+bool base_connection::on_loop_finished(asio::error_code err) {
+  if (m_timed_out) {
+    spdlog::info("timeout!");
+  } else if (err == asio::error::eof) {
+    spdlog::info("connection closed by peer");
+  } else if (err) {
     spdlog::error("[{}:{}] {}: {}", __FILE__, __LINE__, err.category().name(),
                   err.message());
-    m_manager->stop(shared_from_this());
-    return;
   }
-  // spdlog::info("receive data: {} bytes", bytes_transferred);
-  auto [parse_result, pos] = m_parser->parse(
-      m_request, std::string_view(m_buffer.data(), bytes_transferred));
-  switch (parse_result) {
-  case request_parser::PASS: {
-    m_request->update();
-    m_keep_alive = m_request->keep_alive;
-    // if (m_request->content_length > 0) {
-    //   spdlog::info("content length: {}", m_request->content_length);
-    // }
-    // spdlog::info("pos: {}, bytes_transferred: {}", pos, bytes_transferred);
-    m_handler->handle_request(m_request, m_response);
-    get_send_buffers();
-    do_write();
-    break;
-  }
-  case request_parser::FAIL: {
-    spdlog::error("http header parse failed");
-    spdlog::error("request:\n{}", string_utils::escaped(std::string_view(
-                                      m_buffer.data(), bytes_transferred)));
-    response::build_default_response(m_response, response::bad_request);
-    get_send_buffers();
-    do_write();
-    break;
+  if (err && !m_timed_out) {
+    return false;
+  }
+  // 由服务端主动关闭
+  m_shutting_down = true;
+  expire_after(SHUTDOWN_TIMEOUT);
+  return true;
+}
+
+response &base_connection::next_response() {
+  if (m_response_count == m_responses.size()) {
+    m_responses.emplace_back();
+  }
+  return m_responses[m_response_count++];
+}
+
+void base_connection::handle_request() {
+  response &rep = next_response();
+  m_handler->handle_request(m_request, rep);
+  if (rep.source && m_request.http_version_major == 1 &&
+      m_request.http_version_minor == 0) {
+    // no chunked coding before HTTP/1.1, the end of the connection is the end
+    // of the body
+    rep.chunked = false;
+    m_keep_alive = false;
+  }
+  m_request.clear();
+}
+
+asio::mutable_buffer base_connection::prepare_read() {
+  if (!m_partial) {
+    // nothing in the buffer is referenced any more
+    m_request_begin = m_input_begin = m_input_end = 0;
+  } else if (reading_body()) {
+    // the body chunks went into the sink, only the header has to stay
+    m_input_begin = m_input_end = m_header_end;
+  }
+  if (m_input_end == m_buffer->size() && m_request_begin > 0) {
+    // move the partial request to the front instead of copying it out
+    std::size_t offset = m_request_begin;
+    std::size_t keep = m_input_end - offset;
+    std::memmove(m_buffer->data(), m_buffer->data() + offset, keep);
+    m_parser.rebase(m_request, -static_cast<std::ptrdiff_t>(offset));
+    m_request_begin = 0;
+    m_input_begin -= offset;
+    m_input_end -= offset;
+    if (reading_body()) {
+      m_header_end -= offset;
+    }
+  }
+  return asio::buffer(m_buffer->data() + m_input_end,
+                      m_buffer->size() - m_input_end);
+}
+
+void base_connection::on_header_too_large(response::status_type status) {
+  spdlog::error("http header too large: {}", static_cast<int>(status));
+  m_keep_alive = false;
+  m_partial = false;
+  m_body_remaining = 0;
+  m_reading_chunks = false;
+  m_input_begin = m_input_end;
+  response::build_default_response(next_response(), status);
+  m_request.clear();
+  m_body.reset();
+}
+
+bool base_connection::process_input() {
+  while (has_input() && !reading_body() &&
+         m_response_count < MAX_PIPELINED) {
+    if (!m_partial) {
+      m_request_begin = m_input_begin;
+    }
+    std::string_view data(m_buffer->data() + m_input_begin,
+                          m_input_end - m_input_begin);
+    // spdlog::info("receive data: {} bytes", data.size());
+    auto [parse_result, pos] = m_parser.parse(m_request, data);
+    switch (parse_result) {
+    case request_parser::PASS: {
+      // pos is the last byte of the header
+      m_input_begin += pos + 1;
+      m_parser.clear();
+      if (!m_request.update()) {
+        spdlog::error("invalid message framing");
+        m_keep_alive = false;
+        m_partial = false;
+        response::build_default_response(next_response(),
+                                         response::bad_request);
+        m_request.clear();
+        break;
+      }
+      m_keep_alive = m_request.keep_alive;
+      if (m_request.content_length > 0 || m_request.chunked) {
+        // handled once the body went into the sink, the header stays in the
+        // buffer until then
+        m_header_end = m_input_begin;
+        if (!has_input() && buffer_full()) {
+          on_header_too_large(response::request_header_fields_too_large);
+          break;
+        }
+        m_body_remaining = m_request.content_length;
+        m_reading_chunks = m_request.chunked;
+        m_chunks.clear();
+        m_body = m_handler->open_body(m_request);
+        m_request.body = m_body.get();
+        m_partial = true;
+        continue;
+      }
+      m_partial = false;
+      handle_request();
+      break;
+    }
+    case request_parser::FAIL: {
+      spdlog::error("http header parse failed");
+      spdlog::error("request:\n{}", string_utils::escaped(data));
+      // the rest of the stream can not be trusted any more
+      m_keep_alive = false;
+      m_partial = false;
+      response::build_default_response(next_response(),
+                                       response::bad_request);
+      break;
+    }
+    case request_parser::URI_TOO_LONG:
+      on_header_too_large(response::uri_too_long);
+      break;
+    case request_parser::HEADER_TOO_LARGE:
+      on_header_too_large(response::request_header_fields_too_large);
+      break;
+    case request_parser::CONTINUE:
+    default:
+      m_input_begin = m_input_end;
+      m_partial = true;
+      if (buffer_full()) {
+        on_header_too_large(response::request_header_fields_too_large);
+        break;
+      }
+      continue;
+    }
+    if (!m_keep_alive) {
+      // nothing after the last response is answered
+      m_input_begin = m_input_end;
+    }
+  }
+  if (m_response_count == 0) {
+    return false;
   }
-  case request_parser::CONTINUE: {
-    do_read();
-    break;
+  get_send_buffers();
+  return true;
+}
+
+std::string_view base_connection::take_body_chunk(asio::error_code &err) {
+  if (m_reading_chunks) {
+    while (has_input()) {
+      auto [result, pos, data] = m_chunks.decode(std::string_view(
+          m_buffer->data() + m_input_begin, m_input_end - m_input_begin));
+      m_input_begin += pos;
+      switch (result) {
+      case chunked_decoder::DATA:
+        return data;
+      case chunked_decoder::DONE:
+        m_reading_chunks = false;
+        return {};
+      case chunked_decoder::FAIL:
+        err = asio::error::invalid_argument;
+        return {};
+      case chunked_decoder::CONTINUE:
+        break;
+      }
+    }
+    return {};
   }
+  std::size_t size = std::min(m_body_remaining, m_input_end - m_input_begin);
+  std::string_view chunk(m_buffer->data() + m_input_begin, size);
+  m_input_begin += size;
+  m_body_remaining -= size;
+  return chunk;
+}
+
+void base_connection::on_body_finished() {
+  m_partial = false;
+  handle_request();
+  m_body.reset();
+  if (!m_keep_alive) {
+    m_input_begin = m_input_end;
   }
 }
 
+void base_connection::on_body_failed(asio::error_code err) {
+  spdlog::error("request body rejected: {}", err.message());
+  m_keep_alive = false;
+  m_partial = false;
+  m_body_remaining = 0;
+  m_reading_chunks = false;
+  m_input_begin = m_input_end;
+  response::status_type status = response::internal_server_error;
+  if (err == asio::error::message_size) {
+    status = response::payload_too_large;
+  } else if (err == asio::error::invalid_argument) {
+    // broken chunked framing
+    status = response::bad_request;
+  }
+  response::build_default_response(next_response(), status);
+  m_request.clear();
+  m_body.reset();
+}
+
 void base_connection::get_send_buffers() {
-  m_response->update(m_keep_alive);
-  m_response->to_buffers(m_send_buffers);
-  std::string_view response_header =
-      reinterpret_cast<const char *>(m_send_buffers.front().data());
-  spdlog::info("response: {}",
-               response_header.substr(0, response_header.find('\r')));
+  // copied into every head, a line of the thread's clock
+  std::string_view date = date_clock::local().line();
+  while (m_queued < m_response_count && !m_streaming) {
+    std::size_t i = m_queued++;
+    response &rep = m_responses[i];
+    // only the last response of a batch may close the connection
+    rep.update(i + 1 < m_response_count || m_keep_alive, date);
+    rep.to_buffers(m_send_buffers);
+    m_streaming = rep.source != nullptr;
+    spdlog::info("response: {}", static_cast<int>(rep.status));
+  }
+}
+
+asio::awaitable<void> base_connection::pull_stream(asio::error_code &err) {
+  response &rep = m_responses[m_queued - 1];
+  acquire_chunk_buffer();
+  // the previous piece is written, the buffer is free again
+  char *data = m_chunk_buffer->data() + CHUNK_PREFIX;
+  std::size_t size = co_await rep.source->read(
+      std::span<char>(data, m_chunk_buffer->size() - CHUNK_PREFIX -
+                                CHUNK_SUFFIX),
+      err);
+  if (err) {
+    spdlog::error("response body failed: {}", err.message());
+    co_return;
+  }
+  if (size == 0) {
+    if (rep.chunked) {
+      m_send_buffers.push_back(asio::buffer(LAST_CHUNK));
+    }
+    m_streaming = false;
+    get_send_buffers();
+    co_return;
+  }
+  if (!rep.chunked) {
+    m_send_buffers.push_back(asio::buffer(data, size));
+    co_return;
+  }
+  // "<hex size>\r\n" right in front of the piece, "\r\n" behind it, the
+  // chunk is one buffer
+  std::array<char, CHUNK_PREFIX> digits;
+  char *digits_end =
+      std::to_chars(digits.data(), digits.data() + digits.size(), size, 16)
+          .ptr;
+  auto digit_count = static_cast<std::size_t>(digits_end - digits.data());
+  char *begin = data - digit_count - 2;
+  std::memcpy(begin, digits.data(), digit_count);
+  begin[digit_count] = '\r';
+  begin[digit_count + 1] = '\n';
+  data[size] = '\r';
+  data[size + 1] = '\n';
+  m_send_buffers.push_back(
+      asio::buffer(begin, static_cast<std::size_t>(data + size + 2 - begin)));
 }
 
 void base_connection::clear() {
-  m_parser->clear();
-  m_request->clear();
-  m_response->clear();
+  for (std::size_t i = 0; i < m_response_count; i++) {
+    m_responses[i].clear();
+  }
+  m_response_count = 0;
+  m_queued = 0;
+  m_streaming = false;
+  m_chunk_buffer.reset();
 }
 
-void base_connection::on_data_sent(asio::error_code err,
-                                   size_t bytes_transferred) {
-  if (err) {
-    spdlog::error("[{}:{}] {}: {}", __FILE__, __LINE__, err.category().name(),
-                  err.message());
-    m_manager->stop(shared_from_this());
-    return;
+void base_connection::acquire_chunk_buffer() {
+  if (!m_chunk_buffer) {
+    m_chunk_buffer.reset(pool_allocator<chunk_buffer>().allocate(1));
   }
+}
+
+void base_connection::on_data_sent(size_t bytes_transferred) {
   spdlog::info("send: {} bytes", bytes_transferred);
-  while (!m_send_buffers.empty() &&
-         m_send_buffers.front().size() <= bytes_transferred) {
-    bytes_transferred -= m_send_buffers.front().size();
-    m_send_buffers.pop_front();
+  m_send_buffers.consume(bytes_transferred);
+}
+
+asio::const_buffer
+base_connection::read_file_chunk(const send_queue::file_part &file,
+                                 asio::error_code &err) {
+  acquire_chunk_buffer();
+  auto size = static_cast<std::size_t>(
+      std::min<std::uint64_t>(file.size, m_chunk_buffer->size()));
+  size = file_body::read(file.fd, file.offset, m_chunk_buffer->data(), size,
+                         err);
+  return asio::buffer(m_chunk_buffer->data(), size);
+}
+
+void base_connection::on_expired(void *context) {
+  // runs on the executor of the wheel with the wheel locked, the destructor of
+  // m_deadline waits for it, so the connection may be half destroyed but
+  // weak_from_this() is still valid
+  auto self = static_cast<base_connection *>(context)->weak_from_this().lock();
+  if (!self) {
+    return;
   }
-  if (m_send_buffers.empty()) {
-    spdlog::info("finish sending");
-    if (!m_keep_alive) {
-      // spdlog::info("no keep-alive, close connection!", bytes_transferred);
-      shutdown();
-      return;
-    }
-    clear();
-    do_read();
+  asio::post(self->m_executor, [self]() { self->on_deadline(); });
+}
+
+void base_connection::on_deadline() {
+  if (!m_wheel->expired(m_deadline)) {
+    // touched on the executor of the connection while the wheel expired it
+    return;
+  }
+  if (m_shutting_down) {
+    spdlog::warn("shutdown timeout after {} seconds, stop right now!",
+                 SHUTDOWN_TIMEOUT.count());
+    close();
     return;
   }
-  // 之后我们可以计算剩余的偏移量
-  m_send_buffers.front() = {
-      reinterpret_cast<const void *>(
-          reinterpret_cast<const uint8_t *>(m_send_buffers.front().data()) +
-          bytes_transferred),
-      m_send_buffers.front().size() - bytes_transferred};
-  do_write();
+  // the pending operation of the loop completes with operation_aborted, then
+  // the loop shuts the connection down gracefully
+  m_timed_out = true;
+  expire_after(SHUTDOWN_TIMEOUT);
+  cancel();
 }
 } // namespace server
-} // namespace http
\ No newline at end of file
+} // namespace http
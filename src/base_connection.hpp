@@ -1,57 +1,239 @@
 #pragma once
+#include "body_sink.hpp"
+#include "chunked_decoder.hpp"
+#include "pool_allocator.hpp"
+#include "request.hpp"
+#include "header_parser.hpp"
+#include "response.hpp"
+#include "send_queue.hpp"
+#include "timer_wheel.hpp"
 #include <array>
 #include <asio.hpp>
+#include <chrono>
+#include <exception>
 #include <memory>
-#include <list>
+#include <vector>
 
 namespace http {
 namespace server {
 class connection_manager;
 class request_handler;
-class request_parser;
-struct request;
-struct response;
 
+/// Stream independent part of a connection: parsing, dispatching, the send
+/// buffers and the deadline on the timer wheel of the io_context. The parser,
+/// the request and the responses live inline, so a connection is a single
+/// block which basic_connection<Stream> recycles through a per-thread pool.
+/// basic_connection<Stream> runs the connection loop on top of it, only the
+/// life cycle is virtual, nothing on the path of an I/O completion.
 class base_connection : public std::enable_shared_from_this<base_connection> {
 public:
+  using clock = std::chrono::steady_clock;
+
   base_connection(const base_connection &) = delete;
   base_connection &operator=(const base_connection &) = delete;
+  virtual ~base_connection();
 
+  /// Spawn the connection loop on the executor of the stream.
   virtual void start() = 0;
-  virtual void stop() = 0;
-  virtual void shutdown() = 0;
+
+  /// Close the stream, safe to call from any thread.
+  void stop();
 
 protected:
-  explicit base_connection(std::shared_ptr<connection_manager> manager,
-                           std::shared_ptr<request_handler> handler);
+  explicit base_connection(asio::any_io_executor executor,
+                           std::shared_ptr<connection_manager> manager,
+                           std::shared_ptr<request_handler> handler,
+                           std::shared_ptr<timer_wheel> wheel,
+                           parser_backend backend, const header_limits &limits,
+                           clock::duration timeout);
 
-  virtual void do_read() = 0;
-  virtual void do_write() = 0;
+  /// Abort the pending operations of the stream.
+  virtual void cancel() = 0;
 
+  /// Close the stream right now.
+  virtual void close() = 0;
+
+  /// Drop the responses of the batch that was just sent.
   void clear();
 
+  /// Queue the responses of the batch that are not queued yet, up to and
+  /// including the head of a streamed body, which has to be sent first.
   void get_send_buffers();
 
-  void on_data_received(asio::error_code err, size_t bytes_transferred);
-  void on_data_sent(asio::error_code err, size_t bytes_transferred);
+  /// Whether the body of a response is being streamed, its next piece is
+  /// pulled once the send buffers drained.
+  bool streaming() const { return m_streaming; }
+
+  /// Pull the next piece of the streamed body from its source and queue it
+  /// framed as a chunk. The last piece ends the body, the rest of the batch
+  /// is queued then. Sets `err` when the source failed.
+  asio::awaitable<void> pull_stream(asio::error_code &err);
+
+  /// Free part of the receive buffer the next read goes to. The request being
+  /// received stays in place, its header is moved to the front only when the
+  /// buffer ran full.
+  asio::mutable_buffer prepare_read();
+
+  /// `bytes_transferred` bytes were read into the buffer of prepare_read().
+  void on_data_received(size_t bytes_transferred) {
+    m_input_end += bytes_transferred;
+  }
+
+  /// Parse the unconsumed input, every complete request is handled and its
+  /// response queued. Stops at a request with a body, which is streamed by
+  /// the connection loop. Returns true when a batch of responses is ready to
+  /// be sent, the input may still hold the next requests then.
+  bool process_input();
+
+  /// Whether the body of the current request is being received.
+  bool reading_body() const { return m_body_remaining > 0 || m_reading_chunks; }
+
+  /// Consume the part of the input that belongs to the body, up to the next
+  /// piece of chunk data for a chunked body. Sets `err` when the chunked
+  /// framing is broken.
+  std::string_view take_body_chunk(asio::error_code &err);
+
+  /// The whole body went into the sink, handle the request.
+  void on_body_finished();
+
+  /// The sink rejected the body, answer with an error and close.
+  void on_body_failed(asio::error_code err);
+
+  /// Whether the receive buffer holds bytes that were not parsed yet.
+  bool has_input() const { return m_input_begin < m_input_end; }
+
+  /// `bytes_transferred` bytes of the send buffers or of the file they stop
+  /// at were written.
+  void on_data_sent(size_t bytes_transferred);
+
+  /// Read the next piece of `file` into the chunk buffer, for streams which
+  /// sendfile(2) can not write to. The buffer is held until clear().
+  asio::const_buffer read_file_chunk(const send_queue::file_part &file,
+                                     asio::error_code &err);
+
+  /// Log why the connection loop stopped, returns true when the stream should
+  /// still be shut down gracefully.
+  bool on_loop_finished(asio::error_code err);
+
+  /// Completion of the connection loop coroutine.
+  static void on_loop_exit(std::exception_ptr e);
+
+  /// Borrow a receive buffer from the pool of this thread, no-op while one is
+  /// held.
+  void acquire_buffer() {
+    if (!m_buffer) {
+      m_buffer.reset(pool_allocator<receive_buffer>().allocate(1));
+    }
+  }
+
+  /// Hand the receive buffer back, an idle connection holds none.
+  void release_buffer() { m_buffer.reset(); }
+
+  /// Push the deadline of the connection back, lock free on the wheel.
+  void expire_after(clock::duration timeout) {
+    m_wheel->touch(m_deadline, timeout);
+  }
+
+private:
+  /// Next response of the batch.
+  response &next_response();
+
+  /// Let the request_handler answer the parsed request.
+  void handle_request();
+
+  /// Borrow a chunk buffer from the pool of this thread, no-op while one is
+  /// held.
+  void acquire_chunk_buffer();
+
+  /// Whether the request being received fills the whole receive buffer.
+  bool buffer_full() const {
+    return m_request_begin == 0 && m_input_end == m_buffer->size();
+  }
+
+  /// The header of a request is over the header_limits of the parser or does
+  /// not fit the receive buffer, answer with `status` and close without
+  /// reading the rest of it.
+  void on_header_too_large(response::status_type status);
+
+  /// Called by the timer wheel, hands the deadline over to the executor of
+  /// the connection.
+  static void on_expired(void *self);
+  void on_deadline();
 
 protected:
   std::shared_ptr<connection_manager> m_manager{};
   std::shared_ptr<request_handler> m_handler{};
-  std::shared_ptr<request_parser> m_parser{};
+  header_parser m_parser;
 
-  // receive buffer
-  std::array<char, 8192> m_buffer{};
+  using receive_buffer = std::array<char, 8192>;
+  // a TLS record at most
+  using chunk_buffer = std::array<char, 16384>;
+  template <typename Buffer> struct buffer_release {
+    void operator()(Buffer *buffer) const noexcept {
+      pool_allocator<Buffer>().deallocate(buffer, 1);
+    }
+  };
+  // receive buffer, only held from readability until the request is parsed
+  std::unique_ptr<receive_buffer, buffer_release<receive_buffer>> m_buffer{};
+  // pieces of a file on their way to a stream without sendfile(2) or of a
+  // streamed body, only held while such a body is sent
+  std::unique_ptr<chunk_buffer, buffer_release<chunk_buffer>> m_chunk_buffer{};
+  // unparsed bytes of the receive buffer are [m_input_begin, m_input_end),
+  // pipelined requests wait there until the previous batch is sent
+  std::size_t m_input_begin{};
+  std::size_t m_input_end{};
+  // the request being received starts at m_request_begin, m_request points
+  // into its header up to m_header_end while the body is streamed
+  std::size_t m_request_begin{};
+  std::size_t m_header_end{};
+  // bytes of the request body still to be received
+  std::size_t m_body_remaining{};
+  // the chunked request body is being received, m_chunks decodes it in place
+  bool m_reading_chunks{};
+  chunked_decoder m_chunks{};
+  // sink of the request body, from the request_handler
+  std::unique_ptr<body_sink> m_body{};
+  // a request is partially received
+  bool m_partial{};
 
-  // for o(1) push_back and o(1) pop_front and begin()/end() iteration
-  std::list<asio::const_buffer> m_send_buffers{};
+  // responses waiting to be written, a span of it goes to async_write_some()
+  send_queue m_send_buffers{};
 
-  std::shared_ptr<request> m_request{};
-  std::shared_ptr<response> m_response{};
+  request m_request{};
+  // responses of the batch in request order, m_responses is only ever grown so
+  // the strings and maps of the responses are reused
+  std::vector<response> m_responses{};
+  std::size_t m_response_count{};
+  // responses of the batch in the send buffers, the last one queued is the
+  // one being streamed while m_streaming is set
+  std::size_t m_queued{};
+  bool m_streaming{};
   bool m_keep_alive{};
+  // responses flushed by one gathered write at most
+  static constexpr std::size_t MAX_PIPELINED = 32;
+
+  asio::any_io_executor m_executor;
+  std::shared_ptr<timer_wheel> m_wheel;
+  // idle, request and shutdown deadline, declared after m_wheel so it is
+  // unlinked before the wheel can go away
+  timer_wheel::entry m_deadline;
+  // 无连接 m_timeout 后关闭连接，一个请求也必须在 m_timeout 内收完
+  clock::duration m_timeout;
+  bool m_timed_out{};
+  bool m_shutting_down{};
+  // 优雅关闭最多等待 30s
+  static constexpr auto SHUTDOWN_TIMEOUT = std::chrono::seconds(30);
+
+private:
+  friend class connection_manager;
+  // intrusive list of the live connections of the connection_manager, guarded
+  // by its mutex
+  base_connection *m_manager_prev{};
+  base_connection *m_manager_next{};
+  bool m_managed{};
 };
 
 using connection_ptr = std::shared_ptr<base_connection>;
 
 } // namespace server
-} // namespace http
\ No newline at end of file
+} // namespace http
@@ -0,0 +1,171 @@
+#include "basic_connection.hpp"
+#include "connection_manager.hpp"
+
+#include <spdlog/spdlog.h>
+
+namespace http {
+namespace server {
+
+template <typename Stream>
+basic_connection<Stream>::basic_connection(
+    private_tag, stream stream, std::shared_ptr<connection_manager> manager,
+    std::shared_ptr<request_handler> handler, std::shared_ptr<timer_wheel> wheel,
+    parser_backend backend, const header_limits &limits)
+    : base_connection(stream.get_executor(), manager, handler, wheel, backend,
+                      limits, traits::timeout),
+      m_stream(std::move(stream)) {}
+
+template <typename Stream> void basic_connection<Stream>::start() {
+  auto self = std::static_pointer_cast<basic_connection>(shared_from_this());
+  asio::co_spawn(m_executor, run(std::move(self)), on_loop_exit);
+}
+
+template <typename Stream>
+asio::awaitable<void>
+basic_connection<Stream>::run(std::shared_ptr<basic_connection> self) {
+  asio::error_code err;
+  expire_after(m_timeout);
+  if constexpr (traits::has_handshake) {
+    co_await traits::handshake(m_stream, err);
+    if (err) {
+      spdlog::error("error during handshake {}: {}", err.category().name(),
+                    err.message());
+    }
+  }
+  while (!err) {
+    if (!has_input()) {
+      // reading a header does not push the deadline back, a slow sender has
+      // m_timeout to deliver it, a body only has to keep moving
+      if (reading_body()) {
+        expire_after(m_timeout);
+      } else if (!m_partial) {
+        expire_after(m_timeout);
+        if constexpr (traits::wait_before_read) {
+          // an idle connection holds no receive buffer
+          co_await traits::socket(m_stream).async_wait(
+              asio::socket_base::wait_read,
+              asio::redirect_error(asio::use_awaitable, err));
+          if (err) {
+            break;
+          }
+        }
+      }
+      acquire_buffer();
+      size_t bytes_transferred = co_await m_stream.async_read_some(
+          prepare_read(),
+          asio::redirect_error(asio::use_awaitable, err));
+      if (err) {
+        break;
+      }
+      on_data_received(bytes_transferred);
+    }
+    if (reading_body()) {
+      // nothing more is read before the sink took the chunk
+      asio::error_code body_err;
+      std::string_view chunk = take_body_chunk(body_err);
+      if (!body_err && !chunk.empty()) {
+        co_await m_body->write(chunk, body_err);
+      }
+      if (body_err) {
+        on_body_failed(body_err);
+      } else if (!reading_body()) {
+        on_body_finished();
+      }
+    }
+    if (!process_input()) {
+      continue;
+    }
+    if (!has_input() && !m_partial) {
+      release_buffer();
+    }
+    // the responses of all requests parsed so far go out in one gathered
+    // write, up to a file, which goes out on its own, or up to a streamed
+    // body, which is pulled piece by piece as the stream drains
+    while (!err && (!m_send_buffers.empty() || streaming())) {
+      expire_after(m_timeout);
+      if (m_send_buffers.empty()) {
+        co_await pull_stream(err);
+        continue;
+      }
+      if (const send_queue::file_part *file = m_send_buffers.next_file()) {
+        size_t bytes_transferred = co_await send_file(*file, err);
+        if (!err) {
+          on_data_sent(bytes_transferred);
+        }
+        continue;
+      }
+      size_t bytes_transferred = co_await m_stream.async_write_some(
+          m_send_buffers.batch(),
+          asio::redirect_error(asio::use_awaitable, err));
+      if (!err) {
+        on_data_sent(bytes_transferred);
+      }
+    }
+    if (err) {
+      break;
+    }
+    spdlog::info("finish sending");
+    if (!m_keep_alive) {
+      break;
+    }
+    clear();
+  }
+
+  if (on_loop_finished(err)) {
+    co_await traits::shutdown(m_stream, err);
+  }
+  m_manager->stop(self);
+}
+
+template <typename Stream>
+asio::awaitable<std::size_t>
+basic_connection<Stream>::send_file(const send_queue::file_part &file,
+                                    asio::error_code &err) {
+  if constexpr (traits::zero_copy) {
+    auto &socket = traits::socket(m_stream);
+    if (!socket.native_non_blocking()) {
+      socket.native_non_blocking(true, err);
+      if (err) {
+        co_return 0;
+      }
+    }
+    std::size_t sent = file_body::send(socket.native_handle(), file.fd,
+                                       file.offset, file.size, err);
+    if (err == asio::error::would_block) {
+      co_await socket.async_wait(asio::socket_base::wait_write,
+                                 asio::redirect_error(asio::use_awaitable, err));
+    }
+    co_return sent;
+  } else {
+    asio::const_buffer chunk = read_file_chunk(file, err);
+    if (err) {
+      co_return 0;
+    }
+    co_return co_await asio::async_write(
+        m_stream, chunk, asio::redirect_error(asio::use_awaitable, err));
+  }
+}
+
+template <typename Stream> void basic_connection<Stream>::cancel() {
+  asio::error_code err;
+  traits::socket(m_stream).cancel(err);
+}
+
+template <typename Stream> void basic_connection<Stream>::close() {
+  asio::error_code err;
+  // close 就会强制关闭（也就是 RST报文）
+  traits::socket(m_stream).close(err);
+}
+
+template class basic_connection<asio::ip::tcp::socket>;
+template class basic_connection<asio::ssl::stream<asio::ip::tcp::socket>>;
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+template class basic_connection<asio::local::stream_protocol::socket>;
+#endif
+#if defined(MY_SERVER_IO_URING)
+template class basic_connection<uring_socket>;
+template class basic_connection<asio::ssl::stream<uring_socket>>;
+#endif
+
+} // namespace server
+} // namespace http
@@ -0,0 +1,188 @@
+#pragma once
+
+#include "base_connection.hpp"
+#include "file_body.hpp"
+#include "pool_allocator.hpp"
+#if defined(MY_SERVER_IO_URING)
+#include "uring_socket.hpp"
+#endif
+#include <asio.hpp>
+#include <asio/ssl.hpp>
+#include <chrono>
+#include <memory>
+#include <span>
+
+namespace http {
+namespace server {
+
+/// Compile time description of a stream: how long an idle connection is kept,
+/// how to reach the underlying socket and how to open and close the stream.
+template <typename Stream> struct stream_traits;
+
+/// Plain stream sockets, i.e. tcp and unix domain sockets.
+template <typename Protocol, typename Executor>
+struct stream_traits<asio::basic_stream_socket<Protocol, Executor>> {
+  using stream = asio::basic_stream_socket<Protocol, Executor>;
+
+  // 无连接 15s 后关闭连接
+  static constexpr auto timeout = std::chrono::seconds(15);
+
+  static constexpr bool has_handshake = false;
+
+  /// Wait until the socket is readable before a receive buffer is borrowed.
+  static constexpr bool wait_before_read = true;
+
+  /// Files go from the page cache to the socket with sendfile(2).
+  static constexpr bool zero_copy = file_body::HAS_SENDFILE;
+
+  static stream &socket(stream &s) { return s; }
+
+  static asio::awaitable<void> handshake(stream &, asio::error_code &err) {
+    err.clear();
+    co_return;
+  }
+
+  static asio::awaitable<void> shutdown(stream &s, asio::error_code &err) {
+    // 由服务端主动关闭，如何让客户端主动关闭请求呢？
+    // 发送一个 Connection: close 报文？
+    s.shutdown(stream::shutdown_both, err);
+    co_return;
+  }
+};
+
+#if defined(MY_SERVER_IO_URING)
+/// A TCP socket served by the io_uring of its shard.
+template <> struct stream_traits<uring_socket> {
+  using stream = uring_socket;
+
+  static constexpr auto timeout = std::chrono::seconds(15);
+
+  static constexpr bool has_handshake = false;
+
+  /// The data waits in the buffer ring until the connection borrows its
+  /// receive buffer.
+  static constexpr bool wait_before_read = true;
+
+  // the socket has no descriptor of its own, files go through a buffer
+  static constexpr bool zero_copy = false;
+
+  static stream &socket(stream &s) { return s; }
+
+  static asio::awaitable<void> handshake(stream &, asio::error_code &err) {
+    err.clear();
+    co_return;
+  }
+
+  static asio::awaitable<void> shutdown(stream &s, asio::error_code &err) {
+    s.shutdown(asio::socket_base::shutdown_both, err);
+    co_return;
+  }
+};
+#endif
+
+/// TLS on top of a stream socket.
+template <typename Socket> struct stream_traits<asio::ssl::stream<Socket>> {
+  using stream = asio::ssl::stream<Socket>;
+
+  // 无连接 5s 后关闭连接
+  static constexpr auto timeout = std::chrono::seconds(5);
+
+  static constexpr bool has_handshake = true;
+
+  // the engine may already hold decrypted records that the socket knows
+  // nothing about, so the buffer is borrowed right away
+  static constexpr bool wait_before_read = false;
+
+  // files are encrypted like everything else, they go through a buffer
+  static constexpr bool zero_copy = false;
+
+  static typename stream::lowest_layer_type &socket(stream &s) {
+    return s.lowest_layer();
+  }
+
+  static asio::awaitable<void> handshake(stream &s, asio::error_code &err) {
+    co_await s.async_handshake(asio::ssl::stream_base::server,
+                               asio::redirect_error(asio::use_awaitable, err));
+  }
+
+  // error from: https://www.cnblogs.com/langtianya/p/6648100.html
+  // https://ask.wireshark.org/question/10060/keep-alive-packets-after-fin/
+  static asio::awaitable<void> shutdown(stream &s, asio::error_code &err) {
+    // 此处 shutdown 会让客户端主动关闭连接，由于会发送连接，需要异步 shutdown
+    // 超时后由 base_connection 直接关闭
+    co_await s.async_shutdown(asio::redirect_error(asio::use_awaitable, err));
+  }
+};
+
+/// A connection over `Stream`, the connection loop is compiled once per
+/// stream type so every read and write completes without a virtual call.
+template <typename Stream> class basic_connection final : public base_connection {
+  /// Only create() can name it, the constructor is public for allocate_shared.
+  struct private_tag {
+    explicit private_tag() = default;
+  };
+
+public:
+  using stream = Stream;
+  using traits = stream_traits<Stream>;
+
+  /// Connections of a thread are recycled through its pool_allocator, the
+  /// control block, the connection and its parser, request and response are
+  /// one block. Request headers are parsed by `backend` within `limits`.
+  static std::shared_ptr<basic_connection>
+  create(stream stream, std::shared_ptr<connection_manager> manager,
+         std::shared_ptr<request_handler> handler,
+         std::shared_ptr<timer_wheel> wheel, parser_backend backend,
+         const header_limits &limits) {
+    return std::allocate_shared<basic_connection>(
+        pool_allocator<basic_connection>(), private_tag(), std::move(stream),
+        manager, handler, wheel, backend, limits);
+  }
+
+  basic_connection(private_tag, stream stream,
+                   std::shared_ptr<connection_manager> manager,
+                   std::shared_ptr<request_handler> handler,
+                   std::shared_ptr<timer_wheel> wheel, parser_backend backend,
+                   const header_limits &limits);
+
+  virtual void start();
+
+protected:
+  /// The connection loop, `self` is the only strong reference it holds.
+  asio::awaitable<void> run(std::shared_ptr<basic_connection> self);
+
+  /// Send a piece of the file the send queue stops at, returns the number of
+  /// bytes sent, 0 after waiting for the socket to drain.
+  asio::awaitable<std::size_t> send_file(const send_queue::file_part &file,
+                                         asio::error_code &err);
+
+  virtual void cancel();
+  virtual void close();
+
+protected:
+  stream m_stream;
+};
+
+extern template class basic_connection<asio::ip::tcp::socket>;
+extern template class basic_connection<
+    asio::ssl::stream<asio::ip::tcp::socket>>;
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+extern template class basic_connection<asio::local::stream_protocol::socket>;
+#endif
+#if defined(MY_SERVER_IO_URING)
+extern template class basic_connection<uring_socket>;
+extern template class basic_connection<asio::ssl::stream<uring_socket>>;
+#endif
+
+using connection = basic_connection<asio::ip::tcp::socket>;
+using ssl_connection = basic_connection<asio::ssl::stream<asio::ip::tcp::socket>>;
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+using local_connection = basic_connection<asio::local::stream_protocol::socket>;
+#endif
+#if defined(MY_SERVER_IO_URING)
+using uring_connection = basic_connection<uring_socket>;
+using ssl_uring_connection = basic_connection<asio::ssl::stream<uring_socket>>;
+#endif
+
+} // namespace server
+} // namespace http
@@ -0,0 +1,44 @@
+#include "body_sink.hpp"
+
+#include <cerrno>
+
+namespace http {
+namespace server {
+
+asio::awaitable<void> memory_sink::write(std::string_view chunk,
+                                         asio::error_code &err) {
+  err.clear();
+  if (m_data.size() + chunk.size() > m_limit) {
+    err = asio::error::message_size;
+    co_return;
+  }
+  m_data.append(chunk);
+  m_size += chunk.size();
+  co_return;
+}
+
+file_sink::file_sink() : m_file(std::tmpfile(), &std::fclose) {}
+
+asio::awaitable<void> file_sink::write(std::string_view chunk,
+                                       asio::error_code &err) {
+  err.clear();
+  // chunks are at most a receive buffer, a blocking write into the page cache
+  // is cheaper than handing it to another thread
+  if (!m_file ||
+      std::fwrite(chunk.data(), 1, chunk.size(), m_file.get()) != chunk.size()) {
+    err = asio::error_code(errno ? errno : EIO, asio::error::get_system_category());
+    co_return;
+  }
+  m_size += chunk.size();
+  co_return;
+}
+
+asio::awaitable<void> discard_sink::write(std::string_view chunk,
+                                          asio::error_code &err) {
+  err.clear();
+  m_size += chunk.size();
+  co_return;
+}
+
+} // namespace server
+} // namespace http
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <asio.hpp>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace http {
+namespace server {
+
+/// Where the body of a request goes. The request_handler picks one once the
+/// header is parsed, the connection then streams the body into it chunk by
+/// chunk and only reads on after a chunk was taken, so a slow sink slows the
+/// client down instead of piling up memory.
+class body_sink {
+public:
+  body_sink() = default;
+  body_sink(const body_sink &) = delete;
+  body_sink &operator=(const body_sink &) = delete;
+  virtual ~body_sink() = default;
+
+  /// Take the next chunk of the body. `chunk` points into the receive buffer
+  /// and is only valid until the returned awaitable completes. Set `err` to
+  /// reject the body, the connection answers with an error and closes then.
+  virtual asio::awaitable<void> write(std::string_view chunk,
+                                      asio::error_code &err) = 0;
+
+  /// Number of body bytes taken so far.
+  std::size_t size() const { return m_size; }
+
+protected:
+  std::size_t m_size{};
+};
+
+/// Keeps the body in memory, bodies above `limit` are rejected with
+/// asio::error::message_size.
+class memory_sink : public body_sink {
+public:
+  explicit memory_sink(std::size_t limit) : m_limit(limit) {}
+
+  asio::awaitable<void> write(std::string_view chunk,
+                              asio::error_code &err) override;
+
+  const std::string &data() const { return m_data; }
+
+private:
+  std::size_t m_limit;
+  std::string m_data;
+};
+
+/// Spills the body into an anonymous temporary file, removed once the sink
+/// goes away.
+class file_sink : public body_sink {
+public:
+  file_sink();
+
+  asio::awaitable<void> write(std::string_view chunk,
+                              asio::error_code &err) override;
+
+  /// The temporary file, positioned after the last written byte.
+  std::FILE *file() const { return m_file.get(); }
+
+private:
+  std::unique_ptr<std::FILE, int (*)(std::FILE *)> m_file;
+};
+
+/// Drops the body, only counts it.
+class discard_sink : public body_sink {
+public:
+  asio::awaitable<void> write(std::string_view chunk,
+                              asio::error_code &err) override;
+};
+
+} // namespace server
+} // namespace http
@@ -0,0 +1,13 @@
+#include "body_source.hpp"
+
+namespace http {
+namespace server {
+
+asio::awaitable<std::size_t> callback_source::read(std::span<char> out,
+                                                   asio::error_code &err) {
+  err.clear();
+  co_return m_produce(out, err);
+}
+
+} // namespace server
+} // namespace http
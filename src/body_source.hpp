@@ -0,0 +1,50 @@
+#pragma once
+
+#include <asio.hpp>
+#include <cstddef>
+#include <functional>
+#include <span>
+
+namespace http {
+namespace server {
+
+/// Where the body of a streamed response comes from. A handler sets one on
+/// the response instead of content, the connection then pulls the body piece
+/// by piece and asks for the next piece only after the previous one was
+/// written, so a body of any length flows with one buffer of memory and at
+/// the pace of the client. The length is not known up front, the body goes
+/// out with the chunked transfer coding.
+class body_source {
+public:
+  body_source() = default;
+  body_source(const body_source &) = delete;
+  body_source &operator=(const body_source &) = delete;
+  virtual ~body_source() = default;
+
+  /// Produce the next piece of the body into `out`, returns the number of
+  /// bytes written to it, 0 once the body is complete. `out` is only valid
+  /// until the returned awaitable completes, a coroutine may wait for data
+  /// meanwhile, as long as it stays within the timeout of the connection. Set
+  /// `err` to abort the body, the connection is closed then.
+  virtual asio::awaitable<std::size_t> read(std::span<char> out,
+                                            asio::error_code &err) = 0;
+};
+
+/// Pulls the body from a plain function, called on the thread of the
+/// connection for every piece.
+class callback_source : public body_source {
+public:
+  using callback =
+      std::function<std::size_t(std::span<char> out, asio::error_code &err)>;
+
+  explicit callback_source(callback produce) : m_produce(std::move(produce)) {}
+
+  asio::awaitable<std::size_t> read(std::span<char> out,
+                                    asio::error_code &err) override;
+
+private:
+  callback m_produce;
+};
+
+} // namespace server
+} // namespace http
@@ -0,0 +1,269 @@
+#include "char_scan.hpp"
+
+#if (defined(__GNUC__) || defined(__clang__)) &&                               \
+    (defined(__x86_64__) || defined(__i386__))
+#define CHAR_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace http {
+namespace server {
+namespace char_scan {
+
+namespace {
+
+using scan_fn = std::size_t (*)(const char *, std::size_t);
+
+std::size_t token_scalar(const char *p, std::size_t n) {
+  std::size_t i = 0;
+  while (i < n && TCHAR[static_cast<std::uint8_t>(p[i])]) {
+    i++;
+  }
+  return i;
+}
+
+std::size_t target_scalar(const char *p, std::size_t n) {
+  std::size_t i = 0;
+  for (; i < n; i++) {
+    auto ch = static_cast<std::uint8_t>(p[i]);
+    if (ch <= 0x20 || ch == 0x7f) {
+      break;
+    }
+  }
+  return i;
+}
+
+std::size_t field_value_scalar(const char *p, std::size_t n) {
+  std::size_t i = 0;
+  for (; i < n; i++) {
+    auto ch = static_cast<std::uint8_t>(p[i]);
+    if ((ch < 0x20 && ch != '\t') || ch == 0x7f) {
+      break;
+    }
+  }
+  return i;
+}
+
+#ifdef CHAR_SCAN_X86
+
+// tchar as a bitmap for pshufb: the low nibble of a byte picks a byte of
+// TCHAR_LOW, the high nibble picks the bit of that byte. Bytes from 0x80 on
+// pick no bit and are never tchar.
+struct nibble_tables {
+  alignas(16) std::uint8_t low[16];
+  alignas(16) std::uint8_t high[16];
+};
+
+constexpr nibble_tables TCHAR_NIBBLES = []() {
+  nibble_tables t{};
+  for (int ch = 0; ch < 0x80; ch++) {
+    if (TCHAR[ch]) {
+      t.low[ch & 0x0f] |= static_cast<std::uint8_t>(1u << (ch >> 4));
+    }
+  }
+  for (int hi = 0; hi < 8; hi++) {
+    t.high[hi] = static_cast<std::uint8_t>(1u << hi);
+  }
+  return t;
+}();
+
+inline unsigned first_bit(unsigned mask) { return __builtin_ctz(mask); }
+
+__attribute__((target("sse4.2"))) std::size_t token_sse42(const char *p,
+                                                          std::size_t n) {
+  const __m128i low_table = _mm_load_si128(
+      reinterpret_cast<const __m128i *>(TCHAR_NIBBLES.low));
+  const __m128i high_table = _mm_load_si128(
+      reinterpret_cast<const __m128i *>(TCHAR_NIBBLES.high));
+  const __m128i nibble = _mm_set1_epi8(0x0f);
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+    __m128i low = _mm_shuffle_epi8(low_table, _mm_and_si128(v, nibble));
+    __m128i high = _mm_shuffle_epi8(
+        high_table, _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+    __m128i invalid =
+        _mm_cmpeq_epi8(_mm_and_si128(low, high), _mm_setzero_si128());
+    if (unsigned mask = _mm_movemask_epi8(invalid)) {
+      return i + first_bit(mask);
+    }
+  }
+  return i + token_scalar(p + i, n - i);
+}
+
+__attribute__((target("sse4.2"))) std::size_t target_sse42(const char *p,
+                                                           std::size_t n) {
+  const __m128i space = _mm_set1_epi8(0x20);
+  const __m128i del = _mm_set1_epi8(0x7f);
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+    // v <= 0x20 as unsigned bytes
+    __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(v, space), v);
+    __m128i invalid = _mm_or_si128(control, _mm_cmpeq_epi8(v, del));
+    if (unsigned mask = _mm_movemask_epi8(invalid)) {
+      return i + first_bit(mask);
+    }
+  }
+  return i + target_scalar(p + i, n - i);
+}
+
+__attribute__((target("sse4.2"))) std::size_t
+field_value_sse42(const char *p, std::size_t n) {
+  const __m128i below_space = _mm_set1_epi8(0x1f);
+  const __m128i tab = _mm_set1_epi8('\t');
+  const __m128i del = _mm_set1_epi8(0x7f);
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+    __m128i control = _mm_andnot_si128(
+        _mm_cmpeq_epi8(v, tab), _mm_cmpeq_epi8(_mm_min_epu8(v, below_space), v));
+    __m128i invalid = _mm_or_si128(control, _mm_cmpeq_epi8(v, del));
+    if (unsigned mask = _mm_movemask_epi8(invalid)) {
+      return i + first_bit(mask);
+    }
+  }
+  return i + field_value_scalar(p + i, n - i);
+}
+
+__attribute__((target("avx2"))) std::size_t token_avx2(const char *p,
+                                                       std::size_t n) {
+  const __m256i low_table = _mm256_broadcastsi128_si256(_mm_load_si128(
+      reinterpret_cast<const __m128i *>(TCHAR_NIBBLES.low)));
+  const __m256i high_table = _mm256_broadcastsi128_si256(_mm_load_si128(
+      reinterpret_cast<const __m128i *>(TCHAR_NIBBLES.high)));
+  const __m256i nibble = _mm256_set1_epi8(0x0f);
+  std::size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+    __m256i low = _mm256_shuffle_epi8(low_table, _mm256_and_si256(v, nibble));
+    __m256i high = _mm256_shuffle_epi8(
+        high_table, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+    __m256i invalid = _mm256_cmpeq_epi8(_mm256_and_si256(low, high),
+                                        _mm256_setzero_si256());
+    if (unsigned mask = _mm256_movemask_epi8(invalid)) {
+      return i + first_bit(mask);
+    }
+  }
+  return i + token_sse42(p + i, n - i);
+}
+
+__attribute__((target("avx2"))) std::size_t target_avx2(const char *p,
+                                                        std::size_t n) {
+  const __m256i space = _mm256_set1_epi8(0x20);
+  const __m256i del = _mm256_set1_epi8(0x7f);
+  std::size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+    __m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(v, space), v);
+    __m256i invalid = _mm256_or_si256(control, _mm256_cmpeq_epi8(v, del));
+    if (unsigned mask = _mm256_movemask_epi8(invalid)) {
+      return i + first_bit(mask);
+    }
+  }
+  return i + target_sse42(p + i, n - i);
+}
+
+__attribute__((target("avx2"))) std::size_t
+field_value_avx2(const char *p, std::size_t n) {
+  const __m256i below_space = _mm256_set1_epi8(0x1f);
+  const __m256i tab = _mm256_set1_epi8('\t');
+  const __m256i del = _mm256_set1_epi8(0x7f);
+  std::size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+    __m256i control =
+        _mm256_andnot_si256(_mm256_cmpeq_epi8(v, tab),
+                            _mm256_cmpeq_epi8(_mm256_min_epu8(v, below_space), v));
+    __m256i invalid = _mm256_or_si256(control, _mm256_cmpeq_epi8(v, del));
+    if (unsigned mask = _mm256_movemask_epi8(invalid)) {
+      return i + first_bit(mask);
+    }
+  }
+  return i + field_value_sse42(p + i, n - i);
+}
+
+#endif
+
+bool supported(isa set) {
+  switch (set) {
+  case isa::scalar:
+    return true;
+#ifdef CHAR_SCAN_X86
+  case isa::sse42:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2");
+  case isa::avx2:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+  default:
+    return false;
+  }
+}
+
+struct scanners {
+  isa set;
+  scan_fn token;
+  scan_fn target;
+  scan_fn field_value;
+};
+
+scanners make_scanners(isa set) {
+  switch (set) {
+#ifdef CHAR_SCAN_X86
+  case isa::avx2:
+    return {set, token_avx2, target_avx2, field_value_avx2};
+  case isa::sse42:
+    return {set, token_sse42, target_sse42, field_value_sse42};
+#endif
+  default:
+    return {isa::scalar, token_scalar, target_scalar, field_value_scalar};
+  }
+}
+
+scanners &current() {
+  static scanners s = make_scanners(supported(isa::avx2)    ? isa::avx2
+                                    : supported(isa::sse42) ? isa::sse42
+                                                            : isa::scalar);
+  return s;
+}
+
+} // namespace
+
+std::size_t token(std::string_view data) {
+  return current().token(data.data(), data.size());
+}
+
+std::size_t target(std::string_view data) {
+  return current().target(data.data(), data.size());
+}
+
+std::size_t field_value(std::string_view data) {
+  return current().field_value(data.data(), data.size());
+}
+
+isa active() { return current().set; }
+
+bool use(isa set) {
+  if (!supported(set)) {
+    return false;
+  }
+  current() = make_scanners(set);
+  return true;
+}
+
+std::string_view name(isa set) {
+  switch (set) {
+  case isa::avx2:
+    return "avx2";
+  case isa::sse42:
+    return "sse4.2";
+  default:
+    return "scalar";
+  }
+}
+
+} // namespace char_scan
+} // namespace server
+} // namespace http
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace http {
+namespace server {
+
+/// Finds the end of a run of valid characters in the request header, 16 or 32
+/// bytes at a time where the cpu allows. The request_parser copies whole runs
+/// and only walks its state machine over the byte ending a run (SP, CR, ':'
+/// or an invalid one).
+namespace char_scan {
+
+/// Instruction sets a scan can run on, picked once at startup from what the
+/// cpu supports.
+enum class isa { scalar, sse42, avx2 };
+
+/// tchar of RFC 9110, the characters of a method and a field name.
+inline constexpr std::array<bool, 256> TCHAR = []() {
+  std::array<bool, 256> table{};
+  for (int ch = '0'; ch <= '9'; ch++) {
+    table[ch] = true;
+  }
+  for (int ch = 'a'; ch <= 'z'; ch++) {
+    table[ch] = true;
+    table[ch - 'a' + 'A'] = true;
+  }
+  for (unsigned char ch : std::string_view("!#$%&'*+-.^_`|~")) {
+    table[ch] = true;
+  }
+  return table;
+}();
+
+inline bool is_tchar(std::uint8_t ch) { return TCHAR[ch]; }
+
+inline constexpr std::uint8_t NOT_HEX = 0xff;
+
+/// Value of a HEXDIG, upper or lower case, NOT_HEX for anything else.
+inline constexpr std::array<std::uint8_t, 256> HEX_VALUE = []() {
+  std::array<std::uint8_t, 256> table{};
+  for (auto &value : table) {
+    value = NOT_HEX;
+  }
+  for (int ch = '0'; ch <= '9'; ch++) {
+    table[ch] = static_cast<std::uint8_t>(ch - '0');
+  }
+  for (int ch = 'a'; ch <= 'f'; ch++) {
+    table[ch] = static_cast<std::uint8_t>(ch - 'a' + 10);
+    table[ch - 'a' + 'A'] = static_cast<std::uint8_t>(ch - 'a' + 10);
+  }
+  return table;
+}();
+
+/// Length of the leading run of tchar.
+std::size_t token(std::string_view data);
+
+/// Length of the leading run of request-target characters, anything but
+/// controls and SP.
+std::size_t target(std::string_view data);
+
+/// Length of the leading run of field value characters, VCHAR, obs-text, SP
+/// and HTAB.
+std::size_t field_value(std::string_view data);
+
+/// The instruction set the scans run on.
+isa active();
+
+/// Run the scans on `set`, false when the cpu does not support it. Meant for
+/// benchmarks and tests, not thread safe against running scans.
+bool use(isa set);
+
+/// Name of `set` for logs.
+std::string_view name(isa set);
+
+} // namespace char_scan
+} // namespace server
+} // namespace http
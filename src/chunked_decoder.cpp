@@ -0,0 +1,194 @@
+#include "chunked_decoder.hpp"
+#include "char_scan.hpp"
+
+#include <algorithm>
+
+namespace http {
+namespace server {
+
+namespace {
+
+using char_scan::HEX_VALUE;
+using char_scan::NOT_HEX;
+
+/// CTL but HTAB, also DEL.
+constexpr bool is_ctl(std::uint8_t ch) {
+  return (ch < 0x20 && ch != '\t') || ch == 0x7f;
+}
+
+} // namespace
+
+std::tuple<chunked_decoder::decode_result, size_t, std::string_view>
+chunked_decoder::decode(std::string_view data) {
+  if (m_state == done) {
+    return {DONE, 0, {}};
+  }
+  size_t pos = 0;
+  while (pos < data.size()) {
+    if (m_state == chunk_data) {
+      size_t size = static_cast<size_t>(
+          std::min<std::uint64_t>(m_remaining, data.size() - pos));
+      m_remaining -= size;
+      m_size += size;
+      if (m_remaining == 0) {
+        m_state = chunk_data_cr;
+      }
+      return {DATA, pos + size, data.substr(pos, size)};
+    }
+    // the usual framing, CRLF after the data and a size line without
+    // extensions, is taken without a trip through consume()
+    if (m_state == chunk_data_cr && data.size() - pos >= 2 &&
+        data[pos] == '\r' && data[pos + 1] == '\n') {
+      pos += 2;
+      m_state = chunk_size_start;
+      m_digits = 0;
+      m_line = 0;
+      continue;
+    }
+    if (m_state == chunk_size_start || m_state == chunk_size) {
+      size_t first = pos;
+      size_t end = std::min(data.size(), pos + (MAX_LINE - m_line));
+      for (std::uint8_t value;
+           pos < end &&
+           (value = HEX_VALUE[static_cast<std::uint8_t>(data[pos])]) !=
+               NOT_HEX;
+           pos++) {
+        // leading zeros do not count, the size has to fit 64 bits
+        if ((m_remaining > 0 || value > 0) && ++m_digits > 16) {
+          return {FAIL, pos, {}};
+        }
+        m_remaining = m_remaining * 16 + value;
+      }
+      m_line += pos - first;
+      if (pos > first) {
+        m_state = chunk_size;
+      }
+      if (pos == data.size()) {
+        break;
+      }
+      // the CR counts against MAX_LINE too
+      if (m_state == chunk_size && m_line < MAX_LINE &&
+          data.size() - pos >= 2 && data[pos] == '\r' &&
+          data[pos + 1] == '\n') {
+        pos += 2;
+        end_size_line();
+        continue;
+      }
+    }
+    if (!consume(static_cast<std::uint8_t>(data[pos]))) {
+      return {FAIL, pos, {}};
+    }
+    pos++;
+    if (m_state == done) {
+      return {DONE, pos, {}};
+    }
+  }
+  return {CONTINUE, pos, {}};
+}
+
+void chunked_decoder::end_size_line() {
+  if (m_remaining > 0) {
+    m_state = chunk_data;
+  } else {
+    m_line = 0;
+    m_state = trailer_start;
+  }
+}
+
+bool chunked_decoder::consume(std::uint8_t ch) {
+  switch (m_state) {
+  case chunk_size_start:
+    // decode() takes the digits
+    return false;
+  case chunk_size:
+    if (++m_line > MAX_LINE) {
+      return false;
+    }
+    if (ch == ';' || ch == ' ' || ch == '\t') {
+      m_state = chunk_ext;
+      return true;
+    }
+    if (ch == '\r') {
+      m_state = chunk_size_lf;
+      return true;
+    }
+    return false;
+  case chunk_ext:
+    // BWS ";" chunk-ext-name [ BWS "=" BWS chunk-ext-val ], not interpreted
+    if (++m_line > MAX_LINE) {
+      return false;
+    }
+    if (ch == '\r') {
+      m_state = chunk_size_lf;
+      return true;
+    }
+    return !is_ctl(ch);
+  case chunk_size_lf:
+    if (ch != '\n') {
+      return false;
+    }
+    end_size_line();
+    return true;
+  case chunk_data:
+    // decode() hands the data out without looking at it
+    return false;
+  case chunk_data_cr:
+    if (ch != '\r') {
+      return false;
+    }
+    m_state = chunk_data_lf;
+    return true;
+  case chunk_data_lf:
+    if (ch != '\n') {
+      return false;
+    }
+    m_state = chunk_size_start;
+    m_digits = 0;
+    m_line = 0;
+    return true;
+  default:
+    break;
+  }
+  // the trailer section
+  if (++m_line > MAX_TRAILER) {
+    return false;
+  }
+  switch (m_state) {
+  case trailer_start:
+    if (ch == '\r') {
+      m_state = last_lf;
+      return true;
+    }
+    m_state = trailer_name;
+    return char_scan::is_tchar(ch);
+  case trailer_name:
+    if (ch == ':') {
+      m_state = trailer_value;
+      return true;
+    }
+    return char_scan::is_tchar(ch);
+  case trailer_value:
+    if (ch == '\r') {
+      m_state = trailer_lf;
+      return true;
+    }
+    return !is_ctl(ch);
+  case trailer_lf:
+    if (ch != '\n') {
+      return false;
+    }
+    m_state = trailer_start;
+    return true;
+  case last_lf:
+    if (ch != '\n') {
+      return false;
+    }
+    m_state = done;
+    return true;
+  default:
+    return false;
+  }
+}
+
+} // namespace server
+} // namespace http
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <tuple>
+
+namespace http {
+namespace server {
+
+/// Decoder of the chunked transfer coding of RFC 9112 section 7.1. Fed the
+/// bytes following the header as they arrive, in pieces of any size, it hands
+/// out the chunk data as views into its input. Chunk sizes, extensions and
+/// trailer fields are consumed in place and never copied, the state between
+/// two pieces is a handful of integers, so the consumed input may be reused
+/// right away. Trailer fields are checked and dropped, RFC 9110 section 6.5.1
+/// allows a recipient to discard them.
+class chunked_decoder {
+public:
+  enum decode_result {
+    /// A piece of chunk data was found.
+    DATA,
+    /// The last chunk and the trailer section were consumed.
+    DONE,
+    /// The input is no chunked body.
+    FAIL,
+    /// The input was consumed without finding chunk data.
+    CONTINUE,
+  };
+
+  /// Longest chunk size line with its extensions.
+  static constexpr std::size_t MAX_LINE = 4096;
+  /// Longest trailer section.
+  static constexpr std::size_t MAX_TRAILER = 8192;
+
+  /// Reset to the start of a chunked body.
+  void clear() { *this = chunked_decoder(); }
+
+  /// Decode from the front of `data` up to the next piece of chunk data.
+  /// Returns the result, the number of bytes of `data` consumed and for DATA
+  /// the chunk data, the last bytes consumed. On FAIL the position is that of
+  /// the offending byte.
+  std::tuple<decode_result, size_t, std::string_view>
+  decode(std::string_view data);
+
+  /// Bytes of chunk data decoded so far.
+  std::uint64_t size() const { return m_size; }
+
+private:
+  enum decoder_state : std::uint8_t {
+    chunk_size_start,
+    chunk_size,
+    chunk_ext,
+    chunk_size_lf,
+    chunk_data,
+    chunk_data_cr,
+    chunk_data_lf,
+    trailer_start,
+    trailer_name,
+    trailer_value,
+    trailer_lf,
+    last_lf,
+    done,
+  };
+
+  /// Take one byte of framing, false when it is invalid.
+  bool consume(std::uint8_t ch);
+
+  /// The chunk size line ended, on to the data or the trailer section.
+  void end_size_line();
+
+  decoder_state m_state{chunk_size_start};
+  // hex digits of the chunk size seen so far
+  std::uint8_t m_digits{};
+  // bytes of the current chunk size line or of the trailer section
+  std::size_t m_line{};
+  // chunk data left in the current chunk
+  std::uint64_t m_remaining{};
+  std::uint64_t m_size{};
+};
+
+} // namespace server
+} // namespace http
@@ -1,6 +1,7 @@
 #include "connection_manager.hpp"
 #include "base_connection.hpp"
 #include <spdlog/spdlog.h>
+#include <vector>
 
 namespace http {
 namespace server {
@@ -8,21 +9,68 @@ namespace server {
 connection_manager::connection_manager() {}
 
 void connection_manager::start(connection_ptr c) {
-  m_connections.insert(c);
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    c->m_manager_prev = nullptr;
+    c->m_manager_next = m_head;
+    if (m_head) {
+      m_head->m_manager_prev = c.get();
+    }
+    m_head = c.get();
+    c->m_managed = true;
+    ++m_count;
+  }
   c->start();
 }
 
 void connection_manager::stop(connection_ptr c) {
-  m_connections.erase(c);
+  remove(c.get());
   c->stop();
 }
 
+void connection_manager::remove(base_connection *c) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  unlink(c);
+}
+
+void connection_manager::unlink(base_connection *c) {
+  if (!c->m_managed) {
+    return;
+  }
+  if (c->m_manager_prev) {
+    c->m_manager_prev->m_manager_next = c->m_manager_next;
+  } else {
+    m_head = c->m_manager_next;
+  }
+  if (c->m_manager_next) {
+    c->m_manager_next->m_manager_prev = c->m_manager_prev;
+  }
+  c->m_manager_prev = c->m_manager_next = nullptr;
+  c->m_managed = false;
+  --m_count;
+}
+
 void connection_manager::stop_all() {
-  spdlog::info("close {} connections", m_connections.size());
-  for (auto c : m_connections) {
+  std::vector<connection_ptr> connections;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    connections.reserve(m_count);
+    while (m_head) {
+      base_connection *c = m_head;
+      unlink(c);
+      // a connection whose last reference is being dropped right now is
+      // already closed, its destructor waits for the lock to unlink
+      if (auto ptr = c->weak_from_this().lock()) {
+        connections.push_back(std::move(ptr));
+      }
+    }
+  }
+  spdlog::info("close {} connections", connections.size());
+  // connection::stop() hops onto the strand of the connection by itself, so
+  // no lock is held here
+  for (auto c : connections) {
     c->stop();
   }
-  m_connections.clear();
 }
 
 } // namespace server
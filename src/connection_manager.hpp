@@ -1,7 +1,7 @@
 #pragma once
 
 #include <memory>
-#include <unordered_set>
+#include <mutex>
 
 namespace http {
 namespace server {
@@ -18,15 +18,27 @@ public:
 
   connection_manager();
 
+  /// Register and start a connection, safe to call from any thread.
   void start(connection_ptr c);
 
+  /// Unregister and stop a connection, safe to call from any thread.
   void stop(connection_ptr c);
 
   void stop_all();
 
+  /// Unlink a connection that goes away without stop().
+  void remove(base_connection *c);
+
 private:
-  // TODO: 此处使用 priority_queue 来进行管理 ?
-  std::unordered_set<connection_ptr> m_connections;
+  void unlink(base_connection *c);
+
+  // connections are started by the acceptor and stopped from the strand of
+  // each connection, which may run on different threads
+  std::mutex m_mutex;
+  // intrusive list threaded through the connections, registering one does not
+  // allocate, each connection is owned by its loop and unlinks itself
+  base_connection *m_head{};
+  std::size_t m_count{};
 };
 
 } // namespace server
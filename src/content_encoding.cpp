@@ -0,0 +1,589 @@
+#include "content_encoding.hpp"
+#include "pool_allocator.hpp"
+#include "request.hpp"
+#include "response.hpp"
+#include "string_utils.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <new>
+#include <zlib.h>
+
+#if defined(MY_SERVER_BROTLI)
+#include <brotli/encode.h>
+#endif
+#if defined(MY_SERVER_ZSTD)
+#include <zstd.h>
+#endif
+
+namespace http {
+namespace server {
+
+namespace {
+
+constexpr std::string_view CODING_NAMES[CONTENT_CODINGS] = {
+    "identity", "gzip", "deflate", "br", "zstd"};
+
+// the order a tie between two acceptable codings is broken in, the most
+// savings for the least CPU first
+constexpr content_coding PREFERRED[] = {content_coding::zstd,
+                                        content_coding::br,
+                                        content_coding::gzip,
+                                        content_coding::deflate};
+
+/// A qvalue of RFC 9110 section 12.4.2 in thousandths, -1 when it is malformed.
+int parse_qvalue(std::string_view value) {
+  if (value.empty() || (value[0] != '0' && value[0] != '1')) {
+    return -1;
+  }
+  int weight = (value[0] - '0') * 1000;
+  if (value.size() == 1) {
+    return weight;
+  }
+  if (value[1] != '.' || value.size() > 5) {
+    return -1;
+  }
+  int scale = 100;
+  for (char ch : value.substr(2)) {
+    if (ch < '0' || ch > '9' || (weight == 1000 && ch != '0')) {
+      return -1;
+    }
+    weight += (ch - '0') * scale;
+    scale /= 10;
+  }
+  return weight;
+}
+
+/// gzip and deflate, which is the zlib format of RFC 1950 in HTTP.
+class zlib_encoder final : public encoder {
+public:
+  explicit zlib_encoder(content_coding coding) : encoder(coding) {
+    // 15 bits of window, 16 more for the gzip header and trailer
+    int window_bits = coding == content_coding::gzip ? 15 + 16 : 15;
+    if (deflateInit2(&m_stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, window_bits,
+                     8, Z_DEFAULT_STRATEGY) != Z_OK) {
+      throw std::bad_alloc();
+    }
+  }
+
+  ~zlib_encoder() override { deflateEnd(&m_stream); }
+
+  void reset(int level) override {
+    // keeps the window and the hash chains, only the stream starts over
+    deflateReset(&m_stream);
+    if (level != m_level) {
+      deflateParams(&m_stream, level, Z_DEFAULT_STRATEGY);
+      m_level = level;
+    }
+  }
+
+  result encode(std::string_view in, std::span<char> out, mode how,
+                asio::error_code &err) override {
+    auto in_size = static_cast<uInt>(std::min<std::size_t>(in.size(), UINT_MAX));
+    auto out_size =
+        static_cast<uInt>(std::min<std::size_t>(out.size(), UINT_MAX));
+    m_stream.next_in =
+        reinterpret_cast<Bytef *>(const_cast<char *>(in.data()));
+    m_stream.avail_in = in_size;
+    m_stream.next_out = reinterpret_cast<Bytef *>(out.data());
+    m_stream.avail_out = out_size;
+    int ret = deflate(&m_stream, how == more    ? Z_NO_FLUSH
+                                 : how == flush ? Z_SYNC_FLUSH
+                                                : Z_FINISH);
+    // Z_BUF_ERROR only says that nothing could be done this time
+    if (ret == Z_STREAM_ERROR) {
+      err = asio::error::invalid_argument;
+      return {};
+    }
+    result r;
+    r.consumed = in_size - m_stream.avail_in;
+    r.produced = out_size - m_stream.avail_out;
+    bool taken = r.consumed == in.size();
+    if (how == more) {
+      r.complete = taken;
+    } else if (how == finish) {
+      r.complete = ret == Z_STREAM_END;
+    } else {
+      r.complete = taken && m_stream.avail_out > 0;
+    }
+    return r;
+  }
+
+private:
+  z_stream m_stream{};
+  int m_level{Z_DEFAULT_COMPRESSION};
+};
+
+#if defined(MY_SERVER_BROTLI)
+/// br of RFC 7932. The library can not rewind an encoder, reset() creates
+/// the state of the next body, the pool only saves the wrapper.
+class brotli_encoder final : public encoder {
+public:
+  brotli_encoder() : encoder(content_coding::br) {}
+
+  ~brotli_encoder() override {
+    if (m_state) {
+      BrotliEncoderDestroyInstance(m_state);
+    }
+  }
+
+  void reset(int level) override {
+    if (m_state) {
+      BrotliEncoderDestroyInstance(m_state);
+    }
+    m_state = BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
+    if (!m_state) {
+      throw std::bad_alloc();
+    }
+    BrotliEncoderSetParameter(m_state, BROTLI_PARAM_QUALITY,
+                              static_cast<std::uint32_t>(level));
+  }
+
+  result encode(std::string_view in, std::span<char> out, mode how,
+                asio::error_code &err) override {
+    std::size_t avail_in = in.size();
+    auto next_in = reinterpret_cast<const std::uint8_t *>(in.data());
+    std::size_t avail_out = out.size();
+    auto next_out = reinterpret_cast<std::uint8_t *>(out.data());
+    BrotliEncoderOperation op = how == more ? BROTLI_OPERATION_PROCESS
+                                : how == flush ? BROTLI_OPERATION_FLUSH
+                                               : BROTLI_OPERATION_FINISH;
+    if (!BrotliEncoderCompressStream(m_state, op, &avail_in, &next_in,
+                                     &avail_out, &next_out, nullptr)) {
+      err = asio::error::invalid_argument;
+      return {};
+    }
+    result r;
+    r.consumed = in.size() - avail_in;
+    r.produced = out.size() - avail_out;
+    if (how == finish) {
+      r.complete = BrotliEncoderIsFinished(m_state);
+    } else {
+      r.complete = avail_in == 0 && (how == more ||
+                                     !BrotliEncoderHasMoreOutput(m_state));
+    }
+    return r;
+  }
+
+private:
+  BrotliEncoderState *m_state{};
+};
+#endif
+
+#if defined(MY_SERVER_ZSTD)
+/// zstd of RFC 8878, the context is kept and rewound.
+class zstd_encoder final : public encoder {
+public:
+  zstd_encoder() : encoder(content_coding::zstd), m_context(ZSTD_createCCtx()) {
+    if (!m_context) {
+      throw std::bad_alloc();
+    }
+  }
+
+  ~zstd_encoder() override { ZSTD_freeCCtx(m_context); }
+
+  void reset(int level) override {
+    ZSTD_CCtx_reset(m_context, ZSTD_reset_session_only);
+    ZSTD_CCtx_setParameter(m_context, ZSTD_c_compressionLevel, level);
+  }
+
+  result encode(std::string_view in, std::span<char> out, mode how,
+                asio::error_code &err) override {
+    ZSTD_inBuffer input{in.data(), in.size(), 0};
+    ZSTD_outBuffer output{out.data(), out.size(), 0};
+    ZSTD_EndDirective directive = how == more    ? ZSTD_e_continue
+                                  : how == flush ? ZSTD_e_flush
+                                                 : ZSTD_e_end;
+    std::size_t remaining =
+        ZSTD_compressStream2(m_context, &output, &input, directive);
+    if (ZSTD_isError(remaining)) {
+      err = asio::error::invalid_argument;
+      return {};
+    }
+    result r;
+    r.consumed = input.pos;
+    r.produced = output.pos;
+    r.complete = input.pos == in.size() && (how == more || remaining == 0);
+    return r;
+  }
+
+private:
+  ZSTD_CCtx *m_context;
+};
+#endif
+
+} // namespace
+
+std::string_view coding_name(content_coding coding) {
+  return CODING_NAMES[static_cast<std::size_t>(coding)];
+}
+
+bool coding_available(content_coding coding) {
+  switch (coding) {
+  case content_coding::gzip:
+  case content_coding::deflate:
+    return true;
+  case content_coding::br:
+#if defined(MY_SERVER_BROTLI)
+    return true;
+#else
+    return false;
+#endif
+  case content_coding::zstd:
+#if defined(MY_SERVER_ZSTD)
+    return true;
+#else
+    return false;
+#endif
+  case content_coding::identity:
+  default:
+    return false;
+  }
+}
+
+int compression_options::level(content_coding coding) const {
+  switch (coding) {
+  case content_coding::gzip:
+  case content_coding::deflate:
+    return zlib_level;
+  case content_coding::br:
+    return brotli_level;
+  case content_coding::zstd:
+    return zstd_level;
+  case content_coding::identity:
+  default:
+    return 0;
+  }
+}
+
+content_coding negotiate_coding(std::string_view accept_encoding) {
+  // weight per coding in thousandths, -1 when it is not listed
+  std::array<int, CONTENT_CODINGS> weights;
+  weights.fill(-1);
+  int any = -1;
+  while (!accept_encoding.empty()) {
+    std::size_t comma = accept_encoding.find(',');
+    std::string_view element = accept_encoding.substr(0, comma);
+    accept_encoding = comma == std::string_view::npos
+                          ? std::string_view()
+                          : accept_encoding.substr(comma + 1);
+    std::size_t semicolon = element.find(';');
+    std::string_view name = string_utils::trim(element.substr(0, semicolon));
+    int weight = 1000;
+    if (semicolon != std::string_view::npos) {
+      std::string_view param = string_utils::trim(element.substr(semicolon + 1));
+      if (param.size() < 2 || (param[0] != 'q' && param[0] != 'Q') ||
+          param[1] != '=') {
+        continue;
+      }
+      weight = parse_qvalue(param.substr(2));
+      if (weight < 0) {
+        continue;
+      }
+    }
+    if (name == "*") {
+      any = std::max(any, weight);
+      continue;
+    }
+    if (string_utils::iequals(name, "x-gzip")) {
+      name = "gzip";
+    }
+    for (std::size_t i = 0; i < CONTENT_CODINGS; i++) {
+      if (string_utils::iequals(name, CODING_NAMES[i])) {
+        weights[i] = std::max(weights[i], weight);
+      }
+    }
+  }
+
+  content_coding best = content_coding::identity;
+  int best_weight = 0;
+  for (content_coding coding : PREFERRED) {
+    int weight = weights[static_cast<std::size_t>(coding)];
+    if (weight < 0) {
+      // only acceptable through "*"
+      weight = std::max(any, 0);
+    }
+    if (coding_available(coding) && weight > best_weight) {
+      best = coding;
+      best_weight = weight;
+    }
+  }
+  // identity is acceptable unless excluded, but only wins when the client
+  // weights it above every coding; unlisted it is the fallback
+  int identity = weights[static_cast<std::size_t>(content_coding::identity)];
+  if (identity < 0) {
+    identity = std::max(any, 0);
+  }
+  if (identity > best_weight) {
+    return content_coding::identity;
+  }
+  return best;
+}
+
+bool compressible_type(std::string_view content_type) {
+  std::string type = string_utils::lower(
+      string_utils::trim(content_type.substr(0, content_type.find(';'))));
+  std::string_view t = type;
+  if (t.starts_with("text/")) {
+    return true;
+  }
+  if (t.ends_with("+json") || t.ends_with("+xml")) {
+    // application/ld+json, image/svg+xml and the like
+    return true;
+  }
+  return t == "application/json" || t == "application/javascript" ||
+         t == "application/xml" || t == "application/wasm";
+}
+
+std::unique_ptr<encoder> encoder::create(content_coding coding) {
+  switch (coding) {
+  case content_coding::gzip:
+  case content_coding::deflate:
+    return std::make_unique<zlib_encoder>(coding);
+#if defined(MY_SERVER_BROTLI)
+  case content_coding::br:
+    return std::make_unique<brotli_encoder>();
+#endif
+#if defined(MY_SERVER_ZSTD)
+  case content_coding::zstd:
+    return std::make_unique<zstd_encoder>();
+#endif
+  default:
+    return nullptr;
+  }
+}
+
+void encoder_release::operator()(encoder *e) const noexcept {
+  encoder_pool::local().release(std::unique_ptr<encoder>(e));
+}
+
+encoder_pool &encoder_pool::local() {
+  static thread_local encoder_pool pool;
+  return pool;
+}
+
+encoder_ptr encoder_pool::acquire(content_coding coding, int level) {
+  auto &idle = m_idle[static_cast<std::size_t>(coding)];
+  std::unique_ptr<encoder> e;
+  if (!idle.empty()) {
+    e = std::move(idle.back());
+    idle.pop_back();
+  } else {
+    e = encoder::create(coding);
+    if (!e) {
+      return nullptr;
+    }
+  }
+  e->reset(level);
+  return encoder_ptr(e.release());
+}
+
+void encoder_pool::release(std::unique_ptr<encoder> e) {
+  auto &idle = m_idle[static_cast<std::size_t>(e->coding())];
+  if (idle.size() < MAX_IDLE) {
+    idle.push_back(std::move(e));
+  }
+}
+
+void compress_source::buffer_release::operator()(
+    input_buffer *buffer) const noexcept {
+  pool_allocator<input_buffer>().deallocate(buffer, 1);
+}
+
+compress_source::compress_source(encoder_ptr encoder, response &rep)
+    : m_encoder(std::move(encoder)), m_content(std::move(rep.content)),
+      m_cached(std::move(rep.cached)), m_file(std::move(rep.file)),
+      m_source(std::move(rep.source)) {}
+
+asio::awaitable<std::string_view>
+compress_source::next_input(asio::error_code &err) {
+  for (;;) {
+    switch (m_part) {
+    case 0:
+      m_part++;
+      if (!m_content.empty()) {
+        co_return m_content;
+      }
+      break;
+    case 1:
+      m_part++;
+      if (m_cached) {
+        co_return m_cached->data();
+      }
+      break;
+    case 2:
+      if (m_file_offset < m_file.size()) {
+        if (!m_buffer) {
+          m_buffer.reset(pool_allocator<input_buffer>().allocate(1));
+        }
+        auto size = static_cast<std::size_t>(std::min<std::uint64_t>(
+            m_file.size() - m_file_offset, m_buffer->size()));
+        size = file_body::read(m_file.native_handle(), m_file_offset,
+                               m_buffer->data(), size, err);
+        if (err) {
+          co_return std::string_view();
+        }
+        m_file_offset += size;
+        co_return std::string_view(m_buffer->data(), size);
+      }
+      m_part++;
+      break;
+    case 3:
+      if (m_source) {
+        if (!m_buffer) {
+          m_buffer.reset(pool_allocator<input_buffer>().allocate(1));
+        }
+        std::size_t size = co_await m_source->read(
+            std::span<char>(m_buffer->data(), m_buffer->size()), err);
+        if (err) {
+          co_return std::string_view();
+        }
+        if (size > 0) {
+          co_return std::string_view(m_buffer->data(), size);
+        }
+      }
+      m_part++;
+      break;
+    default:
+      co_return std::string_view();
+    }
+  }
+}
+
+asio::awaitable<std::size_t> compress_source::read(std::span<char> out,
+                                                   asio::error_code &err) {
+  err.clear();
+  std::size_t written = 0;
+  while (!m_finished && written < out.size()) {
+    if (m_input.empty() && !m_flushing && !m_input_done) {
+      m_input = co_await next_input(err);
+      if (err) {
+        co_return 0;
+      }
+      m_input_done = m_input.empty();
+      // a piece of a live source goes out right away
+      m_flushing = !m_input_done && m_part == 3;
+    }
+    encoder::mode how = m_input_done ? encoder::finish
+                        : m_flushing ? encoder::flush
+                                     : encoder::more;
+    encoder::result r =
+        m_encoder->encode(m_input, out.subspan(written), how, err);
+    if (err) {
+      co_return 0;
+    }
+    m_input.remove_prefix(r.consumed);
+    written += r.produced;
+    if (r.complete && how == encoder::finish) {
+      m_finished = true;
+      // the next body of this thread may have it
+      m_encoder.reset();
+    } else if (r.complete && how == encoder::flush) {
+      m_flushing = false;
+      if (written > 0) {
+        break;
+      }
+    }
+  }
+  co_return written;
+}
+
+namespace {
+
+/// The whole of `data` in `coding`, nothing when it does not get smaller.
+std::optional<std::string> encode_whole(content_coding coding, int level,
+                                        std::string_view data) {
+  std::size_t original = data.size();
+  encoder_ptr e = encoder_pool::local().acquire(coding, level);
+  if (!e) {
+    return std::nullopt;
+  }
+  std::string out;
+  std::size_t size = 0;
+  asio::error_code err;
+  for (;;) {
+    out.resize(size + std::max<std::size_t>(data.size() / 2, 4096));
+    encoder::result r =
+        e->encode(data, std::span<char>(out).subspan(size), encoder::finish,
+                  err);
+    if (err) {
+      return std::nullopt;
+    }
+    data.remove_prefix(r.consumed);
+    size += r.produced;
+    if (r.complete) {
+      break;
+    }
+  }
+  if (size >= original) {
+    return std::nullopt;
+  }
+  out.resize(size);
+  out.shrink_to_fit();
+  return out;
+}
+
+} // namespace
+
+void compress_response(const request &req, response &rep,
+                       const compression_options &options, file_cache *cache,
+                       const std::filesystem::path &path) {
+  if (!options.enable || rep.headers.find(header_id::content_encoding) ||
+      rep.status == response::no_content ||
+      rep.status == response::not_modified || req.method == "HEAD") {
+    return;
+  }
+  std::optional<std::string_view> type =
+      rep.headers.find(header_id::content_type);
+  if (!type || !compressible_type(*type)) {
+    return;
+  }
+  bool cached = !rep.source && rep.cached && cache && rep.content.empty() &&
+                !rep.file.is_open();
+  // the length of a stream is not known, anything else is measured
+  std::uint64_t size = rep.content.size() + rep.file.size() +
+                       (rep.cached ? rep.cached->size() : 0);
+  if (!rep.source && size < options.min_size) {
+    return;
+  }
+  // caches must not hand a compressed body to a client that did not ask
+  if (std::optional<std::string_view> vary = rep.headers.find(header_id::vary)) {
+    std::string lower = string_utils::lower(*vary);
+    if (lower.find("accept-encoding") == std::string::npos && lower != "*") {
+      rep.headers.set(header_id::vary, std::string(*vary) + ", Accept-Encoding");
+    }
+  } else {
+    rep.headers.set(header_id::vary, "Accept-Encoding");
+  }
+  std::optional<std::string_view> accept =
+      req.find_header(header_id::accept_encoding);
+  if (!accept) {
+    return;
+  }
+  content_coding coding = negotiate_coding(*accept);
+  if (coding == content_coding::identity) {
+    return;
+  }
+  int level = options.level(coding);
+  if (cached) {
+    std::shared_ptr<const cached_file> variant = cache->variant(
+        path, rep.cached, static_cast<std::size_t>(coding),
+        [coding, level](std::string_view data) {
+          return encode_whole(coding, level, data);
+        });
+    if (!variant) {
+      return;
+    }
+    rep.cached = std::move(variant);
+  } else {
+    encoder_ptr e = encoder_pool::local().acquire(coding, level);
+    if (!e) {
+      return;
+    }
+    rep.source = std::make_unique<compress_source>(std::move(e), rep);
+  }
+  rep.headers.set(header_id::content_encoding, coding_name(coding));
+}
+
+} // namespace server
+} // namespace http
@@ -0,0 +1,219 @@
+#pragma once
+
+#include "body_source.hpp"
+#include "file_body.hpp"
+#include "file_cache.hpp"
+
+#include <array>
+#include <asio.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace http {
+namespace server {
+
+struct request;
+struct response;
+
+/// The content codings of RFC 9110 section 8.4.1 a response can be sent with.
+/// gzip and deflate come with zlib, br needs MY_SERVER_BROTLI and zstd needs
+/// MY_SERVER_ZSTD.
+enum class content_coding : std::uint8_t {
+  identity,
+  gzip,
+  deflate,
+  br,
+  zstd,
+};
+
+constexpr std::size_t CONTENT_CODINGS = 5;
+
+// a cached file keeps a variant per coding
+static_assert(CONTENT_CODINGS <= file_cache::MAX_VARIANTS);
+
+/// The token of `coding` in Accept-Encoding and Content-Encoding.
+std::string_view coding_name(content_coding coding);
+
+/// Whether this build can compress with `coding`.
+bool coding_available(content_coding coding);
+
+/// When and how hard responses are compressed.
+struct compression_options {
+  /// Compress responses for clients which accept a content coding.
+  bool enable{true};
+
+  /// Levels of gzip and deflate (1-9), br (0-11) and zstd (1-22).
+  int zlib_level{6};
+  int brotli_level{4};
+  int zstd_level{3};
+
+  /// Bodies below this are sent as they are, the savings would be a few
+  /// bytes. Streamed bodies have no known size and are always compressed.
+  std::size_t min_size{1024};
+
+  /// The level for `coding`.
+  int level(content_coding coding) const;
+};
+
+/// Pick the coding for a response from the Accept-Encoding field value of
+/// RFC 9110 section 12.5.3: the acceptable coding with the highest weight
+/// this build has, on a tie the first of zstd, br, gzip and deflate.
+/// identity when the field is missing, nothing is acceptable or identity is
+/// weighted above every coding.
+content_coding negotiate_coding(std::string_view accept_encoding);
+
+/// Whether a body of the media type `content_type` is worth compressing:
+/// text, json, javascript, xml and svg. Images, audio, video and archives
+/// are compressed already.
+bool compressible_type(std::string_view content_type);
+
+/// Streaming compressor of one content coding. The state of a coding is a
+/// few hundred KiB which the library allocates and clears on creation, an
+/// encoder_pool hands the same encoder to body after body and reset() only
+/// rewinds it.
+class encoder {
+public:
+  /// How far encode() goes with the input it is given.
+  enum mode {
+    /// More input follows, output may be held back.
+    more,
+    /// Everything up to the end of the input goes out, the body goes on.
+    flush,
+    /// The input ends the body.
+    finish,
+  };
+
+  struct result {
+    // bytes of the input taken
+    std::size_t consumed{};
+    // bytes written to the output
+    std::size_t produced{};
+    // the input was taken and, for flush and finish, everything went out
+    bool complete{};
+  };
+
+  encoder(const encoder &) = delete;
+  encoder &operator=(const encoder &) = delete;
+  virtual ~encoder() = default;
+
+  /// Create an encoder of `coding`, nullptr for identity or a coding this
+  /// build does not have.
+  static std::unique_ptr<encoder> create(content_coding coding);
+
+  content_coding coding() const { return m_coding; }
+
+  /// Start a new body compressed at `level`.
+  virtual void reset(int level) = 0;
+
+  /// Compress from the front of `in` into the front of `out`. Called again
+  /// with the rest of the input until the result is complete. Sets `err`
+  /// when the library failed.
+  virtual result encode(std::string_view in, std::span<char> out, mode how,
+                        asio::error_code &err) = 0;
+
+protected:
+  explicit encoder(content_coding coding) : m_coding(coding) {}
+
+private:
+  content_coding m_coding;
+};
+
+/// Returns an encoder to the pool of the releasing thread.
+struct encoder_release {
+  void operator()(encoder *e) const noexcept;
+};
+
+using encoder_ptr = std::unique_ptr<encoder, encoder_release>;
+
+/// Idle encoders of the current thread, at most MAX_IDLE per coding. A
+/// connection takes one for a compressed body and gives it back once the body
+/// is complete, so a thread keeps about as many encoders as it compresses
+/// bodies at once.
+class encoder_pool {
+public:
+  static constexpr std::size_t MAX_IDLE = 16;
+
+  /// The pool of the current thread.
+  static encoder_pool &local();
+
+  /// An encoder of `coding` reset to `level`, nullptr for a coding this build
+  /// does not have.
+  encoder_ptr acquire(content_coding coding, int level);
+
+  /// Take `e` back, destroyed when the pool of its coding is full.
+  void release(std::unique_ptr<encoder> e);
+
+  /// Number of idle encoders of `coding`.
+  std::size_t idle(content_coding coding) const {
+    return m_idle[static_cast<std::size_t>(coding)].size();
+  }
+
+private:
+  std::array<std::vector<std::unique_ptr<encoder>>, CONTENT_CODINGS> m_idle;
+};
+
+/// The body of a response run through an encoder on its way out, set as the
+/// source of that response. The content, the cached file, the file and the
+/// source are taken from the response, which moves around in the queue of its
+/// connection. They are read in this order, the content and the cached file
+/// in place, the file and the source through a buffer of their own. A piece
+/// of a source is flushed as soon as it is compressed, a live stream is not
+/// held back to fill a block.
+class compress_source : public body_source {
+public:
+  compress_source(encoder_ptr encoder, response &rep);
+
+  asio::awaitable<std::size_t> read(std::span<char> out,
+                                    asio::error_code &err) override;
+
+private:
+  using input_buffer = std::array<char, 16384>;
+  struct buffer_release {
+    void operator()(input_buffer *buffer) const noexcept;
+  };
+
+  /// The next piece of the body to compress, empty at its end.
+  asio::awaitable<std::string_view> next_input(asio::error_code &err);
+
+  // given back to its pool as soon as the body is complete
+  encoder_ptr m_encoder;
+  std::string m_content;
+  std::shared_ptr<const cached_file> m_cached;
+  file_body m_file;
+  std::uint64_t m_file_offset{};
+  std::unique_ptr<body_source> m_source;
+  // the part of the body next_input() hands out next
+  int m_part{};
+  // file and source pieces, borrowed from the pool of the thread when the
+  // body has either
+  std::unique_ptr<input_buffer, buffer_release> m_buffer;
+  // input not taken by the encoder yet
+  std::string_view m_input;
+  // the input is a piece of the source, flushed once it is taken
+  bool m_flushing{};
+  bool m_input_done{};
+  bool m_finished{};
+};
+
+/// The compression stage between the handler and the send path, when `req`
+/// accepts a coding of `options` and the body of `rep` is of a compressible
+/// type. A cached file of `cache`, read from `path`, is swapped for its
+/// variant in that coding, compressed once and kept with the file, it goes
+/// out with its Content-Length. Any other body of at least min_size, content,
+/// a file which is not cached or a stream, becomes a compress_source with an
+/// encoder of the thread's pool and goes out chunked, compressed again on
+/// every request. Content-Encoding is set when the body was compressed,
+/// Vary: Accept-Encoding whenever it could have been.
+void compress_response(const request &req, response &rep,
+                       const compression_options &options,
+                       file_cache *cache = nullptr,
+                       const std::filesystem::path &path = {});
+
+} // namespace server
+} // namespace http
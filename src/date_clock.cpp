@@ -0,0 +1,102 @@
+#include "date_clock.hpp"
+
+#include <time.h>
+
+namespace http {
+namespace server {
+
+namespace {
+
+constexpr std::string_view DAY_NAMES = "ThuFriSatSunMonTueWed";
+
+constexpr std::string_view MONTH_NAMES = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+char *put_digits(char *out, unsigned value, int count) {
+  for (int i = count - 1; i >= 0; i--) {
+    out[i] = static_cast<char>('0' + value % 10);
+    value /= 10;
+  }
+  return out + count;
+}
+
+char *put_name(char *out, std::string_view names, std::size_t index) {
+  for (std::size_t i = 0; i < 3; i++) {
+    *out++ = names[index * 3 + i];
+  }
+  return out;
+}
+
+} // namespace
+
+date_clock::tick date_clock::coarse_tick() {
+#if defined(CLOCK_MONOTONIC_COARSE)
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+  return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+#else
+  return std::chrono::duration_cast<tick>(
+      std::chrono::steady_clock::now().time_since_epoch());
+#endif
+}
+
+void date_clock::format(std::int64_t seconds, char *out) {
+  std::int64_t days = seconds / 86400;
+  std::int64_t rest = seconds % 86400;
+  if (rest < 0) {
+    days--;
+    rest += 86400;
+  }
+  // the epoch was a thursday
+  std::int64_t weekday = days % 7;
+  if (weekday < 0) {
+    weekday += 7;
+  }
+  // civil date of the day number, the years start on the first of march so
+  // that the leap day is the last one of its year
+  std::int64_t z = days + 719468;
+  std::int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+  auto day_of_era = static_cast<unsigned>(z - era * 146097);
+  unsigned year_of_era = (day_of_era - day_of_era / 1460 +
+                          day_of_era / 36524 - day_of_era / 146096) /
+                         365;
+  unsigned day_of_year =
+      day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+  unsigned month_index = (5 * day_of_year + 2) / 153;
+  unsigned day = day_of_year - (153 * month_index + 2) / 5 + 1;
+  unsigned month = month_index < 10 ? month_index + 3 : month_index - 9;
+  std::int64_t year = year_of_era + era * 400 + (month <= 2);
+
+  char *p = out;
+  for (char ch : std::string_view("Date: ")) {
+    *p++ = ch;
+  }
+  p = put_name(p, DAY_NAMES, static_cast<std::size_t>(weekday));
+  *p++ = ',';
+  *p++ = ' ';
+  p = put_digits(p, day, 2);
+  *p++ = ' ';
+  p = put_name(p, MONTH_NAMES, month - 1);
+  *p++ = ' ';
+  p = put_digits(p, static_cast<unsigned>(year), 4);
+  *p++ = ' ';
+  p = put_digits(p, static_cast<unsigned>(rest / 3600), 2);
+  *p++ = ':';
+  p = put_digits(p, static_cast<unsigned>(rest / 60 % 60), 2);
+  *p++ = ':';
+  p = put_digits(p, static_cast<unsigned>(rest % 60), 2);
+  for (char ch : std::string_view(" GMT\r\n")) {
+    *p++ = ch;
+  }
+}
+
+void date_clock::render(tick now, std::chrono::system_clock::time_point wall) {
+  auto since_epoch = std::chrono::duration_cast<tick>(wall.time_since_epoch());
+  auto seconds = std::chrono::floor<std::chrono::seconds>(since_epoch);
+  format(seconds.count(), m_line.data());
+  // stale once the rest of this second passed on the monotonic clock, a
+  // step of the wall clock shows up at the next second
+  m_next = now + (std::chrono::seconds(1) - (since_epoch - seconds));
+}
+
+} // namespace server
+} // namespace http
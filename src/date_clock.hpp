@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace http {
+namespace server {
+
+/// The Date header field line of the current second, rendered as an
+/// IMF-fixdate (RFC 9110 5.6.7) once per second and handed out as a view.
+///
+/// Asking for the line reads a coarse monotonic tick only, the time of day is
+/// read and formatted when the second the line shows is over. Every thread
+/// has a clock of its own, so the line is never written while another thread
+/// copies it; in thread-per-core mode that is one clock per io_context.
+class date_clock {
+public:
+  using tick = std::chrono::nanoseconds;
+
+  /// "Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n"
+  static constexpr std::size_t LINE_SIZE = 37;
+
+  /// The line for now, valid until the next call on this clock.
+  std::string_view line() {
+    return line(coarse_tick(),
+                []() { return std::chrono::system_clock::now(); });
+  }
+
+  /// The line at the monotonic time `now`, `wall` returns the time of day and
+  /// is only called when the second of the line is over.
+  template <typename WallClock>
+  std::string_view line(tick now, WallClock &&wall) {
+    if (now >= m_next) {
+      render(now, wall());
+    }
+    return std::string_view(m_line.data(), m_line.size());
+  }
+
+  /// The clock of the calling thread.
+  static date_clock &local() {
+    thread_local date_clock clock;
+    return clock;
+  }
+
+  /// A monotonic tick which is cheap to read, CLOCK_MONOTONIC_COARSE where
+  /// there is one, it lags behind by a scheduler tick at most.
+  static tick coarse_tick();
+
+  /// Render the line of the second `seconds` since the epoch to `out`.
+  static void format(std::int64_t seconds, char *out);
+
+private:
+  /// Render the line of `wall` and note when its second is over.
+  void render(tick now, std::chrono::system_clock::time_point wall);
+
+  // the monotonic tick the line goes stale at, the first call renders
+  tick m_next{tick::min()};
+
+  std::array<char, LINE_SIZE> m_line{};
+};
+
+} // namespace server
+} // namespace http
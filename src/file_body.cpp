@@ -0,0 +1,166 @@
+#include "file_body.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#endif
+
+namespace http {
+namespace server {
+
+namespace {
+
+asio::error_code last_error() {
+  return asio::error_code(errno, asio::error::get_system_category());
+}
+
+} // namespace
+
+file_body &file_body::operator=(file_body &&other) noexcept {
+  if (this != &other) {
+    close();
+    m_fd = other.m_fd;
+    m_size = other.m_size;
+    other.m_fd = -1;
+    other.m_size = 0;
+  }
+  return *this;
+}
+
+#if defined(_WIN32)
+
+// the descriptors of the C runtime, without pread() a read seeks first. A
+// body is read by one connection at a time, so nothing moves the offset in
+// between
+
+bool file_body::open(const std::filesystem::path &path) {
+  close();
+  int fd = ::_wopen(path.c_str(), _O_RDONLY | _O_BINARY | _O_NOINHERIT);
+  if (fd < 0) {
+    return false;
+  }
+  struct _stat64 st;
+  if (::_fstat64(fd, &st) != 0 || (st.st_mode & _S_IFMT) != _S_IFREG) {
+    ::_close(fd);
+    return false;
+  }
+  m_fd = fd;
+  m_size = static_cast<std::uint64_t>(st.st_size);
+  return true;
+}
+
+void file_body::close() {
+  if (m_fd >= 0) {
+    ::_close(m_fd);
+    m_fd = -1;
+  }
+  m_size = 0;
+}
+
+#else
+
+bool file_body::open(const std::filesystem::path &path) {
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    ::close(fd);
+    return false;
+  }
+  m_fd = fd;
+  m_size = static_cast<std::uint64_t>(st.st_size);
+  return true;
+}
+
+void file_body::close() {
+  if (m_fd >= 0) {
+    ::close(m_fd);
+    m_fd = -1;
+  }
+  m_size = 0;
+}
+
+#endif
+
+std::size_t file_body::send(int socket, int fd, std::uint64_t offset,
+                            std::uint64_t size, asio::error_code &err) {
+  err.clear();
+#if defined(__linux__)
+  // a single sendfile() moves at most 0x7ffff000 bytes
+  auto count = static_cast<std::size_t>(
+      std::min<std::uint64_t>(size, 0x7ffff000));
+  auto position = static_cast<off_t>(offset);
+  for (;;) {
+    ssize_t sent = ::sendfile(socket, fd, &position, count);
+    if (sent > 0) {
+      return static_cast<std::size_t>(sent);
+    }
+    if (sent == 0) {
+      // the file shrank since it was opened
+      err = asio::error::eof;
+      return 0;
+    }
+    if (errno == EINTR) {
+      continue;
+    }
+    err = errno == EAGAIN || errno == EWOULDBLOCK
+              ? asio::error_code(asio::error::would_block)
+              : last_error();
+    return 0;
+  }
+#else
+  (void)socket;
+  (void)fd;
+  (void)offset;
+  (void)size;
+  err = asio::error::operation_not_supported;
+  return 0;
+#endif
+}
+
+std::size_t file_body::read(int fd, std::uint64_t offset, char *out,
+                            std::size_t size, asio::error_code &err) {
+  err.clear();
+#if defined(_WIN32)
+  if (::_lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) < 0) {
+    err = last_error();
+    return 0;
+  }
+  auto count = static_cast<unsigned>(std::min<std::size_t>(size, INT_MAX));
+#endif
+  for (;;) {
+#if defined(_WIN32)
+    int n = ::_read(fd, out, count);
+#else
+    ssize_t n = ::pread(fd, out, size, static_cast<off_t>(offset));
+#endif
+    if (n > 0) {
+      return static_cast<std::size_t>(n);
+    }
+    if (n == 0) {
+      err = asio::error::eof;
+      return 0;
+    }
+    if (errno != EINTR) {
+      err = last_error();
+      return 0;
+    }
+  }
+}
+
+} // namespace server
+} // namespace http
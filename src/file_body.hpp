@@ -0,0 +1,62 @@
+#pragma once
+
+#include <asio.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+namespace http {
+namespace server {
+
+/// An open file sent as the body of a response. The descriptor is owned and
+/// closed with the body, the bytes are never read into a string: a plain
+/// socket on Linux gets them through sendfile(2), the connection of any
+/// other stream or platform reads them chunk by chunk into a buffer of its
+/// own.
+class file_body {
+public:
+  /// Whether send() is zero copy on this platform.
+#if defined(__linux__)
+  static constexpr bool HAS_SENDFILE = true;
+#else
+  static constexpr bool HAS_SENDFILE = false;
+#endif
+
+  file_body() = default;
+  file_body(const file_body &) = delete;
+  file_body &operator=(const file_body &) = delete;
+  file_body(file_body &&other) noexcept { *this = std::move(other); }
+  file_body &operator=(file_body &&other) noexcept;
+  ~file_body() { close(); }
+
+  /// Open the regular file at `path` for reading, false when it is missing,
+  /// unreadable or not a regular file.
+  bool open(const std::filesystem::path &path);
+
+  void close();
+
+  bool is_open() const { return m_fd >= 0; }
+
+  int native_handle() const { return m_fd; }
+
+  /// Size of the file when it was opened, 0 when none is open.
+  std::uint64_t size() const { return m_size; }
+
+  /// Send up to `size` bytes of `fd` from `offset` to the non-blocking
+  /// `socket`, returns the number of bytes sent. `err` is
+  /// asio::error::would_block when the socket is full.
+  static std::size_t send(int socket, int fd, std::uint64_t offset,
+                          std::uint64_t size, asio::error_code &err);
+
+  /// Read up to `size` bytes of `fd` from `offset` into `out`, returns the
+  /// number of bytes read, `err` is asio::error::eof when the file shrank.
+  static std::size_t read(int fd, std::uint64_t offset, char *out,
+                          std::size_t size, asio::error_code &err);
+
+private:
+  int m_fd{-1};
+  std::uint64_t m_size{};
+};
+
+} // namespace server
+} // namespace http
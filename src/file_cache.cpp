@@ -0,0 +1,270 @@
+#include "file_cache.hpp"
+
+#include <algorithm>
+
+#if defined(_WIN32)
+#include "file_body.hpp"
+
+#include <chrono>
+#include <system_error>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace http {
+namespace server {
+
+#if defined(_WIN32)
+
+// without device and inode numbers a file is known by its size and write
+// time, a file replaced by one of the same size within the resolution of the
+// write time is not noticed
+
+std::shared_ptr<const cached_file>
+cached_file::read(const std::filesystem::path &path, std::uint64_t max_size) {
+  identity before;
+  file_body file;
+  if (!stat(path, before) || before.size == 0 || before.size > max_size ||
+      !file.open(path) || file.size() != before.size) {
+    return nullptr;
+  }
+  std::string data(static_cast<std::size_t>(before.size), '\0');
+  std::size_t done = 0;
+  asio::error_code err;
+  while (done < data.size()) {
+    done += file_body::read(file.native_handle(), done, data.data() + done,
+                            data.size() - done, err);
+    if (err) {
+      break;
+    }
+  }
+  // a file written to while it was read is torn, it is sent from the
+  // descriptor this time and read again on its next request
+  identity after;
+  if (done != data.size() || !stat(path, after) || !(after == before)) {
+    return nullptr;
+  }
+  return std::shared_ptr<const cached_file>(
+      new cached_file(std::move(data), before));
+}
+
+bool cached_file::stat(const std::filesystem::path &path, identity &id) {
+  std::error_code err;
+  if (!std::filesystem::is_regular_file(path, err)) {
+    return false;
+  }
+  std::uintmax_t size = std::filesystem::file_size(path, err);
+  if (err) {
+    return false;
+  }
+  auto mtime = std::filesystem::last_write_time(path, err);
+  if (err) {
+    return false;
+  }
+  id = {};
+  id.size = static_cast<std::uint64_t>(size);
+  id.mtime_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    mtime.time_since_epoch())
+                    .count();
+  return true;
+}
+
+#else
+
+namespace {
+
+cached_file::identity identity_of(const struct stat &st) {
+  cached_file::identity id;
+  id.device = static_cast<std::uint64_t>(st.st_dev);
+  id.inode = static_cast<std::uint64_t>(st.st_ino);
+  id.size = static_cast<std::uint64_t>(st.st_size);
+#if defined(__APPLE__)
+  id.mtime_ns = static_cast<std::int64_t>(st.st_mtimespec.tv_sec) *
+                    1000000000 +
+                st.st_mtimespec.tv_nsec;
+#else
+  id.mtime_ns = static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 +
+                st.st_mtim.tv_nsec;
+#endif
+  return id;
+}
+
+} // namespace
+
+std::shared_ptr<const cached_file>
+cached_file::read(const std::filesystem::path &path, std::uint64_t max_size) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0 ||
+      static_cast<std::uint64_t>(st.st_size) > max_size) {
+    ::close(fd);
+    return nullptr;
+  }
+  std::string data(static_cast<std::size_t>(st.st_size), '\0');
+  std::size_t done = 0;
+  while (done < data.size()) {
+    ssize_t n = ::pread(fd, data.data() + done, data.size() - done,
+                        static_cast<off_t>(done));
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    done += static_cast<std::size_t>(n);
+  }
+  // a file written to while it was read is torn, it is sent from the
+  // descriptor this time and read again on its next request
+  struct stat after;
+  bool complete = done == data.size() && ::fstat(fd, &after) == 0 &&
+                  identity_of(after) == identity_of(st);
+  ::close(fd);
+  if (!complete) {
+    return nullptr;
+  }
+  return std::shared_ptr<const cached_file>(
+      new cached_file(std::move(data), identity_of(st)));
+}
+
+bool cached_file::stat(const std::filesystem::path &path, identity &id) {
+  struct stat st;
+  if (::stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+    return false;
+  }
+  id = identity_of(st);
+  return true;
+}
+
+#endif
+
+std::shared_ptr<const cached_file>
+file_cache::get(const std::filesystem::path &path, date_clock::tick now) {
+  std::shared_ptr<const cached_file> stale;
+  date_clock::tick checked{};
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(path.native());
+    if (it != m_entries.end()) {
+      entry &e = it->second;
+      if (now - e.checked < m_revalidate) {
+        m_lru.splice(m_lru.begin(), m_lru, e.lru);
+        return e.file;
+      }
+      stale = e.file;
+      checked = e.checked;
+    }
+  }
+
+  if (stale) {
+    // stat without the lock, the other shards keep getting their files
+    cached_file::identity id;
+    bool unchanged = cached_file::stat(path, id) && id == stale->id();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(path.native());
+    if (it != m_entries.end()) {
+      entry &e = it->second;
+      // another thread checked or read the file again meanwhile
+      if (unchanged || e.file != stale || e.checked != checked) {
+        if (e.file == stale && e.checked == checked) {
+          e.checked = now;
+        }
+        m_lru.splice(m_lru.begin(), m_lru, e.lru);
+        return e.file;
+      }
+      // changed or gone, responses holding the old copy keep it
+      erase(it);
+    }
+  }
+
+  // read without the lock, another thread may read the same file meanwhile
+  std::shared_ptr<const cached_file> file =
+      cached_file::read(path, std::min(m_max_file_size, m_capacity));
+  if (!file) {
+    return nullptr;
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (auto it = m_entries.find(path.native()); it != m_entries.end()) {
+    m_lru.splice(m_lru.begin(), m_lru, it->second.lru);
+    return it->second.file;
+  }
+  make_room(file->size());
+  m_lru.push_front(path.native());
+  entry e;
+  e.file = file;
+  e.checked = now;
+  e.lru = m_lru.begin();
+  e.size = file->size();
+  m_entries.emplace(path.native(), std::move(e));
+  m_size += file->size();
+  return file;
+}
+
+std::shared_ptr<const cached_file>
+file_cache::variant(const std::filesystem::path &path,
+                    const std::shared_ptr<const cached_file> &file,
+                    std::size_t slot, const variant_encoder &encode) {
+  std::uint32_t bit = 1u << slot;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(path.native());
+    if (it != m_entries.end() && it->second.file == file &&
+        (it->second.made & bit)) {
+      return it->second.variants[slot];
+    }
+  }
+
+  // made without the lock, another thread may make the same variant
+  std::optional<std::string> data = encode(file->data());
+  std::shared_ptr<const cached_file> made;
+  if (data) {
+    made.reset(new cached_file(std::move(*data), file->id()));
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_entries.find(path.native());
+  if (it == m_entries.end() || it->second.file != file) {
+    return made;
+  }
+  entry &e = it->second;
+  if (e.made & bit) {
+    return e.variants[slot];
+  }
+  e.made |= bit;
+  if (made) {
+    e.variants[slot] = made;
+    e.size += made->size();
+    m_size += made->size();
+    make_room(0);
+  }
+  return made;
+}
+
+void file_cache::make_room(std::size_t size) {
+  while (m_size + size > m_capacity && !m_lru.empty()) {
+    erase(m_entries.find(m_lru.back()));
+  }
+}
+
+void file_cache::erase(std::unordered_map<std::string, entry>::iterator it) {
+  m_size -= it->second.size;
+  m_lru.erase(it->second.lru);
+  m_entries.erase(it);
+}
+
+std::size_t file_cache::count() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_entries.size();
+}
+
+std::size_t file_cache::size() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_size;
+}
+
+} // namespace server
+} // namespace http
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "date_clock.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace http {
+namespace server {
+
+/// A whole file read into memory of its own, freed with the last reference.
+/// Responses hand the bytes straight to the send buffers. Unlike a mapping
+/// the copy can not change under a response when the file is truncated or
+/// rewritten in place.
+class cached_file {
+public:
+  /// Read the regular file at `path`, nullptr when it is missing, empty,
+  /// larger than `max_size` or changed while it was read.
+  static std::shared_ptr<const cached_file>
+  read(const std::filesystem::path &path, std::uint64_t max_size);
+
+  cached_file(const cached_file &) = delete;
+  cached_file &operator=(const cached_file &) = delete;
+
+  std::string_view data() const { return m_data; }
+
+  std::size_t size() const { return m_data.size(); }
+
+  /// Device, inode, size and modification time when the file was read.
+  struct identity {
+    std::uint64_t device{};
+    std::uint64_t inode{};
+    std::uint64_t size{};
+    std::int64_t mtime_ns{};
+
+    bool operator==(const identity &other) const {
+      return device == other.device && inode == other.inode &&
+             size == other.size && mtime_ns == other.mtime_ns;
+    }
+  };
+
+  const identity &id() const { return m_id; }
+
+  /// The identity of the file at `path` now, false when it is gone.
+  static bool stat(const std::filesystem::path &path, identity &id);
+
+private:
+  friend class file_cache;
+
+  cached_file(std::string data, const identity &id)
+      : m_data(std::move(data)), m_id(id) {}
+
+  const std::string m_data;
+  identity m_id;
+};
+
+/// Copies of the hot static files, one cache is shared by the request_handlers
+/// of all shards and their connections. A file is read on its first request,
+/// every response of it then holds a reference to the same copy. At most `capacity` bytes are
+/// kept, the least recently used files are dropped first. A file is checked
+/// for a change at most once per `revalidate` and read again when it was
+/// replaced or modified; responses still sending the old copy keep it. Next
+/// to a file the cache keeps variants of it, e.g. its body in a content
+/// coding, which count against the capacity and go with the file.
+class file_cache {
+public:
+  /// Variants a file can have.
+  static constexpr std::size_t MAX_VARIANTS = 8;
+
+  /// Makes a variant from the data of a file, nothing when the file has none.
+  using variant_encoder =
+      std::function<std::optional<std::string>(std::string_view data)>;
+
+  file_cache(std::size_t capacity, std::size_t max_file_size,
+             date_clock::tick revalidate = std::chrono::seconds(1))
+      : m_capacity(capacity), m_max_file_size(max_file_size),
+        m_revalidate(revalidate) {}
+
+  file_cache(const file_cache &) = delete;
+  file_cache &operator=(const file_cache &) = delete;
+
+  /// The copy of the file at `path`, nullptr when it is missing, empty,
+  /// larger than the max_file_size or would not fit the cache at all.
+  std::shared_ptr<const cached_file> get(const std::filesystem::path &path) {
+    return get(path, date_clock::coarse_tick());
+  }
+
+  /// get() at the monotonic time `now`.
+  std::shared_ptr<const cached_file> get(const std::filesystem::path &path,
+                                         date_clock::tick now);
+
+  /// The variant `slot` of `file`, the copy get() returned for `path`. Made
+  /// by `encode` on first use and kept until the file is dropped, nullptr
+  /// when `encode` gave nothing. A variant of a file which is not in the
+  /// cache any more is made but not kept.
+  std::shared_ptr<const cached_file>
+  variant(const std::filesystem::path &path,
+          const std::shared_ptr<const cached_file> &file, std::size_t slot,
+          const variant_encoder &encode);
+
+  /// Number of files kept.
+  std::size_t count() const;
+
+  /// Bytes kept, the variants included.
+  std::size_t size() const;
+
+private:
+  struct entry {
+    std::shared_ptr<const cached_file> file;
+    // when the file was last compared with the one on disk
+    date_clock::tick checked{};
+    std::array<std::shared_ptr<const cached_file>, MAX_VARIANTS> variants{};
+    // a bit per slot of variants which was made, with or without a result
+    std::uint32_t made{};
+    // the file and its variants
+    std::size_t size{};
+    // the place of the path in m_lru
+    std::list<std::string>::iterator lru;
+  };
+
+  /// Drop the least recently used entries until `size` more bytes fit, the
+  /// mutex is held.
+  void make_room(std::size_t size);
+
+  /// Drop the entry `it`, the mutex is held.
+  void erase(std::unordered_map<std::string, entry>::iterator it);
+
+  std::size_t m_capacity;
+  std::size_t m_max_file_size;
+  date_clock::tick m_revalidate;
+
+  mutable std::mutex m_mutex;
+  std::unordered_map<std::string, entry> m_entries;
+  // the paths of m_entries, the most recently used first
+  std::list<std::string> m_lru;
+  std::size_t m_size{};
+};
+
+} // namespace server
+} // namespace http
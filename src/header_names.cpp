@@ -0,0 +1,125 @@
+#include "header_names.hpp"
+#include "string_utils.hpp"
+
+#include <array>
+
+namespace http {
+namespace server {
+
+namespace {
+
+/// In the order of header_id.
+constexpr std::array<std::string_view, WELL_KNOWN_HEADERS> NAMES = {
+    "Accept",
+    "Accept-Charset",
+    "Accept-Encoding",
+    "Accept-Language",
+    "Accept-Ranges",
+    "Age",
+    "Allow",
+    "Authorization",
+    "Cache-Control",
+    "Connection",
+    "Content-Disposition",
+    "Content-Encoding",
+    "Content-Language",
+    "Content-Length",
+    "Content-Location",
+    "Content-Range",
+    "Content-Type",
+    "Cookie",
+    "Date",
+    "ETag",
+    "Expect",
+    "Expires",
+    "Forwarded",
+    "Host",
+    "If-Match",
+    "If-Modified-Since",
+    "If-None-Match",
+    "If-Range",
+    "If-Unmodified-Since",
+    "Keep-Alive",
+    "Last-Modified",
+    "Location",
+    "Origin",
+    "Pragma",
+    "Range",
+    "Referer",
+    "Retry-After",
+    "Server",
+    "Set-Cookie",
+    "TE",
+    "Trailer",
+    "Transfer-Encoding",
+    "Upgrade",
+    "User-Agent",
+    "Vary",
+    "Via",
+    "WWW-Authenticate",
+    "X-Forwarded-For",
+};
+
+// slots of the hash table, indexed by the top bits of the hash
+constexpr unsigned TABLE_BITS = 8;
+constexpr std::size_t TABLE_SIZE = std::size_t{1} << TABLE_BITS;
+
+/// FNV-1a over the name with ASCII letters folded to lower case. The fold
+/// also maps a few other characters onto each other, that only costs a
+/// candidate which iequals() rejects.
+constexpr std::uint32_t hash(std::string_view name, std::uint32_t seed) {
+  std::uint32_t h = seed;
+  for (char ch : name) {
+    h = (h ^ (static_cast<std::uint8_t>(ch) | 0x20)) * 16777619u;
+  }
+  // the low bits of the product only depend on the low bits of the seed
+  return h >> (32 - TABLE_BITS);
+}
+
+struct perfect_hash {
+  std::uint32_t seed{};
+  // header_id of the name hashing to a slot, unknown for none
+  std::array<header_id, TABLE_SIZE> table{};
+};
+
+/// The first seed under which no two names share a slot.
+constexpr perfect_hash PERFECT_HASH = []() {
+  perfect_hash ph;
+  for (std::uint32_t seed = 2166136261u;; seed++) {
+    ph.seed = seed;
+    for (auto &slot : ph.table) {
+      slot = header_id::unknown;
+    }
+    bool collision = false;
+    for (std::size_t i = 0; i < NAMES.size() && !collision; i++) {
+      auto &slot = ph.table[hash(NAMES[i], seed)];
+      collision = slot != header_id::unknown;
+      slot = static_cast<header_id>(i);
+    }
+    if (!collision) {
+      return ph;
+    }
+  }
+}();
+
+static_assert(WELL_KNOWN_HEADERS < TABLE_SIZE / 4,
+              "keep the table sparse so a seed is found quickly");
+
+} // namespace
+
+std::string_view header_name(header_id id) noexcept {
+  return id == header_id::unknown ? std::string_view{}
+                                  : NAMES[static_cast<std::size_t>(id)];
+}
+
+header_id lookup_header(std::string_view name) noexcept {
+  header_id id = PERFECT_HASH.table[hash(name, PERFECT_HASH.seed)];
+  if (id != header_id::unknown &&
+      string_utils::iequals(NAMES[static_cast<std::size_t>(id)], name)) {
+    return id;
+  }
+  return header_id::unknown;
+}
+
+} // namespace server
+} // namespace http
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace http {
+namespace server {
+
+/// Header fields the server knows by name. Request and response keep a slot
+/// per well known field, the id of a name is found once when the field is
+/// added.
+enum class header_id : std::uint8_t {
+  accept,
+  accept_charset,
+  accept_encoding,
+  accept_language,
+  accept_ranges,
+  age,
+  allow,
+  authorization,
+  cache_control,
+  connection,
+  content_disposition,
+  content_encoding,
+  content_language,
+  content_length,
+  content_location,
+  content_range,
+  content_type,
+  cookie,
+  date,
+  etag,
+  expect,
+  expires,
+  forwarded,
+  host,
+  if_match,
+  if_modified_since,
+  if_none_match,
+  if_range,
+  if_unmodified_since,
+  keep_alive,
+  last_modified,
+  location,
+  origin,
+  pragma,
+  range,
+  referer,
+  retry_after,
+  server,
+  set_cookie,
+  te,
+  trailer,
+  transfer_encoding,
+  upgrade,
+  user_agent,
+  vary,
+  via,
+  www_authenticate,
+  x_forwarded_for,
+  /// Any other name, also the number of well known fields.
+  unknown,
+};
+
+constexpr std::size_t WELL_KNOWN_HEADERS =
+    static_cast<std::size_t>(header_id::unknown);
+
+/// The name of a well known field as it is sent, empty for unknown.
+std::string_view header_name(header_id id) noexcept;
+
+/// The id of the field called `name`, compared case insensitively, unknown if
+/// it is none of the well known ones. O(1), a perfect hash over the lowercase
+/// names picks the only candidate.
+header_id lookup_header(std::string_view name) noexcept;
+
+} // namespace server
+} // namespace http
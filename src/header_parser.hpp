@@ -0,0 +1,89 @@
+#pragma once
+
+#include "request_parser.hpp"
+#ifdef MY_SERVER_LLHTTP
+#include "llhttp_parser.hpp"
+#endif
+
+#include <cstddef>
+#include <string_view>
+#include <tuple>
+#include <variant>
+
+namespace http {
+namespace server {
+
+struct request;
+
+/// Implementations of the request header parser.
+enum class parser_backend {
+  /// request_parser, the state machine of this server.
+  builtin,
+  /// llhttp_parser, only there when built with MY_SERVER_LLHTTP.
+  llhttp,
+};
+
+/// The request header parser of a connection, one of the parser_backend
+/// implementations behind the interface of request_parser.
+class header_parser {
+public:
+  using parse_result = request_parser::parse_result;
+
+  /// Parser of the build default backend with the default limits.
+  header_parser() : header_parser(default_backend()) {}
+
+  explicit header_parser(parser_backend backend,
+                         const header_limits &limits = {})
+      : m_impl(std::in_place_type<request_parser>, limits) {
+#ifdef MY_SERVER_LLHTTP
+    if (backend == parser_backend::llhttp) {
+      m_impl.emplace<llhttp_parser>(limits);
+    }
+#else
+    (void)backend;
+#endif
+  }
+
+  /// Whether `backend` was built in.
+  static constexpr bool available(parser_backend backend) {
+#ifdef MY_SERVER_LLHTTP
+    (void)backend;
+    return true;
+#else
+    return backend == parser_backend::builtin;
+#endif
+  }
+
+  /// The backend of parsers constructed without one, llhttp when built with
+  /// MY_SERVER_LLHTTP.
+  static constexpr parser_backend default_backend() {
+#ifdef MY_SERVER_LLHTTP
+    return parser_backend::llhttp;
+#else
+    return parser_backend::builtin;
+#endif
+  }
+
+  void clear() {
+    std::visit([](auto &parser) { parser.clear(); }, m_impl);
+  }
+
+  std::tuple<parse_result, size_t> parse(request &req, std::string_view data) {
+    return std::visit(
+        [&](auto &parser) { return parser.parse(req, data); }, m_impl);
+  }
+
+  void rebase(request &req, std::ptrdiff_t offset) {
+    std::visit([&](auto &parser) { parser.rebase(req, offset); }, m_impl);
+  }
+
+private:
+#ifdef MY_SERVER_LLHTTP
+  std::variant<request_parser, llhttp_parser> m_impl;
+#else
+  std::variant<request_parser> m_impl;
+#endif
+};
+
+} // namespace server
+} // namespace http
@@ -0,0 +1,173 @@
+#include "llhttp_parser.hpp"
+#include "request.hpp"
+#include "string_utils.hpp"
+
+namespace http {
+namespace server {
+
+llhttp_parser::llhttp_parser(const header_limits &limits)
+    : m_limits(limits), m_line_limit(limits.max_request_line) {
+  llhttp_init(&m_parser, HTTP_REQUEST, &settings());
+  // request::update() lets Transfer-Encoding override Content-Length and
+  // closes the connection after such a request, like with request_parser
+  llhttp_set_lenient_chunked_length(&m_parser, 1);
+  m_parser.data = this;
+}
+
+const llhttp_settings_t &llhttp_parser::settings() {
+  static const llhttp_settings_t s = []() {
+    llhttp_settings_t s;
+    llhttp_settings_init(&s);
+    s.on_method = on_data;
+    s.on_method_complete = on_method_complete;
+    s.on_url = on_data;
+    s.on_url_complete = on_url_complete;
+    s.on_version = on_data;
+    s.on_version_complete = on_version_complete;
+    s.on_header_field = on_data;
+    s.on_header_field_complete = on_header_field_complete;
+    s.on_header_value = on_data;
+    s.on_header_value_complete = on_header_value_complete;
+    s.on_headers_complete = on_headers_complete;
+    return s;
+  }();
+  return s;
+}
+
+void llhttp_parser::clear() {
+  llhttp_reset(&m_parser);
+  m_token = m_token_end = nullptr;
+  m_field_name = {};
+  m_parsed = 0;
+  m_line_start = true;
+  m_line_begin = 0;
+  m_line_limit = m_limits.max_request_line;
+  m_field_count = 0;
+  m_over_limit = false;
+  m_too_large = URI_TOO_LONG;
+}
+
+std::tuple<llhttp_parser::parse_result, size_t>
+llhttp_parser::parse(request &req, std::string_view data) {
+  m_request = &req;
+  m_data = data.data();
+  llhttp_errno_t err = llhttp_execute(&m_parser, data.data(), data.size());
+  m_request = nullptr;
+  if (m_over_limit) {
+    // a callback hit one of the header_limits, llhttp reports the error of a
+    // *_complete callback as its own HPE_CB_* code, not as HPE_USER
+    const char *pos = llhttp_get_error_pos(&m_parser);
+    return {m_too_large, pos ? static_cast<size_t>(pos - data.data()) : 0};
+  }
+  switch (err) {
+  case HPE_OK:
+    m_parsed += data.size();
+    if (m_parsed >= m_limits.max_header_bytes) {
+      return {HEADER_TOO_LARGE, data.size()};
+    }
+    return {CONTINUE, data.size()};
+  case HPE_PAUSED: {
+    // paused by on_headers_complete right after the empty line, report its
+    // last byte like request_parser
+    size_t consumed = llhttp_get_error_pos(&m_parser) - data.data();
+    if (m_parsed + consumed > m_limits.max_header_bytes) {
+      return {HEADER_TOO_LARGE, consumed - 1};
+    }
+    return {PASS, consumed - 1};
+  }
+  default: {
+    const char *pos = llhttp_get_error_pos(&m_parser);
+    return {FAIL, pos ? static_cast<size_t>(pos - data.data()) : 0};
+  }
+  }
+}
+
+void llhttp_parser::rebase(request &req, std::ptrdiff_t offset) {
+  if (m_token) {
+    m_token += offset;
+    m_token_end += offset;
+  }
+  if (m_field_name.data()) {
+    m_field_name = std::string_view(m_field_name.data() + offset,
+                                    m_field_name.size());
+  }
+  req.rebase(offset);
+}
+
+std::string_view llhttp_parser::take_token() {
+  std::string_view token;
+  if (m_token) {
+    token = std::string_view(m_token, static_cast<size_t>(m_token_end - m_token));
+  }
+  m_token = m_token_end = nullptr;
+  return token;
+}
+
+int llhttp_parser::on_data(llhttp_t *parser, const char *at, size_t length) {
+  llhttp_parser &p = self(parser);
+  if (!p.m_token) {
+    p.m_token = at;
+  }
+  p.m_token_end = at + length;
+  if (p.m_line_start) {
+    p.m_line_start = false;
+    p.m_line_begin = p.offset(at);
+  }
+  if (p.offset(at + length) - p.m_line_begin > p.m_line_limit) {
+    p.m_over_limit = true;
+    return HPE_USER;
+  }
+  return HPE_OK;
+}
+
+int llhttp_parser::on_method_complete(llhttp_t *parser) {
+  llhttp_parser &p = self(parser);
+  p.m_request->method = p.take_token();
+  return HPE_OK;
+}
+
+int llhttp_parser::on_url_complete(llhttp_t *parser) {
+  llhttp_parser &p = self(parser);
+  p.m_request->request_target = p.take_token();
+  return HPE_OK;
+}
+
+int llhttp_parser::on_version_complete(llhttp_t *parser) {
+  llhttp_parser &p = self(parser);
+  // read by on_headers_complete, the field lines are limited next
+  p.take_token();
+  p.m_line_start = true;
+  p.m_line_limit = p.m_limits.max_field_size;
+  p.m_too_large = HEADER_TOO_LARGE;
+  return HPE_OK;
+}
+
+int llhttp_parser::on_header_field_complete(llhttp_t *parser) {
+  llhttp_parser &p = self(parser);
+  p.m_field_name = p.take_token();
+  return HPE_OK;
+}
+
+int llhttp_parser::on_header_value_complete(llhttp_t *parser) {
+  llhttp_parser &p = self(parser);
+  if (p.m_field_count == p.m_limits.max_field_count) {
+    p.m_over_limit = true;
+    return HPE_USER;
+  }
+  p.m_field_count++;
+  p.m_request->add_header(p.m_field_name, string_utils::trim(p.take_token()));
+  p.m_field_name = {};
+  p.m_line_start = true;
+  return HPE_OK;
+}
+
+int llhttp_parser::on_headers_complete(llhttp_t *parser) {
+  llhttp_parser &p = self(parser);
+  p.m_request->http_version_major = llhttp_get_http_major(parser);
+  p.m_request->http_version_minor = llhttp_get_http_minor(parser);
+  // the body is the business of the connection
+  return HPE_PAUSED;
+}
+
+} // namespace server
+} // namespace http
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "request_parser.hpp"
+
+#include <cstddef>
+#include <string_view>
+#include <tuple>
+
+#include <llhttp.h>
+
+namespace http {
+namespace server {
+
+struct request;
+
+/// request_parser on top of llhttp, same interface and the same views into
+/// the receive buffer. llhttp is paused once the header is complete, the body
+/// is left to the connection like with request_parser. The header_limits are
+/// checked as llhttp reports the pieces of the request line and the fields.
+class llhttp_parser {
+public:
+  using parse_result = request_parser::parse_result;
+  static constexpr parse_result PASS = request_parser::PASS;
+  static constexpr parse_result FAIL = request_parser::FAIL;
+  static constexpr parse_result CONTINUE = request_parser::CONTINUE;
+  static constexpr parse_result URI_TOO_LONG = request_parser::URI_TOO_LONG;
+  static constexpr parse_result HEADER_TOO_LARGE =
+      request_parser::HEADER_TOO_LARGE;
+
+  explicit llhttp_parser(const header_limits &limits = {});
+  llhttp_parser(const llhttp_parser &) = delete;
+  llhttp_parser &operator=(const llhttp_parser &) = delete;
+
+  /// Reset to initial parser state.
+  void clear();
+
+  /// Same contract as request_parser::parse().
+  std::tuple<parse_result, size_t> parse(request &req, std::string_view data);
+
+  /// Same contract as request_parser::rebase().
+  void rebase(request &req, std::ptrdiff_t offset);
+
+private:
+  static llhttp_parser &self(llhttp_t *parser) {
+    return *static_cast<llhttp_parser *>(parser->data);
+  }
+
+  /// A piece of the current token, the pieces follow each other in memory.
+  static int on_data(llhttp_t *parser, const char *at, size_t length);
+  static int on_method_complete(llhttp_t *parser);
+  static int on_url_complete(llhttp_t *parser);
+  static int on_version_complete(llhttp_t *parser);
+  static int on_header_field_complete(llhttp_t *parser);
+  static int on_header_value_complete(llhttp_t *parser);
+  static int on_headers_complete(llhttp_t *parser);
+
+  static const llhttp_settings_t &settings();
+
+  /// The current token, empty when llhttp reported no piece of it.
+  std::string_view take_token();
+
+  /// Position of `at` in the header, only during parse().
+  std::size_t offset(const char *at) const {
+    return m_parsed + static_cast<std::size_t>(at - m_data);
+  }
+
+  llhttp_t m_parser;
+  // the request of the running parse()
+  request *m_request{};
+  const char *m_token{};
+  const char *m_token_end{};
+  std::string_view m_field_name{};
+
+  header_limits m_limits;
+  // data of the running parse() and the bytes of the header before it
+  const char *m_data{};
+  std::size_t m_parsed{};
+  // the next piece starts a line, the line being parsed starts at
+  // m_line_begin and may not grow beyond m_line_limit
+  bool m_line_start{true};
+  std::size_t m_line_begin{};
+  std::size_t m_line_limit{};
+  std::size_t m_field_count{};
+  // a callback stopped llhttp over a limit, parse() reports m_too_large
+  bool m_over_limit{};
+  parse_result m_too_large{URI_TOO_LONG};
+};
+
+} // namespace server
+} // namespace http
@@ -1,4 +1,5 @@
 #include <asio.hpp>
+#include <cstdlib>
 #include <iostream>
 #include <string>
 
@@ -18,8 +19,15 @@ int main(int argc, char *argv[]) {
 
     // Initialise the server.
     // http::server::server s(argv[1], argv[2], argv[3]);
+    // worker threads from the first argument, 0 for one per hardware core,
+    // the single threaded default of server_options without it
+    http::server::server_options options;
+    if (argc > 1) {
+      options.thread_count = std::strtoul(argv[1], nullptr, 10);
+    }
     http::server::server s("0.0.0.0", "8081",
-                           "D:\\Code\\Cpp\\TinyHttpServer\\static");
+                           "D:\\Code\\Cpp\\TinyHttpServer\\static",
+                           options);
 
     // Run the server until stopped.
     s.run();
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+
+namespace http {
+namespace server {
+
+/// Allocator recycling single objects of T through a per-thread free list.
+///
+/// Meant for std::allocate_shared, which rebinds it to its control block, so
+/// the reference counts and the object come out of one recycled block. A block
+/// goes back to the free list of the thread releasing it, at most MAX_FREE
+/// blocks are kept per thread and type.
+template <typename T> class pool_allocator {
+public:
+  using value_type = T;
+
+  static constexpr std::size_t MAX_FREE = 256;
+
+  pool_allocator() noexcept = default;
+
+  template <typename U>
+  pool_allocator(const pool_allocator<U> &) noexcept {}
+
+  T *allocate(std::size_t n) {
+    if constexpr (poolable) {
+      free_list &list = cache();
+      if (n == 1 && list.head) {
+        node *block = list.head;
+        list.head = block->next;
+        --list.size;
+        block->~node();
+        return reinterpret_cast<T *>(block);
+      }
+    }
+    return std::allocator<T>().allocate(n);
+  }
+
+  void deallocate(T *p, std::size_t n) noexcept {
+    if constexpr (poolable) {
+      free_list &list = cache();
+      if (n == 1 && list.size < MAX_FREE) {
+        list.head = ::new (static_cast<void *>(p)) node{list.head};
+        ++list.size;
+        return;
+      }
+    }
+    std::allocator<T>().deallocate(p, n);
+  }
+
+  template <typename U>
+  bool operator==(const pool_allocator<U> &) const noexcept {
+    return true;
+  }
+
+  template <typename U>
+  bool operator!=(const pool_allocator<U> &) const noexcept {
+    return false;
+  }
+
+private:
+  struct node {
+    node *next;
+  };
+
+  // blocks come from operator new, which aligns them for any fundamental
+  // type, so a node fits in every block large enough
+  static constexpr bool poolable = sizeof(T) >= sizeof(node);
+
+  struct free_list {
+    node *head{};
+    std::size_t size{};
+
+    ~free_list() {
+      while (head) {
+        node *next = head->next;
+        head->~node();
+        std::allocator<T>().deallocate(reinterpret_cast<T *>(head), 1);
+        head = next;
+      }
+    }
+  };
+
+  static free_list &cache() {
+    thread_local free_list list;
+    return list;
+  }
+};
+
+} // namespace server
+} // namespace http
@@ -3,15 +3,105 @@
 
 namespace http {
 namespace server {
+void request::add_header(std::string_view name, std::string_view value) {
+  header_id id = lookup_header(name);
+  headers.push_back({name, value, id});
+  if (id != header_id::unknown && headers.size() <= UINT16_MAX) {
+    std::uint16_t &slot = m_slots[static_cast<std::size_t>(id)];
+    if (slot == 0) {
+      slot = static_cast<std::uint16_t>(headers.size());
+    }
+  }
+}
+
+std::optional<std::string_view>
+request::find_header(std::string_view name) const {
+  if (header_id id = lookup_header(name); id != header_id::unknown) {
+    return find_header(id);
+  }
+  for (const header &field : headers) {
+    if (string_utils::iequals(field.name, name)) {
+      return field.value;
+    }
+  }
+  return std::nullopt;
+}
+
+void request::rebase(std::ptrdiff_t offset) {
+  auto move = [offset](std::string_view &view) {
+    if (view.data()) {
+      view = std::string_view(view.data() + offset, view.size());
+    }
+  };
+  move(method);
+  move(request_target);
+  uri.rebase(offset);
+  for (header &field : headers) {
+    move(field.name);
+    move(field.value);
+  }
+}
+
+bool request::update() {
+  uri.parse(request_target);
+  keep_alive = get_keep_alive();
+  // a length read differently by a proxy in front would smuggle the rest of
+  // the body in as another request
+  auto length = get_content_length();
+  content_length = length.value_or(0);
+  auto is_chunked = get_chunked();
+  chunked = is_chunked.value_or(false);
+  if (chunked && find_header(header_id::content_length)) {
+    // RFC 9112 section 6.3: Transfer-Encoding overrides Content-Length, such
+    // a request may be smuggling another one, close after answering it
+    content_length = 0;
+    keep_alive = false;
+  }
+  return is_chunked.has_value() && length.has_value();
+}
+
 bool request::get_keep_alive() {
-  return headers.find("Connection") != headers.end() &&
-         string_utils::lower(headers["Connection"]) == "keep-alive";
+  auto connection = find_header(header_id::connection);
+  return connection && string_utils::iequals(*connection, "keep-alive");
+}
+
+std::optional<size_t> request::get_content_length() const {
+  if (!find_header(header_id::content_length)) {
+    return 0;
+  }
+  // repeated values may be refused even when they agree, llhttp does so and
+  // both parser backends have to frame a request the same way
+  std::optional<size_t> length;
+  for (const header &field : headers) {
+    if (field.id != header_id::content_length) {
+      continue;
+    }
+    if (length) {
+      return std::nullopt;
+    }
+    length = string_utils::parse_ull(string_utils::trim(field.value));
+    if (!length) {
+      return std::nullopt;
+    }
+  }
+  return length;
 }
 
-size_t request::get_content_length() {
-  return headers.find("Content-Length") == headers.end()
-             ? 0
-             : string_utils::parse_ull(headers["Content-Length"]);
+std::optional<bool> request::get_chunked() const {
+  auto transfer_encoding = find_header(header_id::transfer_encoding);
+  if (!transfer_encoding) {
+    return false;
+  }
+  // other codings are not implemented, several fields could be read in
+  // different ways, in both cases the length of the body is unknown
+  std::size_t fields = 0;
+  for (const header &field : headers) {
+    fields += field.id == header_id::transfer_encoding;
+  }
+  if (fields > 1 || !string_utils::iequals(*transfer_encoding, "chunked")) {
+    return std::nullopt;
+  }
+  return true;
 }
 } // namespace server
-} // namespace http
\ No newline at end of file
+} // namespace http
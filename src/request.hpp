@@ -1,34 +1,99 @@
 #pragma once
 
-#include <string>
-#include <unordered_map>
+#include "header_names.hpp"
+#include "request_uri.hpp"
+#include "small_vector.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
 
 namespace http {
 namespace server {
 
-/// A request received from a client.
+class body_sink;
+
+/// A header field of a request.
+struct header {
+  std::string_view name;
+  std::string_view value;
+  header_id id{header_id::unknown};
+};
+
+/// A request received from a client. The method, the target and the header
+/// fields are views into the receive buffer of the connection and only valid
+/// while the request is handled.
 struct request {
 public:
-  std::string method{};
-  // this may be parsed?
-  std::string request_target{};
+  std::string_view method{};
+  std::string_view request_target{};
+  // request_target split into its decoded path and its query by update()
+  request_uri uri{};
   int http_version_major{};
   int http_version_minor{};
-  std::unordered_map<std::string, std::string> headers{};
+  // in the order they were received, typical requests fit inline
+  small_vector<header, 16> headers{};
   bool keep_alive{};
   size_t content_length{};
+  // the body is sent with the chunked transfer coding, content_length is 0
+  bool chunked{};
+  // where the body went, owned by the connection, nullptr without a body
+  body_sink *body{};
+
+  /// Parse the request target and derive keep_alive and the framing of the
+  /// body from the header fields, false when the length of the body can not
+  /// be determined: a transfer coding other than chunked, or a Content-Length
+  /// which is not a number or differs between its fields. A target which
+  /// does not parse leaves uri.path() empty.
+  bool update();
 
-  void update() {
-    keep_alive = get_keep_alive();
-    content_length = get_content_length();
+  void clear() {
+    method = {};
+    request_target = {};
+    uri.clear();
+    headers.clear();
+    m_slots.fill(0);
+    body = nullptr;
   }
 
-  void clear() { headers.clear(); }
+  /// Append a header field, the parsers resolve the well known names here.
+  void add_header(std::string_view name, std::string_view value);
+
+  /// Value of the first header field `id`, O(1).
+  std::optional<std::string_view> find_header(header_id id) const {
+    if (id == header_id::unknown) {
+      return std::nullopt;
+    }
+    if (std::uint16_t slot = m_slots[static_cast<std::size_t>(id)]) {
+      return headers[slot - 1].value;
+    }
+    return std::nullopt;
+  }
+
+  /// Value of the first header field called `name`, compared case
+  /// insensitively.
+  std::optional<std::string_view> find_header(std::string_view name) const;
+
+  /// The bytes the views point into moved by `offset`.
+  void rebase(std::ptrdiff_t offset);
 
 private:
   bool get_keep_alive();
 
-  size_t get_content_length();
+  /// The value of Content-Length by RFC 9112 section 6.3, 0 without one.
+  /// Nothing when the value is not 1*DIGIT or too large, or when it is
+  /// repeated in several fields or a list in one.
+  std::optional<size_t> get_content_length() const;
+
+  /// Whether Transfer-Encoding is exactly chunked, nullopt for any other
+  /// transfer coding.
+  std::optional<bool> get_chunked() const;
+
+  // per well known field the index + 1 of its first occurrence in headers,
+  // 0 when the request has none
+  std::array<std::uint16_t, WELL_KNOWN_HEADERS> m_slots{};
 };
 
 } // namespace server
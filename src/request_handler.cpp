@@ -1,9 +1,10 @@
 #include "request_handler.hpp"
+#include "body_sink.hpp"
 #include "mime_types.hpp"
 #include "request.hpp"
 #include "response.hpp"
 
-#include <fstream>
+#include <algorithm>
 #include <spdlog/fmt/bundled/xchar.h>
 #include <spdlog/spdlog.h>
 #include <sstream>
@@ -14,23 +15,50 @@ namespace fs = std::filesystem;
 namespace http {
 namespace server {
 
-void request_handler::handle_request(std::shared_ptr<request> req,
-                                     std::shared_ptr<response> rep) {
-  spdlog::info("request: {} {} HTTP/{}.{}", req->method, req->request_target,
-               req->http_version_major, req->http_version_minor);
-  // Decode url to path.
-  std::string request_path;
-  if (!url_decode(req->request_target, request_path)) {
-    response::build_default_response(rep, response::bad_request);
-    return;
+namespace {
+
+/// Whether the normalised `path` is `root` or lies below it.
+bool within_root(const fs::path &root, const fs::path &path) {
+  return std::mismatch(root.begin(), root.end(), path.begin(), path.end())
+             .first == root.end();
+}
+
+} // namespace
+
+std::unique_ptr<body_sink> request_handler::open_body(const request &req) {
+  // only static files are served, nothing reads the body of a GET
+  if (req.method == "GET" || req.method == "HEAD") {
+    return std::make_unique<discard_sink>();
+  }
+  // the length of a chunked body is only known at its end
+  if (!req.chunked && req.content_length <= MEMORY_BODY_LIMIT) {
+    return std::make_unique<memory_sink>(MEMORY_BODY_LIMIT);
   }
+  return std::make_unique<file_sink>();
+}
 
-  // Request path must be absolute and not contain "..".
-  if (request_path.empty() || request_path[0] != '/' ||
-      request_path.find("..") != std::string::npos) {
+void request_handler::handle_request(const request &req, response &rep) {
+  spdlog::info("request: {} {} HTTP/{}.{}", req.method, req.request_target,
+               req.http_version_major, req.http_version_minor);
+  if (req.body) {
+    spdlog::info("request body: {} bytes", req.body->size());
+  }
+  // The path is decoded and free of dot segments, it is empty when the target
+  // was malformed or ".." left the root.
+  if (req.uri.path().empty()) {
     response::build_default_response(rep, response::bad_request);
+    compress_response(req, rep, m_compression);
     return;
   }
+  std::string request_path(req.uri.path());
+  if (!m_routes.empty()) {
+    if (auto it = m_routes.find(request_path); it != m_routes.end()) {
+      rep.status = response::ok;
+      it->second(req, rep);
+      compress_response(req, rep, m_compression);
+      return;
+    }
+  }
 
   // If path ends in slash (i.e. is a directory) then add "index.html".
   if (request_path[request_path.size() - 1] == '/') {
@@ -45,62 +73,36 @@ void request_handler::handle_request(std::shared_ptr<request> req,
   if (last_dot_pos != std::string::npos && last_dot_pos > last_slash_pos) {
     extension = final_path.substr(last_dot_pos + 1);
   }
-  if (request_path[0] == '/') {
-    // convert to relative path
-    final_path = final_path.substr(1, request_path.size() - 1);
+  // convert to relative path, the normalised path has a single leading slash
+  final_path.remove_prefix(final_path.find_first_not_of('/'));
+
+  // A path that is absolute on its own would replace the root, whatever the
+  // target looked like the file has to lie below the root.
+  fs::path relative_path = fs::u8path(final_path);
+  fs::path full_path = (m_static_dir / relative_path).lexically_normal();
+  if (relative_path.has_root_path() || !within_root(m_static_dir, full_path)) {
+    response::build_default_response(rep, response::bad_request);
+    compress_response(req, rep, m_compression);
+    return;
   }
 
-  // Open the file to send back.
-  fs::path full_path = m_static_dir / fs::u8path(final_path);
-  std::ifstream is(full_path, std::ios::in | std::ios::binary);
-  if (!is) {
+  // Small files come from the shared copies of the file cache, the others
+  // are opened and the connection sends them straight from the descriptor,
+  // nothing of them is read here.
+  if (m_file_cache) {
+    rep.cached = m_file_cache->get(full_path);
+  }
+  if (!rep.cached && !rep.file.open(full_path)) {
     response::build_default_response(rep, response::not_found);
+    compress_response(req, rep, m_compression);
     return;
   }
 
   // Fill out the reply to be sent to the client.
-  // TODO: 此处我们发送文件是先将文件全部读取到内存中，然后发送给后端，这样感觉有点整蛊（万一我们要发送很大的文件怎么办？）
-  // TODO: 此处需要实现边读取文件，边发送请求，要不然内存占用太高了
-  // 提供一个回调来加载数据？
-  // we should implement a new streaming response
-  rep->status = response::ok;
-  std::array<char, 512> buf;
-  while (!is.eof()) {
-    is.read(buf.data(), buf.size());
-    rep->content.append(buf.data(), is.gcount());
-  }
-  rep->headers["Content-Type"] =
-      mime_types::extension_to_type(std::string(extension));
-}
-
-// 这个函数需要重写一下，最好使用 antlr 进行解析，需要在 header
-// 解析完成后就搞完，目前还是最简单的形式
-bool request_handler::url_decode(std::string_view in, std::string &out) {
-  out.clear();
-  out.reserve(in.size());
-  for (std::size_t i = 0; i < in.size(); ++i) {
-    if (in[i] == '%') {
-      if (i + 3 <= in.size()) {
-        int value = 0;
-        uint8_t b0 = in[i + 1];
-        uint8_t b1 = in[i + 2];
-        if (std::isxdigit(b0) && std::isxdigit(b1)) {
-          uint8_t ch = (b0 << 4) | b1;
-          out += static_cast<char>(value);
-          i += 2;
-        } else {
-          return false;
-        }
-      } else {
-        return false;
-      }
-    } else if (in[i] == '+') {
-      out += ' ';
-    } else {
-      out += in[i];
-    }
-  }
-  return true;
+  rep.status = response::ok;
+  rep.headers.set(header_id::content_type,
+                  mime_types::extension_to_type(std::string(extension)));
+  compress_response(req, rep, m_compression, m_file_cache.get(), full_path);
 }
 
 } // namespace server
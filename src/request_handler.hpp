@@ -1,16 +1,29 @@
 #pragma once
 
+#include "content_encoding.hpp"
+#include "file_cache.hpp"
+
 #include <filesystem>
+#include <functional>
+#include <memory>
 #include <spdlog/spdlog.h>
 #include <string>
+#include <unordered_map>
 
 namespace http {
 namespace server {
 
 struct response;
 struct request;
+class body_sink;
+
+/// Answers a request for a dynamic path, fills the response like
+/// request_handler::handle_request(), e.g. with a body_source. Called on the
+/// thread of the connection, concurrently by the threads of a shared pool.
+using route_handler = std::function<void(const request &, response &)>;
 
-// we have to implement some kind of register to perform different request
+/// Dynamic paths by their decoded path, e.g. "/events".
+using route_map = std::unordered_map<std::string, route_handler>;
 
 /// The common handler for all incoming requests.
 class request_handler {
@@ -18,23 +31,69 @@ public:
   request_handler(const request_handler &) = delete;
   request_handler &operator=(const request_handler &) = delete;
 
-  /// Construct with a directory containing files to be served.
-  explicit request_handler(const std::filesystem::path& doc_root)
-      : m_static_dir(doc_root) {
-    spdlog::info("document root: {}", doc_root.u8string());
+  /// Construct with a directory containing files to be served, files up to
+  /// CACHED_FILE_LIMIT are kept in memory in a file_cache of `file_cache_size`
+  /// bytes, 0 disables it. The paths of `routes` are answered by their
+  /// handler instead of a file. Responses are compressed as `compression`
+  /// says.
+  explicit request_handler(const std::filesystem::path &doc_root,
+                           std::size_t file_cache_size = 0,
+                           route_map routes = {},
+                           const compression_options &compression = {})
+      : request_handler(doc_root, make_file_cache(file_cache_size),
+                        std::move(routes), compression) {}
+
+  /// Construct with the file cache `cache` of make_file_cache(), shared with
+  /// other handlers, nullptr serves every file from its descriptor.
+  request_handler(const std::filesystem::path &doc_root,
+                  std::shared_ptr<file_cache> cache, route_map routes = {},
+                  const compression_options &compression = {})
+      : m_static_dir(doc_root.lexically_normal()), m_routes(std::move(routes)),
+        m_compression(compression), m_file_cache(std::move(cache)) {
+    // "static/" and "static" are the same root
+    if (!m_static_dir.has_filename() && m_static_dir.has_relative_path()) {
+      m_static_dir = m_static_dir.parent_path();
+    }
+    spdlog::info("document root: {}", doc_root.string());
+  }
+
+  /// A file cache of `size` bytes for the files up to CACHED_FILE_LIMIT,
+  /// nullptr when `size` is 0.
+  static std::shared_ptr<file_cache> make_file_cache(std::size_t size) {
+    if (size == 0) {
+      return nullptr;
+    }
+    return std::make_shared<file_cache>(size, CACHED_FILE_LIMIT);
   }
 
-  /// Handle a request and produce a reply.
-  void handle_request(std::shared_ptr<request> req,
-                      std::shared_ptr<response> rep);
+  /// Pick the sink for the body of `req`, called once its header is parsed.
+  /// handle_request() runs after the whole body went into it.
+  std::unique_ptr<body_sink> open_body(const request &req);
+
+  /// Handle a request and produce a reply, compressed when the client
+  /// accepts it.
+  void handle_request(const request &req, response &rep);
 
 private:
+  /// Bodies up to this size are kept in memory, larger ones spill to disk.
+  static constexpr std::size_t MEMORY_BODY_LIMIT = 64 * 1024;
+
+  /// Files up to this size are served from the file cache, larger ones with
+  /// sendfile(2).
+  static constexpr std::size_t CACHED_FILE_LIMIT = 1024 * 1024;
+
   /// The directory containing the files to be served.
   std::filesystem::path m_static_dir;
 
-  /// Perform URL-decoding on a string. Returns false if the encoding was
-  /// invalid.
-  static bool url_decode(std::string_view in, std::string &out);
+  /// Handlers of the dynamic paths.
+  route_map m_routes;
+
+  /// When and how hard responses are compressed.
+  compression_options m_compression;
+
+  /// Copies of the hot files, shared by the connections of every handler
+  /// given the same cache, nullptr when disabled.
+  std::shared_ptr<file_cache> m_file_cache;
 };
 
 } // namespace server
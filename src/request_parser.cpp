@@ -1,228 +1,291 @@
 #include "request_parser.hpp"
+#include "char_scan.hpp"
 #include "request.hpp"
 #include "string_utils.hpp"
 
-#include <unordered_set>
+#include <array>
+#include <initializer_list>
 
 namespace http {
 namespace server {
 
-static constexpr uint8_t SP = ' ';
-static constexpr uint8_t CR = '\r';
-static constexpr uint8_t LF = '\n';
+namespace {
 
-bool request_parser::is_tchar(uint8_t ch) {
-  static std::unordered_set<uint8_t> tchar_set{'!',  '#', '$', '%', '&',
-                                               '\'', '*', '+', '-', '.',
-                                               '^',  '_', '`', '|', '~'};
-  return std::isalnum(ch) || tchar_set.find(ch) != tchar_set.end();
+/// States of the DFA, request_line is 0.
+enum parser_state : std::uint8_t {
+  request_line,
+  method,
+  request_target,
+  http_version_h,
+  http_version_t_0,
+  http_version_t_1,
+  http_version_p,
+  http_version_slash,
+  http_version_major,
+  http_version_dot,
+  http_version_minor,
+  request_line_cr,
+  request_line_lf,
+  field_line,
+  field_name,
+  field_value,
+  field_line_lf,
+  body_lf,
+  // the request was rejected, no transition leaves it
+  failed,
+  STATE_COUNT,
+};
+
+/// Classes of input bytes, every byte of a class takes the same transitions.
+enum char_class : std::uint8_t {
+  // CTL but HTAB, CR and LF, also DEL
+  ctl,
+  htab,
+  cr,
+  lf,
+  sp,
+  colon,
+  slash,
+  dot,
+  digit,
+  upper_h,
+  upper_t,
+  upper_p,
+  // tchar not in a class of its own
+  tchar,
+  // VCHAR which is no tchar
+  vchar,
+  obs_text,
+  CLASS_COUNT,
+};
+
+constexpr std::array<std::uint8_t, 256> CHAR_CLASS = []() {
+  std::array<std::uint8_t, 256> table{};
+  for (int ch = 0; ch < 256; ch++) {
+    if (ch >= 0x80) {
+      table[ch] = obs_text;
+    } else if (ch < 0x20 || ch == 0x7f) {
+      table[ch] = ctl;
+    } else if (char_scan::TCHAR[ch]) {
+      table[ch] = tchar;
+    } else {
+      table[ch] = vchar;
+    }
+  }
+  table['\t'] = htab;
+  table['\r'] = cr;
+  table['\n'] = lf;
+  table[' '] = sp;
+  table[':'] = colon;
+  table['/'] = slash;
+  table['.'] = dot;
+  for (int ch = '0'; ch <= '9'; ch++) {
+    table[ch] = digit;
+  }
+  table['H'] = upper_h;
+  table['T'] = upper_t;
+  table['P'] = upper_p;
+  return table;
+}();
+
+/// What a transition does besides changing the state.
+enum parser_action : std::uint8_t {
+  none,
+  fail,
+  pass,
+  begin_token,
+  end_method,
+  end_target,
+  begin_version,
+  set_major,
+  set_minor,
+  end_field_name,
+  end_field_value,
+  begin_field_line,
+};
+
+struct transition {
+  std::uint8_t next{failed};
+  std::uint8_t action{fail};
+};
+
+using transition_table =
+    std::array<std::array<transition, CLASS_COUNT>, STATE_COUNT>;
+
+constexpr std::initializer_list<char_class> TCHAR_CLASSES = {
+    dot, digit, upper_h, upper_t, upper_p, tchar};
+
+constexpr std::initializer_list<char_class> TARGET_CLASSES = {
+    colon,   slash,   dot,   digit, upper_h,
+    upper_t, upper_p, tchar, vchar, obs_text};
+
+constexpr std::initializer_list<char_class> FIELD_VALUE_CLASSES = {
+    htab,    sp,      colon,   slash, dot,   digit,
+    upper_h, upper_t, upper_p, tchar, vchar, obs_text};
+
+/// The request line and the header of RFC 9112, see README.md, everything
+/// not listed fails.
+constexpr transition_table TRANSITIONS = []() {
+  transition_table table{};
+  auto on = [&table](parser_state from,
+                     std::initializer_list<char_class> classes,
+                     parser_state to, parser_action action = none) {
+    for (char_class c : classes) {
+      table[from][c] = {to, action};
+    }
+  };
+  on(request_line, TCHAR_CLASSES, method, begin_token);
+  on(method, TCHAR_CLASSES, method);
+  on(method, {sp}, request_target, end_method);
+  on(request_target, TARGET_CLASSES, request_target);
+  on(request_target, {sp}, http_version_h, end_target);
+  on(http_version_h, {upper_h}, http_version_t_0);
+  on(http_version_t_0, {upper_t}, http_version_t_1);
+  on(http_version_t_1, {upper_t}, http_version_p);
+  on(http_version_p, {upper_p}, http_version_slash);
+  on(http_version_slash, {slash}, http_version_major, begin_version);
+  on(http_version_major, {digit}, http_version_dot, set_major);
+  on(http_version_dot, {dot}, http_version_minor);
+  on(http_version_minor, {digit}, request_line_cr, set_minor);
+  on(request_line_cr, {cr}, request_line_lf);
+  on(request_line_lf, {lf}, field_line, begin_field_line);
+  on(field_line, {cr}, body_lf);
+  on(field_line, TCHAR_CLASSES, field_name, begin_token);
+  on(field_name, TCHAR_CLASSES, field_name);
+  on(field_name, {colon}, field_value, end_field_name);
+  on(field_value, FIELD_VALUE_CLASSES, field_value);
+  on(field_value, {cr}, field_line_lf, end_field_value);
+  on(field_line_lf, {lf}, field_line, begin_field_line);
+  on(body_lf, {lf}, request_line, pass);
+  return table;
+}();
+
+std::string_view token_view(const char *begin, const char *end) {
+  return std::string_view(begin, static_cast<size_t>(end - begin));
+}
+
+} // namespace
+
+size_t request_parser::scan(std::string_view data) const {
+  switch (m_state) {
+  case method:
+  case field_name:
+    return char_scan::token(data);
+  case request_target:
+    return char_scan::target(data);
+  case field_value:
+    return char_scan::field_value(data);
+  default:
+    return 0;
+  }
 }
 
 std::tuple<request_parser::parse_result, size_t>
-request_parser::parse(std::shared_ptr<request> req, std::string_view data) {
-  parse_result result;
+request_parser::parse(request &req, std::string_view data) {
+  parse_result result{CONTINUE};
   size_t pos;
   for (pos = 0; pos < data.size(); pos++) {
-    result = consume(req, data[pos]);
+    if (size_t run = scan(data.substr(pos)); run > 0) {
+      // only runs grow a line without bound, the DFA checks the lines it
+      // ends
+      pos += run;
+      result = check_limits(m_parsed + pos);
+      if (result != CONTINUE || pos == data.size()) {
+        break;
+      }
+    }
+    result = consume(req, data.data() + pos, m_parsed + pos);
     if (result != CONTINUE) {
       break;
     }
   }
+  m_parsed += pos;
   return std::make_tuple(result, pos);
 }
 
 request_parser::parse_result
-request_parser::consume(std::shared_ptr<request> req, uint8_t ch) {
-  parse_result res{CONTINUE};
-  switch (m_state) {
-  case request_line: {
-    if (is_tchar(ch)) {
-      m_buffer << ch;
-      m_state = method;
-    } else {
-      res = FAIL;
-    }
-    break;
+request_parser::check_limits(size_t parsed) const {
+  if (parsed - m_line_begin > m_line_limit) {
+    return m_line_begin == 0 ? URI_TOO_LONG : HEADER_TOO_LARGE;
   }
-  case method: {
-    if (ch == SP) {
-      req->method = m_buffer.str();
-      m_buffer.str("");
-      m_state = request_target;
-    } else if (is_tchar(ch)) {
-      m_buffer << ch;
-    } else {
-      res = FAIL;
-    }
-    break;
-  }
-  case request_target: {
-    if (ch == SP) {
-      req->request_target = m_buffer.str();
-      m_buffer.str("");
-      m_state = http_version_h;
-    } else if (!std::iscntrl(ch)) {
-      m_buffer << ch;
-    } else {
-      res = FAIL;
-    }
-    break;
-  }
-  case http_version_h: {
-    if (ch == 'H') {
-      m_state = http_version_t_0;
-    } else {
-      res = FAIL;
-    }
-    break;
-  }
-  case http_version_t_0: {
-    if (ch == 'T') {
-      m_state = http_version_t_1;
-    } else {
-      res = FAIL;
-    }
-    break;
-  }
-  case http_version_t_1: {
-    if (ch == 'T') {
-      m_state = http_version_p;
-    } else {
-      res = FAIL;
-    }
-    break;
+  // the byte at `parsed` is part of the header whatever it is
+  if (parsed >= m_limits.max_header_bytes) {
+    return HEADER_TOO_LARGE;
   }
-  case http_version_p: {
-    if (ch == 'P') {
-      m_state = http_version_slash;
-    } else {
-      res = FAIL;
-    }
-    break;
+  return CONTINUE;
+}
+
+void request_parser::rebase(request &req, std::ptrdiff_t offset) {
+  if (m_token) {
+    m_token += offset;
   }
-  case http_version_slash: {
-    if (ch == '/') {
-      m_state = http_version_major;
-      req->http_version_major = 0;
-      req->http_version_minor = 0;
-    } else {
-      res = FAIL;
-    }
-    break;
+  if (m_field_name.data()) {
+    m_field_name = std::string_view(m_field_name.data() + offset,
+                                    m_field_name.size());
   }
-  case http_version_major: {
-    if (std::isdigit(ch)) {
-      req->http_version_major = (ch - '0');
-      m_state = http_version_dot;
-    } else {
-      res = FAIL;
-    }
+  req.rebase(offset);
+}
+
+request_parser::parse_result
+request_parser::consume(request &req, const char *input, size_t offset) {
+  auto ch = static_cast<std::uint8_t>(*input);
+  const transition &t = TRANSITIONS[m_state][CHAR_CLASS[ch]];
+  m_state = t.next;
+  switch (t.action) {
+  case none:
     break;
-  }
-  case http_version_dot: {
-    if (ch == '.') {
-      m_state = http_version_minor;
-    } else {
-      res = FAIL;
+  case fail:
+    return FAIL;
+  case pass:
+    if (parse_result result = check_limits(offset); result != CONTINUE) {
+      return result;
     }
+    return PASS;
+  case begin_token:
+    m_token = input;
     break;
-  }
-  case http_version_minor: {
-    if (std::isdigit(ch)) {
-      req->http_version_minor = (ch - '0');
-      m_state = request_line_cr;
-    } else {
-      res = FAIL;
-    }
+  case end_method:
+    req.method = token_view(m_token, input);
+    m_token = input + 1;
     break;
-  }
-  case request_line_cr: {
-    if (ch == CR) {
-      m_state = request_line_lf;
-    } else {
-      res = FAIL;
-    }
+  case end_target:
+    req.request_target = token_view(m_token, input);
+    m_token = nullptr;
     break;
-  }
-  case request_line_lf: {
-    if (ch == LF) {
-      m_state = field_line;
-    } else {
-      res = FAIL;
-    }
+  case begin_version:
+    req.http_version_major = 0;
+    req.http_version_minor = 0;
     break;
-  }
-  case field_line: {
-    if (ch == CR) {
-      m_state = body_lf;
-    } else if (is_tchar(ch)) {
-      m_buffer << ch;
-      m_state = field_name;
-    } else {
-      res = FAIL;
-    }
+  case set_major:
+    req.http_version_major = ch - '0';
     break;
-  }
-  case field_name: {
-    if (ch == ':') {
-      m_last_field_name = m_buffer.str();
-      m_buffer.str("");
-      m_state = field_value;
-    } else if (is_tchar(ch)) {
-      m_buffer << ch;
-    } else {
-      res = FAIL;
-    }
+  case set_minor:
+    req.http_version_minor = ch - '0';
     break;
-  }
-  case field_value: {
-    if (ch == CR) {
-      // we have to strip buffer_value here
-      req->headers[m_last_field_name] = string_utils::trim(m_buffer.str());
-      m_last_field_name.clear();
-      m_buffer.str("");
-      m_state = field_line_lf;
-    } else if (is_field_vchar(ch)) {
-      m_buffer << ch;
-    } else if (std::isblank(ch)) {
-      m_buffer << ch;
-      m_state = field_value_ows;
-    } else {
-      res = FAIL;
-    }
+  case end_field_name:
+    m_field_name = token_view(m_token, input);
+    m_token = input + 1;
     break;
-  }
-  case field_value_ows: {
-    if (ch == CR) {
-      // we have to strip buffer value here
-      req->headers[m_last_field_name] = string_utils::trim(m_buffer.str());
-      m_last_field_name.clear();
-      m_buffer.str("");
-      m_state = field_line_lf;
-    } else if (is_field_vchar(ch)) {
-      m_buffer << ch;
-      m_state = field_value;
-    } else if (std::isblank(ch)) {
-      // skip
-    } else {
-      res = FAIL;
+  case end_field_value:
+    if (m_field_count == m_limits.max_field_count) {
+      return HEADER_TOO_LARGE;
     }
+    m_field_count++;
+    // leading and trailing OWS are not part of the value
+    req.add_header(m_field_name,
+                   string_utils::trim(token_view(m_token, input)));
+    m_field_name = {};
+    m_token = nullptr;
     break;
-  }
-  case field_line_lf: {
-    if (ch == LF) {
-      m_state = field_line;
-    } else {
-      res = FAIL;
+  case begin_field_line:
+    if (parse_result result = check_limits(offset); result != CONTINUE) {
+      return result;
     }
+    m_line_begin = offset + 1;
+    m_line_limit = m_limits.max_field_size + 1;
     break;
   }
-  case body_lf: {
-    res = (ch == LF) ? PASS : FAIL;
-    break;
-  }
-  }
-  return res;
+  return CONTINUE;
 }
 
 } // namespace server
@@ -1,8 +1,8 @@
 #pragma once
 
-#include <cctype>
-#include <sstream>
-#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
 #include <tuple>
 
 namespace http {
@@ -10,67 +10,88 @@ namespace server {
 
 struct request;
 
+/// Limits on the header of a request, checked by the parser as the bytes
+/// arrive so an oversized header is rejected before the excess is buffered.
+struct header_limits {
+  /// Bytes of the request line without its CRLF, 414 beyond.
+  std::size_t max_request_line{8190};
+  /// Bytes of a field line without its CRLF, 431 beyond.
+  std::size_t max_field_size{8190};
+  /// Number of field lines, 431 beyond.
+  std::size_t max_field_count{100};
+  /// Bytes of the whole header up to and including the empty line, 431
+  /// beyond. The receive buffer of a connection bounds it anyway.
+  std::size_t max_header_bytes{8192};
+};
+
 /// Parser for incoming requests.
 class request_parser {
 public:
   /// Construct ready to parse the request method.
   request_parser() = default;
 
+  explicit request_parser(const header_limits &limits) : m_limits(limits) {}
+
   /// Reset to initial parser state.
   void clear() {
-    m_state = parser_state::request_line;
-    m_buffer.str("");
+    m_state = 0;
+    m_token = nullptr;
+    m_field_name = {};
+    m_parsed = 0;
+    m_line_begin = 0;
+    m_line_limit = m_limits.max_request_line + 1;
+    m_field_count = 0;
   }
 
-  /// Result of parse.
-  enum parse_result { PASS, FAIL, CONTINUE };
+  /// Result of parse. URI_TOO_LONG and HEADER_TOO_LARGE are failures caused by
+  /// the header_limits, the request line or the field lines are too large.
+  enum parse_result { PASS, FAIL, CONTINUE, URI_TOO_LONG, HEADER_TOO_LARGE };
 
   /// Parse some data. The enum return value is good when a complete request has
   /// been parsed, bad if the data is invalid, indeterminate when more data is
   /// required. The InputIterator return value indicates how much of the input
   /// has been consumed.
-  std::tuple<parse_result, size_t> parse(std::shared_ptr<request> req,
-                                         std::string_view data);
+  ///
+  /// Nothing is copied, the fields of `req` are views into `data`, which has
+  /// to follow the data of the previous call in memory until the request is
+  /// parsed, or be moved there with rebase(). Runs of method, request-target,
+  /// field name and field value characters are skipped by char_scan, the DFA
+  /// only sees the bytes in between. The header_limits are checked after each
+  /// run and each transition.
+  std::tuple<parse_result, size_t> parse(request &req, std::string_view data);
+
+  /// The data parsed so far moved by `offset` bytes, move the views of the
+  /// parser and of `req` along.
+  void rebase(request &req, std::ptrdiff_t offset);
 
 private:
-  /// Handle the next character of input.
-  parse_result consume(std::shared_ptr<request> req, uint8_t input);
+  /// Take the transition of the next character of input and run its action,
+  /// `offset` is the position of `input` in the header.
+  parse_result consume(request &req, const char *input, std::size_t offset);
 
-  static bool is_obs_text(uint8_t ch) { return ch >= 0x80; }
+  /// Whether the first `parsed` bytes of the header stay within the limits.
+  parse_result check_limits(std::size_t parsed) const;
 
-  static bool is_vchar(uint8_t ch) { return ch > 0x20 && ch <= 0x7e; }
+  /// Length of the run of characters at the start of `data` the current state
+  /// takes without a transition.
+  size_t scan(std::string_view data) const;
 
-  static bool is_tchar(uint8_t ch);
+  /// State of the DFA, the states and the transition table are generated at
+  /// compile time in request_parser.cpp, 0 expects the request line.
+  std::uint8_t m_state{};
 
-  static bool is_field_vchar(uint8_t ch) {
-    return is_vchar(ch) || is_obs_text(ch);
-  }
+  // start of the method, target, field name or value being parsed
+  const char *m_token{};
+  std::string_view m_field_name{};
 
-  /// The current state of the parser.
-  enum parser_state {
-    request_line,
-    method,
-    request_target,
-    http_version_h,
-    http_version_t_0,
-    http_version_t_1,
-    http_version_p,
-    http_version_slash,
-    http_version_major,
-    http_version_dot,
-    http_version_minor,
-    request_line_cr,
-    request_line_lf,
-    field_line,
-    field_name,
-    field_value,
-    field_value_ows,
-    field_line_lf,
-    body_lf,
-  } m_state{request_line};
-
-  std::ostringstream m_buffer;
-  std::string m_last_field_name;
+  header_limits m_limits{};
+  // bytes of the header passed by the previous calls of parse()
+  std::size_t m_parsed{};
+  // offset of the line being parsed and the limit of its length, the CR
+  // counts
+  std::size_t m_line_begin{};
+  std::size_t m_line_limit{m_limits.max_request_line + 1};
+  std::size_t m_field_count{};
 };
 
 } // namespace server
@@ -0,0 +1,236 @@
+#include "request_uri.hpp"
+#include "char_scan.hpp"
+#include "string_utils.hpp"
+
+#include <cstring>
+
+namespace http {
+namespace server {
+
+namespace {
+
+/// The path of an absolute-form target, after its scheme and authority.
+std::optional<std::string_view> absolute_path(std::string_view target) {
+  for (std::string_view scheme : {"http://", "https://"}) {
+    if (target.size() >= scheme.size() &&
+        string_utils::iequals(target.substr(0, scheme.size()), scheme)) {
+      std::size_t slash = target.find('/', scheme.size());
+      return target.substr(slash == std::string_view::npos ? target.size()
+                                                           : slash);
+    }
+  }
+  return std::nullopt;
+}
+
+/// Whether a segment of the absolute path `path` starts with '.', only those
+/// may be dot segments.
+bool has_dot_segment(std::string_view path) {
+  for (std::size_t dot = path.find('.'); dot != std::string_view::npos;
+       dot = path.find('.', dot + 1)) {
+    if (path[dot - 1] == '/') {
+      return true;
+    }
+  }
+  return false;
+}
+
+/// Whether the absolute path `path` has dot segments or empty segments, only
+/// those change when it is normalised.
+bool needs_normalising(std::string_view path) {
+  return has_dot_segment(path) || path.find("//") != std::string_view::npos;
+}
+
+/// Whether `path` has an escaped '/', "%2F" in either case.
+bool has_encoded_slash(std::string_view path) {
+  for (std::size_t percent = path.find('%');
+       percent != std::string_view::npos && percent + 2 < path.size();
+       percent = path.find('%', percent + 1)) {
+    if (path[percent + 1] == '2' &&
+        (path[percent + 2] == 'F' || path[percent + 2] == 'f')) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/// Remove the dot segments of RFC 3986 section 5.2.4 and the empty segments
+/// from the absolute path in `path` in place, false when ".." would leave the
+/// root. "//etc" is "/etc", a trailing '/' stays.
+bool normalise_path(std::string &path) {
+  char *p = path.data();
+  std::size_t size = path.size();
+  std::size_t out = 0;
+  std::size_t in = 0;
+  while (in < size) {
+    // p[in] is the '/' starting a segment
+    std::size_t end = in + 1;
+    while (end < size && p[end] != '/') {
+      end++;
+    }
+    std::size_t length = end - in - 1;
+    if (length == 0 && end < size) {
+      // "//" is one '/'
+    } else if (length == 1 && p[in + 1] == '.') {
+      // "/." stays a '/' at the end
+      if (end == size) {
+        p[out++] = '/';
+      }
+    } else if (length == 2 && p[in + 1] == '.' && p[in + 2] == '.') {
+      if (out == 0) {
+        return false;
+      }
+      // drop the last segment written, "/.." stays a '/' at the end
+      while (p[--out] != '/') {
+      }
+      if (end == size) {
+        p[out++] = '/';
+      }
+    } else {
+      if (out != in) {
+        std::memmove(p + out, p + in, end - in);
+      }
+      out += end - in;
+    }
+    in = end;
+  }
+  path.resize(out);
+  return true;
+}
+
+} // namespace
+
+bool percent_decode(std::string_view in, std::string &out,
+                    bool plus_as_space) {
+  // decoding never grows the input, a reused string keeps its capacity
+  out.resize(in.size());
+  char *to = out.data();
+  const char *from = in.data();
+  const char *end = in.data() + in.size();
+  while (from < end) {
+    const char *special = static_cast<const char *>(
+        std::memchr(from, '%', static_cast<std::size_t>(end - from)));
+    if (plus_as_space) {
+      const char *plus = static_cast<const char *>(
+          std::memchr(from, '+', static_cast<std::size_t>(
+                                     (special ? special : end) - from)));
+      special = plus ? plus : special;
+    }
+    if (!special) {
+      special = end;
+    }
+    std::memcpy(to, from, static_cast<std::size_t>(special - from));
+    to += special - from;
+    from = special;
+    // escapes often come in a row, e.g. for UTF-8
+    while (from < end && (*from == '%' || (plus_as_space && *from == '+'))) {
+      if (*from == '+') {
+        *to++ = ' ';
+        from++;
+        continue;
+      }
+      if (end - from < 3) {
+        return false;
+      }
+      std::uint8_t high =
+          char_scan::HEX_VALUE[static_cast<std::uint8_t>(from[1])];
+      std::uint8_t low =
+          char_scan::HEX_VALUE[static_cast<std::uint8_t>(from[2])];
+      if (high == char_scan::NOT_HEX || low == char_scan::NOT_HEX ||
+          (high | low) == 0) {
+        return false;
+      }
+      *to++ = static_cast<char>(high << 4 | low);
+      from += 3;
+    }
+  }
+  out.resize(static_cast<std::size_t>(to - out.data()));
+  return true;
+}
+
+void query_view::iterator::next() {
+  while (!m_rest.empty()) {
+    std::size_t end = m_rest.find('&');
+    std::string_view pair = m_rest.substr(0, end);
+    m_rest = end == std::string_view::npos ? std::string_view(
+                                                 m_rest.data() + m_rest.size(),
+                                                 0)
+                                           : m_rest.substr(end + 1);
+    if (pair.empty()) {
+      continue;
+    }
+    std::size_t equals = pair.find('=');
+    m_param.key = pair.substr(0, equals);
+    m_param.value = equals == std::string_view::npos
+                        ? std::string_view()
+                        : pair.substr(equals + 1);
+    m_done = false;
+    return;
+  }
+  *this = iterator();
+}
+
+std::optional<std::string_view> query_view::find(std::string_view key) const {
+  for (const param &p : *this) {
+    if (p.key == key) {
+      return p.value;
+    }
+  }
+  return std::nullopt;
+}
+
+bool request_uri::parse(std::string_view target) {
+  clear();
+  std::string_view path = target.substr(0, target.find('?'));
+  if (path.size() < target.size()) {
+    m_query = target.substr(path.size() + 1);
+  }
+  if (path.empty() || path[0] != '/') {
+    auto absolute = absolute_path(path);
+    if (!absolute) {
+      m_query = {};
+      return false;
+    }
+    path = *absolute;
+    if (path.empty()) {
+      // "http://host" stands for the root
+      m_buffer.assign("/");
+      m_decoded = true;
+      return true;
+    }
+  }
+  bool encoded = path.find('%') != std::string_view::npos;
+  if (!encoded && !needs_normalising(path)) {
+    // the common case, nothing to decode or normalise
+    m_path = path;
+    return true;
+  }
+  if (encoded) {
+    // a decoded '/' would be taken for a separator, "%2F" is not a file name
+    if (has_encoded_slash(path) || !percent_decode(path, m_buffer)) {
+      m_query = {};
+      return false;
+    }
+  } else {
+    m_buffer.assign(path);
+  }
+  // "%2e" is a dot too, so this looks at the decoded path
+  if (needs_normalising(m_buffer) && !normalise_path(m_buffer)) {
+    m_query = {};
+    return false;
+  }
+  m_decoded = true;
+  return true;
+}
+
+void request_uri::rebase(std::ptrdiff_t offset) {
+  auto move = [offset](std::string_view &view) {
+    if (view.data()) {
+      view = std::string_view(view.data() + offset, view.size());
+    }
+  };
+  move(m_path);
+  move(m_query);
+}
+
+} // namespace server
+} // namespace http
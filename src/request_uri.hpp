@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace http {
+namespace server {
+
+/// Percent-decode `in` into `out`, with `plus_as_space` a '+' becomes a blank
+/// like in form data. Runs without '%' are copied whole. False for a broken
+/// escape or an escaped NUL.
+bool percent_decode(std::string_view in, std::string &out,
+                    bool plus_as_space = false);
+
+/// The key=value pairs of a query, split on '&' while iterating. Keys and
+/// values are still percent-encoded, percent_decode() them with
+/// `plus_as_space` where needed.
+class query_view {
+public:
+  struct param {
+    std::string_view key;
+    // empty for a key without '='
+    std::string_view value;
+  };
+
+  class iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = param;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const param *;
+    using reference = const param &;
+
+    iterator() = default;
+    explicit iterator(std::string_view rest) : m_rest(rest) { next(); }
+
+    reference operator*() const { return m_param; }
+    pointer operator->() const { return &m_param; }
+
+    iterator &operator++() {
+      next();
+      return *this;
+    }
+
+    iterator operator++(int) {
+      iterator old = *this;
+      next();
+      return old;
+    }
+
+    bool operator==(const iterator &other) const {
+      return m_done == other.m_done && m_rest.data() == other.m_rest.data();
+    }
+    bool operator!=(const iterator &other) const { return !(*this == other); }
+
+  private:
+    /// Split off the next non-empty pair.
+    void next();
+
+    std::string_view m_rest{};
+    param m_param{};
+    bool m_done{true};
+  };
+
+  query_view() = default;
+  explicit query_view(std::string_view query) : m_query(query) {}
+
+  iterator begin() const { return iterator(m_query); }
+  iterator end() const { return iterator(); }
+
+  /// Value of the first pair called `key`, compared with the raw key.
+  std::optional<std::string_view> find(std::string_view key) const;
+
+private:
+  std::string_view m_query{};
+};
+
+/// The request target of RFC 9112 section 3.2 split into the path and the
+/// query. The path is percent-decoded and its dot segments and empty segments
+/// are removed once, a path without '%', "/." and "//" stays a view into the
+/// request target, others go into a buffer that is reused from request to
+/// request.
+class request_uri {
+public:
+  /// Parse an origin-form or absolute-form target, false when it is neither,
+  /// its percent-encoding is broken, it escapes a '/' or a NUL or ".." leaves
+  /// the root.
+  bool parse(std::string_view target);
+
+  /// The decoded and normalised path, it starts with '/'. Empty when the
+  /// target was not parsed or was rejected.
+  std::string_view path() const {
+    return m_decoded ? std::string_view(m_buffer) : m_path;
+  }
+
+  /// The query without '?', still percent-encoded.
+  std::string_view query() const { return m_query; }
+
+  /// The pairs of the query.
+  query_view params() const { return query_view(m_query); }
+
+  void clear() {
+    m_path = {};
+    m_query = {};
+    m_decoded = false;
+  }
+
+  /// The request target moved by `offset`.
+  void rebase(std::ptrdiff_t offset);
+
+private:
+  // the path when it did not have to be decoded
+  std::string_view m_path{};
+  std::string_view m_query{};
+  // the path is in m_buffer
+  bool m_decoded{};
+  std::string m_buffer{};
+};
+
+} // namespace server
+} // namespace http
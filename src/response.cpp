@@ -1,139 +1,368 @@
 #include "response.hpp"
+#include "date_clock.hpp"
+#include "send_queue.hpp"
+#include "string_utils.hpp"
 
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <iterator>
 #include <string>
 
 namespace http {
 namespace server {
 
-std::string_view get_status_line(response::status_type status) {
-  static std::unordered_map<response::status_type, std::string_view> mappings{
-      {response::ok, "HTTP/1.1 200 OK\r\n"},
-      {response::created, "HTTP/1.1 201 Created\r\n"},
-      {response::accepted, "HTTP/1.1 202 Accepted\r\n"},
-      {response::no_content, "HTTP/1.1 204 No Content\r\n"},
-      {response::multiple_choices, "HTTP/1.1 300 Multiple Choices\r\n"},
-      {response::moved_permanently, "HTTP/1.1 301 Moved Permanently\r\n"},
-      {response::moved_temporarily, "HTTP/1.1 302 Moved Temporarily\r\n"},
-      {response::not_modified, "HTTP/1.1 304 Not Modified\r\n"},
-      {response::bad_request, "HTTP/1.1 400 Bad Request\r\n"},
-      {response::unauthorized, "HTTP/1.1 401 Unauthorized\r\n"},
-      {response::forbidden, "HTTP/1.1 403 Forbidden\r\n"},
-      {response::not_found, "HTTP/1.1 404 Not Found\r\n"},
-      {response::internal_server_error,
-       "HTTP/1.1 500 Internal Server Error\r\n"},
-      {response::not_implemented, "HTTP/1.1 501 Not Implemented\r\n"},
-      {response::bad_gateway, "HTTP/1.1 502 Bad Gateway\r\n"},
-      {response::service_unavailable, "HTTP/1.1 503 Service Unavailable\r\n"},
-  };
-  if (mappings.find(status) == mappings.end()) {
-    return mappings[response::internal_server_error];
-  }
-  return mappings[status];
+std::size_t response_headers::index_of(header_id id) const {
+  if (std::uint8_t slot = m_slots[static_cast<std::size_t>(id)]) {
+    return slot - 1;
+  }
+  if (m_fields.size() < UINT8_MAX) {
+    // every field got a slot
+    return m_fields.size();
+  }
+  std::size_t i = 0;
+  while (i < m_fields.size() && m_fields[i].id != id) {
+    i++;
+  }
+  return i;
+}
+
+response_header response_headers::operator[](std::size_t index) const {
+  const field_line &field = m_fields[index];
+  return {std::string_view(m_block.data() + field.offset, field.name_size),
+          std::string_view(m_block.data() + field.value_offset(),
+                           field.value_size),
+          field.id};
+}
+
+void response_headers::append(header_id id, std::string_view name,
+                              std::string_view value) {
+  field_line field;
+  field.id = id;
+  field.name_size = static_cast<std::uint16_t>(name.size());
+  field.offset = static_cast<std::uint32_t>(m_end);
+  field.value_size = static_cast<std::uint32_t>(value.size());
+  reserve(m_end + name.size() + value.size() + 4);
+  char *out = m_block.data() + m_end;
+  std::memcpy(out, name.data(), name.size());
+  out += name.size();
+  *out++ = ':';
+  *out++ = ' ';
+  std::memcpy(out, value.data(), value.size());
+  out += value.size();
+  *out++ = '\r';
+  *out++ = '\n';
+  m_end = static_cast<std::size_t>(out - m_block.data());
+  m_fields.push_back(field);
+  if (id != header_id::unknown && m_fields.size() <= UINT8_MAX) {
+    m_slots[static_cast<std::size_t>(id)] =
+        static_cast<std::uint8_t>(m_fields.size());
+  }
+}
+
+void response_headers::replace(std::size_t index, std::string_view value) {
+  field_line &field = m_fields[index];
+  std::size_t begin = field.value_offset();
+  std::size_t old_end = begin + field.value_size;
+  std::size_t new_end = begin + value.size();
+  if (new_end != old_end) {
+    // move the lines behind the value
+    reserve(m_end + value.size());
+    std::memmove(m_block.data() + new_end, m_block.data() + old_end,
+                 m_end - old_end);
+    m_end = m_end + new_end - old_end;
+    for (std::size_t i = index + 1; i < m_fields.size(); i++) {
+      m_fields[i].offset = static_cast<std::uint32_t>(m_fields[i].offset +
+                                                      new_end - old_end);
+    }
+    field.value_size = static_cast<std::uint32_t>(value.size());
+  }
+  std::memcpy(m_block.data() + begin, value.data(), value.size());
+}
+
+void response_headers::set(header_id id, std::string_view value) {
+  if (id == header_id::unknown) {
+    return;
+  }
+  if (std::size_t i = index_of(id); i < m_fields.size()) {
+    replace(i, value);
+  } else {
+    append(id, header_name(id), value);
+  }
+}
+
+void response_headers::set(std::string_view name, std::string_view value) {
+  if (header_id id = lookup_header(name); id != header_id::unknown) {
+    set(id, value);
+    return;
+  }
+  for (std::size_t i = 0; i < m_fields.size(); i++) {
+    if (m_fields[i].id == header_id::unknown &&
+        m_fields[i].name_size == name.size() &&
+        string_utils::iequals((*this)[i].name, name)) {
+      replace(i, value);
+      return;
+    }
+  }
+  append(header_id::unknown, name, value);
+}
+
+std::optional<std::string_view> response_headers::find(header_id id) const {
+  if (id == header_id::unknown) {
+    return std::nullopt;
+  }
+  std::size_t i = index_of(id);
+  if (i < m_fields.size()) {
+    return (*this)[i].value;
+  }
+  return std::nullopt;
+}
+
+std::optional<std::string_view>
+response_headers::find(std::string_view name) const {
+  if (header_id id = lookup_header(name); id != header_id::unknown) {
+    return find(id);
+  }
+  for (response_header field : *this) {
+    if (field.id == header_id::unknown &&
+        string_utils::iequals(field.name, name)) {
+      return field.value;
+    }
+  }
+  return std::nullopt;
+}
+
+void response_headers::erase(header_id id) {
+  if (id == header_id::unknown) {
+    return;
+  }
+  std::size_t index = index_of(id);
+  if (index == m_fields.size()) {
+    return;
+  }
+  std::size_t begin = m_fields[index].offset;
+  std::size_t end = m_fields[index].value_offset() +
+                    m_fields[index].value_size + 2;
+  std::memmove(m_block.data() + begin, m_block.data() + end, m_end - end);
+  m_end -= end - begin;
+  m_fields.erase(index);
+  m_slots.fill(0);
+  for (std::size_t i = 0; i < m_fields.size(); i++) {
+    if (i >= index) {
+      m_fields[i].offset = static_cast<std::uint32_t>(m_fields[i].offset -
+                                                      (end - begin));
+    }
+    if (m_fields[i].id != header_id::unknown && i < UINT8_MAX) {
+      m_slots[static_cast<std::size_t>(m_fields[i].id)] =
+          static_cast<std::uint8_t>(i + 1);
+    }
+  }
+}
+
+std::string_view response_headers::wrap(std::string_view prefix,
+                                        std::string_view suffix) {
+  reserve(m_end + suffix.size());
+  std::size_t begin = PREFIX_CAPACITY - prefix.size();
+  std::memcpy(m_block.data() + begin, prefix.data(), prefix.size());
+  std::memcpy(m_block.data() + m_end, suffix.data(), suffix.size());
+  return std::string_view(m_block.data() + begin,
+                          m_end + suffix.size() - begin);
 }
 
-void response::to_buffers(std::list<asio::const_buffer> &buffers) {
-  static std::string_view COLON_SP = ": ";
-  static std::string_view CRLF = "\r\n";
-  // sizes.emplace_back_back(0);
-  buffers.emplace_back(asio::buffer(get_status_line(status)));
-  for (const auto &[name, value] : headers) {
-    buffers.emplace_back(asio::buffer(name));
-    buffers.emplace_back(asio::buffer(COLON_SP));
-    buffers.emplace_back(asio::buffer(value));
-    buffers.emplace_back(asio::buffer(CRLF));
-  }
-  buffers.emplace_back(asio::buffer(CRLF));
-  buffers.emplace_back(asio::buffer(content));
+namespace {
+
+struct status_text {
+  response::status_type status;
+  std::string_view line;
+  std::string_view content;
+};
+
+constexpr status_text STATUS_TEXTS[] = {
+    {response::ok, "HTTP/1.1 200 OK\r\n",
+     "<html>"
+     "<head><title>Created</title></head>"
+     "<body><h1>201 Created</h1></body>"
+     "</html>"},
+    {response::created, "HTTP/1.1 201 Created\r\n",
+     "<html>"
+     "<head><title>Created</title></head>"
+     "<body><h1>201 Created</h1></body>"
+     "</html>"},
+    {response::accepted, "HTTP/1.1 202 Accepted\r\n",
+     "<html>"
+     "<head><title>Accepted</title></head>"
+     "<body><h1>202 Accepted</h1></body>"
+     "</html>"},
+    {response::no_content, "HTTP/1.1 204 No Content\r\n",
+     "<html>"
+     "<head><title>No Content</title></head>"
+     "<body><h1>204 Content</h1></body>"
+     "</html>"},
+    {response::multiple_choices, "HTTP/1.1 300 Multiple Choices\r\n",
+     "<html>"
+     "<head><title>Multiple Choices</title></head>"
+     "<body><h1>300 Multiple Choices</h1></body>"
+     "</html>"},
+    {response::moved_permanently, "HTTP/1.1 301 Moved Permanently\r\n",
+     "<html>"
+     "<head><title>Moved Permanently</title></head>"
+     "<body><h1>301 Moved Permanently</h1></body>"
+     "</html>"},
+    {response::moved_temporarily, "HTTP/1.1 302 Moved Temporarily\r\n",
+     "<html>"
+     "<head><title>Moved Temporarily</title></head>"
+     "<body><h1>302 Moved Temporarily</h1></body>"
+     "</html>"},
+    {response::not_modified, "HTTP/1.1 304 Not Modified\r\n",
+     "<html>"
+     "<head><title>Not Modified</title></head>"
+     "<body><h1>304 Not Modified</h1></body>"
+     "</html>"},
+    {response::bad_request, "HTTP/1.1 400 Bad Request\r\n",
+     "<html>"
+     "<head><title>Bad Request</title></head>"
+     "<body><h1>400 Bad Request</h1></body>"
+     "</html>"},
+    {response::unauthorized, "HTTP/1.1 401 Unauthorized\r\n",
+     "<html>"
+     "<head><title>Unauthorized</title></head>"
+     "<body><h1>401 Unauthorized</h1></body>"
+     "</html>"},
+    {response::forbidden, "HTTP/1.1 403 Forbidden\r\n",
+     "<html>"
+     "<head><title>Forbidden</title></head>"
+     "<body><h1>403 Forbidden</h1></body>"
+     "</html>"},
+    {response::not_found, "HTTP/1.1 404 Not Found\r\n",
+     "<html>"
+     "<head><title>Not Found</title></head>"
+     "<body><h1>404 Not Found</h1></body>"
+     "</html>"},
+    {response::payload_too_large, "HTTP/1.1 413 Payload Too Large\r\n",
+     "<html>"
+     "<head><title>Payload Too Large</title></head>"
+     "<body><h1>413 Payload Too Large</h1></body>"
+     "</html>"},
+    {response::uri_too_long, "HTTP/1.1 414 URI Too Long\r\n",
+     "<html>"
+     "<head><title>URI Too Long</title></head>"
+     "<body><h1>414 URI Too Long</h1></body>"
+     "</html>"},
+    {response::request_header_fields_too_large,
+     "HTTP/1.1 431 Request Header Fields Too Large\r\n",
+     "<html>"
+     "<head><title>Request Header Fields Too Large</title></head>"
+     "<body><h1>431 Request Header Fields Too Large</h1></body>"
+     "</html>"},
+    {response::internal_server_error,
+     "HTTP/1.1 500 Internal Server Error\r\n",
+     "<html>"
+     "<head><title>Internal Server Error</title></head>"
+     "<body><h1>500 Internal Server Error</h1></body>"
+     "</html>"},
+    {response::not_implemented, "HTTP/1.1 501 Not Implemented\r\n",
+     "<html>"
+     "<head><title>Not Implemented</title></head>"
+     "<body><h1>501 Not Implemented</h1></body>"
+     "</html>"},
+    {response::bad_gateway, "HTTP/1.1 502 Bad Gateway\r\n",
+     "<html>"
+     "<head><title>Bad Gateway</title></head>"
+     "<body><h1>502 Bad Gateway</h1></body>"
+     "</html>"},
+    {response::service_unavailable, "HTTP/1.1 503 Service Unavailable\r\n",
+     "<html>"
+     "<head><title>Service Unavailable</title></head>"
+     "<body><h1>503 Service Unavailable</h1></body>"
+     "</html>"},
+};
+
+constexpr std::size_t STATUS_LIMIT = 600;
+
+/// Index into STATUS_TEXTS per status code, codes without a text map to 500.
+constexpr std::array<std::uint8_t, STATUS_LIMIT> STATUS_INDEX = []() {
+  std::array<std::uint8_t, STATUS_LIMIT> index{};
+  std::uint8_t fallback = 0;
+  for (std::size_t i = 0; i < std::size(STATUS_TEXTS); i++) {
+    if (STATUS_TEXTS[i].status == response::internal_server_error) {
+      fallback = static_cast<std::uint8_t>(i);
+    }
+  }
+  index.fill(fallback);
+  for (std::size_t i = 0; i < std::size(STATUS_TEXTS); i++) {
+    index[STATUS_TEXTS[i].status] = static_cast<std::uint8_t>(i);
+  }
+  return index;
+}();
+
+const status_text &get_status_text(response::status_type status) {
+  auto code = static_cast<std::size_t>(status);
+  return STATUS_TEXTS[STATUS_INDEX[code < STATUS_LIMIT ? code : 0]];
 }
 
-std::string_view get_default_response_content(response::status_type status) {
-  static std::unordered_map<response::status_type, std::string_view> mappings{
-      {response::ok, "<html>"
-                     "<head><title>Created</title></head>"
-                     "<body><h1>201 Created</h1></body>"
-                     "</html>"},
-      {response::created, "<html>"
-                          "<head><title>Created</title></head>"
-                          "<body><h1>201 Created</h1></body>"
-                          "</html>"},
-      {response::accepted, "<html>"
-                           "<head><title>Accepted</title></head>"
-                           "<body><h1>202 Accepted</h1></body>"
-                           "</html>"},
-      {response::no_content, "<html>"
-                             "<head><title>No Content</title></head>"
-                             "<body><h1>204 Content</h1></body>"
-                             "</html>"},
-      {response::multiple_choices,
-       "<html>"
-       "<head><title>Multiple Choices</title></head>"
-       "<body><h1>300 Multiple Choices</h1></body>"
-       "</html>"},
-      {response::moved_permanently,
-       "<html>"
-       "<head><title>Moved Permanently</title></head>"
-       "<body><h1>301 Moved Permanently</h1></body>"
-       "</html>"},
-      {response::moved_temporarily,
-       "<html>"
-       "<head><title>Moved Temporarily</title></head>"
-       "<body><h1>302 Moved Temporarily</h1></body>"
-       "</html>"},
-      {response::not_modified, "<html>"
-                               "<head><title>Not Modified</title></head>"
-                               "<body><h1>304 Not Modified</h1></body>"
-                               "</html>"},
-      {response::bad_request, "<html>"
-                              "<head><title>Bad Request</title></head>"
-                              "<body><h1>400 Bad Request</h1></body>"
-                              "</html>"},
-      {response::unauthorized, "<html>"
-                               "<head><title>Unauthorized</title></head>"
-                               "<body><h1>401 Unauthorized</h1></body>"
-                               "</html>"},
-      {response::forbidden, "<html>"
-                            "<head><title>Forbidden</title></head>"
-                            "<body><h1>403 Forbidden</h1></body>"
-                            "</html>"},
-      {response::not_found, "<html>"
-                            "<head><title>Not Found</title></head>"
-                            "<body><h1>404 Not Found</h1></body>"
-                            "</html>"},
-      {response::internal_server_error,
-       "<html>"
-       "<head><title>Internal Server Error</title></head>"
-       "<body><h1>500 Internal Server Error</h1></body>"
-       "</html>"},
-      {response::not_implemented, "<html>"
-                                  "<head><title>Not Implemented</title></head>"
-                                  "<body><h1>501 Not Implemented</h1></body>"
-                                  "</html>"},
-      {response::bad_gateway, "<html>"
-                              "<head><title>Bad Gateway</title></head>"
-                              "<body><h1>502 Bad Gateway</h1></body>"
-                              "</html>"},
-      {response::service_unavailable,
-       "<html>"
-       "<head><title>Service Unavailable</title></head>"
-       "<body><h1>503 Service Unavailable</h1></body>"
-       "</html>"}};
-
-  if (mappings.find(status) == mappings.end()) {
-    return mappings[response::internal_server_error];
-  }
-  return mappings[status];
+constexpr std::string_view SERVER = "Server: TinyHttpServer\r\n";
+constexpr std::string_view CONTENT_LENGTH = "Content-Length: ";
+constexpr std::string_view CHUNKED = "Transfer-Encoding: chunked\r\n";
+constexpr std::string_view KEEP_ALIVE = "Connection: keep-alive\r\n\r\n";
+constexpr std::string_view CLOSE = "Connection: close\r\n\r\n";
+
+} // namespace
+
+void response::to_buffers(send_queue &buffers) {
+  buffers.push_back(asio::buffer(m_head));
+  if (source) {
+    // the connection pulls the body once the head is written
+    return;
+  }
+  buffers.push_back(asio::buffer(content));
+  if (cached) {
+    buffers.push_back(asio::buffer(cached->data()));
+  }
+  buffers.push_file(file.native_handle(), 0, file.size());
 }
 
-void response::build_default_response(std::shared_ptr<response> rep,
-                                      status_type status) {
-  rep->status = status;
-  rep->content = get_default_response_content(status);
-  rep->headers["Content-Type"] = "text/html";
+void response::build_default_response(response &rep, status_type status) {
+  rep.status = status;
+  rep.content = get_status_text(status).content;
+  rep.headers.set(header_id::content_type, "text/html");
 }
 
-void response::update(bool keep_alive) {
-  headers["Content-Length"] = std::to_string(content.size());
-  headers["Connection"] = keep_alive ? "keep-alive" : "close";
+void response::update(bool keep_alive, std::string_view date) {
+  headers.erase(header_id::content_length);
+  headers.erase(header_id::transfer_encoding);
+  headers.erase(header_id::connection);
+  // "<server><date>Content-Length: <digits>\r\nConnection: keep-alive\r\n\r\n"
+  std::array<char, 64 + SERVER.size() + date_clock::LINE_SIZE> suffix;
+  char *out = suffix.data();
+  // the handler knows better
+  if (!headers.find(header_id::server)) {
+    out = std::copy(SERVER.begin(), SERVER.end(), out);
+  }
+  if (headers.find(header_id::date)) {
+    date = {};
+  }
+  out = std::copy(date.begin(),
+                  date.begin() + std::min(date.size(), date_clock::LINE_SIZE),
+                  out);
+  if (source) {
+    if (chunked) {
+      out = std::copy(CHUNKED.begin(), CHUNKED.end(), out);
+    }
+  } else {
+    out = std::copy(CONTENT_LENGTH.begin(), CONTENT_LENGTH.end(), out);
+    std::uint64_t body_size =
+        content.size() + (cached ? cached->size() : 0) + file.size();
+    out = std::to_chars(out, suffix.data() + suffix.size(), body_size).ptr;
+    *out++ = '\r';
+    *out++ = '\n';
+  }
+  std::string_view connection = keep_alive ? KEEP_ALIVE : CLOSE;
+  out = std::copy(connection.begin(), connection.end(), out);
+  m_head = headers.wrap(
+      get_status_text(status).line,
+      std::string_view(suffix.data(),
+                       static_cast<std::size_t>(out - suffix.data())));
 }
 
 } // namespace server
@@ -1,12 +1,159 @@
 #pragma once
 
+#include "body_source.hpp"
+#include "file_body.hpp"
+#include "file_cache.hpp"
+#include "header_names.hpp"
+#include "small_vector.hpp"
+
+#include <array>
 #include <asio.hpp>
-#include <list>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
 
 namespace http {
 namespace server {
 
+class send_queue;
+
+/// A header field of a response, a view into the rendered header lines.
+struct response_header {
+  std::string_view name;
+  std::string_view value;
+  header_id id{header_id::unknown};
+};
+
+/// The header fields of a response in the order they were first set, setting
+/// a field again replaces its value. Every field is rendered as its line
+/// "name: value\r\n" into one block when it is set, wrap() puts the status
+/// line in front of the block and the last fields behind it, so the whole
+/// head goes out as one buffer without being copied again. Well known fields
+/// are found through their slot. clear() keeps the block, a response reused
+/// for request after request stops allocating once its fields fit.
+class response_headers {
+public:
+  /// Room in front of the lines for the text passed to wrap().
+  static constexpr std::size_t PREFIX_CAPACITY = 64;
+
+  class const_iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = response_header;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = response_header;
+
+    const_iterator() = default;
+    const_iterator(const response_headers *headers, std::size_t index)
+        : m_headers(headers), m_index(index) {}
+
+    response_header operator*() const { return (*m_headers)[m_index]; }
+
+    const_iterator &operator++() {
+      m_index++;
+      return *this;
+    }
+
+    const_iterator operator++(int) {
+      const_iterator it = *this;
+      m_index++;
+      return it;
+    }
+
+    bool operator==(const const_iterator &other) const {
+      return m_index == other.m_index;
+    }
+    bool operator!=(const const_iterator &other) const {
+      return m_index != other.m_index;
+    }
+
+  private:
+    const response_headers *m_headers{};
+    std::size_t m_index{};
+  };
+
+  /// Set the well known field `id`.
+  void set(header_id id, std::string_view value);
+
+  /// Set the field called `name`, compared case insensitively.
+  void set(std::string_view name, std::string_view value);
+
+  std::optional<std::string_view> find(header_id id) const;
+
+  std::optional<std::string_view> find(std::string_view name) const;
+
+  /// Remove the well known field `id`, the lines behind it move.
+  void erase(header_id id);
+
+  void clear() {
+    m_fields.clear();
+    m_slots.fill(0);
+    m_end = PREFIX_CAPACITY;
+  }
+
+  std::size_t size() const { return m_fields.size(); }
+
+  bool empty() const { return m_fields.empty(); }
+
+  /// The field at `index` in the order first set.
+  response_header operator[](std::size_t index) const;
+
+  const_iterator begin() const { return {this, 0}; }
+  const_iterator end() const { return {this, m_fields.size()}; }
+
+  /// The lines of all fields, one after the other.
+  std::string_view lines() const {
+    return std::string_view(m_block.data(), m_end).substr(PREFIX_CAPACITY);
+  }
+
+  /// Write `prefix` right in front of the lines and `suffix` right behind
+  /// them, return the three as one block. `prefix` is at most
+  /// PREFIX_CAPACITY bytes. Valid until the fields change.
+  std::string_view wrap(std::string_view prefix, std::string_view suffix);
+
+private:
+  /// Where a field lives in m_block.
+  struct field_line {
+    header_id id{header_id::unknown};
+    // length of the name, the value follows ": "
+    std::uint16_t name_size{};
+    // start of the line and length of the value
+    std::uint32_t offset{};
+    std::uint32_t value_size{};
+
+    std::size_t value_offset() const { return offset + name_size + 2; }
+  };
+
+  /// Index of the field `id` in m_fields, size() when it is not set.
+  std::size_t index_of(header_id id) const;
+
+  /// Append the line of a new field.
+  void append(header_id id, std::string_view name, std::string_view value);
+
+  /// Replace the value of the field at `index`, the lines behind it move.
+  void replace(std::size_t index, std::string_view value);
+
+  /// Make m_block at least `size` bytes, it only ever grows so the bytes
+  /// being written over are never cleared first.
+  void reserve(std::size_t size) {
+    if (m_block.size() < size) {
+      m_block.resize(size);
+    }
+  }
+
+  small_vector<field_line, 8> m_fields;
+  // per well known field its index + 1 in m_fields, 0 when not set
+  std::array<std::uint8_t, WELL_KNOWN_HEADERS> m_slots{};
+  // PREFIX_CAPACITY bytes for wrap(), then the lines up to m_end
+  std::string m_block;
+  std::size_t m_end{PREFIX_CAPACITY};
+};
+
 /// A reply to be sent to a client.
 struct response {
   /// The status of the reply.
@@ -23,33 +170,72 @@ struct response {
     unauthorized = 401,
     forbidden = 403,
     not_found = 404,
+    payload_too_large = 413,
+    uri_too_long = 414,
+    request_header_fields_too_large = 431,
     internal_server_error = 500,
     not_implemented = 501,
     bad_gateway = 502,
     service_unavailable = 503
-  } status;
+  } status{ok};
 
   /// The headers to be included in the reply.
-  std::unordered_map<std::string, std::string> headers;
+  response_headers headers;
 
   /// The content to be sent in the reply.
   std::string content;
 
-  /// Convert the reply into a vector of buffers. The buffers do not own the
-  /// underlying memory blocks, therefore the reply object must remain valid and
-  /// not be changed until the write operation has completed.
-  void to_buffers(std::list<asio::const_buffer> &buffers);
+  /// A copy of the file_cache sent after `content`, shared with every other
+  /// response of the same file.
+  std::shared_ptr<const cached_file> cached;
+
+  /// A file sent after `content`, not read into memory.
+  file_body file;
+
+  /// The producer of a streamed body of unknown length, sent instead of
+  /// content, cached and file, which are ignored when it is set.
+  std::unique_ptr<body_source> source;
+
+  /// Whether the streamed body goes out with the chunked transfer coding.
+  /// An HTTP/1.0 client does not know it, the body then ends with the
+  /// connection.
+  bool chunked{true};
+
+  /// Append the reply to a send queue, the head rendered by update(), the
+  /// content, the cached file and the file, only the head for a streamed body.
+  /// The buffers do not own the underlying memory blocks, therefore the reply
+  /// object must remain valid and not be changed until the write operation has
+  /// completed.
+  void to_buffers(send_queue &buffers);
 
   void clear() {
     content.clear();
+    cached.reset();
+    file.close();
+    source.reset();
+    chunked = true;
     headers.clear();
+    m_head = {};
   }
 
-  void update(bool keep_alive);
+  /// Put the status line in front of the lines of the headers, the constant
+  /// Server line, `date`, Content-Length of the whole body, or
+  /// Transfer-Encoding: chunked for a streamed body, and Connection behind
+  /// them, the head is then one block. `date` is the Date line of a
+  /// date_clock or empty. Server and Date are left out when `headers` have
+  /// them. A Content-Length, Transfer-Encoding or Connection set in `headers`
+  /// is replaced.
+  void update(bool keep_alive, std::string_view date = {});
+
+  /// The block made by the last update(), valid until the headers change.
+  std::string_view head() const { return m_head; }
 
   /// Get a stock reply.
-  static void build_default_response(std::shared_ptr<response> rep,
-                                     status_type status);
+  static void build_default_response(response &rep, status_type status);
+
+private:
+  // a view into the block of the headers
+  std::string_view m_head{};
 };
 
 } // namespace server
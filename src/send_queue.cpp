@@ -0,0 +1,58 @@
+#include "send_queue.hpp"
+
+#include <algorithm>
+
+namespace http {
+namespace server {
+
+void send_queue::consume(std::size_t bytes_transferred) {
+  if (!m_files.empty() && m_files[0].position == m_head) {
+    file_part &file = m_files[0];
+    file.offset += bytes_transferred;
+    file.size -= bytes_transferred;
+    if (file.size == 0) {
+      m_files.erase(0);
+    }
+    if (empty()) {
+      clear();
+    }
+    return;
+  }
+  // batch() never reaches past the next file
+  while (m_head < m_tail && m_data[m_head].size() <= bytes_transferred) {
+    bytes_transferred -= m_data[m_head].size();
+    m_head++;
+  }
+  if (empty()) {
+    clear();
+    return;
+  }
+  if (m_head == m_tail) {
+    // only files are left
+    return;
+  }
+  // 之后我们可以计算剩余的偏移量
+  m_data[m_head] += bytes_transferred;
+}
+
+void send_queue::make_room() {
+  std::size_t pending = size();
+  if (m_head > 0 && pending < m_capacity / 2) {
+    std::copy(m_data + m_head, m_data + m_tail, m_data);
+  } else {
+    std::size_t capacity = m_capacity * 2;
+    auto heap = std::make_unique<asio::const_buffer[]>(capacity);
+    std::copy(m_data + m_head, m_data + m_tail, heap.get());
+    m_heap = std::move(heap);
+    m_data = m_heap.get();
+    m_capacity = capacity;
+  }
+  for (file_part &file : m_files) {
+    file.position -= m_head;
+  }
+  m_head = 0;
+  m_tail = pending;
+}
+
+} // namespace server
+} // namespace http
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "small_vector.hpp"
+
+#include <array>
+#include <asio.hpp>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+namespace http {
+namespace server {
+
+/// Buffers waiting to be written, kept contiguous so the pending part is
+/// always a single span for async_write_some(). The first INLINE_CAPACITY
+/// buffers live inside the queue, a typical response never touches the heap.
+/// Written buffers are dropped by moving the head, a partially written front
+/// buffer is shrunk in place. The queue rewinds when it drains and compacts
+/// instead of wrapping around when the tail reaches the end.
+///
+/// A range of a file can be queued between the buffers. batch() stops in
+/// front of it, once the buffers before it are written next_file() hands it
+/// out and consume() counts the bytes sent against it instead.
+class send_queue {
+public:
+  static constexpr std::size_t INLINE_CAPACITY = 64;
+
+  /// A range of an open file, sent once the buffers queued before it are.
+  struct file_part {
+    int fd{-1};
+    std::uint64_t offset{};
+    std::uint64_t size{};
+    // index of the buffer it goes in front of
+    std::size_t position{};
+  };
+
+  /// Buffers handed out by batch() at most, a writev() with more than IOV_MAX
+  /// iovecs fails.
+#if defined(IOV_MAX)
+  static constexpr std::size_t MAX_BATCH = IOV_MAX;
+#else
+  static constexpr std::size_t MAX_BATCH = 1024;
+#endif
+
+  send_queue() = default;
+  send_queue(const send_queue &) = delete;
+  send_queue &operator=(const send_queue &) = delete;
+
+  bool empty() const { return m_head == m_tail && m_files.empty(); }
+
+  /// Number of buffers still to be written.
+  std::size_t size() const { return m_tail - m_head; }
+
+  /// Queue `buffer`, empty buffers are skipped.
+  void push_back(asio::const_buffer buffer) {
+    if (buffer.size() == 0) {
+      return;
+    }
+    if (m_tail == m_capacity) {
+      make_room();
+    }
+    m_data[m_tail++] = buffer;
+  }
+
+  /// Queue `size` bytes of the file `fd` from `offset`, the descriptor must
+  /// stay open until they are sent.
+  void push_file(int fd, std::uint64_t offset, std::uint64_t size) {
+    if (size > 0) {
+      m_files.push_back({fd, offset, size, m_tail});
+    }
+  }
+
+  /// The next buffers to write, at most MAX_BATCH of them and none behind
+  /// the next file.
+  std::span<const asio::const_buffer> batch() const {
+    std::size_t count = std::min(size(), MAX_BATCH);
+    if (!m_files.empty()) {
+      count = std::min(count, m_files[0].position - m_head);
+    }
+    return {m_data + m_head, count};
+  }
+
+  /// The file to send now, nullptr while buffers in front of it are pending.
+  const file_part *next_file() const {
+    return !m_files.empty() && m_files[0].position == m_head ? &m_files[0]
+                                                             : nullptr;
+  }
+
+  /// `bytes_transferred` bytes from the front were written, of the file when
+  /// next_file() is not null.
+  void consume(std::size_t bytes_transferred);
+
+  /// Drop everything, the capacity is kept.
+  void clear() {
+    m_head = m_tail = 0;
+    m_files.clear();
+  }
+
+private:
+  /// Compact the pending buffers to the front, or grow when they fill the
+  /// whole capacity.
+  void make_room();
+
+  std::array<asio::const_buffer, INLINE_CAPACITY> m_inline{};
+  std::unique_ptr<asio::const_buffer[]> m_heap{};
+  asio::const_buffer *m_data{m_inline.data()};
+  std::size_t m_capacity{INLINE_CAPACITY};
+  std::size_t m_head{};
+  std::size_t m_tail{};
+  // files between the buffers in queue order, usually none
+  small_vector<file_part, 2> m_files{};
+};
+
+} // namespace server
+} // namespace http
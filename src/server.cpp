@@ -1,54 +1,67 @@
 #include "server.hpp"
-#include "connection.hpp"
-#include "connection_manager.hpp"
-#include "request_handler.hpp"
-#include "ssl_connection.hpp"
+#include "shard.hpp"
 
+#include <algorithm>
+#include <csignal>
+#include <cstring>
 #include <iostream>
 #include <signal.h>
 #include <spdlog/spdlog.h>
 #include <string>
+#include <thread>
 #include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 namespace fs = std::filesystem;
 
 namespace http {
 namespace server {
 
-server::server(std::string_view address, std::string_view port,
-               const fs::path &doc_root, const fs::path &cert_path,
-               const fs::path &key_path)
-    : m_context(1), m_signal_set(m_context), m_acceptor(m_context) {
-  m_connection_manager = std::make_shared<connection_manager>();
-  m_request_handler = std::make_shared<request_handler>(doc_root);
-  // Register to handle the signals that indicate when the server should exit.
-  // It is safe to register for the same signal multiple times in a program,
-  // provided all registration for the specified signal is made through Asio.
-  m_signal_set.add(SIGINT);
-  m_signal_set.add(SIGTERM);
-#if defined(SIGQUIT)
-  signals_.add(SIGQUIT);
-#endif // defined(SIGQUIT)
-
-  m_signal_set.async_wait([this](std::error_code /*ec*/, int signo) {
-    // The server is stopped by cancelling all outstanding asynchronous
-    // operations. Once all operations have finished the io_context::run()
-    // call will exit.
-    spdlog::info("receive signal: {}, server exit!", signo);
-    m_acceptor.close();
-    m_connection_manager->stop_all();
-  });
+static std::size_t resolve_thread_count(std::size_t thread_count) {
+  if (thread_count == 0) {
+    thread_count = std::thread::hardware_concurrency();
+  }
+  return std::max<std::size_t>(thread_count, 1);
+}
 
-  static constexpr bool enable_ssl = true;
+static void pin_current_thread(std::size_t index) {
+#if defined(__linux__)
+  std::size_t cpu_count =
+      std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(index % cpu_count, &cpus);
+  int err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+  if (err != 0) {
+    spdlog::warn("failed to pin thread {} to cpu {}: {}", index,
+                 index % cpu_count, std::strerror(err));
+  }
+#else
+  spdlog::warn("thread pinning is only supported on linux, ignored");
+#endif
+}
 
-  if (enable_ssl && fs::exists(cert_path) && fs::exists(key_path)) {
+server::server(std::string_view address, std::string_view port,
+               const fs::path &doc_root, const server_options &options,
+               const fs::path &cert_path, const fs::path &key_path)
+    : m_thread_count(resolve_thread_count(options.thread_count)),
+      m_pin_threads(options.pin_threads) {
+  if (options.parser && !header_parser::available(*options.parser)) {
+    spdlog::warn("llhttp parser not built in, using the builtin parser");
+  }
+  if (options.enable_ssl && fs::exists(cert_path) && fs::exists(key_path)) {
     spdlog::info("enable SSL/TLS");
     // sslv23 means generic SSL/TLS (support both)
     // SSLv2 is too old and insecure, so we disable support for it!
     m_ssl_context = asio::ssl::context(asio::ssl::context::sslv23);
     m_ssl_context->set_options(asio::ssl::context::default_workarounds);
     asio::error_code err;
-    m_ssl_context->use_certificate_file(cert_path.u8string().c_str(),
+    m_ssl_context->use_certificate_file(cert_path.string(),
                                         asio::ssl::context::file_format::pem,
                                         err);
     if (err) {
@@ -57,7 +70,7 @@ server::server(std::string_view address, std::string_view port,
                       err.category().name(), err.message()));
     }
     m_ssl_context->use_private_key_file(
-        key_path.u8string().c_str(), asio::ssl::context::file_format::pem, err);
+        key_path.string(), asio::ssl::context::file_format::pem, err);
     if (err) {
       throw std::runtime_error(
           fmt::format("[file: {},line: {}] {}: {}", __FILE__, __LINE__,
@@ -65,67 +78,103 @@ server::server(std::string_view address, std::string_view port,
     }
   }
 
-  // Open the acceptor with the option to reuse the address (i.e. SO_REUSEADDR).
-  asio::ip::tcp::resolver resolver(m_context);
+  asio::io_context resolver_context;
+  asio::ip::tcp::resolver resolver(resolver_context);
   auto endpoints = resolver.resolve(address, port);
   for (auto e : endpoints) {
     spdlog::info("resolved: {}://{}:{}", m_ssl_context ? "https" : "http",
                  e.endpoint().address().to_string(), e.endpoint().port());
   }
-  asio::ip::tcp::endpoint endpoint = *resolver.resolve(address, port).begin();
-  m_acceptor.open(endpoint.protocol());
-  // first true means enable linger, the second means timeout value
-  // m_acceptor.set_option(asio::ip::tcp::acceptor::linger(true, 30));
-  m_acceptor.set_option(asio::ip::tcp::acceptor::reuse_address(true));
-  m_acceptor.bind(endpoint);
-  m_acceptor.listen();
+  asio::ip::tcp::endpoint endpoint = endpoints.begin()->endpoint();
+
+  execution_mode mode = options.mode;
+#if !defined(SO_REUSEPORT)
+  if (mode == execution_mode::thread_per_core) {
+    spdlog::warn("SO_REUSEPORT is not supported, fall back to shared pool");
+    mode = execution_mode::shared_pool;
+  }
+#endif
+  asio::ssl::context *ssl_context = m_ssl_context ? &*m_ssl_context : nullptr;
+  // one copy of each hot file however many shards serve it
+  std::shared_ptr<file_cache> cache =
+      request_handler::make_file_cache(options.file_cache_size);
+  if (mode == execution_mode::thread_per_core) {
+    for (std::size_t i = 0; i < m_thread_count; i++) {
+      m_shards.emplace_back(std::make_unique<shard>(
+          1, endpoint, true, doc_root, options, cache, ssl_context));
+    }
+  } else {
+    m_shards.emplace_back(std::make_unique<shard>(
+        m_thread_count, endpoint, false, doc_root, options, cache,
+        ssl_context));
+  }
+
+  if (!options.unix_socket_path.empty()) {
+    m_shards.front()->listen_local(options.unix_socket_path);
+  }
+
+  // Register to handle the signals that indicate when the server should exit.
+  // It is safe to register for the same signal multiple times in a program,
+  // provided all registration for the specified signal is made through Asio.
+  m_signal_set.emplace(m_shards.front()->get_executor());
+  m_signal_set->add(SIGINT);
+  m_signal_set->add(SIGTERM);
+#if defined(SIGQUIT)
+  m_signal_set->add(SIGQUIT);
+#endif // defined(SIGQUIT)
+#if defined(SIGPIPE)
+  // asio sends with MSG_NOSIGNAL, sendfile(2) of a file body has no such flag
+  // and would kill the process when the peer is gone
+  std::signal(SIGPIPE, SIG_IGN);
+#endif // defined(SIGPIPE)
+
+  m_signal_set->async_wait([this](asio::error_code err, int signo) {
+    if (err) {
+      return;
+    }
+    spdlog::info("receive signal: {}, server exit!", signo);
+    stop();
+  });
+
   std::string address_str = endpoint.address().to_string();
   if (address_str == "0.0.0.0") {
     address_str = "localhost";
   }
-  spdlog::info("start server at: {}://{}:{}", m_ssl_context ? "https" : "http",
-               address_str, endpoint.port());
-  do_accept();
+  spdlog::info("start server at: {}://{}:{} with {} threads ({})",
+               m_ssl_context ? "https" : "http", address_str, endpoint.port(),
+               m_thread_count,
+               mode == execution_mode::thread_per_core ? "thread per core"
+                                                       : "shared pool");
 }
 
+server::~server() = default;
+
 void server::run() {
-  // The io_context::run() call will block until all asynchronous operations
-  // have finished. While the server is running, there is always at least one
-  // asynchronous operation outstanding: the asynchronous accept call waiting
-  // for new incoming connections.
-  m_context.run();
+  // thread i runs shard i in thread-per-core mode, every thread runs the only
+  // shard of the shared pool
+  auto worker = [this](std::size_t index) {
+    if (m_pin_threads) {
+      pin_current_thread(index);
+    }
+    m_shards[index % m_shards.size()]->run();
+  };
+  std::vector<std::thread> workers;
+  workers.reserve(m_thread_count - 1);
+  for (std::size_t i = 1; i < m_thread_count; i++) {
+    workers.emplace_back(worker, i);
+  }
+  worker(0);
+  for (auto &t : workers) {
+    t.join();
+  }
 }
 
-void server::do_accept() {
-  m_acceptor.async_accept(
-      [this](asio::error_code ec, asio::ip::tcp::socket socket) {
-        // Check whether the server was stopped by a signal before this
-        // completion handler had a chance to run.
-        if (!m_acceptor.is_open()) {
-          return;
-        }
-
-        if (ec) {
-          spdlog::error("[file:{},line:{}] {}: {}", __FILE__, __LINE__,
-                        ec.category().name(), ec.message());
-          return;
-        }
-
-        spdlog::info("connected: {}:{}",
-                     socket.remote_endpoint().address().to_string(),
-                     socket.remote_endpoint().port());
-
-        if (m_ssl_context) {
-          m_connection_manager->start(ssl_connection::create(
-              ssl_connection::stream(std::move(socket), m_ssl_context.value()),
-              m_connection_manager, m_request_handler));
-        } else {
-          m_connection_manager->start(connection::create(
-              std::move(socket), m_connection_manager, m_request_handler));
-        }
-
-        do_accept();
-      });
+void server::stop() {
+  asio::post(m_signal_set->get_executor(),
+             [this]() { m_signal_set->cancel(); });
+  for (auto &s : m_shards) {
+    s->stop();
+  }
 }
 
 } // namespace server
@@ -1,16 +1,76 @@
 #pragma once
 
+#include "header_parser.hpp"
+#include "request_handler.hpp"
+
 #include <asio.hpp>
 #include <asio/ssl.hpp>
 #include <filesystem>
+#include <memory>
 #include <optional>
 #include <string>
+#include <thread>
+#include <vector>
+
+// asio drives sockets through io_uring since 1.21, older releases ignore the
+// macro and stay on epoll without a word
+#if defined(ASIO_HAS_IO_URING) && ASIO_VERSION < 102100
+#error "MY_SERVER_ASIO_IO_URING needs asio 1.21 or later"
+#endif
 
 namespace http {
 namespace server {
 
-class connection_manager;
-class request_handler;
+class shard;
+
+/// How the worker threads share the work.
+enum class execution_mode {
+  /// All threads run one io_context and one acceptor, each connection gets a
+  /// strand of its own.
+  shared_pool,
+  /// Each thread runs its own io_context with its own acceptor bound with
+  /// SO_REUSEPORT, its own connection_manager and request_handler.
+  thread_per_core,
+};
+
+/// Tunables of the server, the defaults match the original single threaded
+/// setup.
+struct server_options {
+  /// Number of worker threads, 0 means one thread per hardware core.
+  std::size_t thread_count{1};
+
+  /// How the worker threads share the work.
+  execution_mode mode{execution_mode::shared_pool};
+
+  /// Pin worker thread i to cpu i (modulo the number of cores), Linux only.
+  bool pin_threads{false};
+
+  /// Serve https when the certificate and the private key can be found.
+  bool enable_ssl{true};
+
+  /// Also serve plain http on a unix domain socket at this path when not
+  /// empty, only the first shard listens on it.
+  std::filesystem::path unix_socket_path{};
+
+  /// Request header parser, the build default when not set: llhttp with
+  /// MY_SERVER_LLHTTP, the builtin one otherwise.
+  std::optional<parser_backend> parser{};
+
+  /// Limits on the request line and the header fields of a request.
+  header_limits limits{};
+
+  /// Bytes of small static files kept in memory once for the whole server
+  /// and shared by the connections of all shards, 0 sends every file from
+  /// its descriptor.
+  std::size_t file_cache_size{64 * 1024 * 1024};
+
+  /// Dynamic paths answered by a handler instead of a static file, every
+  /// shard gets a copy.
+  route_map routes{};
+
+  /// Compression of the responses for clients sending Accept-Encoding.
+  compression_options compression{};
+};
 
 /// The top-level class of the HTTP server.
 class server {
@@ -22,35 +82,38 @@ public:
   /// serve up files from the given directory.
   explicit server(std::string_view address, std::string_view port,
                   const std::filesystem::path &doc_root,
+                  const server_options &options = {},
                   const std::filesystem::path &cert_path =
                       std::filesystem::path(DATA_PATH) / "CA/cert.pem",
                   const std::filesystem::path &key_path =
                       std::filesystem::path(DATA_PATH) / "CA/key.pem");
 
-  /// Run the server's io_context loop.
-  void run();
+  ~server();
 
-private:
-  /// Perform an asynchronous accept operation.
-  void do_accept();
+  /// Run the io_context loops on all worker threads, blocks until the server
+  /// is stopped.
+  void run();
 
-  /// The io_context used to perform asynchronous operations.
-  asio::io_context m_context;
+  /// Stop accepting and close all live connections of every shard, safe to
+  /// call from any thread.
+  void stop();
 
-  /// The signal_set is used to register for process termination notifications.
-  asio::signal_set m_signal_set;
+private:
+  /// Number of worker threads.
+  std::size_t m_thread_count;
 
-  /// Acceptor used to listen for incoming connections.
-  asio::ip::tcp::acceptor m_acceptor;
+  /// Whether worker threads are pinned to cpus.
+  bool m_pin_threads;
 
-  /// The connection manager which owns all live connections.
-  std::shared_ptr<connection_manager> m_connection_manager;
+  /// ssl context, shared read-only by all shards
+  std::optional<asio::ssl::context> m_ssl_context;
 
-  /// The handler for all incoming requests.
-  std::shared_ptr<request_handler> m_request_handler;
+  /// One shard for the shared pool, one per worker thread otherwise.
+  std::vector<std::unique_ptr<shard>> m_shards;
 
-  /// ssl context
-  std::optional<asio::ssl::context> m_ssl_context;
+  /// The signal_set is used to register for process termination notifications,
+  /// lives on the acceptor strand of the first shard and fans out to all.
+  std::optional<asio::signal_set> m_signal_set;
 };
 
 } // namespace server
@@ -0,0 +1,223 @@
+#include "shard.hpp"
+#include "basic_connection.hpp"
+#include "connection_manager.hpp"
+#include "request_handler.hpp"
+#include "timer_wheel.hpp"
+
+#include <spdlog/spdlog.h>
+
+namespace http {
+namespace server {
+
+#if defined(SO_REUSEPORT)
+using reuse_port = asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+#endif
+
+shard::shard(std::size_t concurrency, const asio::ip::tcp::endpoint &endpoint,
+             bool enable_reuse_port, const std::filesystem::path &doc_root,
+             const server_options &options, std::shared_ptr<file_cache> cache,
+             asio::ssl::context *ssl_context)
+    : m_context(static_cast<int>(concurrency)),
+      m_acceptor(asio::make_strand(m_context)),
+      m_strand_per_connection(concurrency > 1),
+      m_connection_manager(std::make_shared<connection_manager>()),
+      m_request_handler(std::make_shared<request_handler>(
+          doc_root, std::move(cache), options.routes, options.compression)),
+      m_timer_wheel(std::make_shared<timer_wheel>(
+          concurrency > 1 ? asio::any_io_executor(asio::make_strand(m_context))
+                          : asio::any_io_executor(m_context.get_executor()))),
+      m_ssl_context(ssl_context),
+      m_parser_backend(
+          options.parser && header_parser::available(*options.parser)
+              ? *options.parser
+              : header_parser::default_backend()),
+      m_limits(options.limits) {
+  // Open the acceptor with the option to reuse the address (i.e. SO_REUSEADDR).
+  m_acceptor.open(endpoint.protocol());
+  // first true means enable linger, the second means timeout value
+  // m_acceptor.set_option(asio::ip::tcp::acceptor::linger(true, 30));
+  m_acceptor.set_option(asio::ip::tcp::acceptor::reuse_address(true));
+  if (enable_reuse_port) {
+#if defined(SO_REUSEPORT)
+    // the kernel spreads incoming connections over all sockets bound to the
+    // same endpoint
+    m_acceptor.set_option(reuse_port(true));
+#else
+    throw std::runtime_error("SO_REUSEPORT is not supported on this platform");
+#endif
+  }
+  m_acceptor.bind(endpoint);
+  m_acceptor.listen();
+#if defined(MY_SERVER_IO_URING)
+  if (concurrency == 1) {
+    asio::error_code err;
+    auto &uring = asio::use_service<uring_service>(m_context);
+    if (uring.open(err)) {
+      m_uring = &uring;
+    } else {
+      spdlog::warn("io_uring unavailable ({}), serving with epoll",
+                   err.message());
+    }
+  } else {
+    spdlog::warn("io_uring runs one thread per shard, the {} threads of the "
+                 "shared pool stay on epoll",
+                 concurrency);
+  }
+  if (m_uring) {
+    // accepted sockets inherit TCP_NODELAY from the listening socket
+    m_acceptor.set_option(asio::ip::tcp::no_delay(true));
+    m_uring->start_accept(m_acceptor.native_handle(), [this](int index) {
+      on_accepted(uring_socket(*m_uring, index));
+    });
+    return;
+  }
+#endif
+  do_accept();
+}
+
+void shard::listen_local(const std::filesystem::path &path) {
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+  std::error_code err;
+  std::filesystem::remove(path, err);
+  m_local_acceptor.emplace(m_acceptor.get_executor(),
+                           asio::local::stream_protocol::endpoint(path.string()));
+  spdlog::info("start server at: unix:{}", path.string());
+  do_accept_local();
+#else
+  throw std::runtime_error("unix domain sockets are not supported");
+#endif
+}
+
+void shard::run() {
+  // The io_context::run() call will block until all asynchronous operations
+  // have finished. While the server is running, there is always at least one
+  // asynchronous operation outstanding: the asynchronous accept call waiting
+  // for new incoming connections.
+  m_context.run();
+}
+
+void shard::stop() {
+  // The shard is stopped by cancelling all outstanding asynchronous
+  // operations. Once all operations have finished the io_context::run()
+  // call will exit.
+  asio::post(m_acceptor.get_executor(), [this]() {
+    if (!m_acceptor.is_open()) {
+      return;
+    }
+#if defined(MY_SERVER_IO_URING)
+    if (m_uring) {
+      m_uring->cancel_accept();
+    }
+#endif
+    m_acceptor.close();
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+    if (m_local_acceptor) {
+      std::string path = m_local_acceptor->local_endpoint().path();
+      m_local_acceptor->close();
+      std::error_code err;
+      std::filesystem::remove(path, err);
+    }
+#endif
+    m_connection_manager->stop_all();
+    m_timer_wheel->stop();
+  });
+}
+
+void shard::do_accept() {
+  auto handler = [this](asio::error_code ec, asio::ip::tcp::socket socket) {
+    // Check whether the server was stopped by a signal before this
+    // completion handler had a chance to run.
+    if (!m_acceptor.is_open()) {
+      return;
+    }
+
+    if (ec) {
+      spdlog::error("[file:{},line:{}] {}: {}", __FILE__, __LINE__,
+                    ec.category().name(), ec.message());
+      return;
+    }
+
+    on_accepted(std::move(socket));
+    do_accept();
+  };
+  if (m_strand_per_connection) {
+    // every accepted socket is bound to its own strand, all handlers of one
+    // connection are serialized while different connections run in parallel
+    m_acceptor.async_accept(asio::make_strand(m_context), std::move(handler));
+  } else {
+    // a single thread runs this shard, no strand needed
+    m_acceptor.async_accept(m_context, std::move(handler));
+  }
+}
+
+void shard::on_accepted(asio::ip::tcp::socket socket) {
+  asio::error_code err;
+  auto remote = socket.remote_endpoint(err);
+  if (err) {
+    return;
+  }
+  spdlog::info("connected: {}:{}", remote.address().to_string(),
+               remote.port());
+  // a batch of pipelined responses may take more than one write, nagle would
+  // hold the tail back until the client acks the head
+  socket.set_option(asio::ip::tcp::no_delay(true), err);
+
+  if (m_ssl_context) {
+    m_connection_manager->start(ssl_connection::create(
+        ssl_connection::stream(std::move(socket), *m_ssl_context),
+        m_connection_manager, m_request_handler, m_timer_wheel,
+        m_parser_backend, m_limits));
+  } else {
+    m_connection_manager->start(connection::create(
+        std::move(socket), m_connection_manager, m_request_handler,
+        m_timer_wheel, m_parser_backend, m_limits));
+  }
+}
+
+#if defined(MY_SERVER_IO_URING)
+void shard::on_accepted(uring_socket socket) {
+  spdlog::info("connected: io_uring socket");
+  if (m_ssl_context) {
+    m_connection_manager->start(ssl_uring_connection::create(
+        ssl_uring_connection::stream(std::move(socket), *m_ssl_context),
+        m_connection_manager, m_request_handler, m_timer_wheel,
+        m_parser_backend, m_limits));
+  } else {
+    m_connection_manager->start(uring_connection::create(
+        std::move(socket), m_connection_manager, m_request_handler,
+        m_timer_wheel, m_parser_backend, m_limits));
+  }
+}
+#endif
+
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+void shard::do_accept_local() {
+  auto handler = [this](asio::error_code ec,
+                        asio::local::stream_protocol::socket socket) {
+    if (!m_local_acceptor->is_open()) {
+      return;
+    }
+
+    if (ec) {
+      spdlog::error("[file:{},line:{}] {}: {}", __FILE__, __LINE__,
+                    ec.category().name(), ec.message());
+      return;
+    }
+
+    spdlog::info("connected: unix socket");
+    m_connection_manager->start(local_connection::create(
+        std::move(socket), m_connection_manager, m_request_handler,
+        m_timer_wheel, m_parser_backend, m_limits));
+    do_accept_local();
+  };
+  if (m_strand_per_connection) {
+    m_local_acceptor->async_accept(asio::make_strand(m_context),
+                                   std::move(handler));
+  } else {
+    m_local_acceptor->async_accept(m_context, std::move(handler));
+  }
+}
+#endif
+
+} // namespace server
+} // namespace http
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "header_parser.hpp"
+#include "request_handler.hpp"
+#include "server.hpp"
+#if defined(MY_SERVER_IO_URING)
+#include "uring_socket.hpp"
+#endif
+
+#include <asio.hpp>
+#include <asio/ssl.hpp>
+#include <filesystem>
+#include <memory>
+#include <optional>
+
+namespace http {
+namespace server {
+
+class connection_manager;
+class timer_wheel;
+
+/// One listening socket together with the io_context, connection_manager and
+/// request_handler serving it. The shared pool runs a single shard on many
+/// threads, the thread-per-core mode runs one shard per thread and shares
+/// nothing between them on the hot path.
+class shard {
+public:
+  shard(const shard &) = delete;
+  shard &operator=(const shard &) = delete;
+
+  /// Open, bind and listen. `concurrency` is the number of threads that will
+  /// call run(), connections get a strand of their own when it is above one.
+  /// `reuse_port` lets several shards bind the same endpoint (SO_REUSEPORT).
+  /// Static files are served through `cache`, the file cache of the whole
+  /// server. The routes, compression, header parser and its limits are
+  /// taken from `options`.
+  shard(std::size_t concurrency, const asio::ip::tcp::endpoint &endpoint,
+        bool reuse_port, const std::filesystem::path &doc_root,
+        const server_options &options, std::shared_ptr<file_cache> cache,
+        asio::ssl::context *ssl_context);
+
+  /// Also listen on a unix domain socket at `path`, a stale socket file is
+  /// replaced.
+  void listen_local(const std::filesystem::path &path);
+
+  /// Run the io_context loop, blocks until the shard is stopped.
+  void run();
+
+  /// Stop accepting and close all live connections, safe to call from any
+  /// thread.
+  void stop();
+
+  /// Executor of the acceptor, handlers posted here never race with accept.
+  asio::any_io_executor get_executor() { return m_acceptor.get_executor(); }
+
+private:
+  /// Perform an asynchronous accept operation.
+  void do_accept();
+
+  /// Start serving an accepted socket.
+  void on_accepted(asio::ip::tcp::socket socket);
+
+#if defined(MY_SERVER_IO_URING)
+  /// Start serving a socket accepted by the io_uring of the shard.
+  void on_accepted(uring_socket socket);
+#endif
+
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+  /// Perform an asynchronous accept operation on the unix domain socket.
+  void do_accept_local();
+#endif
+
+  /// The io_context used to perform asynchronous operations.
+  asio::io_context m_context;
+
+  /// Acceptor used to listen for incoming connections, lives on its own strand
+  /// so that accepting and stopping never race.
+  asio::ip::tcp::acceptor m_acceptor;
+
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+  /// Optional acceptor of a unix domain socket, shares the acceptor strand.
+  std::optional<asio::local::stream_protocol::acceptor> m_local_acceptor;
+#endif
+
+  /// Whether every connection needs a strand of its own.
+  bool m_strand_per_connection;
+
+  /// The connection manager which owns all live connections of this shard.
+  std::shared_ptr<connection_manager> m_connection_manager;
+
+  /// The handler for all incoming requests of this shard.
+  std::shared_ptr<request_handler> m_request_handler;
+
+  /// Deadlines of all connections of this shard, ticks on its own strand.
+  std::shared_ptr<timer_wheel> m_timer_wheel;
+
+  /// ssl context owned by the server, nullptr for plain http
+  asio::ssl::context *m_ssl_context;
+
+  /// Header parser of the connections of this shard and its limits.
+  parser_backend m_parser_backend;
+  header_limits m_limits;
+
+#if defined(MY_SERVER_IO_URING)
+  /// The io_uring accepting and serving the tcp connections, nullptr when
+  /// they go through the reactor of asio.
+  uring_service *m_uring{};
+#endif
+};
+
+} // namespace server
+} // namespace http
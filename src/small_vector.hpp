@@ -0,0 +1,84 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <vector>
+
+namespace http {
+namespace server {
+
+/// Vector keeping its first N elements inline. Past N it moves everything into
+/// a std::vector and stays there, clear() keeps whichever storage it has, so
+/// an object reused request after request allocates at most once.
+template <typename T, std::size_t N> class small_vector {
+public:
+  using value_type = T;
+  using iterator = T *;
+  using const_iterator = const T *;
+
+  small_vector() = default;
+
+  small_vector(const small_vector &other) { *this = other; }
+
+  small_vector &operator=(const small_vector &other) {
+    if (this != &other) {
+      clear();
+      for (const T &value : other) {
+        push_back(value);
+      }
+    }
+    return *this;
+  }
+
+  void push_back(const T &value) {
+    if (m_heap.empty() && m_size < N) {
+      m_inline[m_size++] = value;
+      return;
+    }
+    if (m_heap.empty()) {
+      m_heap.assign(m_inline.begin(), m_inline.begin() + m_size);
+    } else {
+      m_heap.resize(m_size);
+    }
+    m_heap.push_back(value);
+    m_size++;
+  }
+
+  /// Remove the element at `index`, the ones behind it move up.
+  void erase(std::size_t index) {
+    T *elements = data();
+    std::move(elements + index + 1, elements + m_size, elements + index);
+    m_size--;
+  }
+
+  void clear() { m_size = 0; }
+
+  std::size_t size() const { return m_size; }
+
+  bool empty() const { return m_size == 0; }
+
+  T *data() { return m_heap.empty() ? m_inline.data() : m_heap.data(); }
+
+  const T *data() const {
+    return m_heap.empty() ? m_inline.data() : m_heap.data();
+  }
+
+  T &operator[](std::size_t i) { return data()[i]; }
+
+  const T &operator[](std::size_t i) const { return data()[i]; }
+
+  iterator begin() { return data(); }
+  iterator end() { return data() + m_size; }
+  const_iterator begin() const { return data(); }
+  const_iterator end() const { return data() + m_size; }
+
+private:
+  std::array<T, N> m_inline{};
+  // holds all elements once more than N were pushed, never shrinks again
+  std::vector<T> m_heap;
+  std::size_t m_size{};
+};
+
+} // namespace server
+} // namespace http
@@ -49,6 +49,15 @@ std::string lower(std::string_view s) {
   return out;
 }
 
+bool iequals(std::string_view a, std::string_view b) noexcept {
+  auto fold = [](char ch) -> char {
+    return (ch >= 'A' && ch <= 'Z') ? (ch - 'A' + 'a') : ch;
+  };
+  return a.size() == b.size() &&
+         std::equal(a.begin(), a.end(), b.begin(),
+                    [&](char x, char y) { return fold(x) == fold(y); });
+}
+
 std::string_view trim(std::string_view data) {
   auto begin = std::find_if_not(data.begin(), data.end(), isblank);
   auto end = std::find_if_not(data.rbegin(), data.rend(), isblank);
@@ -57,15 +66,20 @@ std::string_view trim(std::string_view data) {
   return data.substr(begin_index, end_index - begin_index + 1);
 }
 
-size_t parse_ull(std::string_view data) noexcept {
+std::optional<size_t> parse_ull(std::string_view data) noexcept {
+  if (data.empty()) {
+    return std::nullopt;
+  }
   size_t res = 0;
   for (uint8_t ch : data) {
-    if (std::isdigit(ch)) {
-      res = res * 10 + (ch - '0');
-    } else {
-      res = 0;
-      break;
+    if (ch < '0' || ch > '9') {
+      return std::nullopt;
+    }
+    size_t digit = ch - '0';
+    if (res > (SIZE_MAX - digit) / 10) {
+      return std::nullopt;
     }
+    res = res * 10 + digit;
   }
   return res;
 }
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <algorithm>
+#include <cstddef>
+#include <optional>
 #include <string>
 #include <string_view>
 
@@ -10,11 +12,16 @@ namespace server {
 namespace string_utils {
 std::string lower(std::string_view s);
 
+/// Whether `a` and `b` are equal ignoring ASCII case.
+bool iequals(std::string_view a, std::string_view b) noexcept;
+
 std::string_view trim(std::string_view data);
 
 std::string escaped(std::string_view data);
 
-size_t parse_ull(std::string_view data) noexcept;
+/// The decimal number of `data`, nothing when it is empty, has anything but
+/// digits or does not fit a size_t.
+std::optional<size_t> parse_ull(std::string_view data) noexcept;
 } // namespace string_utils
 } // namespace server
 } // namespace http
\ No newline at end of file
@@ -0,0 +1,151 @@
+#include "timer_wheel.hpp"
+
+namespace http {
+namespace server {
+
+timer_wheel::entry::~entry() {
+  if (m_wheel) {
+    m_wheel->cancel(*this);
+  }
+}
+
+timer_wheel::timer_wheel(asio::any_io_executor executor, clock::duration tick)
+    : m_timer(std::move(executor)), m_tick(tick), m_epoch(clock::now()) {}
+
+std::uint64_t timer_wheel::tick_at(clock::time_point t) const {
+  return static_cast<std::uint64_t>((t - m_epoch) / m_tick);
+}
+
+std::uint64_t timer_wheel::deadline_tick(clock::duration timeout) const {
+  auto since_epoch = clock::now() + timeout - m_epoch;
+  return static_cast<std::uint64_t>((since_epoch + m_tick - clock::duration(1)) /
+                                    m_tick);
+}
+
+void timer_wheel::schedule(entry &e, clock::duration timeout) {
+  std::uint64_t deadline = deadline_tick(timeout);
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (e.m_linked.load(std::memory_order_relaxed)) {
+    unlink(e);
+  }
+  e.m_deadline.store(deadline, std::memory_order_relaxed);
+  link(e, deadline);
+}
+
+void timer_wheel::touch(entry &e, clock::duration timeout) {
+  if (!e.m_linked.load(std::memory_order_acquire)) {
+    schedule(e, timeout);
+    return;
+  }
+  // the entry stays in its slot, on_tick() moves it when the slot comes up
+  e.m_deadline.store(deadline_tick(timeout), std::memory_order_relaxed);
+}
+
+void timer_wheel::cancel(entry &e) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (e.m_linked.load(std::memory_order_relaxed)) {
+    unlink(e);
+  }
+}
+
+bool timer_wheel::expired(entry &e) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::uint64_t deadline = e.m_deadline.load(std::memory_order_relaxed);
+  if (deadline <= tick_at(clock::now())) {
+    return true;
+  }
+  if (!e.m_linked.load(std::memory_order_relaxed) && !m_stopped) {
+    link(e, deadline);
+  }
+  return false;
+}
+
+void timer_wheel::stop() {
+  asio::dispatch(m_timer.get_executor(), [this]() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stopped = true;
+      m_running = false;
+    }
+    m_timer.cancel();
+  });
+}
+
+void timer_wheel::link(entry &e, std::uint64_t slot_tick) {
+  if (!m_running && !m_stopped) {
+    // the wheel was idle, nothing is linked and the ticks in between are
+    // skipped
+    m_current = tick_at(clock::now());
+    m_running = true;
+    asio::post(m_timer.get_executor(),
+               [this, tick = m_current]() { arm(tick); });
+  }
+  e.m_slot = slot_tick % SLOT_COUNT;
+  entry *&head = m_slots[e.m_slot];
+  e.m_wheel = this;
+  e.m_prev = nullptr;
+  e.m_next = head;
+  if (head) {
+    head->m_prev = &e;
+  }
+  head = &e;
+  ++m_size;
+  e.m_linked.store(true, std::memory_order_release);
+}
+
+void timer_wheel::unlink(entry &e) {
+  if (e.m_prev) {
+    e.m_prev->m_next = e.m_next;
+  } else {
+    m_slots[e.m_slot] = e.m_next;
+  }
+  if (e.m_next) {
+    e.m_next->m_prev = e.m_prev;
+  }
+  e.m_prev = e.m_next = nullptr;
+  --m_size;
+  e.m_linked.store(false, std::memory_order_release);
+}
+
+void timer_wheel::arm(std::uint64_t tick) {
+  m_timer.expires_at(m_epoch + m_tick * static_cast<clock::rep>(tick + 1));
+  m_timer.async_wait([this](asio::error_code err) {
+    if (err) {
+      return;
+    }
+    on_tick();
+  });
+}
+
+void timer_wheel::on_tick() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_stopped) {
+    return;
+  }
+  std::uint64_t now = tick_at(clock::now());
+  for (; m_current <= now; ++m_current) {
+    entry *e = m_slots[m_current % SLOT_COUNT];
+    while (e) {
+      entry *next = e->m_next;
+      std::uint64_t deadline = e->m_deadline.load(std::memory_order_relaxed);
+      if (deadline <= m_current) {
+        unlink(*e);
+        e->m_callback(e->m_context);
+      } else if (deadline % SLOT_COUNT != m_current % SLOT_COUNT) {
+        // touched since it was linked
+        unlink(*e);
+        link(*e, deadline);
+      }
+      e = next;
+    }
+  }
+  if (m_size == 0) {
+    // stay quiet until the next schedule()
+    m_running = false;
+    return;
+  }
+  arm(m_current - 1);
+}
+
+} // namespace server
+} // namespace http
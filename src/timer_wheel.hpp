@@ -0,0 +1,114 @@
+#pragma once
+
+#include <array>
+#include <asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+namespace http {
+namespace server {
+
+/// Hashed timing wheel shared by all connections of one io_context.
+///
+/// Deadlines are rounded up to coarse ticks and kept in intrusive lists, one
+/// list per slot, so scheduling, touching and cancelling are O(1) and never
+/// allocate. A single steady_timer drives the wheel while it holds entries.
+/// Entries whose deadline is more than a revolution away, or was pushed back
+/// by touch(), are moved to their new slot when their old slot comes up.
+class timer_wheel {
+public:
+  using clock = std::chrono::steady_clock;
+
+  /// An intrusive deadline, embedded in the object it guards.
+  class entry {
+  public:
+    /// `callback` is called with `context` from the executor of the wheel,
+    /// while the wheel is locked, once the deadline passed. It must not call
+    /// back into the wheel.
+    entry(void (*callback)(void *), void *context)
+        : m_callback(callback), m_context(context) {}
+    entry(const entry &) = delete;
+    entry &operator=(const entry &) = delete;
+
+    /// Unlinks the entry, after it returns the callback is not running and
+    /// will not be called.
+    ~entry();
+
+  private:
+    friend class timer_wheel;
+
+    void (*m_callback)(void *);
+    void *m_context;
+    timer_wheel *m_wheel{};
+    entry *m_prev{};
+    entry *m_next{};
+    // slot the entry is linked into
+    std::size_t m_slot{};
+    // tick of the deadline, touch() only stores it
+    std::atomic<std::uint64_t> m_deadline{};
+    // whether the entry is in a slot, only written with the wheel locked
+    std::atomic<bool> m_linked{};
+  };
+
+  timer_wheel(const timer_wheel &) = delete;
+  timer_wheel &operator=(const timer_wheel &) = delete;
+
+  /// `executor` runs the tick timer and the callbacks, it has to be a strand
+  /// when the io_context runs on several threads.
+  explicit timer_wheel(asio::any_io_executor executor,
+                       clock::duration tick = std::chrono::milliseconds(250));
+
+  /// Set the deadline of `e` to `timeout` from now and link it into the wheel.
+  void schedule(entry &e, clock::duration timeout);
+
+  /// Push the deadline of a scheduled `e` back to `timeout` from now. Lock
+  /// free while `e` is linked, falls back to schedule() otherwise. The deadline
+  /// must not move earlier, use schedule() for that.
+  void touch(entry &e, clock::duration timeout);
+
+  /// Unlink `e`, its callback is not called any more.
+  void cancel(entry &e);
+
+  /// Whether the deadline of `e` passed, links `e` again when it did not. A
+  /// callback may race with touch() on another thread, so the owner checks
+  /// this before acting on it.
+  bool expired(entry &e);
+
+  /// Stop ticking, safe to call from any thread. Linked entries stay linked
+  /// but do not expire any more.
+  void stop();
+
+private:
+  /// Tick of `timeout` from now, rounded up.
+  std::uint64_t deadline_tick(clock::duration timeout) const;
+
+  /// Tick that the wheel reached at `t`.
+  std::uint64_t tick_at(clock::time_point t) const;
+
+  void link(entry &e, std::uint64_t slot_tick);
+  void unlink(entry &e);
+
+  /// Wait for the end of `tick`, runs on m_timer's executor.
+  void arm(std::uint64_t tick);
+  void on_tick();
+
+  // 256 slots of 250ms cover about a minute, longer deadlines take another turn
+  static constexpr std::size_t SLOT_COUNT = 256;
+
+  asio::steady_timer m_timer;
+  clock::duration m_tick;
+  clock::time_point m_epoch;
+
+  std::mutex m_mutex;
+  std::array<entry *, SLOT_COUNT> m_slots{};
+  // next tick to process
+  std::uint64_t m_current{};
+  std::size_t m_size{};
+  bool m_running{};
+  bool m_stopped{};
+};
+
+} // namespace server
+} // namespace http
@@ -0,0 +1,491 @@
+#include "uring_service.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <spdlog/spdlog.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace http {
+namespace server {
+
+asio::execution_context::id uring_service::id;
+
+namespace {
+
+asio::error_code last_error() {
+  return asio::error_code(errno, asio::error::get_system_category());
+}
+
+int setup(unsigned entries, io_uring_params &params) {
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+}
+
+int enter(int fd, unsigned submit, unsigned wait, unsigned flags) {
+  return static_cast<int>(
+      ::syscall(__NR_io_uring_enter, fd, submit, wait, flags, nullptr, 0));
+}
+
+int register_ring(int fd, unsigned opcode, void *arg, unsigned count) {
+  return static_cast<int>(
+      ::syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+// the rings are shared with the kernel, which reads what the tails publish
+// and publishes completions through the completion tail
+unsigned load_acquire(unsigned *p) {
+  return std::atomic_ref<unsigned>(*p).load(std::memory_order_acquire);
+}
+
+void store_release(unsigned *p, unsigned value) {
+  std::atomic_ref<unsigned>(*p).store(value, std::memory_order_release);
+}
+
+} // namespace
+
+uring_service::uring_service(asio::execution_context &context)
+    : asio::execution_context::service(context),
+      m_context(static_cast<asio::io_context &>(context)) {}
+
+uring_service::~uring_service() { release(); }
+
+bool uring_service::open(asio::error_code &err) {
+  if (is_open()) {
+    return true;
+  }
+  io_uring_params params{};
+  params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL;
+  params.cq_entries = CQ_ENTRIES;
+  int fd = setup(SQ_ENTRIES, params);
+  if (fd < 0) {
+    err = last_error();
+    return false;
+  }
+  m_ring_fd = fd;
+  constexpr unsigned required =
+      IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_FAST_POLL;
+  if ((params.features & required) != required) {
+    release();
+    err = asio::error::operation_not_supported;
+    return false;
+  }
+
+  // the submission and the completion ring share one mapping
+  m_ring_size =
+      std::max<std::size_t>(params.sq_off.array + params.sq_entries * 4,
+                            params.cq_off.cqes +
+                                params.cq_entries * sizeof(io_uring_cqe));
+  void *ring = ::mmap(nullptr, m_ring_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+  void *sqes = ::mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (ring == MAP_FAILED || sqes == MAP_FAILED) {
+    err = last_error();
+    if (ring != MAP_FAILED) {
+      ::munmap(ring, m_ring_size);
+    }
+    if (sqes != MAP_FAILED) {
+      ::munmap(sqes, m_sqes_size);
+    }
+    release();
+    return false;
+  }
+  m_ring = ring;
+  m_sqes = static_cast<io_uring_sqe *>(sqes);
+  char *base = static_cast<char *>(ring);
+  m_sq_head = reinterpret_cast<unsigned *>(base + params.sq_off.head);
+  m_sq_tail = reinterpret_cast<unsigned *>(base + params.sq_off.tail);
+  m_sq_flags = reinterpret_cast<unsigned *>(base + params.sq_off.flags);
+  m_sq_mask = *reinterpret_cast<unsigned *>(base + params.sq_off.ring_mask);
+  m_sq_entries = params.sq_entries;
+  m_cq_head = reinterpret_cast<unsigned *>(base + params.cq_off.head);
+  m_cq_tail = reinterpret_cast<unsigned *>(base + params.cq_off.tail);
+  m_cq_mask = *reinterpret_cast<unsigned *>(base + params.cq_off.ring_mask);
+  m_cqes = reinterpret_cast<io_uring_cqe *>(base + params.cq_off.cqes);
+  // entries are taken in order, slot i of the array always names entry i
+  unsigned *array = reinterpret_cast<unsigned *>(base + params.sq_off.array);
+  for (unsigned i = 0; i < m_sq_entries; i++) {
+    array[i] = i;
+  }
+  m_queued = m_submitted = *m_sq_tail;
+
+  // accepted sockets only live in the file table, no descriptor of their own
+  io_uring_rsrc_register files{};
+  files.nr = FILE_SLOTS;
+  files.flags = IORING_RSRC_REGISTER_SPARSE;
+  if (register_ring(fd, IORING_REGISTER_FILES2, &files, sizeof(files)) < 0) {
+    err = last_error();
+    release();
+    return false;
+  }
+
+  // the ring entries and the buffers they point to, page aligned
+  void *buffer_ring =
+      ::mmap(nullptr, BUFFER_COUNT * sizeof(io_uring_buf),
+             PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  void *buffers = ::mmap(nullptr, BUFFER_COUNT * BUFFER_SIZE,
+                         PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                         -1, 0);
+  if (buffer_ring == MAP_FAILED || buffers == MAP_FAILED) {
+    err = last_error();
+    if (buffer_ring != MAP_FAILED) {
+      ::munmap(buffer_ring, BUFFER_COUNT * sizeof(io_uring_buf));
+    }
+    if (buffers != MAP_FAILED) {
+      ::munmap(buffers, BUFFER_COUNT * BUFFER_SIZE);
+    }
+    release();
+    return false;
+  }
+  m_buffer_ring = static_cast<io_uring_buf *>(buffer_ring);
+  m_buffers = static_cast<char *>(buffers);
+  io_uring_buf_reg ring_reg{};
+  ring_reg.ring_addr = reinterpret_cast<std::uint64_t>(m_buffer_ring);
+  ring_reg.ring_entries = BUFFER_COUNT;
+  ring_reg.bgid = BUFFER_GROUP;
+  if (register_ring(fd, IORING_REGISTER_PBUF_RING, &ring_reg, 1) < 0) {
+    err = last_error();
+    release();
+    return false;
+  }
+  for (std::size_t bid = 0; bid < BUFFER_COUNT; bid++) {
+    provide(static_cast<std::uint16_t>(bid));
+  }
+
+  // every completion signals the eventfd, the ones of the submission itself
+  // are reaped right after it already. IORING_REGISTER_EVENTFD_ASYNC would
+  // skip the completions of multishot operations, which run as task work
+  int event = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (event < 0) {
+    err = last_error();
+    release();
+    return false;
+  }
+  if (register_ring(fd, IORING_REGISTER_EVENTFD, &event, 1) < 0) {
+    err = last_error();
+    ::close(event);
+    release();
+    return false;
+  }
+  m_event.emplace(m_context, event);
+  return true;
+}
+
+void uring_service::register_ring_fd() {
+  m_ring_fd_registered = true;
+  // io_uring_enter(2) skips the lookup of a registered ring fd, the
+  // registration belongs to the calling thread
+  io_uring_rsrc_update self{};
+  self.offset = static_cast<std::uint32_t>(-1);
+  self.data = static_cast<std::uint64_t>(m_ring_fd);
+  if (register_ring(m_ring_fd, IORING_REGISTER_RING_FDS, &self, 1) == 1) {
+    m_ring_index = static_cast<int>(self.offset);
+  }
+}
+
+void uring_service::release() {
+  m_event.reset();
+  if (m_ring_index >= 0) {
+    // a no-op on another thread, whose registration goes when it exits
+    io_uring_rsrc_update self{};
+    self.offset = static_cast<std::uint32_t>(m_ring_index);
+    register_ring(m_ring_fd, IORING_UNREGISTER_RING_FDS, &self, 1);
+    m_ring_index = -1;
+  }
+  // the receives of the ring go before the buffers they write to
+  if (m_ring_fd >= 0) {
+    ::close(m_ring_fd);
+    m_ring_fd = -1;
+  }
+  if (m_buffers) {
+    ::munmap(m_buffers, BUFFER_COUNT * BUFFER_SIZE);
+    m_buffers = nullptr;
+  }
+  if (m_buffer_ring) {
+    ::munmap(m_buffer_ring, BUFFER_COUNT * sizeof(io_uring_buf));
+    m_buffer_ring = nullptr;
+  }
+  if (m_sqes) {
+    ::munmap(m_sqes, m_sqes_size);
+    m_sqes = nullptr;
+  }
+  if (m_ring) {
+    ::munmap(m_ring, m_ring_size);
+    m_ring = nullptr;
+  }
+}
+
+void uring_service::shutdown() {
+  m_stopped = true;
+  m_accept_handler = nullptr;
+  // the handlers may own the last reference to a client, which unlinks
+  // itself when it goes
+  while (m_clients) {
+    client *c = m_clients;
+    unlink(c);
+    c->abandon();
+  }
+  // closing the ring cancels what is still in flight
+  release();
+}
+
+void uring_service::link(client *c) {
+  c->m_prev = nullptr;
+  c->m_next = m_clients;
+  if (m_clients) {
+    m_clients->m_prev = c;
+  }
+  m_clients = c;
+}
+
+void uring_service::unlink(client *c) {
+  if (c->m_prev) {
+    c->m_prev->m_next = c->m_next;
+  } else if (m_clients == c) {
+    m_clients = c->m_next;
+  } else {
+    // unlinked by shutdown() already
+    return;
+  }
+  if (c->m_next) {
+    c->m_next->m_prev = c->m_prev;
+  }
+  c->m_prev = c->m_next = nullptr;
+}
+
+void uring_service::start_accept(int fd, accept_handler handler) {
+  m_listen_fd = fd;
+  m_accept_handler = std::move(handler);
+  arm_accept();
+}
+
+void uring_service::arm_accept() {
+  io_uring_sqe *sqe = prepare(&m_accept_op);
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = m_listen_fd;
+  sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+  sqe->file_index = IORING_FILE_INDEX_ALLOC;
+  m_accepting = true;
+}
+
+void uring_service::cancel_accept() {
+  m_accept_handler = nullptr;
+  m_accept_stalled = false;
+  if (m_accepting && !m_stopped) {
+    io_uring_sqe *sqe = prepare(nullptr);
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<std::uint64_t>(&m_accept_op);
+  }
+}
+
+void uring_service::accept_op::on_complete(int result, std::uint32_t flags) {
+  bool more = flags & IORING_CQE_F_MORE;
+  if (!more) {
+    service.m_accepting = false;
+  }
+  if (result >= 0) {
+    if (service.m_accept_handler) {
+      service.m_accept_handler(result);
+    } else {
+      // accepted while the cancellation was on its way
+      service.close_file(result);
+    }
+  } else if (result == -ENFILE || result == -EMFILE) {
+    spdlog::warn("io_uring file table full, accepting again once a "
+                 "connection closes");
+    service.m_accept_stalled = true;
+  } else if (result != -ECANCELED) {
+    spdlog::error("io_uring accept: {}", std::strerror(-result));
+  }
+  if (!more && !service.m_accepting && service.m_accept_handler &&
+      !service.m_accept_stalled) {
+    service.arm_accept();
+  }
+}
+
+void uring_service::file_freed_op::on_complete(int, std::uint32_t) {
+  if (service.m_accept_stalled && service.m_accept_handler) {
+    service.m_accept_stalled = false;
+    service.arm_accept();
+  }
+}
+
+void uring_service::close_file(int index) {
+  // hard linked, the close runs whether something was cancelled or not
+  reserve(2);
+  io_uring_sqe *cancel = prepare(nullptr);
+  cancel->opcode = IORING_OP_ASYNC_CANCEL;
+  cancel->fd = index;
+  cancel->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_FD_FIXED |
+                         IORING_ASYNC_CANCEL_ALL;
+  cancel->flags = IOSQE_IO_HARDLINK;
+  io_uring_sqe *close = prepare(&m_file_freed_op);
+  close->opcode = IORING_OP_CLOSE;
+  close->file_index = static_cast<std::uint32_t>(index) + 1;
+}
+
+void uring_service::reserve(unsigned n) {
+  if (m_queued + n - load_acquire(m_sq_head) > m_sq_entries) {
+    submit(0);
+  }
+}
+
+io_uring_sqe *uring_service::prepare(operation *op) {
+  reserve(1);
+  io_uring_sqe *sqe = &m_sqes[m_queued & m_sq_mask];
+  ++m_queued;
+  std::memset(sqe, 0, sizeof(*sqe));
+  sqe->user_data = reinterpret_cast<std::uint64_t>(op);
+  ++m_in_flight;
+  if (!m_flush_posted) {
+    m_flush_posted = true;
+    asio::post(m_context, [this]() { flush(); });
+  }
+  return sqe;
+}
+
+void uring_service::provide(std::uint16_t bid) {
+  if (!m_buffer_ring) {
+    return;
+  }
+  io_uring_buf &entry = m_buffer_ring[m_buffer_tail & (BUFFER_COUNT - 1)];
+  entry.addr = reinterpret_cast<std::uint64_t>(buffer(bid));
+  entry.len = BUFFER_SIZE;
+  entry.bid = bid;
+  ++m_buffer_tail;
+  // the tail of the buffer ring overlays the reserved field of entry 0
+  std::atomic_ref<std::uint16_t>(m_buffer_ring[0].resv)
+      .store(m_buffer_tail, std::memory_order_release);
+}
+
+void uring_service::submit(unsigned flags) {
+  store_release(m_sq_tail, m_queued);
+  int fd = m_ring_fd;
+  if (m_ring_index >= 0) {
+    fd = m_ring_index;
+    flags |= IORING_ENTER_REGISTERED_RING;
+  }
+  for (;;) {
+    unsigned pending = m_queued - m_submitted;
+    ++m_enter_calls;
+    int result = enter(fd, pending, 0, flags);
+    if (result >= 0) {
+      m_submitted += static_cast<unsigned>(result);
+      if (m_submitted == m_queued || result == 0) {
+        return;
+      }
+      continue;
+    }
+    if (errno == EINTR) {
+      continue;
+    }
+    if ((errno == EBUSY || errno == EAGAIN) && !m_reaping) {
+      // the completion queue is full, make room first
+      reap();
+      continue;
+    }
+    if (errno == EBUSY || errno == EAGAIN) {
+      // called by an operation, which a nested reap could run again. The
+      // entries stay queued for the flush after the completions
+      return;
+    }
+    spdlog::error("io_uring_enter: {}", std::strerror(errno));
+    return;
+  }
+}
+
+void uring_service::flush() {
+  m_flush_posted = false;
+  if (m_stopped) {
+    return;
+  }
+  if (!m_ring_fd_registered) {
+    register_ring_fd();
+  }
+  if (m_queued != m_submitted) {
+    submit(0);
+  }
+  reap();
+  wait();
+}
+
+void uring_service::reap() {
+  m_reaping = true;
+  reap_completions();
+  m_reaping = false;
+}
+
+void uring_service::reap_completions() {
+  for (;;) {
+    unsigned head = *m_cq_head;
+    unsigned tail = load_acquire(m_cq_tail);
+    if (head == tail) {
+      if (load_acquire(m_sq_flags) & IORING_SQ_CQ_OVERFLOW) {
+        // completions the full queue did not take wait in the kernel
+        int fd = m_ring_index >= 0 ? m_ring_index : m_ring_fd;
+        ++m_enter_calls;
+        enter(fd, 0, 0,
+              IORING_ENTER_GETEVENTS |
+                  (m_ring_index >= 0 ? IORING_ENTER_REGISTERED_RING : 0u));
+        continue;
+      }
+      return;
+    }
+    while (head != tail) {
+      const io_uring_cqe &cqe = m_cqes[head & m_cq_mask];
+      auto *op = reinterpret_cast<operation *>(cqe.user_data);
+      int result = cqe.res;
+      std::uint32_t flags = cqe.flags;
+      // the slot is free before the operation runs and queues the next
+      store_release(m_cq_head, ++head);
+      if (!(flags & IORING_CQE_F_MORE)) {
+        --m_in_flight;
+      }
+      if (op) {
+        op->on_complete(result, flags);
+      }
+      if (m_stopped) {
+        return;
+      }
+    }
+  }
+}
+
+void uring_service::wait() {
+  if (!m_event) {
+    return;
+  }
+  if (m_in_flight == 0) {
+    // nothing can complete, the io_context may run out of work
+    if (m_waiting) {
+      m_event->cancel();
+    }
+    return;
+  }
+  if (m_waiting) {
+    return;
+  }
+  m_waiting = true;
+  m_event->async_read_some(
+      asio::buffer(&m_event_count, sizeof(m_event_count)),
+      [this](asio::error_code err, std::size_t) {
+        m_waiting = false;
+        if (m_stopped) {
+          return;
+        }
+        // cancelled while nothing was in flight, something may be by now
+        if (err != asio::error::operation_aborted) {
+          reap();
+        }
+        wait();
+      });
+}
+
+} // namespace server
+} // namespace http
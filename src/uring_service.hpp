@@ -0,0 +1,227 @@
+#pragma once
+
+#include <asio.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct io_uring_buf;
+
+namespace http {
+namespace server {
+
+/// The io_uring of an io_context run by a single thread, Linux 6.0 or later.
+/// A multishot accept puts the accepted sockets straight into the registered
+/// file table of the ring, a multishot receive per socket takes its data into
+/// a buffer of the provided buffer ring, so neither needs a syscall per
+/// operation. Entries are queued while the ready handlers run and submitted
+/// together by one io_uring_enter(2). Completions wake the io_context through
+/// an eventfd registered with the ring, the reactor of asio waits for it next
+/// to everything else.
+class uring_service : public asio::execution_context::service {
+public:
+  static asio::execution_context::id id;
+
+  /// An operation in flight, its address is the user_data of its entry.
+  class operation {
+  public:
+    /// Called for every completion, a multishot operation ends with the first
+    /// one without IORING_CQE_F_MORE.
+    virtual void on_complete(int result, std::uint32_t flags) = 0;
+
+  protected:
+    ~operation() = default;
+  };
+
+  /// Something holding completion handlers of the service, they are destroyed
+  /// without being called when the io_context shuts down.
+  class client {
+  public:
+    virtual void abandon() = 0;
+
+  protected:
+    ~client() = default;
+
+  private:
+    friend class uring_service;
+    client *m_prev{};
+    client *m_next{};
+  };
+
+  /// Called with the index of an accepted socket in the registered file
+  /// table.
+  using accept_handler = std::function<void(int index)>;
+
+  /// Entries of the submission and the completion queue.
+  static constexpr unsigned SQ_ENTRIES = 256;
+  static constexpr unsigned CQ_ENTRIES = 4096;
+  /// Slots of the registered file table, the connections of the ring.
+  static constexpr unsigned FILE_SLOTS = 16384;
+  /// Receive buffers of the provided buffer ring, a power of two. A receive
+  /// takes in at most the free ones before the io_context sees a single
+  /// completion, so they also bound the burst of a fast sender.
+  static constexpr std::size_t BUFFER_COUNT = 64;
+  static constexpr std::size_t BUFFER_SIZE = 8192;
+  /// The buffer group of the provided buffer ring.
+  static constexpr std::uint16_t BUFFER_GROUP = 0;
+
+  explicit uring_service(asio::execution_context &context);
+  ~uring_service();
+
+  /// Set up the ring, its file table, buffer ring and eventfd. Sets `err` and
+  /// returns false when the kernel lacks one of them, nothing of the service
+  /// may be used then.
+  bool open(asio::error_code &err);
+
+  bool is_open() const { return m_ring_fd >= 0; }
+
+  /// Whether the io_context shut down, operations complete with
+  /// operation_aborted from then on.
+  bool stopped() const { return m_stopped; }
+
+  asio::any_io_executor get_executor() { return m_context.get_executor(); }
+
+  /// Accept the connections of the listening socket `fd` with one multishot
+  /// accept until cancel_accept().
+  void start_accept(int fd, accept_handler handler);
+
+  /// Stop accepting, the listening socket may be closed right after.
+  void cancel_accept();
+
+  /// A zeroed submission queue entry with `op` as its user_data, nullptr for
+  /// an entry whose completion is ignored. Submitted by the next flush, which
+  /// is posted to the io_context when the first entry is queued.
+  io_uring_sqe *prepare(operation *op);
+
+  /// Submit the queued entries now rather than with the next flush.
+  void submit_now() {
+    if (m_queued != m_submitted) {
+      submit(0);
+    }
+  }
+
+  /// The receive buffer `bid` of the buffer ring.
+  char *buffer(std::uint16_t bid) { return m_buffers + bid * BUFFER_SIZE; }
+
+  /// Take the receive buffer `bid` of a completion out of the buffer ring.
+  char *borrow(std::uint16_t bid) {
+    ++m_borrowed;
+    return buffer(bid);
+  }
+
+  /// Hand the borrowed receive buffer `bid` back to the kernel.
+  void recycle(std::uint16_t bid) {
+    --m_borrowed;
+    provide(bid);
+  }
+
+  /// Whether half the receive buffers are borrowed, data nobody reads yet
+  /// should be copied out of them then.
+  bool buffers_low() const { return m_borrowed >= BUFFER_COUNT / 2; }
+
+  /// Cancel everything in flight on the slot `index` of the file table, then
+  /// close it.
+  void close_file(int index);
+
+  /// Calls of io_uring_enter(2) so far.
+  std::uint64_t enter_calls() const { return m_enter_calls; }
+
+  void link(client *c);
+  void unlink(client *c);
+
+private:
+  struct accept_op final : operation {
+    explicit accept_op(uring_service &service) : service(service) {}
+    void on_complete(int result, std::uint32_t flags) override;
+    uring_service &service;
+  };
+
+  struct file_freed_op final : operation {
+    explicit file_freed_op(uring_service &service) : service(service) {}
+    void on_complete(int result, std::uint32_t flags) override;
+    uring_service &service;
+  };
+
+  void shutdown() override;
+
+  /// Unmap and close whatever open() set up.
+  void release();
+
+  /// Register the ring fd with the thread running the io_context.
+  void register_ring_fd();
+
+  /// Submit `n` more entries without a flush when the queue would overflow.
+  void reserve(unsigned n);
+
+  /// Submit the queued entries, `flags` of io_uring_enter(2).
+  void submit(unsigned flags);
+
+  /// Submit the queued entries and reap the completions.
+  void flush();
+
+  /// Run the operations of the completed entries.
+  void reap();
+  void reap_completions();
+
+  /// Wait for the eventfd while entries are in flight.
+  void wait();
+
+  void arm_accept();
+
+  /// Put the receive buffer `bid` into the buffer ring.
+  void provide(std::uint16_t bid);
+
+  asio::io_context &m_context;
+  bool m_stopped{};
+
+  int m_ring_fd{-1};
+  // the ring fd registered with itself, -1 when the kernel can not
+  int m_ring_index{-1};
+  bool m_ring_fd_registered{};
+  void *m_ring{};
+  std::size_t m_ring_size{};
+  io_uring_sqe *m_sqes{};
+  std::size_t m_sqes_size{};
+  unsigned *m_sq_head{};
+  unsigned *m_sq_tail{};
+  unsigned *m_sq_flags{};
+  unsigned m_sq_mask{};
+  unsigned m_sq_entries{};
+  unsigned *m_cq_head{};
+  unsigned *m_cq_tail{};
+  unsigned m_cq_mask{};
+  io_uring_cqe *m_cqes{};
+  // entries queued, entries handed to the kernel
+  unsigned m_queued{};
+  unsigned m_submitted{};
+  // entries whose last completion did not come yet
+  std::size_t m_in_flight{};
+  bool m_flush_posted{};
+  bool m_reaping{};
+  std::uint64_t m_enter_calls{};
+
+  io_uring_buf *m_buffer_ring{};
+  char *m_buffers{};
+  std::uint16_t m_buffer_tail{};
+  std::size_t m_borrowed{};
+
+  std::optional<asio::posix::stream_descriptor> m_event;
+  std::uint64_t m_event_count{};
+  bool m_waiting{};
+
+  accept_op m_accept_op{*this};
+  file_freed_op m_file_freed_op{*this};
+  accept_handler m_accept_handler;
+  int m_listen_fd{-1};
+  bool m_accepting{};
+  // the file table ran full, accepting goes on once a slot is free
+  bool m_accept_stalled{};
+
+  client *m_clients{};
+};
+
+} // namespace server
+} // namespace http
@@ -0,0 +1,466 @@
+#include "uring_socket.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <string>
+#include <sys/socket.h>
+
+namespace http {
+namespace server {
+
+namespace {
+
+asio::error_code to_error(int result) {
+  if (result == -ECANCELED) {
+    return asio::error::operation_aborted;
+  }
+  return asio::error_code(-result, asio::error::get_system_category());
+}
+
+} // namespace
+
+/// The state of a uring_socket, alive while the socket or one of its entries
+/// in flight refers to it.
+class uring_socket::impl final : public uring_service::client {
+public:
+  /// Received buffers a socket keeps before it copies what nobody read yet.
+  static constexpr std::size_t MAX_HELD = 4;
+  /// Bytes nobody read yet at which the receive stops, the peer is held back
+  /// by the socket buffer then, as with a plain read loop. What the kernel
+  /// took in before it saw the cancellation is kept as well, at most one
+  /// socket buffer.
+  static constexpr std::size_t MAX_BUFFERED =
+      MAX_HELD * uring_service::BUFFER_SIZE;
+
+  impl(uring_service &service, int index) : m_service(service), m_index(index) {
+    m_service.link(this);
+  }
+
+  static impl *create(uring_service &service, int index) {
+    impl *p = pool_allocator<impl>().allocate(1);
+    return ::new (static_cast<void *>(p)) impl(service, index);
+  }
+
+  void release() {
+    if (--m_refs == 0) {
+      m_service.unlink(this);
+      destroy();
+    }
+  }
+
+  void abandon() override {
+    // the ring goes away with the entries in flight, the handlers are
+    // destroyed without being called
+    uring_completion *reader = std::exchange(m_reader, nullptr);
+    uring_completion *writer = std::exchange(m_writer, nullptr);
+    m_refs -= (m_receiving ? 1 : 0) + (m_shutting_down ? 1 : 0) +
+              (writer ? 1 : 0);
+    m_receiving = false;
+    m_shutting_down = false;
+    m_closed = true;
+    m_held_count = 0;
+    if (m_refs == 0) {
+      destroy();
+    }
+    // may destroy the socket, and with it this
+    if (reader) {
+      reader->destroy();
+    }
+    if (writer) {
+      writer->destroy();
+    }
+  }
+
+  uring_service &service() { return m_service; }
+  bool closed() const { return m_closed; }
+
+  void wait(uring_completion *c) {
+    if (m_closed || m_service.stopped()) {
+      c->complete(closed_error(), 0, true);
+    } else if (buffered() || m_eof || m_error) {
+      c->complete({}, 0, true);
+    } else {
+      m_reader = c;
+      m_reader_waits = true;
+      arm();
+    }
+  }
+
+  void read(uring_completion *c, asio::mutable_buffer buffer) {
+    if (m_closed || m_service.stopped()) {
+      c->complete(closed_error(), 0, true);
+    } else if (buffer.size() == 0) {
+      c->complete({}, 0, true);
+    } else if (buffered()) {
+      c->complete({}, take(buffer), true);
+    } else if (m_eof) {
+      c->complete(asio::error::eof, 0, true);
+    } else if (m_error) {
+      c->complete(m_error, 0, true);
+    } else {
+      m_reader = c;
+      m_reader_waits = false;
+      m_read_buffer = buffer;
+      arm();
+    }
+  }
+
+  void write(uring_completion *c, const iovec *iov, std::size_t count) {
+    if (m_closed || m_service.stopped()) {
+      c->complete(closed_error(), 0, true);
+      return;
+    }
+    if (count == 0) {
+      c->complete({}, 0, true);
+      return;
+    }
+    io_uring_sqe *sqe = m_service.prepare(&m_send_op);
+    sqe->fd = m_index;
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    if (count == 1) {
+      sqe->opcode = IORING_OP_SEND;
+      sqe->addr = reinterpret_cast<std::uint64_t>(iov[0].iov_base);
+      sqe->len = static_cast<std::uint32_t>(iov[0].iov_len);
+    } else {
+      std::copy(iov, iov + count, m_iov.begin());
+      m_msg = {};
+      m_msg.msg_iov = m_iov.data();
+      m_msg.msg_iovlen = count;
+      sqe->opcode = IORING_OP_SENDMSG;
+      sqe->addr = reinterpret_cast<std::uint64_t>(&m_msg);
+      sqe->len = 1;
+    }
+    m_writer = c;
+    ++m_refs;
+  }
+
+  void cancel() {
+    if (m_closed || m_service.stopped()) {
+      return;
+    }
+    // the end of a paused receive aborts the read now
+    m_pausing = false;
+    io_uring_sqe *sqe = m_service.prepare(nullptr);
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = m_index;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_FD |
+                        IORING_ASYNC_CANCEL_FD_FIXED | IORING_ASYNC_CANCEL_ALL;
+  }
+
+  void close() {
+    if (m_closed) {
+      return;
+    }
+    m_closed = true;
+    drop_held();
+    // a shutdown runs on a worker of the kernel, which looks the slot up only
+    // then, it must not find the next connection in there
+    if (!m_shutting_down && !m_service.stopped()) {
+      m_service.close_file(m_index);
+    }
+  }
+
+  void shutdown(int how) {
+    if (m_closed || m_shutting_down || m_service.stopped()) {
+      return;
+    }
+    io_uring_sqe *sqe = m_service.prepare(&m_shutdown_op);
+    sqe->opcode = IORING_OP_SHUTDOWN;
+    sqe->fd = m_index;
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->len = static_cast<std::uint32_t>(how);
+    m_shutting_down = true;
+    ++m_refs;
+  }
+
+private:
+  struct recv_op final : uring_service::operation {
+    explicit recv_op(impl &self) : self(self) {}
+    void on_complete(int result, std::uint32_t flags) override {
+      self.on_receive(result, flags);
+    }
+    impl &self;
+  };
+
+  struct send_op final : uring_service::operation {
+    explicit send_op(impl &self) : self(self) {}
+    void on_complete(int result, std::uint32_t) override {
+      self.on_send(result);
+    }
+    impl &self;
+  };
+
+  struct shutdown_op final : uring_service::operation {
+    explicit shutdown_op(impl &self) : self(self) {}
+    void on_complete(int, std::uint32_t) override { self.on_shutdown(); }
+    impl &self;
+  };
+
+  /// A part of a borrowed receive buffer nobody read yet.
+  struct held {
+    std::uint16_t bid;
+    std::uint32_t begin;
+    std::uint32_t end;
+  };
+
+  void destroy() {
+    drop_held();
+    this->~impl();
+    pool_allocator<impl>().deallocate(this, 1);
+  }
+
+  asio::error_code closed_error() const {
+    return m_service.stopped() ? asio::error::operation_aborted
+                               : asio::error::bad_descriptor;
+  }
+
+  /// Keep receiving until the peer closes, the next completions wait in
+  /// buffers of the ring.
+  void arm() {
+    if (m_receiving || m_closed || m_eof || m_error) {
+      return;
+    }
+    io_uring_sqe *sqe = m_service.prepare(&m_recv_op);
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = m_index;
+    sqe->flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+    sqe->buf_group = uring_service::BUFFER_GROUP;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    m_receiving = true;
+    ++m_refs;
+  }
+
+  void on_receive(int result, std::uint32_t flags) {
+    bool more = flags & IORING_CQE_F_MORE;
+    if (!more) {
+      m_receiving = false;
+    }
+    bool cancelled = false;
+    if (result > 0) {
+      auto bid = static_cast<std::uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+      char *data = m_service.borrow(bid);
+      if (m_closed) {
+        m_service.recycle(bid);
+      } else {
+        hold(bid, data, static_cast<std::uint32_t>(result));
+      }
+    } else if (result == 0) {
+      m_eof = true;
+    } else if (result == -ECANCELED) {
+      cancelled = !std::exchange(m_pausing, false);
+    } else if (result != -ENOBUFS) {
+      // ENOBUFS only ends the receive, it is armed again while read
+      m_error = to_error(result);
+    }
+    if (cancelled) {
+      if (m_reader) {
+        std::exchange(m_reader, nullptr)
+            ->complete(asio::error::operation_aborted, 0, false);
+      }
+    } else {
+      serve_reader();
+    }
+    if (more && m_buffered >= MAX_BUFFERED && !m_pausing) {
+      // armed again by the read which empties the buffers. Submitted right
+      // away, the receive keeps draining the socket until it sees it
+      io_uring_sqe *sqe = m_service.prepare(nullptr);
+      sqe->opcode = IORING_OP_ASYNC_CANCEL;
+      sqe->addr = reinterpret_cast<std::uint64_t>(&m_recv_op);
+      m_pausing = true;
+      m_service.submit_now();
+    }
+    if (!more) {
+      if (m_reader && m_closed) {
+        std::exchange(m_reader, nullptr)
+            ->complete(asio::error::operation_aborted, 0, false);
+      } else if (m_reader) {
+        arm();
+      }
+      release();
+    }
+  }
+
+  void on_send(int result) {
+    uring_completion *c = std::exchange(m_writer, nullptr);
+    if (result < 0) {
+      c->complete(to_error(result), 0, false);
+    } else {
+      c->complete({}, static_cast<std::size_t>(result), false);
+    }
+    release();
+  }
+
+  void on_shutdown() {
+    m_shutting_down = false;
+    if (m_closed && !m_service.stopped()) {
+      m_service.close_file(m_index);
+    }
+    release();
+  }
+
+  /// Complete the pending read or wait if it can be.
+  void serve_reader() {
+    if (!m_reader) {
+      return;
+    }
+    if (m_reader_waits) {
+      if (buffered() || m_eof || m_error) {
+        std::exchange(m_reader, nullptr)->complete({}, 0, false);
+      }
+    } else if (buffered()) {
+      std::size_t n = take(m_read_buffer);
+      std::exchange(m_reader, nullptr)->complete({}, n, false);
+    } else if (m_eof) {
+      std::exchange(m_reader, nullptr)->complete(asio::error::eof, 0, false);
+    } else if (m_error) {
+      std::exchange(m_reader, nullptr)->complete(m_error, 0, false);
+    }
+  }
+
+  bool buffered() const { return m_buffered > 0; }
+
+  void hold(std::uint16_t bid, const char *data, std::uint32_t size) {
+    m_buffered += size;
+    // a copy once the ring runs short, or to stay behind earlier copies
+    if (m_held_count == MAX_HELD || m_overflow_begin < m_overflow.size() ||
+        m_service.buffers_low()) {
+      m_overflow.append(data, size);
+      m_service.recycle(bid);
+      return;
+    }
+    m_held[(m_held_head + m_held_count) % MAX_HELD] = {bid, 0, size};
+    ++m_held_count;
+  }
+
+  /// Copy the oldest data into `buffer`, returns its size.
+  std::size_t take(asio::mutable_buffer buffer) {
+    char *out = static_cast<char *>(buffer.data());
+    std::size_t size = buffer.size();
+    std::size_t n = 0;
+    while (n < size && m_held_count > 0) {
+      held &h = m_held[m_held_head];
+      std::size_t k = std::min<std::size_t>(h.end - h.begin, size - n);
+      std::memcpy(out + n, m_service.buffer(h.bid) + h.begin, k);
+      h.begin += static_cast<std::uint32_t>(k);
+      n += k;
+      if (h.begin == h.end) {
+        m_service.recycle(h.bid);
+        m_held_head = (m_held_head + 1) % MAX_HELD;
+        --m_held_count;
+      }
+    }
+    if (n < size && m_overflow_begin < m_overflow.size()) {
+      std::size_t k = std::min(m_overflow.size() - m_overflow_begin, size - n);
+      std::memcpy(out + n, m_overflow.data() + m_overflow_begin, k);
+      m_overflow_begin += k;
+      n += k;
+      if (m_overflow_begin == m_overflow.size()) {
+        // the burst of a fast sender is not kept for the life of the socket
+        if (m_overflow.capacity() > MAX_BUFFERED) {
+          std::string().swap(m_overflow);
+        } else {
+          m_overflow.clear();
+        }
+        m_overflow_begin = 0;
+      }
+    }
+    m_buffered -= n;
+    return n;
+  }
+
+  void drop_held() {
+    for (; m_held_count > 0; --m_held_count) {
+      m_service.recycle(m_held[m_held_head].bid);
+      m_held_head = (m_held_head + 1) % MAX_HELD;
+    }
+    m_overflow.clear();
+    m_overflow_begin = 0;
+    m_buffered = 0;
+  }
+
+  uring_service &m_service;
+  int m_index;
+  recv_op m_recv_op{*this};
+  send_op m_send_op{*this};
+  shutdown_op m_shutdown_op{*this};
+  // the socket and each entry in flight
+  int m_refs{1};
+  bool m_receiving{};
+  bool m_shutting_down{};
+  // the receive is being cancelled as too much waits to be read
+  bool m_pausing{};
+  bool m_closed{};
+  bool m_eof{};
+  // ends the receive, reported once the data before it is read
+  asio::error_code m_error;
+
+  uring_completion *m_reader{};
+  bool m_reader_waits{};
+  asio::mutable_buffer m_read_buffer;
+
+  uring_completion *m_writer{};
+  std::array<iovec, MAX_IOV> m_iov;
+  msghdr m_msg{};
+
+  std::array<held, MAX_HELD> m_held;
+  std::size_t m_held_head{};
+  std::size_t m_held_count{};
+  std::string m_overflow;
+  std::size_t m_overflow_begin{};
+  // bytes held and copied, not read yet
+  std::size_t m_buffered{};
+};
+
+uring_socket::uring_socket(uring_service &service, int index)
+    : m_impl(impl::create(service, index)) {}
+
+uring_socket::~uring_socket() {
+  if (m_impl) {
+    m_impl->close();
+    m_impl->release();
+  }
+}
+
+uring_socket::executor_type uring_socket::get_executor() const {
+  return m_impl->service().get_executor();
+}
+
+bool uring_socket::is_open() const { return m_impl && !m_impl->closed(); }
+
+void uring_socket::cancel(asio::error_code &err) {
+  err = {};
+  m_impl->cancel();
+}
+
+void uring_socket::close(asio::error_code &err) {
+  err = {};
+  m_impl->close();
+}
+
+void uring_socket::shutdown(asio::socket_base::shutdown_type what,
+                            asio::error_code &err) {
+  if (m_impl->closed()) {
+    err = asio::error::bad_descriptor;
+    return;
+  }
+  err = {};
+  m_impl->shutdown(static_cast<int>(what));
+}
+
+void uring_socket::start_wait(uring_completion *c) { m_impl->wait(c); }
+
+void uring_socket::start_read(uring_completion *c,
+                              asio::mutable_buffer buffer) {
+  m_impl->read(c, buffer);
+}
+
+void uring_socket::start_write(uring_completion *c, const iovec *iov,
+                               std::size_t count) {
+  m_impl->write(c, iov, count);
+}
+
+} // namespace server
+} // namespace http
@@ -0,0 +1,194 @@
+#pragma once
+
+#include "pool_allocator.hpp"
+#include "uring_service.hpp"
+
+#include <array>
+#include <asio.hpp>
+#include <cstddef>
+#include <sys/uio.h>
+#include <type_traits>
+#include <utility>
+
+namespace http {
+namespace server {
+
+/// Type erased completion handler of an operation of a uring_socket, recycled
+/// through the pool_allocator of the thread.
+class uring_completion {
+public:
+  /// Free the completion, then call the handler with `err` and `size`. As if
+  /// by post() when `immediate`, the operation completed within its
+  /// initiating function then.
+  virtual void complete(const asio::error_code &err, std::size_t size,
+                        bool immediate) = 0;
+
+  /// Free the completion without calling the handler.
+  virtual void destroy() = 0;
+
+protected:
+  ~uring_completion() = default;
+};
+
+namespace detail {
+
+/// A `Handler` of void(error_code, size_t) when `Sized`, of void(error_code)
+/// otherwise.
+template <typename Handler, bool Sized>
+class uring_handler final : public uring_completion {
+public:
+  uring_handler(Handler handler, asio::any_io_executor executor)
+      : m_handler(std::move(handler)), m_executor(std::move(executor)) {}
+
+  static uring_completion *create(Handler handler,
+                                  asio::any_io_executor executor) {
+    uring_handler *p = pool_allocator<uring_handler>().allocate(1);
+    return ::new (static_cast<void *>(p))
+        uring_handler(std::move(handler), std::move(executor));
+  }
+
+  void complete(const asio::error_code &err, std::size_t size,
+                bool immediate) override {
+    Handler handler(std::move(m_handler));
+    auto executor = asio::get_associated_executor(handler, m_executor);
+    free();
+    auto call = [handler = std::move(handler), err, size]() mutable {
+      if constexpr (Sized) {
+        handler(err, size);
+      } else {
+        (void)size;
+        handler(err);
+      }
+    };
+    if (immediate) {
+      asio::post(executor, std::move(call));
+    } else {
+      asio::dispatch(executor, std::move(call));
+    }
+  }
+
+  void destroy() override { free(); }
+
+private:
+  void free() {
+    this->~uring_handler();
+    pool_allocator<uring_handler>().deallocate(this, 1);
+  }
+
+  Handler m_handler;
+  asio::any_io_executor m_executor;
+};
+
+} // namespace detail
+
+/// A TCP connection in the file table of a uring_service, the stream of a
+/// basic_connection and the next layer of an asio::ssl::stream. A multishot
+/// receive armed by the first read keeps taking the data of the socket into
+/// the buffer ring of the service, a read copies it out and hands the buffer
+/// back. Reads and waits, writes and the receive each have at most one
+/// operation in flight, like the sockets of asio. All calls come from the
+/// thread running the service.
+class uring_socket {
+public:
+  using executor_type = asio::any_io_executor;
+  using lowest_layer_type = uring_socket;
+
+  /// Buffers a single write gathers at most.
+  static constexpr std::size_t MAX_IOV = 64;
+
+  /// Take over the slot `index` of the file table of `service`.
+  uring_socket(uring_service &service, int index);
+
+  uring_socket(uring_socket &&other) noexcept
+      : m_impl(std::exchange(other.m_impl, nullptr)) {}
+  uring_socket &operator=(uring_socket &&) = delete;
+
+  ~uring_socket();
+
+  executor_type get_executor() const;
+
+  lowest_layer_type &lowest_layer() { return *this; }
+  const lowest_layer_type &lowest_layer() const { return *this; }
+
+  bool is_open() const;
+
+  /// Abort the pending operations, they complete with operation_aborted.
+  void cancel(asio::error_code &err);
+
+  /// Cancel what is in flight and free the slot of the socket.
+  void close(asio::error_code &err);
+
+  /// Queue a shutdown(2) of the socket, it runs before a following close.
+  void shutdown(asio::socket_base::shutdown_type what, asio::error_code &err);
+
+  /// Wait until data arrived or the peer closed, without taking a buffer.
+  template <typename WaitToken>
+  auto async_wait(asio::socket_base::wait_type, WaitToken &&token) {
+    return asio::async_initiate<WaitToken, void(asio::error_code)>(
+        [this](auto &&handler) {
+          using handler_type = std::decay_t<decltype(handler)>;
+          start_wait(detail::uring_handler<handler_type, false>::create(
+              std::move(handler), get_executor()));
+        },
+        token);
+  }
+
+  template <typename MutableBufferSequence, typename ReadToken>
+  auto async_read_some(const MutableBufferSequence &buffers,
+                       ReadToken &&token) {
+    return asio::async_initiate<ReadToken,
+                                void(asio::error_code, std::size_t)>(
+        [this](auto &&handler, const MutableBufferSequence &buffers) {
+          using handler_type = std::decay_t<decltype(handler)>;
+          asio::mutable_buffer first;
+          for (auto it = asio::buffer_sequence_begin(buffers);
+               it != asio::buffer_sequence_end(buffers); ++it) {
+            first = asio::mutable_buffer(*it);
+            if (first.size() > 0) {
+              break;
+            }
+          }
+          start_read(detail::uring_handler<handler_type, true>::create(
+                         std::move(handler), get_executor()),
+                     first);
+        },
+        token, buffers);
+  }
+
+  template <typename ConstBufferSequence, typename WriteToken>
+  auto async_write_some(const ConstBufferSequence &buffers,
+                        WriteToken &&token) {
+    return asio::async_initiate<WriteToken,
+                                void(asio::error_code, std::size_t)>(
+        [this](auto &&handler, const ConstBufferSequence &buffers) {
+          using handler_type = std::decay_t<decltype(handler)>;
+          std::array<iovec, MAX_IOV> iov;
+          std::size_t count = 0;
+          for (auto it = asio::buffer_sequence_begin(buffers);
+               it != asio::buffer_sequence_end(buffers) && count < MAX_IOV;
+               ++it) {
+            asio::const_buffer buffer(*it);
+            if (buffer.size() > 0) {
+              iov[count++] = {const_cast<void *>(buffer.data()),
+                              buffer.size()};
+            }
+          }
+          start_write(detail::uring_handler<handler_type, true>::create(
+                          std::move(handler), get_executor()),
+                      iov.data(), count);
+        },
+        token, buffers);
+  }
+
+private:
+  class impl;
+
+  void start_wait(uring_completion *c);
+  void start_read(uring_completion *c, asio::mutable_buffer buffer);
+  void start_write(uring_completion *c, const iovec *iov, std::size_t count);
+
+  impl *m_impl;
+};
+
+} // namespace server
+} // namespace http
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// replacements of the global operator new and delete which count the heap
+// allocations of the tests and benchmarks. They are not inline, include this
+// in one translation unit of a program only
+
+namespace alloc_counter {
+
+/// The allocations of the calling thread are counted while set.
+inline thread_local bool counting = false;
+/// Calls of operator new and the bytes asked for by the counting threads.
+inline std::atomic<std::uint64_t> allocations{0};
+inline std::atomic<std::uint64_t> bytes{0};
+
+} // namespace alloc_counter
+
+// the replacements are not inlined: gcc pairs the free() of an inlined
+// operator delete with the new-expression of the pointer and warns with
+// -Wmismatched-new-delete
+[[gnu::noinline]] void *operator new(std::size_t size) {
+  if (alloc_counter::counting) {
+    alloc_counter::allocations.fetch_add(1, std::memory_order_relaxed);
+    alloc_counter::bytes.fetch_add(size, std::memory_order_relaxed);
+  }
+  if (void *p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) { return ::operator new(size); }
+
+[[gnu::noinline]] void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete[](void *p) noexcept { ::operator delete(p); }
+
+void operator delete(void *p, std::size_t) noexcept { ::operator delete(p); }
+
+void operator delete[](void *p, std::size_t) noexcept { ::operator delete(p); }
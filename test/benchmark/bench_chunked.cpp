@@ -0,0 +1,98 @@
+#include "chunked_decoder.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <spdlog/fmt/fmt.h>
+#include <string>
+#include <vector>
+
+// decoding rate of chunked request bodies in GB/s of encoded input, for chunk
+// sizes from 16 bytes to 64 KiB, handed to the decoder whole and in reads of
+// random size up to the 8 KiB receive buffer of a connection. The chunk data
+// is copied out like memory_sink does, a body of the same size framed by
+// Content-Length going through the same reads is the floor.
+//
+// usage: bench_chunked [milliseconds per run]
+
+using namespace http::server;
+
+/// A chunked body of about `total` bytes of chunk data in `chunk_size` chunks,
+/// every fourth chunk with an extension.
+static std::string encode(std::size_t chunk_size, std::size_t total) {
+  std::string body;
+  std::string chunk(chunk_size, 'x');
+  for (std::size_t i = 0; i * chunk_size < total; i++) {
+    body += fmt::format("{:x}{}\r\n", chunk_size, i % 4 == 0 ? ";ext=1" : "");
+    body += chunk;
+    body += "\r\n";
+  }
+  body += "0\r\nX-Checksum: none\r\n\r\n";
+  return body;
+}
+
+/// Where the chunk data goes, large enough for the largest chunk.
+static char sink[1 << 16];
+
+/// Decode `body` cut at `reads` over and over for about `millis`, print GB/s.
+/// Without `chunked` the body is taken as it is.
+static void run(const std::string &body, const std::vector<std::size_t> &reads,
+                bool chunked, int millis) {
+  using clock = std::chrono::steady_clock;
+  chunked_decoder decoder;
+  std::size_t bytes = 0;
+  auto start = clock::now();
+  auto end = start + std::chrono::milliseconds(millis);
+  clock::time_point now;
+  do {
+    decoder.clear();
+    std::size_t begin = 0;
+    for (std::size_t read : reads) {
+      std::string_view data(body.data() + begin, read);
+      begin += read;
+      if (!chunked) {
+        std::memcpy(sink, data.data(), data.size());
+        continue;
+      }
+      while (!data.empty()) {
+        auto [result, pos, chunk] = decoder.decode(data);
+        if (result == chunked_decoder::FAIL) {
+          fmt::print(stderr, "decode failed\n");
+          std::exit(EXIT_FAILURE);
+        }
+        std::memcpy(sink, chunk.data(), chunk.size());
+        data.remove_prefix(pos);
+      }
+    }
+    bytes += body.size();
+  } while ((now = clock::now()) < end);
+  fmt::print(" {:>10.3f}",
+             bytes / std::chrono::duration<double, std::nano>(now - start).count());
+}
+
+int main(int argc, char *argv[]) {
+  int millis = 300;
+  if (argc > 1) {
+    millis = std::atoi(argv[1]);
+  }
+  fmt::print("{:>10} {:>10} {:>10} {:>10} {:>10}   (GB/s)\n", "chunk",
+             "encoded", "whole", "reads", "length");
+  std::mt19937 random(1);
+  for (std::size_t chunk_size : {16, 256, 4096, 65536}) {
+    std::string body = encode(chunk_size, 4 << 20);
+    std::vector<std::size_t> whole{body.size()};
+    std::vector<std::size_t> reads;
+    std::uniform_int_distribution<std::size_t> read_size(1, 8192);
+    for (std::size_t left = body.size(); left > 0;) {
+      reads.push_back(std::min(left, read_size(random)));
+      left -= reads.back();
+    }
+    fmt::print("{:>10} {:>10}", chunk_size, body.size());
+    run(body, whole, true, millis);
+    run(body, reads, true, millis);
+    run(body, reads, false, millis);
+    fmt::print("\n");
+  }
+  return 0;
+}
@@ -0,0 +1,59 @@
+#include "../alloc_counter.hpp"
+#include "load_client.hpp"
+#include "server.hpp"
+
+#include <cstdlib>
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/spdlog.h>
+#include <thread>
+
+// connection churn: every request goes over a new connection which the server
+// closes after the response, reports connections per second and the heap
+// allocations done by the server thread per connection
+//
+// usage: bench_churn [connections] [seconds]
+
+int main(int argc, char *argv[]) {
+  std::size_t connections = 8;
+  int seconds = 3;
+  if (argc > 1) {
+    connections = std::strtoul(argv[1], nullptr, 10);
+  }
+  if (argc > 2) {
+    seconds = std::atoi(argv[2]);
+  }
+  spdlog::set_level(spdlog::level::off);
+
+  static constexpr std::string_view port = "18085";
+  std::string request = "GET /index.html HTTP/1.1\r\n"
+                        "Host: 127.0.0.1\r\n"
+                        "Connection: close\r\n\r\n";
+
+  http::server::server_options options;
+  options.thread_count = 1;
+  options.mode = http::server::execution_mode::thread_per_core;
+  options.enable_ssl = false;
+  http::server::server s("127.0.0.1", port, STATIC_PATH, options);
+  std::thread server_thread([&s]() {
+    alloc_counter::counting = true;
+    s.run();
+    alloc_counter::counting = false;
+  });
+
+  bench::load_client client("127.0.0.1", std::string(port), request,
+                            connections, 1);
+  client.reconnect_each_request();
+  auto result = client.run(std::chrono::seconds(seconds));
+  s.stop();
+  server_thread.join();
+
+  double accepted =
+      static_cast<double>(std::max<std::uint64_t>(result.requests, 1));
+  fmt::print("{:>12} {:>14} {:>14} {:>14} {:>8}\n", "connections",
+             "connections/s", "allocs/conn", "bytes/conn", "errors");
+  fmt::print("{:>12} {:>14.0f} {:>14.2f} {:>14.1f} {:>8}\n", result.requests,
+             result.requests_per_second(),
+             alloc_counter::allocations.load() / accepted,
+             alloc_counter::bytes.load() / accepted, result.errors);
+  return 0;
+}
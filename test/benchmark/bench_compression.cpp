@@ -0,0 +1,187 @@
+#include "body_source.hpp"
+#include "content_encoding.hpp"
+#include "request.hpp"
+#include "request_handler.hpp"
+#include "response.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <vector>
+
+// the compression stage on bodies of the repository: a css file, the js
+// bundle of the demo page and a 250 KB html page, compressed with every
+// coding of this build at a few levels. Reports the compressed size, the
+// ratio and the cpu time per body, with an encoder created for the body and
+// destroyed after it against one taken from the encoder_pool of the thread
+// and reset. Then the cpu time per request of the js bundle through a
+// request_handler: sent as it is, its cached gzip variant, and compressed on
+// every request as a streamed body
+//
+// usage: bench_compression [rounds]
+
+using namespace http::server;
+namespace fs = std::filesystem;
+
+static std::string read_file(const fs::path &path) {
+  std::ifstream in(path, std::ios::in | std::ios::binary);
+  return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+/// CPU time of the calling thread in nanoseconds.
+static std::uint64_t thread_cpu_ns() {
+  timespec ts{};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return static_cast<std::uint64_t>(ts.tv_sec) * 1000000000u +
+         static_cast<std::uint64_t>(ts.tv_nsec);
+}
+
+/// Compress the whole of `body` through `e` in pieces of the send path, returns
+/// the compressed size.
+static std::size_t compress(encoder &e, std::string_view body,
+                            std::vector<char> &out) {
+  std::size_t size = 0;
+  asio::error_code err;
+  while (!err) {
+    encoder::result r = e.encode(body, out, encoder::finish, err);
+    body.remove_prefix(r.consumed);
+    size += r.produced;
+    if (r.complete) {
+      break;
+    }
+  }
+  return size;
+}
+
+/// CPU time per request in microseconds of `rounds` GET `target` with
+/// `accept_encoding`, a streamed body is pulled through as well.
+static double handler_us(request_handler &handler, std::string_view target,
+                         std::string_view accept_encoding, int rounds) {
+  std::vector<char> out(64 * 1024);
+  std::uint64_t start = thread_cpu_ns();
+  for (int i = 0; i < rounds; i++) {
+    request req;
+    req.method = "GET";
+    req.request_target = target;
+    if (!accept_encoding.empty()) {
+      req.add_header("Accept-Encoding", accept_encoding);
+    }
+    req.update();
+    response rep;
+    handler.handle_request(req, rep);
+    if (rep.source) {
+      asio::io_context context;
+      asio::co_spawn(
+          context,
+          [&]() -> asio::awaitable<void> {
+            asio::error_code err;
+            while (co_await rep.source->read(out, err) > 0 && !err) {
+            }
+          },
+          asio::detached);
+      context.run();
+    }
+  }
+  return (thread_cpu_ns() - start) / 1000.0 / rounds;
+}
+
+int main(int argc, char *argv[]) {
+  int rounds = 50;
+  if (argc > 1) {
+    rounds = std::atoi(argv[1]);
+  }
+  fs::path data = fs::u8path(DATA_PATH);
+  fs::path assets = data.parent_path() / "static" / "assets";
+  struct corpus {
+    std::string name;
+    std::string body;
+  };
+  std::vector<corpus> corpora = {
+      {"css", read_file(assets / "index-efcb3133.css")},
+      {"js", read_file(assets / "index-888ab6c0.js")},
+      {"html", read_file(data / "br_decoded.bin")},
+  };
+  struct setting {
+    content_coding coding;
+    int level;
+  };
+  std::vector<setting> settings = {
+      {content_coding::gzip, 1},    {content_coding::gzip, 6},
+      {content_coding::gzip, 9},    {content_coding::deflate, 6},
+      {content_coding::br, 1},      {content_coding::br, 4},
+      {content_coding::br, 9},      {content_coding::br, 11},
+      {content_coding::zstd, 1},    {content_coding::zstd, 3},
+      {content_coding::zstd, 9},    {content_coding::zstd, 19},
+  };
+  // a chunk of the send path less its framing
+  std::vector<char> out(64 * 1024 - 10);
+
+  fmt::print("{} bodies each\n", rounds);
+  fmt::print("{:>6} {:>8} {:>6} {:>10} {:>10} {:>8} {:>12} {:>12}\n", "body",
+             "coding", "level", "size", "encoded", "ratio", "fresh(us)",
+             "pooled(us)");
+  for (const corpus &c : corpora) {
+    for (const setting &s : settings) {
+      if (!coding_available(s.coding)) {
+        continue;
+      }
+      std::size_t size = 0;
+      std::uint64_t start = thread_cpu_ns();
+      for (int i = 0; i < rounds; i++) {
+        std::unique_ptr<encoder> e = encoder::create(s.coding);
+        e->reset(s.level);
+        size = compress(*e, c.body, out);
+      }
+      std::uint64_t fresh = thread_cpu_ns() - start;
+
+      // warm the pool first
+      encoder_pool::local().acquire(s.coding, s.level);
+      start = thread_cpu_ns();
+      for (int i = 0; i < rounds; i++) {
+        encoder_ptr e = encoder_pool::local().acquire(s.coding, s.level);
+        size = compress(*e, c.body, out);
+      }
+      std::uint64_t pooled = thread_cpu_ns() - start;
+
+      fmt::print("{:>6} {:>8} {:>6} {:>10} {:>10} {:>8.3f} {:>12.1f} "
+                 "{:>12.1f}\n",
+                 c.name, coding_name(s.coding), s.level, c.body.size(), size,
+                 static_cast<double>(size) / c.body.size(),
+                 fresh / 1000.0 / rounds, pooled / 1000.0 / rounds);
+    }
+  }
+
+  std::string script = read_file(assets / "index-888ab6c0.js");
+  route_map routes;
+  routes["/streamed.js"] = [&script](const request &, response &rep) {
+    rep.headers.set(header_id::content_type, "application/javascript");
+    rep.source = std::make_unique<callback_source>(
+        [&script, pos = std::size_t{0}](std::span<char> out,
+                                        asio::error_code &) mutable {
+          std::size_t size = std::min(out.size(), script.size() - pos);
+          std::copy_n(script.data() + pos, size, out.data());
+          pos += size;
+          return size;
+        });
+  };
+  spdlog::set_level(spdlog::level::off);
+  request_handler handler(assets.parent_path(), 64 * 1024 * 1024, routes);
+  // the first request reads the file and makes the variant
+  handler_us(handler, "/assets/index-888ab6c0.js", "gzip", 1);
+  fmt::print("\njs bundle through the request_handler, cpu per request\n");
+  fmt::print("{:>28} {:>10.1f} us\n", "identity, cached",
+             handler_us(handler, "/assets/index-888ab6c0.js", "", rounds));
+  fmt::print("{:>28} {:>10.1f} us\n", "gzip, cached variant",
+             handler_us(handler, "/assets/index-888ab6c0.js", "gzip", rounds));
+  fmt::print("{:>28} {:>10.1f} us\n", "gzip, streamed",
+             handler_us(handler, "/streamed.js", "gzip", rounds));
+  return 0;
+}
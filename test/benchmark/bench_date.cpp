@@ -0,0 +1,83 @@
+#include "../alloc_counter.hpp"
+#include "date_clock.hpp"
+#include "response.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <spdlog/fmt/fmt.h>
+#include <string>
+
+// the Date line of a response: system_clock, gmtime and strftime for every
+// response against the line of a date_clock, which reads a coarse monotonic
+// tick and formats once per second, on its own and as part of a whole
+// response::update()
+//
+// usage: bench_date [iterations]
+
+using alloc_counter::allocations;
+using http::server::date_clock;
+using http::server::header_id;
+using http::server::response;
+
+/// The Date line formatted on the spot, like a server without a cache does.
+static std::string_view strftime_line(char (&buffer)[64]) {
+  std::time_t t = std::chrono::system_clock::to_time_t(
+      std::chrono::system_clock::now());
+  std::tm tm{};
+  gmtime_r(&t, &tm);
+  std::size_t size = std::strftime(buffer, sizeof(buffer),
+                                   "Date: %a, %d %b %Y %H:%M:%S GMT\r\n", &tm);
+  return std::string_view(buffer, size);
+}
+
+/// Call `f` `iterations` times, print ns and allocations per call.
+template <typename F>
+static void run(std::string_view name, std::size_t iterations, F &&f) {
+  f();
+  std::uint64_t allocations_before = allocations;
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < iterations; i++) {
+    auto result = f();
+    asm volatile("" : : "r"(&result) : "memory");
+  }
+  double ns = std::chrono::duration<double, std::nano>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+  fmt::print("{:>24} {:>12.1f} {:>14.0f} {:>12.2f}\n", name, ns / iterations,
+             iterations * 1e9 / ns,
+             static_cast<double>(allocations - allocations_before) /
+                 iterations);
+}
+
+int main(int argc, char *argv[]) {
+  alloc_counter::counting = true;
+  std::size_t iterations = 5000000;
+  if (argc > 1) {
+    iterations = std::strtoul(argv[1], nullptr, 10);
+  }
+
+  fmt::print("{:>24} {:>12} {:>14} {:>12}\n", "date", "ns/call", "calls/s",
+             "allocs/call");
+  char buffer[64];
+  run("strftime", iterations, [&]() { return strftime_line(buffer); });
+  run("date_clock", iterations,
+      []() { return date_clock::local().line(); });
+  run("coarse tick", iterations, []() { return date_clock::coarse_tick(); });
+
+  // the whole head of a small response, with each of the lines
+  response rep;
+  rep.content = std::string(512, 'x');
+  auto update = [&rep](std::string_view date) {
+    rep.headers.clear();
+    rep.headers.set(header_id::content_type, "text/html");
+    rep.update(true, date);
+    return rep.head();
+  };
+  run("update, no date", iterations, [&]() { return update({}); });
+  run("update, strftime", iterations,
+      [&]() { return update(strftime_line(buffer)); });
+  run("update, date_clock", iterations,
+      [&]() { return update(date_clock::local().line()); });
+  return 0;
+}
@@ -0,0 +1,194 @@
+#include "request.hpp"
+#include "request_parser.hpp"
+#include "switch_request_parser.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <spdlog/fmt/fmt.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// the table driven request_parser against the switch over the states it
+// replaced, on the data/test_header*.txt captures: GB/s, branches and branch
+// misses per request, counted in process with perf_event_open(2)
+//
+// usage: bench_dfa [milliseconds per run] [dfa|switch]
+//
+// with a parser given only that one runs, e.g. under
+// `perf stat -e branches,branch-misses bench_dfa 3000 dfa` where the counters
+// can not be opened in process
+
+using namespace http::server;
+namespace fs = std::filesystem;
+
+/// Branches and branch misses of this thread in user space.
+class branch_counters {
+public:
+  branch_counters() {
+#if defined(__linux__)
+    m_branches = open_counter(PERF_COUNT_HW_BRANCH_INSTRUCTIONS, -1);
+    if (m_branches >= 0) {
+      m_misses = open_counter(PERF_COUNT_HW_BRANCH_MISSES, m_branches);
+    }
+#endif
+  }
+
+  ~branch_counters() {
+#if defined(__linux__)
+    for (int fd : {m_misses, m_branches}) {
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+#endif
+  }
+
+  bool available() const { return m_misses >= 0; }
+
+  void start() {
+#if defined(__linux__)
+    if (available()) {
+      ioctl(m_branches, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+      ioctl(m_branches, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#endif
+  }
+
+  /// Stop counting, returns the branches and the branch misses.
+  std::pair<std::uint64_t, std::uint64_t> stop() {
+    std::uint64_t branches = 0;
+    std::uint64_t misses = 0;
+#if defined(__linux__)
+    if (available()) {
+      ioctl(m_branches, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+      if (read(m_branches, &branches, sizeof(branches)) != sizeof(branches) ||
+          read(m_misses, &misses, sizeof(misses)) != sizeof(misses)) {
+        branches = misses = 0;
+      }
+    }
+#endif
+    return {branches, misses};
+  }
+
+private:
+#if defined(__linux__)
+  static int open_counter(std::uint64_t config, int group) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = group < 0 ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return static_cast<int>(
+        syscall(SYS_perf_event_open, &attr, 0, -1, group, 0));
+  }
+#endif
+
+  int m_branches{-1};
+  int m_misses{-1};
+};
+
+struct corpus {
+  std::string name;
+  std::string data;
+};
+
+static std::vector<corpus> load_corpora() {
+  fs::path data_path = fs::u8path(DATA_PATH);
+  std::vector<corpus> corpora;
+  for (auto name : {"test_header1.txt", "test_header2.txt", "test_header3.txt",
+                    "test_header4.txt"}) {
+    std::ifstream in(data_path / name, std::ios::in | std::ios::binary);
+    std::string data{std::istreambuf_iterator<char>(in),
+                     std::istreambuf_iterator<char>()};
+    // the header captures stop after the last field line
+    data += "\r\n\r\n";
+    corpora.push_back({name, std::move(data)});
+  }
+  return corpora;
+}
+
+/// Parse `data` over and over for about `millis`, print GB/s, branches and
+/// branch misses per request.
+template <typename Parser>
+static void run(std::string_view data, int millis, branch_counters &counters) {
+  using clock = std::chrono::steady_clock;
+  Parser parser;
+  request req;
+  std::size_t bytes = 0;
+  std::size_t requests = 0;
+  auto start = clock::now();
+  auto end = start + std::chrono::milliseconds(millis);
+  clock::time_point now;
+  counters.start();
+  do {
+    for (int i = 0; i < 64; i++) {
+      auto [result, pos] = parser.parse(req, data);
+      if (result != Parser::PASS) {
+        fmt::print(stderr, "parse failed\n");
+        std::exit(EXIT_FAILURE);
+      }
+      bytes += pos + 1;
+      parser.clear();
+      req.clear();
+    }
+    requests += 64;
+  } while ((now = clock::now()) < end);
+  auto [branches, misses] = counters.stop();
+  fmt::print(" {:>8.3f}",
+             bytes / std::chrono::duration<double, std::nano>(now - start).count());
+  if (counters.available()) {
+    fmt::print(" {:>9.1f} {:>7.2f}", static_cast<double>(branches) / requests,
+               static_cast<double>(misses) / requests);
+  } else {
+    fmt::print(" {:>9} {:>7}", "n/a", "n/a");
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int millis = 300;
+  std::string_view only;
+  if (argc > 1) {
+    millis = std::atoi(argv[1]);
+  }
+  if (argc > 2) {
+    only = argv[2];
+  }
+  branch_counters counters;
+  if (!counters.available()) {
+    fmt::print("branch counters not available in process, run one parser under "
+               "perf stat instead\n");
+  }
+  fmt::print("{:>18} {:>8}", "corpus", "bytes");
+  for (std::string_view name : {"switch", "dfa"}) {
+    if (only.empty() || only == name) {
+      fmt::print(" {:>8} {:>9} {:>7}", name, "branches", "misses");
+    }
+  }
+  fmt::print("   (GB/s, per request)\n");
+  for (const auto &[name, data] : load_corpora()) {
+    fmt::print("{:>18} {:>8}", name, data.size());
+    if (only.empty() || only == "switch") {
+      run<switch_request_parser>(data, millis, counters);
+    }
+    if (only.empty() || only == "dfa") {
+      run<request_parser>(data, millis, counters);
+    }
+    fmt::print("\n");
+  }
+  return 0;
+}
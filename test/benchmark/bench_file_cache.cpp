@@ -0,0 +1,111 @@
+#include "load_client.hpp"
+#include "server.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// many keep-alive clients requesting the same static asset over and over,
+// every response opening the file and sending it with sendfile(2) against the
+// shared copy of the file_cache. The server runs in a process of its own,
+// reports requests per second, the p99 latency and the resident set of the
+// server sampled while the clients run
+//
+// usage: bench_file_cache [connections] [seconds]
+
+/// Resident set of the process `pid`.
+static std::size_t resident_bytes(pid_t pid) {
+  std::size_t pages = 0;
+  std::size_t resident = 0;
+  std::ifstream statm("/proc/" + std::to_string(pid) + "/statm");
+  statm >> pages >> resident;
+  return resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+}
+
+int main(int argc, char *argv[]) {
+  std::size_t connections = 10000;
+  int seconds = 5;
+  if (argc > 1) {
+    connections = std::strtoul(argv[1], nullptr, 10);
+  }
+  if (argc > 2) {
+    seconds = std::atoi(argv[2]);
+  }
+  spdlog::set_level(spdlog::level::off);
+  rlimit limit{};
+  getrlimit(RLIMIT_NOFILE, &limit);
+  limit.rlim_cur = limit.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &limit);
+  connections = std::min<std::size_t>(connections, limit.rlim_cur - 64);
+
+  std::vector<std::string_view> assets = {"/index.html", "/favicon.ico",
+                                          "/assets/index-888ab6c0.js"};
+  fmt::print("{} connections\n", connections);
+  fmt::print("{:>28} {:>10} {:>12} {:>10} {:>10} {:>10}\n", "asset", "body",
+             "requests/s", "p99(us)", "rss(MB)", "peak(MB)");
+  // the servers are forked up front, while this process is small and has a
+  // single thread, one without and one with the file cache
+  std::vector<pid_t> servers;
+  for (bool cached : {false, true}) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      http::server::server_options options;
+      options.thread_count = 1;
+      options.mode = http::server::execution_mode::thread_per_core;
+      options.enable_ssl = false;
+      options.file_cache_size = cached ? options.file_cache_size : 0;
+      http::server::server s("127.0.0.1", cached ? "18111" : "18110",
+                             STATIC_PATH, options);
+      s.run();
+      _exit(0);
+    }
+    servers.push_back(pid);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  for (std::string_view asset : assets) {
+    for (bool cached : {false, true}) {
+      pid_t pid = servers[cached];
+      std::size_t rss_start = resident_bytes(pid);
+      std::atomic<std::size_t> rss_peak{rss_start};
+      std::atomic<bool> running{true};
+      std::thread sampler([&]() {
+        while (running) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(20));
+          rss_peak = std::max(rss_peak.load(), resident_bytes(pid));
+        }
+      });
+      std::string request = "GET " + std::string(asset) +
+                            " HTTP/1.1\r\n"
+                            "Host: 127.0.0.1\r\n"
+                            "Connection: keep-alive\r\n\r\n";
+      bench::load_client client("127.0.0.1", cached ? "18111" : "18110",
+                                request, connections, 1);
+      auto result = client.run(std::chrono::seconds(seconds));
+      running = false;
+      sampler.join();
+
+      fmt::print("{:>28} {:>10} {:>12.0f} {:>10} {:>10.1f} {:>10.1f}\n",
+                 asset, cached ? "cached" : "sendfile",
+                 result.requests_per_second(), result.percentile(0.99),
+                 rss_start / 1048576.0, rss_peak / 1048576.0);
+    }
+  }
+  // the servers stop on SIGINT like my_server
+  for (pid_t pid : servers) {
+    kill(pid, SIGINT);
+    waitpid(pid, nullptr, 0);
+  }
+  return 0;
+}
@@ -0,0 +1,182 @@
+#include "server.hpp"
+
+#include <algorithm>
+#include <asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__)
+#include <unistd.h>
+#endif
+
+// oversized header flood: every connection sends a request line and then
+// header bytes without end, the server has to answer 414 or 431 and close.
+// Reports the rate of rejected connections, the share of them which got the
+// answer before the connection was dropped and the resident set of the
+// process sampled while the flood runs, once with the default header_limits
+// and once limited by the receive buffer only
+//
+// usage: bench_header_flood [connections] [seconds]
+
+static std::size_t resident_bytes() {
+  std::size_t pages = 0;
+  std::size_t resident = 0;
+  std::ifstream statm("/proc/self/statm");
+  statm >> pages >> resident;
+#if defined(__unix__)
+  return resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+#else
+  return resident * 4096;
+#endif
+}
+
+struct flood {
+  std::string_view name;
+  // sent once per connection
+  std::string head;
+  // sent over and over until the server gives up
+  std::string block;
+};
+
+struct flood_result {
+  std::uint64_t rejected{};
+  std::uint64_t answered{};
+  std::size_t rss_start{};
+  std::size_t rss_peak{};
+  std::size_t rss_end{};
+};
+
+/// One client: connect, flood until the server answers or drops the
+/// connection, count it and start over.
+static void run_client(const asio::ip::tcp::endpoint &endpoint, const flood &f,
+                       std::atomic<bool> &running, flood_result &result,
+                       std::mutex &mutex) {
+  asio::io_context context;
+  std::uint64_t rejected = 0;
+  std::uint64_t answered = 0;
+  while (running) {
+    asio::ip::tcp::socket socket(context);
+    asio::error_code err;
+    socket.connect(endpoint, err);
+    if (err) {
+      continue;
+    }
+    asio::write(socket, asio::buffer(f.head), err);
+    while (!err && running && socket.available(err) == 0 && !err) {
+      asio::write(socket, asio::buffer(f.block), err);
+    }
+    if (!running && !err) {
+      break;
+    }
+    char status[12];
+    if (asio::read(socket, asio::buffer(status), err) == sizeof(status) &&
+        (std::string_view(status + 9, 3) == "414" ||
+         std::string_view(status + 9, 3) == "431")) {
+      answered++;
+    }
+    rejected++;
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  result.rejected += rejected;
+  result.answered += answered;
+}
+
+static flood_result run_flood(const flood &f,
+                              const http::server::header_limits &limits,
+                              std::size_t connections, int seconds,
+                              std::string_view port) {
+  http::server::server_options options;
+  options.thread_count = 1;
+  options.mode = http::server::execution_mode::thread_per_core;
+  options.enable_ssl = false;
+  options.limits = limits;
+  http::server::server s("127.0.0.1", port, STATIC_PATH, options);
+  std::thread server_thread([&s]() { s.run(); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  asio::ip::tcp::endpoint endpoint(
+      asio::ip::make_address("127.0.0.1"),
+      static_cast<unsigned short>(std::atoi(port.data())));
+  flood_result result;
+  std::mutex mutex;
+  std::atomic<bool> running{true};
+  result.rss_start = resident_bytes();
+  std::vector<std::thread> clients;
+  for (std::size_t i = 0; i < connections; i++) {
+    clients.emplace_back(run_client, std::cref(endpoint), std::cref(f),
+                         std::ref(running), std::ref(result),
+                         std::ref(mutex));
+  }
+  auto end = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+  while (std::chrono::steady_clock::now() < end) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    result.rss_peak = std::max(result.rss_peak, resident_bytes());
+  }
+  result.rss_end = resident_bytes();
+  running = false;
+  for (auto &client : clients) {
+    client.join();
+  }
+  s.stop();
+  server_thread.join();
+  return result;
+}
+
+int main(int argc, char *argv[]) {
+  std::size_t connections = 16;
+  int seconds = 2;
+  if (argc > 1) {
+    connections = std::strtoul(argv[1], nullptr, 10);
+  }
+  if (argc > 2) {
+    seconds = std::atoi(argv[2]);
+  }
+  spdlog::set_level(spdlog::level::off);
+
+  std::string request_line = "GET / HTTP/1.1\r\nHost: 127.0.0.1\r\n";
+  std::string tiny_fields;
+  while (tiny_fields.size() < 1024) {
+    tiny_fields += "a: b\r\n";
+  }
+  std::vector<flood> floods = {
+      {"target", "GET /", std::string(1024, 'a')},
+      {"one field", request_line + "X-Flood: ", std::string(1024, 'v')},
+      {"tiny fields", request_line, tiny_fields},
+  };
+  http::server::header_limits unlimited;
+  unlimited.max_request_line = std::numeric_limits<std::size_t>::max() / 2;
+  unlimited.max_field_size = unlimited.max_request_line;
+  unlimited.max_field_count = unlimited.max_request_line;
+  unlimited.max_header_bytes = unlimited.max_request_line;
+
+  fmt::print("{:>12} {:>14} {:>12} {:>10} {:>10} {:>10} {:>10}\n", "flood",
+             "limits", "rejected/s", "answered", "rss(MB)", "peak(MB)",
+             "end(MB)");
+  unsigned short port = 18092;
+  for (const flood &f : floods) {
+    for (bool limited : {true, false}) {
+      std::string port_name = std::to_string(port++);
+      flood_result result =
+          run_flood(f, limited ? http::server::header_limits{} : unlimited,
+                    connections, seconds, port_name);
+      fmt::print("{:>12} {:>14} {:>12.0f} {:>9.0f}% {:>10.1f} {:>10.1f} "
+                 "{:>10.1f}\n",
+                 f.name, limited ? "default" : "buffer only",
+                 static_cast<double>(result.rejected) / seconds,
+                 result.rejected ? 100.0 * result.answered / result.rejected
+                                 : 0.0,
+                 result.rss_start / 1048576.0, result.rss_peak / 1048576.0,
+                 result.rss_end / 1048576.0);
+    }
+  }
+  return 0;
+}
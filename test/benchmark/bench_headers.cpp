@@ -0,0 +1,174 @@
+#include "../alloc_counter.hpp"
+#include "request.hpp"
+#include "request_parser.hpp"
+#include "response.hpp"
+#include "string_utils.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <spdlog/fmt/fmt.h>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// cost of keeping and looking up header fields on header heavy requests, the
+// std::unordered_map<std::string, std::string> request and response used to
+// carry against the well known slots: parse the data/test_header*.txt captures
+// and a request of 64 fields, look up what the connection and the handler
+// ask for, fill in and serialise the response headers. ns and heap
+// allocations per request, parse alone as the floor.
+//
+// usage: bench_headers [milliseconds per run]
+
+using alloc_counter::allocations;
+using namespace http::server;
+namespace fs = std::filesystem;
+
+using header_map = std::unordered_map<std::string, std::string>;
+
+struct corpus {
+  std::string name;
+  std::string data;
+};
+
+static std::vector<corpus> load_corpora() {
+  fs::path data_path = fs::u8path(DATA_PATH);
+  std::vector<corpus> corpora;
+  for (auto name : {"test_header1.txt", "test_header2.txt", "test_header3.txt",
+                    "test_header4.txt"}) {
+    std::ifstream in(data_path / name, std::ios::in | std::ios::binary);
+    std::string data{std::istreambuf_iterator<char>(in),
+                     std::istreambuf_iterator<char>()};
+    // the header captures stop after the last field line
+    data += "\r\n\r\n";
+    corpora.push_back({name, std::move(data)});
+  }
+  std::string many = "GET /index.html HTTP/1.1\r\n"
+                     "Host: 127.0.0.1:8080\r\n"
+                     "connection: keep-alive\r\n";
+  for (int i = 0; i < 62; i++) {
+    many += fmt::format("X-Field-{}: value of field {}\r\n", i, i);
+  }
+  many += "\r\n";
+  corpora.push_back({"64 fields", std::move(many)});
+  return corpora;
+}
+
+/// The map based request and response of before: the fields copied into the
+/// map, a case sensitive find() and a lowered copy for Connection.
+static std::size_t with_map(const request &req, header_map &request_headers,
+                            header_map &response_headers) {
+  request_headers.clear();
+  for (const auto &field : req.headers) {
+    request_headers.emplace(field.name, field.value);
+  }
+  bool keep_alive = false;
+  if (request_headers.find("Connection") != request_headers.end()) {
+    keep_alive =
+        string_utils::lower(request_headers["Connection"]) == "keep-alive";
+  }
+  std::size_t content_length = 0;
+  if (auto it = request_headers.find("Content-Length");
+      it != request_headers.end()) {
+    content_length = string_utils::parse_ull(it->second).value_or(0);
+  }
+  std::size_t found = keep_alive + content_length;
+  for (auto name : {"Host", "If-None-Match", "Accept-Encoding"}) {
+    found += request_headers.count(name);
+  }
+
+  response_headers.clear();
+  response_headers["Content-Type"] = "text/html";
+  response_headers["Content-Length"] = std::to_string(1234);
+  response_headers["Connection"] = keep_alive ? "keep-alive" : "close";
+  for (const auto &[name, value] : response_headers) {
+    found += name.size() + value.size();
+  }
+  return found;
+}
+
+/// The same with the slots filled in while parsing.
+static std::size_t with_slots(request &req, response &rep) {
+  req.update();
+  std::size_t found = req.keep_alive + req.content_length;
+  for (auto id :
+       {header_id::host, header_id::if_none_match, header_id::accept_encoding}) {
+    found += req.find_header(id).has_value();
+  }
+
+  rep.headers.clear();
+  rep.headers.set(header_id::content_type, "text/html");
+  rep.headers.set(header_id::content_length, std::to_string(1234));
+  rep.headers.set(header_id::connection,
+                  req.keep_alive ? "keep-alive" : "close");
+  for (const auto &field : rep.headers) {
+    found += field.name.size() + field.value.size();
+  }
+  return found;
+}
+
+/// Parse `data` and run `work` for about `millis`, print ns and allocations
+/// per request.
+template <typename Work>
+static void run(std::string_view data, int millis, Work work) {
+  using clock = std::chrono::steady_clock;
+  request_parser parser;
+  request req;
+  std::size_t requests = 0;
+  std::size_t sink = 0;
+  std::uint64_t allocations_before = allocations;
+  auto start = clock::now();
+  auto end = start + std::chrono::milliseconds(millis);
+  clock::time_point now;
+  do {
+    for (int i = 0; i < 64; i++) {
+      auto [result, pos] = parser.parse(req, data);
+      if (result != request_parser::PASS) {
+        fmt::print(stderr, "parse failed\n");
+        std::exit(EXIT_FAILURE);
+      }
+      sink += work(req);
+      parser.clear();
+      req.clear();
+    }
+    requests += 64;
+  } while ((now = clock::now()) < end);
+  fmt::print(" {:>10.1f} {:>7.1f}",
+             std::chrono::duration<double, std::nano>(now - start).count() /
+                 requests,
+             static_cast<double>(allocations - allocations_before) / requests);
+  if (sink == 0) {
+    fmt::print("?");
+  }
+}
+
+int main(int argc, char *argv[]) {
+  alloc_counter::counting = true;
+  int millis = 300;
+  if (argc > 1) {
+    millis = std::atoi(argv[1]);
+  }
+  fmt::print("{:>18} {:>7} {:>10} {:>7} {:>10} {:>7} {:>10} {:>7}\n",
+             "request", "fields", "parse ns", "allocs", "map ns", "allocs",
+             "slots ns", "allocs");
+  for (const auto &[name, data] : load_corpora()) {
+    request_parser parser;
+    request req;
+    parser.parse(req, data);
+    fmt::print("{:>18} {:>7}", name, req.headers.size());
+    run(data, millis, [](request &) { return std::size_t{1}; });
+    header_map request_headers;
+    header_map response_headers;
+    run(data, millis, [&](request &req) {
+      return with_map(req, request_headers, response_headers);
+    });
+    response rep;
+    run(data, millis, [&](request &req) { return with_slots(req, rep); });
+    fmt::print("\n");
+  }
+  return 0;
+}
@@ -0,0 +1,96 @@
+#include "server.hpp"
+
+#include <asio.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/spdlog.h>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__)
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+// resident memory per idle keep-alive connection: opens N sockets that never
+// send anything and compares the resident set of the process before and after
+// the server accepted them, the client side sockets are plain file descriptors
+//
+// usage: bench_idle_rss [connections]
+
+static std::size_t resident_bytes() {
+  std::size_t pages = 0;
+  std::size_t resident = 0;
+  std::ifstream statm("/proc/self/statm");
+  statm >> pages >> resident;
+#if defined(__unix__)
+  return resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+#else
+  return resident * 4096;
+#endif
+}
+
+int main(int argc, char *argv[]) {
+  std::size_t connections = 10000;
+  if (argc > 1) {
+    connections = std::strtoul(argv[1], nullptr, 10);
+  }
+  spdlog::set_level(spdlog::level::off);
+#if defined(__unix__)
+  // both ends of every connection live in this process
+  rlimit limit{};
+  getrlimit(RLIMIT_NOFILE, &limit);
+  limit.rlim_cur = limit.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &limit);
+  connections = std::min<std::size_t>(connections, (limit.rlim_cur - 64) / 2);
+#endif
+
+  static constexpr std::string_view port = "18086";
+  http::server::server_options options;
+  options.thread_count = 1;
+  options.mode = http::server::execution_mode::thread_per_core;
+  options.enable_ssl = false;
+  http::server::server s("127.0.0.1", port, STATIC_PATH, options);
+  std::thread server_thread([&s]() { s.run(); });
+
+  asio::io_context context;
+  asio::ip::tcp::endpoint endpoint(asio::ip::make_address("127.0.0.1"),
+                                   static_cast<unsigned short>(std::atoi(port.data())));
+  std::vector<asio::ip::tcp::socket> sockets;
+  sockets.reserve(connections);
+  // let the server settle before the baseline is taken
+  {
+    asio::ip::tcp::socket warmup(context);
+    warmup.connect(endpoint);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  }
+  std::size_t before = resident_bytes();
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < connections; i++) {
+    sockets.emplace_back(context).connect(endpoint);
+  }
+  // every connection is accepted and parked well within the idle timeout
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  std::size_t after = resident_bytes();
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+  sockets.clear();
+  s.stop();
+  server_thread.join();
+
+  fmt::print("{:>12} {:>14} {:>14} {:>16}\n", "connections", "rss before(MB)",
+             "rss after(MB)", "bytes/connection");
+  fmt::print("{:>12} {:>14.1f} {:>14.1f} {:>16.0f}\n", connections,
+             before / 1048576.0, after / 1048576.0,
+             after > before ? static_cast<double>(after - before) / connections
+                            : 0.0);
+  if (seconds > 10) {
+    fmt::print("warning: connecting took {:.1f}s, close to the idle timeout\n",
+               seconds);
+  }
+  return 0;
+}
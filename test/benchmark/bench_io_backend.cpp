@@ -0,0 +1,86 @@
+#include "syscall_counter.hpp"
+
+#include "load_client.hpp"
+#include "server.hpp"
+
+#include <cstdlib>
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/spdlog.h>
+#include <thread>
+
+#if defined(__linux__)
+#include <sys/resource.h>
+#endif
+
+// keep-alive workload against a single server thread, build once without
+// io_uring, once with -DMY_SERVER_IO_URING=ON (the server's own ring) and
+// once with -DMY_SERVER_ASIO_IO_URING=ON (asio's backend) and compare the
+// tables. syscalls/req counts the libc calls of the server thread, the
+// kernel cpu time per request is what they cost
+//
+// usage: bench_io_backend [connections] [seconds]
+int main(int argc, char *argv[]) {
+  std::size_t connections = 64;
+  int seconds = 5;
+  if (argc > 1) {
+    connections = std::strtoul(argv[1], nullptr, 10);
+  }
+  if (argc > 2) {
+    seconds = std::atoi(argv[2]);
+  }
+  spdlog::set_level(spdlog::level::off);
+
+#if defined(MY_SERVER_IO_URING)
+  static constexpr std::string_view backend = "io_uring";
+#elif defined(ASIO_HAS_IO_URING) && defined(ASIO_DISABLE_EPOLL)
+  static constexpr std::string_view backend = "asio_uring";
+#else
+  static constexpr std::string_view backend = "epoll";
+#endif
+
+  static constexpr std::string_view port = "18082";
+  std::string request = "GET /index.html HTTP/1.1\r\n"
+                        "Host: 127.0.0.1\r\n"
+                        "Connection: keep-alive\r\n\r\n";
+
+  // one shard on one thread, so the rusage of that thread is the server
+  http::server::server_options options;
+  options.thread_count = 1;
+  options.mode = http::server::execution_mode::thread_per_core;
+  options.enable_ssl = false;
+  http::server::server s("127.0.0.1", port, STATIC_PATH, options);
+  double user_us = 0;
+  double system_us = 0;
+  long context_switches = 0;
+  std::thread server_thread([&]() {
+    syscall_counter::counting = true;
+    s.run();
+    syscall_counter::counting = false;
+#if defined(__linux__)
+    rusage usage{};
+    getrusage(RUSAGE_THREAD, &usage);
+    user_us = usage.ru_utime.tv_sec * 1e6 + usage.ru_utime.tv_usec;
+    system_us = usage.ru_stime.tv_sec * 1e6 + usage.ru_stime.tv_usec;
+    context_switches = usage.ru_nvcsw + usage.ru_nivcsw;
+#endif
+  });
+
+  bench::load_client client("127.0.0.1", std::string(port), request,
+                            connections, 1);
+  auto result = client.run(std::chrono::seconds(seconds));
+  s.stop();
+  server_thread.join();
+
+  double requests =
+      static_cast<double>(std::max<std::uint64_t>(result.requests, 1));
+  fmt::print("{:>10} {:>12} {:>9} {:>9} {:>12} {:>12} {:>10} {:>13}\n",
+             "backend", "requests/s", "p50(us)", "p99(us)", "user(us)/req",
+             "sys(us)/req", "csw/req", "syscalls/req");
+  fmt::print(
+      "{:>10} {:>12.0f} {:>9} {:>9} {:>12.2f} {:>12.2f} {:>10.3f} {:>13.3f}\n",
+      backend, result.requests_per_second(), result.percentile(0.5),
+      result.percentile(0.99), user_us / requests, system_us / requests,
+      context_switches / requests,
+      static_cast<double>(syscall_counter::calls.load()) / requests);
+  return 0;
+}
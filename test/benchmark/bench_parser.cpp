@@ -0,0 +1,157 @@
+#include "../alloc_counter.hpp"
+#include "char_scan.hpp"
+#include "legacy_request_parser.hpp"
+#include "request.hpp"
+#include "request_parser.hpp"
+#ifdef MY_SERVER_LLHTTP
+#include "llhttp_parser.hpp"
+#endif
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <spdlog/fmt/fmt.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// request header parsing rate and heap allocations per request on the
+// data/test_header*.txt and data/test_post*.txt captures, for the byte at a
+// time parser the char_scan runs replaced, for request_parser on every
+// instruction set the cpu has and, when built with MY_SERVER_LLHTTP, for
+// llhttp_parser
+//
+// usage: bench_parser [milliseconds per run]
+
+using alloc_counter::allocations;
+using namespace http::server;
+namespace fs = std::filesystem;
+
+struct corpus {
+  std::string name;
+  std::string data;
+};
+
+static std::vector<corpus> load_corpora() {
+  fs::path data_path = fs::u8path(DATA_PATH);
+  std::vector<corpus> corpora;
+  for (auto name : {"test_header1.txt", "test_header2.txt", "test_header3.txt",
+                    "test_header4.txt", "test_post1.txt", "test_post2.txt",
+                    "test_post3.txt"}) {
+    std::ifstream in(data_path / name, std::ios::in | std::ios::binary);
+    std::string data{std::istreambuf_iterator<char>(in),
+                     std::istreambuf_iterator<char>()};
+    if (data.find("\r\n\r\n") == std::string::npos) {
+      // the header captures stop after the last field line
+      data += "\r\n\r\n";
+    }
+    corpora.push_back({name, std::move(data)});
+  }
+  return corpora;
+}
+
+/// Parse `data` over and over for about `millis`, print GB/s of header bytes
+/// and allocations per request.
+template <typename Parser, typename Request>
+static void run(std::string_view data, int millis) {
+  using clock = std::chrono::steady_clock;
+  Parser parser;
+  Request req;
+  std::size_t bytes = 0;
+  std::size_t requests = 0;
+  std::uint64_t allocations_before = allocations;
+  auto start = clock::now();
+  auto end = start + std::chrono::milliseconds(millis);
+  clock::time_point now;
+  do {
+    for (int i = 0; i < 64; i++) {
+      auto [result, pos] = parser.parse(req, data);
+      if (result != Parser::PASS) {
+        fmt::print(stderr, "parse failed\n");
+        std::exit(EXIT_FAILURE);
+      }
+      bytes += pos + 1;
+      parser.clear();
+      req.clear();
+    }
+    requests += 64;
+  } while ((now = clock::now()) < end);
+  fmt::print(" {:>8.3f} {:>5.1f}",
+             bytes / std::chrono::duration<double, std::nano>(now - start).count(),
+             static_cast<double>(allocations - allocations_before) / requests);
+}
+
+/// The header fields request_parser finds, to compare against the baseline.
+template <typename Parser, typename Request>
+static Request parse_once(std::string_view data) {
+  Parser parser;
+  Request req;
+  parser.parse(req, data);
+  return req;
+}
+
+/// The header fields as the baseline keeps them. It squeezed runs of OWS
+/// inside a field value into one blank, request_parser keeps the value as sent.
+static std::unordered_map<std::string, std::string>
+squeezed(const request &req) {
+  std::unordered_map<std::string, std::string> out;
+  for (const auto &[name, value, id] : req.headers) {
+    std::string &v = out[std::string(name)];
+    for (char ch : value) {
+      if (!(ch == ' ' || ch == '\t') || v.empty() ||
+          !(v.back() == ' ' || v.back() == '\t')) {
+        v.push_back(ch);
+      }
+    }
+  }
+  return out;
+}
+
+int main(int argc, char *argv[]) {
+  alloc_counter::counting = true;
+  int millis = 300;
+  if (argc > 1) {
+    millis = std::atoi(argv[1]);
+  }
+  using char_scan::isa;
+  auto corpora = load_corpora();
+
+  fmt::print("{:>18} {:>8} {:>14}", "corpus", "bytes", "legacy");
+  std::vector<isa> sets;
+  for (isa set : {isa::scalar, isa::sse42, isa::avx2}) {
+    if (char_scan::use(set)) {
+      sets.push_back(set);
+      fmt::print(" {:>14}", char_scan::name(set));
+    }
+  }
+#ifdef MY_SERVER_LLHTTP
+  fmt::print(" {:>14}", "llhttp");
+#endif
+  fmt::print("   (GB/s, allocations per request)\n");
+
+  for (const auto &[name, data] : corpora) {
+    auto expected = parse_once<legacy_request_parser, legacy_request>(data);
+    auto parsed = parse_once<request_parser, request>(data);
+    if (parsed.method != expected.method ||
+        parsed.request_target != expected.request_target ||
+        squeezed(parsed) != expected.headers) {
+      fmt::print(stderr, "{}: request_parser disagrees with the baseline\n",
+                 name);
+      return EXIT_FAILURE;
+    }
+    std::size_t header_size = data.find("\r\n\r\n") + 4;
+    fmt::print("{:>18} {:>8}", name, header_size);
+    run<legacy_request_parser, legacy_request>(data, millis);
+    for (isa set : sets) {
+      char_scan::use(set);
+      run<request_parser, request>(data, millis);
+    }
+#ifdef MY_SERVER_LLHTTP
+    run<llhttp_parser, request>(data, millis);
+#endif
+    fmt::print("\n");
+  }
+  return 0;
+}
@@ -0,0 +1,51 @@
+#include "load_client.hpp"
+#include "server.hpp"
+
+#include <cstdlib>
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/spdlog.h>
+#include <thread>
+
+// keep-alive throughput with HTTP/1.1 pipelining, every connection writes
+// `depth` requests at once and then reads their responses
+//
+// usage: bench_pipeline [connections] [seconds]
+
+int main(int argc, char *argv[]) {
+  std::size_t connections = 16;
+  int seconds = 3;
+  if (argc > 1) {
+    connections = std::strtoul(argv[1], nullptr, 10);
+  }
+  if (argc > 2) {
+    seconds = std::atoi(argv[2]);
+  }
+  spdlog::set_level(spdlog::level::off);
+
+  static constexpr std::string_view port = "18087";
+  std::string request = "GET /index.html HTTP/1.1\r\n"
+                        "Host: 127.0.0.1\r\n"
+                        "Connection: keep-alive\r\n\r\n";
+
+  http::server::server_options options;
+  options.thread_count = 1;
+  options.mode = http::server::execution_mode::thread_per_core;
+  options.enable_ssl = false;
+  http::server::server s("127.0.0.1", port, STATIC_PATH, options);
+  std::thread server_thread([&s]() { s.run(); });
+
+  fmt::print("{:>6} {:>12} {:>12} {:>10} {:>10} {:>8}\n", "depth", "requests",
+             "requests/s", "p50(us)", "p99(us)", "errors");
+  for (std::size_t depth : {1, 8, 32}) {
+    bench::load_client client("127.0.0.1", std::string(port), request,
+                              connections, 1);
+    client.pipeline(depth);
+    auto result = client.run(std::chrono::seconds(seconds));
+    fmt::print("{:>6} {:>12} {:>12.0f} {:>10} {:>10} {:>8}\n", depth,
+               result.requests, result.requests_per_second(),
+               result.percentile(0.5), result.percentile(0.99), result.errors);
+  }
+  s.stop();
+  server_thread.join();
+  return 0;
+}
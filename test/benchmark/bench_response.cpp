@@ -0,0 +1,210 @@
+#include "../alloc_counter.hpp"
+#include "response.hpp"
+#include "send_queue.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <spdlog/fmt/fmt.h>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// filling in the header fields of a response and serialising it into the send
+// buffers, nothing is written: a string per field, the status line lookup in
+// an std::unordered_map, std::to_string for Content-Length and four buffers
+// per field of before against the fields rendered into one block as they are
+// set, for a stock error page, a static file and a response with a dozen
+// fields
+//
+// usage: bench_response [iterations]
+
+using alloc_counter::allocations;
+using http::server::header_id;
+using http::server::header_name;
+using http::server::response;
+using http::server::send_queue;
+
+/// The response of before: a string per field value, reused request after
+/// request, a status line lookup in an std::unordered_map, std::to_string for
+/// Content-Length and four buffers per field.
+struct legacy_response {
+  struct field {
+    std::string name;
+    std::string value;
+  };
+
+  response::status_type status{response::ok};
+  std::vector<field> fields;
+  std::size_t count{};
+  std::string content;
+  std::string content_length;
+
+  void set(header_id, std::string_view name, std::string_view value) {
+    set(name, value);
+  }
+
+  void set(std::string_view name, std::string_view value) {
+    for (std::size_t i = 0; i < count; i++) {
+      if (fields[i].name == name) {
+        fields[i].value.assign(value);
+        return;
+      }
+    }
+    if (count == fields.size()) {
+      fields.emplace_back();
+    }
+    fields[count].name.assign(name);
+    fields[count].value.assign(value);
+    count++;
+  }
+
+  static std::string_view status_line(response::status_type status) {
+    static std::unordered_map<response::status_type, std::string_view>
+        mappings{
+            {response::ok, "HTTP/1.1 200 OK\r\n"},
+            {response::not_found, "HTTP/1.1 404 Not Found\r\n"},
+            {response::internal_server_error,
+             "HTTP/1.1 500 Internal Server Error\r\n"},
+        };
+    if (mappings.find(status) == mappings.end()) {
+      return mappings[response::internal_server_error];
+    }
+    return mappings[status];
+  }
+
+  void update(bool keep_alive) {
+    set(header_name(header_id::content_length),
+        std::to_string(content.size()));
+    set(header_name(header_id::connection),
+        keep_alive ? "keep-alive" : "close");
+  }
+
+  void to_buffers(send_queue &queue) const {
+    static std::string_view COLON_SP = ": ";
+    static std::string_view CRLF = "\r\n";
+    queue.push_back(asio::buffer(status_line(status)));
+    for (std::size_t i = 0; i < count; i++) {
+      queue.push_back(asio::buffer(fields[i].name));
+      queue.push_back(asio::buffer(COLON_SP));
+      queue.push_back(asio::buffer(fields[i].value));
+      queue.push_back(asio::buffer(CRLF));
+    }
+    queue.push_back(asio::buffer(CRLF));
+    queue.push_back(asio::buffer(content));
+  }
+};
+
+struct field {
+  std::string_view name;
+  std::string_view value;
+  header_id id{http::server::lookup_header(name)};
+};
+
+/// A response as a handler fills it in.
+struct sample {
+  std::string_view name;
+  response::status_type status;
+  std::string content;
+  std::vector<field> fields;
+};
+
+/// Fill in `rep` for `s` and serialise it `iterations` times, print ns and
+/// allocations per response.
+template <typename Response>
+static void run(std::string_view name, const sample &s, std::size_t iterations,
+                Response &rep) {
+  send_queue queue;
+  rep.content = s.content;
+  auto serialize = [&](bool keep_alive) {
+    if constexpr (std::is_same_v<Response, legacy_response>) {
+      rep.count = 0;
+    } else {
+      rep.headers.clear();
+    }
+    rep.status = s.status;
+    for (const field &f : s.fields) {
+      rep.set(f.id, f.name, f.value);
+    }
+    rep.update(keep_alive);
+    rep.to_buffers(queue);
+  };
+  // warm up, the strings of the response reach their size
+  serialize(true);
+  std::size_t buffers = queue.size();
+  std::size_t bytes = asio::buffer_size(queue.batch());
+  queue.clear();
+  std::uint64_t allocations_before = allocations;
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < iterations; i++) {
+    serialize((i & 7) != 0);
+    asm volatile("" : : "r"(queue.batch().data()) : "memory");
+    queue.clear();
+  }
+  double ns = std::chrono::duration<double, std::nano>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+  fmt::print("{:>12} {:>8} {:>12.1f} {:>14.0f} {:>12.2f} {:>8} {:>8}\n",
+             s.name, name, ns / iterations, iterations * 1e9 / ns,
+             static_cast<double>(allocations - allocations_before) /
+                 iterations,
+             buffers, bytes);
+}
+
+/// response::headers behind the interface of legacy_response, the well
+/// known fields are set by id like the handlers do.
+struct block_response : response {
+  void set(header_id id, std::string_view name, std::string_view value) {
+    if (id != header_id::unknown) {
+      headers.set(id, value);
+    } else {
+      headers.set(name, value);
+    }
+  }
+};
+
+int main(int argc, char *argv[]) {
+  alloc_counter::counting = true;
+  std::size_t iterations = 2000000;
+  if (argc > 1) {
+    iterations = std::strtoul(argv[1], nullptr, 10);
+  }
+
+  std::vector<sample> samples = {
+      {"error page",
+       response::not_found,
+       "<html><head><title>Not Found</title></head>"
+       "<body><h1>404 Not Found</h1></body></html>",
+       {{"Content-Type", "text/html"}}},
+      {"static file",
+       response::ok,
+       std::string(4286, 'x'),
+       {{"Content-Type", "text/html"},
+        {"Last-Modified", "Tue, 15 Nov 1994 08:12:31 GMT"},
+        {"ETag", "\"5e8f-10be\""}}},
+      {"api",
+       response::ok,
+       std::string(512, 'j'),
+       {{"Content-Type", "application/json; charset=utf-8"},
+        {"Cache-Control", "no-store, no-cache, must-revalidate"},
+        {"Vary", "Accept-Encoding"},
+        {"Server", "TinyHttpServer"},
+        {"X-Request-Id", "4f1c2d0e-9b7a-4c55"},
+        {"X-Frame-Options", "DENY"},
+        {"X-Content-Type-Options", "nosniff"},
+        {"Strict-Transport-Security", "max-age=63072000; includeSubDomains"},
+        {"Access-Control-Allow-Origin", "*"},
+        {"Referrer-Policy", "no-referrer"}}},
+  };
+
+  fmt::print("{:>12} {:>8} {:>12} {:>14} {:>12} {:>8} {:>8}\n", "response",
+             "head", "ns/response", "responses/s", "allocs/resp", "buffers",
+             "bytes");
+  for (const sample &s : samples) {
+    legacy_response legacy;
+    run("strings", s, iterations, legacy);
+    block_response block;
+    run("block", s, iterations, block);
+  }
+  return 0;
+}
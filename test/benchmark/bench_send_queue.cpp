@@ -0,0 +1,131 @@
+#include "../alloc_counter.hpp"
+#include "response.hpp"
+#include "send_queue.hpp"
+
+#include <array>
+#include <asio.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <list>
+#include <spdlog/fmt/fmt.h>
+#include <sys/uio.h>
+
+// serialising a typical response into the send buffers and the bookkeeping of
+// its send completions, for the contiguous send_queue and for the
+// std::list<asio::const_buffer> it replaced, writes complete `write_size`
+// bytes at a time so partially written buffers are exercised too
+//
+// usage: bench_send_queue [iterations] [write_size]
+
+using alloc_counter::allocations;
+using http::server::header_id;
+using http::server::response;
+using http::server::send_queue;
+
+/// The serialisation of response::to_buffers() before the send_queue.
+static void to_list(const response &rep,
+                    std::list<asio::const_buffer> &buffers) {
+  static std::string_view STATUS = "HTTP/1.1 200 OK\r\n";
+  static std::string_view COLON_SP = ": ";
+  static std::string_view CRLF = "\r\n";
+  buffers.emplace_back(asio::buffer(STATUS));
+  for (const auto &field : rep.headers) {
+    buffers.emplace_back(asio::buffer(field.name));
+    buffers.emplace_back(asio::buffer(COLON_SP));
+    buffers.emplace_back(asio::buffer(field.value));
+    buffers.emplace_back(asio::buffer(CRLF));
+  }
+  buffers.emplace_back(asio::buffer(CRLF));
+  buffers.emplace_back(asio::buffer(rep.content));
+}
+
+static void consume_list(std::list<asio::const_buffer> &buffers,
+                         std::size_t bytes_transferred) {
+  while (!buffers.empty() && buffers.front().size() <= bytes_transferred) {
+    bytes_transferred -= buffers.front().size();
+    buffers.pop_front();
+  }
+  if (!buffers.empty()) {
+    buffers.front() += bytes_transferred;
+  }
+}
+
+/// What write_some() does with the buffer sequence, copy up to 64 buffers into
+/// an iovec array.
+template <typename Iterator> static void gather(Iterator begin, Iterator end) {
+  static std::array<iovec, 64> iov;
+  std::size_t count = 0;
+  for (; begin != end && count < iov.size(); ++begin, ++count) {
+    iov[count].iov_base = const_cast<void *>(begin->data());
+    iov[count].iov_len = begin->size();
+  }
+  asm volatile("" : : "r"(iov.data()), "r"(count) : "memory");
+}
+
+template <typename Serialize>
+static void run(std::string_view name, std::size_t iterations,
+                Serialize &&serialize) {
+  std::uint64_t allocations_before = allocations;
+  auto start = std::chrono::steady_clock::now();
+  std::size_t bytes = 0;
+  for (std::size_t i = 0; i < iterations; i++) {
+    bytes += serialize();
+  }
+  double ns = std::chrono::duration<double, std::nano>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+  fmt::print("{:>12} {:>14.1f} {:>14.2f} {:>12}\n", name, ns / iterations,
+             static_cast<double>(allocations - allocations_before) /
+                 iterations,
+             bytes / iterations);
+}
+
+int main(int argc, char *argv[]) {
+  alloc_counter::counting = true;
+  std::size_t iterations = 1000000;
+  std::size_t write_size = 256;
+  if (argc > 1) {
+    iterations = std::strtoul(argv[1], nullptr, 10);
+  }
+  if (argc > 2) {
+    write_size = std::max<std::size_t>(std::strtoul(argv[2], nullptr, 10), 1);
+  }
+
+  response rep;
+  response::build_default_response(rep, response::ok);
+  rep.headers.set(header_id::cache_control, "no-cache");
+  rep.headers.set(header_id::server, "TinyHttpServer");
+  // update() writes these behind the fields, to_list() sends them as fields
+  response listed;
+  listed.headers = rep.headers;
+  listed.content = rep.content;
+  listed.headers.set(header_id::content_length,
+                     std::to_string(rep.content.size()));
+  listed.headers.set(header_id::connection, "keep-alive");
+  rep.update(true);
+
+  fmt::print("{:>12} {:>14} {:>14} {:>12}\n", "buffers", "ns/response",
+             "allocs/resp", "bytes");
+  std::list<asio::const_buffer> list;
+  run("std::list", iterations, [&]() {
+    to_list(listed, list);
+    std::size_t total = asio::buffer_size(list);
+    for (std::size_t sent = 0; sent < total; sent += write_size) {
+      gather(list.begin(), list.end());
+      consume_list(list, std::min(write_size, total - sent));
+    }
+    return total;
+  });
+  send_queue queue;
+  run("send_queue", iterations, [&]() {
+    rep.to_buffers(queue);
+    std::size_t total = asio::buffer_size(queue.batch());
+    for (std::size_t sent = 0; sent < total; sent += write_size) {
+      auto batch = queue.batch();
+      gather(batch.begin(), batch.end());
+      queue.consume(std::min(write_size, total - sent));
+    }
+    return total;
+  });
+  return 0;
+}
@@ -0,0 +1,240 @@
+#include "server.hpp"
+
+#include <algorithm>
+#include <asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__)
+#include <unistd.h>
+#endif
+
+// static files of 1 MB, 100 MB and 4 GB downloaded over and over by many
+// concurrent clients on keep-alive connections. The server of before, which
+// read the whole file through an std::ifstream in 512 byte pieces into the
+// content of the response, against the file body sent with sendfile(2).
+// Reports the throughput and the resident set of the process sampled while
+// the clients run, the server of before is skipped where the files of all
+// clients do not fit in memory
+//
+// usage: bench_static_file [clients] [seconds]
+
+namespace fs = std::filesystem;
+
+static std::size_t resident_bytes() {
+  std::size_t pages = 0;
+  std::size_t resident = 0;
+  std::ifstream statm("/proc/self/statm");
+  statm >> pages >> resident;
+#if defined(__unix__)
+  return resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+#else
+  return resident * 4096;
+#endif
+}
+
+/// The static file path of before on one thread: the file read into a string
+/// per request, the head and the string in one gathered write.
+class legacy_server {
+public:
+  legacy_server(unsigned short port, fs::path doc_root)
+      : m_acceptor(m_context, {asio::ip::make_address("127.0.0.1"), port}),
+        m_doc_root(std::move(doc_root)) {
+    asio::co_spawn(m_context, accept(), asio::detached);
+  }
+
+  void run() { m_context.run(); }
+
+  void stop() {
+    asio::post(m_context, [this]() { m_context.stop(); });
+  }
+
+private:
+  asio::awaitable<void> accept() {
+    for (;;) {
+      asio::ip::tcp::socket socket =
+          co_await m_acceptor.async_accept(asio::use_awaitable);
+      asio::co_spawn(m_context, serve(std::move(socket)), asio::detached);
+    }
+  }
+
+  asio::awaitable<void> serve(asio::ip::tcp::socket socket) {
+    std::string input;
+    asio::error_code err;
+    while (!err) {
+      std::size_t end = co_await asio::async_read_until(
+          socket, asio::dynamic_buffer(input), "\r\n\r\n",
+          asio::redirect_error(asio::use_awaitable, err));
+      if (err) {
+        break;
+      }
+      std::size_t path_begin = input.find(' ') + 2;
+      std::string path =
+          input.substr(path_begin, input.find(' ', path_begin) - path_begin);
+      input.erase(0, end);
+      std::ifstream is(m_doc_root / path, std::ios::in | std::ios::binary);
+      std::string content;
+      std::array<char, 512> buf;
+      while (!is.eof()) {
+        is.read(buf.data(), buf.size());
+        content.append(buf.data(), is.gcount());
+      }
+      std::string head = "HTTP/1.1 200 OK\r\nContent-Length: " +
+                         std::to_string(content.size()) +
+                         "\r\nConnection: keep-alive\r\n\r\n";
+      std::array<asio::const_buffer, 2> buffers = {asio::buffer(head),
+                                                   asio::buffer(content)};
+      co_await asio::async_write(
+          socket, buffers, asio::redirect_error(asio::use_awaitable, err));
+    }
+  }
+
+  asio::io_context m_context;
+  asio::ip::tcp::acceptor m_acceptor;
+  fs::path m_doc_root;
+};
+
+struct download_result {
+  std::uint64_t bytes{};
+  std::uint64_t files{};
+  std::size_t rss_start{};
+  std::size_t rss_peak{};
+};
+
+/// One client: download `name` again and again on one connection until
+/// `running` drops, the body is dropped as it arrives.
+static void run_client(unsigned short port, const std::string &name,
+                       std::uint64_t size, std::atomic<bool> &running,
+                       download_result &result, std::mutex &mutex) {
+  asio::io_context context;
+  asio::ip::tcp::socket socket(context);
+  asio::error_code err;
+  socket.connect({asio::ip::make_address("127.0.0.1"), port}, err);
+  std::string request = "GET /" + name +
+                        " HTTP/1.1\r\nHost: 127.0.0.1\r\n"
+                        "Connection: keep-alive\r\n\r\n";
+  std::vector<char> buffer(256 * 1024);
+  std::uint64_t bytes = 0;
+  std::uint64_t files = 0;
+  while (!err && running) {
+    asio::write(socket, asio::buffer(request), err);
+    // the head, then the body
+    std::string head;
+    asio::read_until(socket, asio::dynamic_buffer(head), "\r\n\r\n", err);
+    std::size_t early = head.size() - (head.find("\r\n\r\n") + 4);
+    std::uint64_t remaining = size - early;
+    bytes += early;
+    while (!err && running && remaining > 0) {
+      auto want = static_cast<std::size_t>(
+          std::min<std::uint64_t>(buffer.size(), remaining));
+      std::size_t n = socket.read_some(asio::buffer(buffer.data(), want), err);
+      bytes += n;
+      remaining -= n;
+    }
+    files += remaining == 0;
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  result.bytes += bytes;
+  result.files += files;
+}
+
+template <typename Server>
+static download_result run_downloads(Server &s, unsigned short port,
+                                     const std::string &name,
+                                     std::uint64_t size, std::size_t clients,
+                                     int seconds) {
+  std::thread server_thread([&s]() { s.run(); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  download_result result;
+  std::mutex mutex;
+  std::atomic<bool> running{true};
+  result.rss_start = resident_bytes();
+  std::vector<std::thread> threads;
+  for (std::size_t i = 0; i < clients; i++) {
+    threads.emplace_back(run_client, port, std::cref(name), size,
+                         std::ref(running), std::ref(result), std::ref(mutex));
+  }
+  auto end = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+  while (std::chrono::steady_clock::now() < end) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    result.rss_peak = std::max(result.rss_peak, resident_bytes());
+  }
+  // the clients stop after their next read, the server still serves them
+  running = false;
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  s.stop();
+  server_thread.join();
+  return result;
+}
+
+int main(int argc, char *argv[]) {
+  std::size_t clients = 8;
+  int seconds = 3;
+  if (argc > 1) {
+    clients = std::strtoul(argv[1], nullptr, 10);
+  }
+  if (argc > 2) {
+    seconds = std::atoi(argv[2]);
+  }
+  spdlog::set_level(spdlog::level::off);
+
+  // sparse files, the page cache holds their zeros
+  fs::path doc_root = fs::temp_directory_path() / "bench_static_file";
+  fs::create_directories(doc_root);
+  struct file {
+    std::string name;
+    std::uint64_t size;
+  };
+  std::vector<file> files = {{"1m.bin", 1ull << 20},
+                             {"100m.bin", 100ull << 20},
+                             {"4g.bin", 4ull << 30}};
+  for (const file &f : files) {
+    std::ofstream(doc_root / f.name).close();
+    fs::resize_file(doc_root / f.name, f.size);
+  }
+  // the server of before holds a copy per client, leave room for the rest
+  std::uint64_t legacy_limit = 2ull << 30;
+
+  fmt::print("{:>10} {:>10} {:>12} {:>10} {:>10} {:>10}\n", "file", "server",
+             "MB/s", "files/s", "rss(MB)", "peak(MB)");
+  unsigned short port = 18099;
+  for (const file &f : files) {
+    for (bool zero_copy : {false, true}) {
+      download_result result;
+      if (zero_copy) {
+        http::server::server_options options;
+        options.thread_count = 1;
+        options.mode = http::server::execution_mode::thread_per_core;
+        options.enable_ssl = false;
+        http::server::server s("127.0.0.1", std::to_string(port), doc_root,
+                               options);
+        result = run_downloads(s, port, f.name, f.size, clients, seconds);
+      } else if (f.size * clients <= legacy_limit) {
+        legacy_server s(port, doc_root);
+        result = run_downloads(s, port, f.name, f.size, clients, seconds);
+      } else {
+        fmt::print("{:>10} {:>10} {:>12}\n", f.name, "ifstream", "skipped");
+        continue;
+      }
+      port++;
+      fmt::print("{:>10} {:>10} {:>12.0f} {:>10.1f} {:>10.1f} {:>10.1f}\n",
+                 f.name, zero_copy ? "sendfile" : "ifstream",
+                 result.bytes / 1048576.0 / seconds,
+                 static_cast<double>(result.files) / seconds,
+                 result.rss_start / 1048576.0, result.rss_peak / 1048576.0);
+    }
+  }
+  fs::remove_all(doc_root);
+  return 0;
+}
@@ -0,0 +1,231 @@
+#include "body_source.hpp"
+#include "response.hpp"
+#include "server.hpp"
+
+#include <algorithm>
+#include <array>
+#include <asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__)
+#include <unistd.h>
+#endif
+
+// a generated body of 1 MB and 64 MB, rows of csv rendered one by one, fetched
+// by concurrent clients. The body built into the content of the response
+// before anything is sent, against the same rows pulled from a body_source
+// and sent as chunks while they are rendered. Reports the time to the first
+// byte of the response, the time to the whole body, the throughput and how
+// much the resident set of the process grew while the clients ran
+//
+// usage: bench_stream_body [clients] [rounds]
+
+using namespace http::server;
+using clock_type = std::chrono::steady_clock;
+
+static std::size_t resident_bytes() {
+  std::size_t pages = 0;
+  std::size_t resident = 0;
+  std::ifstream statm("/proc/self/statm");
+  statm >> pages >> resident;
+#if defined(__unix__)
+  return resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+#else
+  return resident * 4096;
+#endif
+}
+
+/// Render row `i` into `out`, returns its length.
+static std::size_t render_row(std::size_t i, char *out) {
+  return fmt::format_to(out, "{},row-{},{}\n", i, i * 2654435761u % 100000,
+                        i * 7 % 1000) -
+         out;
+}
+
+// a row is at most this long
+static constexpr std::size_t MAX_ROW = 64;
+
+/// The rows rendered into the content, the whole body in memory at once.
+static void buffered_rows(std::size_t rows, response &rep) {
+  std::array<char, MAX_ROW> row;
+  for (std::size_t i = 0; i < rows; i++) {
+    rep.content.append(row.data(), render_row(i, row.data()));
+  }
+}
+
+/// The rows pulled piece by piece, as many whole rows as fit a piece.
+static std::unique_ptr<body_source> streamed_rows(std::size_t rows) {
+  return std::make_unique<callback_source>(
+      [rows, i = std::size_t{0}](std::span<char> out,
+                                 asio::error_code &) mutable {
+        std::size_t size = 0;
+        while (i < rows && out.size() - size >= MAX_ROW) {
+          size += render_row(i++, out.data() + size);
+        }
+        return size;
+      });
+}
+
+struct fetch_result {
+  // microseconds per request
+  std::vector<std::uint32_t> first_byte;
+  std::vector<std::uint32_t> whole_body;
+  std::uint64_t bytes{};
+  std::size_t rss_start{};
+  std::size_t rss_peak{};
+};
+
+static std::uint32_t percentile(std::vector<std::uint32_t> values, double p) {
+  if (values.empty()) {
+    return 0;
+  }
+  std::sort(values.begin(), values.end());
+  return values[std::min(values.size() - 1,
+                         static_cast<std::size_t>(p * values.size()))];
+}
+
+/// One client: fetch `path` `rounds` times, one connection per request, the
+/// body is dropped as it arrives.
+static void run_client(unsigned short port, const std::string &path,
+                       int rounds, fetch_result &result, std::mutex &mutex) {
+  asio::io_context context;
+  std::vector<char> buffer(256 * 1024);
+  std::string request = "GET " + path +
+                        " HTTP/1.1\r\nHost: 127.0.0.1\r\n"
+                        "Connection: close\r\n\r\n";
+  std::vector<std::uint32_t> first_byte;
+  std::vector<std::uint32_t> whole_body;
+  std::uint64_t bytes = 0;
+  for (int round = 0; round < rounds; round++) {
+    asio::ip::tcp::socket socket(context);
+    asio::error_code err;
+    socket.connect({asio::ip::make_address("127.0.0.1"), port}, err);
+    auto start = clock_type::now();
+    asio::write(socket, asio::buffer(request), err);
+    // the head arrives with the first piece of the body
+    bool first = true;
+    while (!err) {
+      std::size_t n = socket.read_some(asio::buffer(buffer), err);
+      if (first && n > 0) {
+        first = false;
+        first_byte.push_back(static_cast<std::uint32_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                clock_type::now() - start)
+                .count()));
+      }
+      bytes += n;
+    }
+    whole_body.push_back(static_cast<std::uint32_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            clock_type::now() - start)
+            .count()));
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  result.first_byte.insert(result.first_byte.end(), first_byte.begin(),
+                           first_byte.end());
+  result.whole_body.insert(result.whole_body.end(), whole_body.begin(),
+                           whole_body.end());
+  result.bytes += bytes;
+}
+
+static fetch_result run_fetches(unsigned short port, const std::string &path,
+                                std::size_t clients, int rounds) {
+  fetch_result result;
+  std::mutex mutex;
+  result.rss_start = result.rss_peak = resident_bytes();
+  std::atomic<bool> running{true};
+  std::thread sampler([&]() {
+    while (running) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      std::size_t rss = resident_bytes();
+      std::lock_guard<std::mutex> lock(mutex);
+      result.rss_peak = std::max(result.rss_peak, rss);
+    }
+  });
+  std::vector<std::thread> threads;
+  for (std::size_t i = 0; i < clients; i++) {
+    threads.emplace_back(run_client, port, std::cref(path), rounds,
+                         std::ref(result), std::ref(mutex));
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  running = false;
+  sampler.join();
+  return result;
+}
+
+int main(int argc, char *argv[]) {
+  std::size_t clients = 8;
+  int rounds = 10;
+  if (argc > 1) {
+    clients = std::strtoul(argv[1], nullptr, 10);
+  }
+  if (argc > 2) {
+    rounds = std::atoi(argv[2]);
+  }
+  spdlog::set_level(spdlog::level::off);
+
+  struct body {
+    std::string name;
+    std::size_t rows;
+  };
+  // rows of about 24 bytes
+  std::vector<body> bodies = {{"1m", (1u << 20) / 24},
+                              {"64m", (64u << 20) / 24}};
+  server_options options;
+  options.thread_count = 1;
+  options.enable_ssl = false;
+  for (const body &b : bodies) {
+    std::size_t rows = b.rows;
+    options.routes["/buffered/" + b.name] = [rows](const request &,
+                                                   response &rep) {
+      rep.headers.set(header_id::content_type, "text/csv");
+      buffered_rows(rows, rep);
+    };
+    options.routes["/streamed/" + b.name] = [rows](const request &,
+                                                   response &rep) {
+      rep.headers.set(header_id::content_type, "text/csv");
+      rep.source = streamed_rows(rows);
+    };
+  }
+  // no static files are asked for
+  server s("127.0.0.1", "18113", std::filesystem::temp_directory_path(),
+           options);
+  std::thread server_thread([&s]() { s.run(); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  fmt::print("{} clients, {} requests each\n", clients, rounds);
+  fmt::print("{:>6} {:>10} {:>14} {:>14} {:>14} {:>10} {:>10}\n", "body",
+             "mode", "first p50(us)", "first p99(us)", "whole p50(us)",
+             "MB/s", "rss+(MB)");
+  for (const body &b : bodies) {
+    for (std::string mode : {"buffered", "streamed"}) {
+      auto start = clock_type::now();
+      fetch_result result =
+          run_fetches(18113, "/" + mode + "/" + b.name, clients, rounds);
+      double seconds =
+          std::chrono::duration<double>(clock_type::now() - start).count();
+      fmt::print("{:>6} {:>10} {:>14} {:>14} {:>14} {:>10.1f} {:>10.1f}\n",
+                 b.name, mode, percentile(result.first_byte, 0.5),
+                 percentile(result.first_byte, 0.99),
+                 percentile(result.whole_body, 0.5),
+                 result.bytes / seconds / 1048576.0,
+                 (result.rss_peak - result.rss_start) / 1048576.0);
+    }
+  }
+  s.stop();
+  server_thread.join();
+  return 0;
+}
@@ -0,0 +1,105 @@
+#include "load_client.hpp"
+#include "self_signed.hpp"
+#include "server.hpp"
+
+#include <cstdlib>
+#include <filesystem>
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/spdlog.h>
+#include <thread>
+
+#if defined(__linux__)
+#include <sys/resource.h>
+#endif
+
+// cpu time the server thread spends per keep-alive request for every stream
+// type of basic_connection: tcp, unix domain socket and TLS over tcp
+//
+// usage: bench_stream_cpu [connections] [seconds]
+
+namespace fs = std::filesystem;
+
+struct stream_cost {
+  bench::load_result result;
+  double cpu_us{};
+};
+
+enum class stream_kind { tcp, unix_socket, ssl };
+
+static stream_cost measure(stream_kind kind, std::size_t connections,
+                           int seconds,
+                           const std::pair<fs::path, fs::path> &cert) {
+  static constexpr std::string_view port = "18084";
+  static const std::string request = "GET /index.html HTTP/1.1\r\n"
+                                     "Host: 127.0.0.1\r\n"
+                                     "Connection: keep-alive\r\n\r\n";
+  fs::path unix_path = fs::temp_directory_path() / "bench_stream_cpu.sock";
+
+  // one shard on one thread, so the rusage of that thread is the server
+  http::server::server_options options;
+  options.thread_count = 1;
+  options.mode = http::server::execution_mode::thread_per_core;
+  options.enable_ssl = kind == stream_kind::ssl;
+  if (kind == stream_kind::unix_socket) {
+    options.unix_socket_path = unix_path;
+  }
+  http::server::server s("127.0.0.1", port, STATIC_PATH, options, cert.first,
+                         cert.second);
+  stream_cost cost;
+  std::thread server_thread([&]() {
+    s.run();
+#if defined(__linux__)
+    rusage usage{};
+    getrusage(RUSAGE_THREAD, &usage);
+    cost.cpu_us = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e6 +
+                  usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+#endif
+  });
+
+  asio::ssl::context client_context(asio::ssl::context::tls_client);
+  bench::load_client client("127.0.0.1", std::string(port), request,
+                            connections, 1);
+  if (kind == stream_kind::ssl) {
+    client.use_ssl(client_context);
+  } else if (kind == stream_kind::unix_socket) {
+    client.use_unix_socket(unix_path.string());
+  }
+  cost.result = client.run(std::chrono::seconds(seconds));
+  s.stop();
+  server_thread.join();
+  return cost;
+}
+
+int main(int argc, char *argv[]) {
+  std::size_t connections = 16;
+  int seconds = 3;
+  if (argc > 1) {
+    connections = std::strtoul(argv[1], nullptr, 10);
+  }
+  if (argc > 2) {
+    seconds = std::atoi(argv[2]);
+  }
+  spdlog::set_level(spdlog::level::off);
+  auto cert = bench::make_self_signed(fs::temp_directory_path());
+
+  fmt::print("{:>8} {:>12} {:>12} {:>14} {:>8}\n", "stream", "requests",
+             "requests/s", "cpu(us)/req", "errors");
+  std::pair<stream_kind, std::string_view> kinds[] = {
+      {stream_kind::tcp, "tcp"},
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+      {stream_kind::unix_socket, "unix"},
+#endif
+      {stream_kind::ssl, "ssl"},
+  };
+  for (auto [kind, name] : kinds) {
+    auto cost = measure(kind, connections, seconds, cert);
+    double requests = static_cast<double>(
+        std::max<std::uint64_t>(cost.result.requests, 1));
+    fmt::print("{:>8} {:>12} {:>12.0f} {:>14.2f} {:>8}\n", name,
+               cost.result.requests, cost.result.requests_per_second(),
+               cost.cpu_us / requests, cost.result.errors);
+  }
+  fs::remove(cert.first);
+  fs::remove(cert.second);
+  return 0;
+}
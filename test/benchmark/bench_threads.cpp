@@ -0,0 +1,74 @@
+#include "load_client.hpp"
+#include "server.hpp"
+
+#include <cstdlib>
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/spdlog.h>
+#include <thread>
+
+// throughput and latency of the shared io_context pool and of the
+// thread-per-core shards against the number of worker threads, the load
+// generator runs in the same process over loopback
+//
+// usage: bench_threads [max_threads] [connections] [seconds] [pool|core|both]
+int main(int argc, char *argv[]) {
+  using http::server::execution_mode;
+  std::size_t max_threads = std::thread::hardware_concurrency();
+  std::size_t connections = 64;
+  int seconds = 3;
+  std::string_view modes = "both";
+  if (argc > 1) {
+    max_threads = std::strtoul(argv[1], nullptr, 10);
+  }
+  if (argc > 2) {
+    connections = std::strtoul(argv[2], nullptr, 10);
+  }
+  if (argc > 3) {
+    seconds = std::atoi(argv[3]);
+  }
+  if (argc > 4) {
+    modes = argv[4];
+  }
+  // disconnects are logged as errors by the server, keep the table readable
+  spdlog::set_level(spdlog::level::off);
+
+  static constexpr std::string_view port = "18081";
+  std::string request = "GET /index.html HTTP/1.1\r\n"
+                        "Host: 127.0.0.1\r\n"
+                        "Connection: keep-alive\r\n\r\n";
+
+  std::vector<execution_mode> selected;
+  if (modes != "core") {
+    selected.push_back(execution_mode::shared_pool);
+  }
+  if (modes != "pool") {
+    selected.push_back(execution_mode::thread_per_core);
+  }
+
+  fmt::print("{:>6} {:>8} {:>12} {:>10} {:>10} {:>10} {:>8}\n", "mode",
+             "threads", "requests/s", "p50(us)", "p99(us)", "p999(us)",
+             "errors");
+  for (auto mode : selected) {
+    for (std::size_t threads = 1; threads <= max_threads; threads *= 2) {
+      http::server::server_options options;
+      options.thread_count = threads;
+      options.mode = mode;
+      options.enable_ssl = false;
+      http::server::server s("127.0.0.1", port, STATIC_PATH, options);
+      std::thread server_thread([&s]() { s.run(); });
+
+      bench::load_client client("127.0.0.1", std::string(port), request,
+                                connections, max_threads);
+      auto result = client.run(std::chrono::seconds(seconds));
+
+      s.stop();
+      server_thread.join();
+      fmt::print("{:>6} {:>8} {:>12.0f} {:>10} {:>10} {:>10} {:>8}\n",
+                 mode == execution_mode::shared_pool ? "pool" : "core",
+                 threads, result.requests_per_second(),
+                 result.percentile(0.5), result.percentile(0.99),
+                 result.percentile(0.999), result.errors);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,78 @@
+#include "load_client.hpp"
+#include "server.hpp"
+
+#include <cstdlib>
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/spdlog.h>
+#include <thread>
+
+#if defined(__unix__)
+#include <sys/resource.h>
+#endif
+
+// large uploads: every connection posts a `size_mb` MiB body over and over,
+// the server streams it into a temporary file, reports the upload rate and the
+// peak resident memory of the process, which stays far below the body size
+//
+// usage: bench_upload [connections] [seconds] [size_mb]
+
+static double peak_rss_mb() {
+#if defined(__unix__)
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss / 1024.0;
+#else
+  return 0;
+#endif
+}
+
+int main(int argc, char *argv[]) {
+  std::size_t connections = 4;
+  int seconds = 3;
+  std::size_t size_mb = 16;
+  if (argc > 1) {
+    connections = std::strtoul(argv[1], nullptr, 10);
+  }
+  if (argc > 2) {
+    seconds = std::atoi(argv[2]);
+  }
+  if (argc > 3) {
+    size_mb = std::strtoul(argv[3], nullptr, 10);
+  }
+  spdlog::set_level(spdlog::level::off);
+
+  static constexpr std::string_view port = "18088";
+  std::size_t body_size = size_mb << 20;
+  std::string request = "POST /upload HTTP/1.1\r\n"
+                        "Host: 127.0.0.1\r\n"
+                        "Connection: keep-alive\r\n"
+                        "Content-Length: " +
+                        std::to_string(body_size) + "\r\n\r\n";
+  request.append(body_size, 'x');
+  double baseline_rss = peak_rss_mb();
+
+  http::server::server_options options;
+  options.thread_count = 1;
+  options.mode = http::server::execution_mode::thread_per_core;
+  options.enable_ssl = false;
+  http::server::server s("127.0.0.1", port, STATIC_PATH, options);
+  std::thread server_thread([&s]() { s.run(); });
+
+  bench::load_client client("127.0.0.1", std::string(port), request,
+                            connections, 1);
+  auto result = client.run(std::chrono::seconds(seconds));
+  s.stop();
+  server_thread.join();
+
+  fmt::print("{:>10} {:>10} {:>10} {:>12} {:>14} {:>8}\n", "body(MiB)",
+             "uploads", "uploads/s", "MiB/s", "peak rss(MiB)", "errors");
+  fmt::print("{:>10} {:>10} {:>10.1f} {:>12.1f} {:>14.1f} {:>8}\n", size_mb,
+             result.requests, result.requests_per_second(),
+             result.requests_per_second() * size_mb, peak_rss_mb(),
+             result.errors);
+  // load_client keeps two more copies of the request
+  fmt::print("peak rss before the run: {:.1f} MiB, the client holds another "
+             "{} MiB\n",
+             baseline_rss, 2 * size_mb);
+  return 0;
+}
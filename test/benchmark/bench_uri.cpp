@@ -0,0 +1,153 @@
+#include "../alloc_counter.hpp"
+#include "request_uri.hpp"
+
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <spdlog/fmt/fmt.h>
+#include <string>
+#include <vector>
+
+// request target handling per target: the byte at a time url_decode() the
+// request_handler had (with the decoded byte it lost put back) and its ".."
+// check, against request_uri splitting, decoding and normalising the path and
+// walking the query pairs. The corpus is the request targets of the data/
+// captures plus typical static asset, api, percent-encoded and dot segment
+// targets.
+//
+// usage: bench_uri [milliseconds per run]
+
+using alloc_counter::allocations;
+using namespace http::server;
+namespace fs = std::filesystem;
+
+/// request_handler::url_decode() as it was, fixed to append the decoded byte.
+static bool url_decode(std::string_view in, std::string &out) {
+  out.clear();
+  out.reserve(in.size());
+  for (std::size_t i = 0; i < in.size(); ++i) {
+    if (in[i] == '%') {
+      if (i + 3 <= in.size()) {
+        auto hex = [](std::uint8_t b) {
+          return std::isdigit(b) ? b - '0' : std::tolower(b) - 'a' + 10;
+        };
+        std::uint8_t b0 = in[i + 1];
+        std::uint8_t b1 = in[i + 2];
+        if (std::isxdigit(b0) && std::isxdigit(b1)) {
+          out += static_cast<char>(hex(b0) << 4 | hex(b1));
+          i += 2;
+        } else {
+          return false;
+        }
+      } else {
+        return false;
+      }
+    } else if (in[i] == '+') {
+      out += ' ';
+    } else {
+      out += in[i];
+    }
+  }
+  return true;
+}
+
+struct corpus {
+  std::string name;
+  std::vector<std::string> targets;
+};
+
+static std::vector<corpus> load_corpora() {
+  fs::path data_path = fs::u8path(DATA_PATH);
+  corpus captures{"captures", {}};
+  for (auto name : {"test_header1.txt", "test_header2.txt", "test_header3.txt",
+                    "test_header4.txt", "test_post1.txt", "test_post2.txt",
+                    "test_post3.txt"}) {
+    std::ifstream in(data_path / name, std::ios::in | std::ios::binary);
+    std::string line;
+    std::getline(in, line);
+    std::size_t begin = line.find(' ') + 1;
+    captures.targets.push_back(
+        line.substr(begin, line.rfind(' ') - begin));
+  }
+  return {
+      {"static",
+       {"/", "/index.html", "/favicon.ico", "/assets/index-888ab6c0.js",
+        "/assets/index-1b2d4c5e.css", "/images/logo@2x.png",
+        "/fonts/inter-var-latin.woff2", "/docs/guide/getting-started.html"}},
+      {"api query",
+       {"/api/v1/users?id=42", "/api/v1/search?q=asio&page=2&per_page=50",
+        "/phoenix/web/v1/isCollect?articleId=84755007",
+        "/track?event=click&target=button&ts=1697000000&session=8f3a9c0d1e2b",
+        "/api/items?sort=-created_at&filter[status]=open&fields=id,title"}},
+      {"encoded",
+       {"/%E4%B8%AD%E6%96%87/%E6%96%87%E4%BB%B6.html",
+        "/files/My%20Document%20(final).pdf",
+        "/wiki/C%2B%2B_Standard_Library", "/photos/caf%C3%A9%20au%20lait.jpg",
+        "/search/results%2Fpage%3D2"}},
+      {"dot segments",
+       {"/a/./b/../c/index.html", "/static/../static/./app.js",
+        "/docs/guide/../api/./index.html", "/assets/%2e/img/../logo.png"}},
+      captures,
+  };
+}
+
+/// Handle every target of `targets` for about `millis`, print ns and
+/// allocations per target.
+template <typename Work>
+static void run(const std::vector<std::string> &targets, int millis,
+                Work work) {
+  using clock = std::chrono::steady_clock;
+  std::size_t count = 0;
+  std::size_t sink = 0;
+  std::uint64_t allocations_before = allocations;
+  auto start = clock::now();
+  auto end = start + std::chrono::milliseconds(millis);
+  clock::time_point now;
+  do {
+    for (const std::string &target : targets) {
+      sink += work(target);
+    }
+    count += targets.size();
+  } while ((now = clock::now()) < end);
+  fmt::print(" {:>9.1f} {:>7.2f}",
+             std::chrono::duration<double, std::nano>(now - start).count() /
+                 count,
+             static_cast<double>(allocations - allocations_before) / count);
+  if (sink == 0) {
+    fmt::print("?");
+  }
+}
+
+int main(int argc, char *argv[]) {
+  alloc_counter::counting = true;
+  int millis = 300;
+  if (argc > 1) {
+    millis = std::atoi(argv[1]);
+  }
+  fmt::print("{:>14} {:>7} {:>9} {:>7} {:>9} {:>7}   (ns, allocs per target)\n",
+             "corpus", "targets", "decode", "allocs", "uri", "allocs");
+  for (const auto &[name, targets] : load_corpora()) {
+    fmt::print("{:>14} {:>7}", name, targets.size());
+    // like the handler did for every request
+    run(targets, millis, [](std::string_view target) {
+      std::string path;
+      if (!url_decode(target, path) || path.find("..") != std::string::npos) {
+        return std::size_t{1};
+      }
+      return path.size();
+    });
+    // one request_uri per connection, reused like the request
+    request_uri uri;
+    run(targets, millis, [&uri](std::string_view target) {
+      std::size_t size = uri.parse(target) ? uri.path().size() : 0;
+      for (const auto &param : uri.params()) {
+        size += param.value.size();
+      }
+      return size;
+    });
+    fmt::print("\n");
+  }
+  return 0;
+}
@@ -0,0 +1,313 @@
+#pragma once
+
+// the byte at a time request_parser and its owning request as they were
+// before the char_scan runs and the views into the receive buffer, kept as the
+// baseline of the parser benchmarks
+
+#include "string_utils.hpp"
+
+#include <cctype>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace http {
+namespace server {
+
+/// The request as it was before it became a view into the receive buffer.
+struct legacy_request {
+  std::string method{};
+  std::string request_target{};
+  int http_version_major{};
+  int http_version_minor{};
+  std::unordered_map<std::string, std::string> headers{};
+
+  void clear() { headers.clear(); }
+};
+
+/// Parser for incoming requests, one byte at a time.
+class legacy_request_parser {
+public:
+  /// Construct ready to parse the request method.
+  legacy_request_parser() = default;
+
+  /// Reset to initial parser state.
+  void clear() {
+    m_state = parser_state::request_line;
+    m_buffer.str("");
+  }
+
+  /// Result of parse.
+  enum parse_result { PASS, FAIL, CONTINUE };
+
+  /// Parse some data. The enum return value is good when a complete request has
+  /// been parsed, bad if the data is invalid, indeterminate when more data is
+  /// required. The InputIterator return value indicates how much of the input
+  /// has been consumed.
+  std::tuple<parse_result, size_t> parse(legacy_request &req,
+                                         std::string_view data);
+
+private:
+  /// Handle the next character of input.
+  parse_result consume(legacy_request &req, uint8_t input);
+
+  static bool is_obs_text(uint8_t ch) { return ch >= 0x80; }
+
+  static bool is_vchar(uint8_t ch) { return ch > 0x20 && ch <= 0x7e; }
+
+  static bool is_tchar(uint8_t ch);
+
+  static bool is_field_vchar(uint8_t ch) {
+    return is_vchar(ch) || is_obs_text(ch);
+  }
+
+  /// The current state of the parser.
+  enum parser_state {
+    request_line,
+    method,
+    request_target,
+    http_version_h,
+    http_version_t_0,
+    http_version_t_1,
+    http_version_p,
+    http_version_slash,
+    http_version_major,
+    http_version_dot,
+    http_version_minor,
+    request_line_cr,
+    request_line_lf,
+    field_line,
+    field_name,
+    field_value,
+    field_value_ows,
+    field_line_lf,
+    body_lf,
+  } m_state{request_line};
+
+  std::ostringstream m_buffer;
+  std::string m_last_field_name;
+};
+
+static constexpr uint8_t LEGACY_SP = ' ';
+static constexpr uint8_t LEGACY_CR = '\r';
+static constexpr uint8_t LEGACY_LF = '\n';
+
+inline bool legacy_request_parser::is_tchar(uint8_t ch) {
+  static std::unordered_set<uint8_t> tchar_set{'!',  '#', '$', '%', '&',
+                                               '\'', '*', '+', '-', '.',
+                                               '^',  '_', '`', '|', '~'};
+  return std::isalnum(ch) || tchar_set.find(ch) != tchar_set.end();
+}
+
+inline std::tuple<legacy_request_parser::parse_result, size_t>
+legacy_request_parser::parse(legacy_request &req, std::string_view data) {
+  parse_result result;
+  size_t pos;
+  for (pos = 0; pos < data.size(); pos++) {
+    result = consume(req, data[pos]);
+    if (result != CONTINUE) {
+      break;
+    }
+  }
+  return std::make_tuple(result, pos);
+}
+
+inline legacy_request_parser::parse_result
+legacy_request_parser::consume(legacy_request &req, uint8_t ch) {
+  parse_result res{CONTINUE};
+  switch (m_state) {
+  case request_line: {
+    if (is_tchar(ch)) {
+      m_buffer << ch;
+      m_state = method;
+    } else {
+      res = FAIL;
+    }
+    break;
+  }
+  case method: {
+    if (ch == LEGACY_SP) {
+      req.method = m_buffer.str();
+      m_buffer.str("");
+      m_state = request_target;
+    } else if (is_tchar(ch)) {
+      m_buffer << ch;
+    } else {
+      res = FAIL;
+    }
+    break;
+  }
+  case request_target: {
+    if (ch == LEGACY_SP) {
+      req.request_target = m_buffer.str();
+      m_buffer.str("");
+      m_state = http_version_h;
+    } else if (!std::iscntrl(ch)) {
+      m_buffer << ch;
+    } else {
+      res = FAIL;
+    }
+    break;
+  }
+  case http_version_h: {
+    if (ch == 'H') {
+      m_state = http_version_t_0;
+    } else {
+      res = FAIL;
+    }
+    break;
+  }
+  case http_version_t_0: {
+    if (ch == 'T') {
+      m_state = http_version_t_1;
+    } else {
+      res = FAIL;
+    }
+    break;
+  }
+  case http_version_t_1: {
+    if (ch == 'T') {
+      m_state = http_version_p;
+    } else {
+      res = FAIL;
+    }
+    break;
+  }
+  case http_version_p: {
+    if (ch == 'P') {
+      m_state = http_version_slash;
+    } else {
+      res = FAIL;
+    }
+    break;
+  }
+  case http_version_slash: {
+    if (ch == '/') {
+      m_state = http_version_major;
+      req.http_version_major = 0;
+      req.http_version_minor = 0;
+    } else {
+      res = FAIL;
+    }
+    break;
+  }
+  case http_version_major: {
+    if (std::isdigit(ch)) {
+      req.http_version_major = (ch - '0');
+      m_state = http_version_dot;
+    } else {
+      res = FAIL;
+    }
+    break;
+  }
+  case http_version_dot: {
+    if (ch == '.') {
+      m_state = http_version_minor;
+    } else {
+      res = FAIL;
+    }
+    break;
+  }
+  case http_version_minor: {
+    if (std::isdigit(ch)) {
+      req.http_version_minor = (ch - '0');
+      m_state = request_line_cr;
+    } else {
+      res = FAIL;
+    }
+    break;
+  }
+  case request_line_cr: {
+    if (ch == LEGACY_CR) {
+      m_state = request_line_lf;
+    } else {
+      res = FAIL;
+    }
+    break;
+  }
+  case request_line_lf: {
+    if (ch == LEGACY_LF) {
+      m_state = field_line;
+    } else {
+      res = FAIL;
+    }
+    break;
+  }
+  case field_line: {
+    if (ch == LEGACY_CR) {
+      m_state = body_lf;
+    } else if (is_tchar(ch)) {
+      m_buffer << ch;
+      m_state = field_name;
+    } else {
+      res = FAIL;
+    }
+    break;
+  }
+  case field_name: {
+    if (ch == ':') {
+      m_last_field_name = m_buffer.str();
+      m_buffer.str("");
+      m_state = field_value;
+    } else if (is_tchar(ch)) {
+      m_buffer << ch;
+    } else {
+      res = FAIL;
+    }
+    break;
+  }
+  case field_value: {
+    if (ch == LEGACY_CR) {
+      // we have to strip buffer_value here
+      req.headers[m_last_field_name] = string_utils::trim(m_buffer.str());
+      m_last_field_name.clear();
+      m_buffer.str("");
+      m_state = field_line_lf;
+    } else if (is_field_vchar(ch)) {
+      m_buffer << ch;
+    } else if (std::isblank(ch)) {
+      m_buffer << ch;
+      m_state = field_value_ows;
+    } else {
+      res = FAIL;
+    }
+    break;
+  }
+  case field_value_ows: {
+    if (ch == LEGACY_CR) {
+      // we have to strip buffer value here
+      req.headers[m_last_field_name] = string_utils::trim(m_buffer.str());
+      m_last_field_name.clear();
+      m_buffer.str("");
+      m_state = field_line_lf;
+    } else if (is_field_vchar(ch)) {
+      m_buffer << ch;
+      m_state = field_value;
+    } else if (std::isblank(ch)) {
+      // skip
+    } else {
+      res = FAIL;
+    }
+    break;
+  }
+  case field_line_lf: {
+    if (ch == LEGACY_LF) {
+      m_state = field_line;
+    } else {
+      res = FAIL;
+    }
+    break;
+  }
+  case body_lf: {
+    res = (ch == LEGACY_LF) ? PASS : FAIL;
+    break;
+  }
+  }
+  return res;
+}
+
+} // namespace server
+} // namespace http
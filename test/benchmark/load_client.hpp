@@ -0,0 +1,296 @@
+#pragma once
+
+#include <algorithm>
+#include <asio.hpp>
+#include <asio/ssl.hpp>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace bench {
+
+/// Result of one load run.
+struct load_result {
+  std::uint64_t requests{};
+  std::uint64_t errors{};
+  double seconds{};
+  /// latency of every completed request in microseconds, sorted
+  std::vector<std::uint32_t> latencies{};
+
+  double requests_per_second() const {
+    return seconds > 0 ? static_cast<double>(requests) / seconds : 0.0;
+  }
+
+  /// latency percentile in microseconds, `p` in [0, 1]
+  std::uint32_t percentile(double p) const {
+    if (latencies.empty()) {
+      return 0;
+    }
+    auto index = static_cast<std::size_t>(p * (latencies.size() - 1));
+    return latencies[index];
+  }
+};
+
+/// Keep-alive HTTP/1.1 load generator, every connection sends `request` and
+/// reads the whole response before sending the next one. Connects over tcp by
+/// default, over TLS after use_ssl() and over a unix domain socket after
+/// use_unix_socket(). After reconnect_each_request() every request goes over a
+/// new connection, after pipeline(depth) `depth` requests are written at once
+/// before their responses are read.
+class load_client {
+public:
+  using clock = std::chrono::steady_clock;
+
+  load_client(std::string host, std::string port, std::string request,
+              std::size_t connections, std::size_t threads = 1)
+      : m_host(std::move(host)), m_port(std::move(port)),
+        m_request(std::move(request)), m_connections(connections),
+        m_threads(std::max<std::size_t>(threads, 1)) {}
+
+  void use_ssl(asio::ssl::context &context) { m_ssl_context = &context; }
+
+  void use_unix_socket(std::string path) { m_unix_path = std::move(path); }
+
+  void reconnect_each_request() { m_reconnect = true; }
+
+  void pipeline(std::size_t depth) {
+    m_depth = std::max<std::size_t>(depth, 1);
+  }
+
+  load_result run(std::chrono::milliseconds duration) {
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+    if (!m_unix_path.empty()) {
+      return run_sessions<asio::local::stream_protocol::socket>(duration);
+    }
+#endif
+    if (m_ssl_context) {
+      return run_sessions<asio::ssl::stream<asio::ip::tcp::socket>>(duration);
+    }
+    return run_sessions<asio::ip::tcp::socket>(duration);
+  }
+
+private:
+  template <typename Stream> struct session;
+
+  template <typename Stream>
+  load_result run_sessions(std::chrono::milliseconds duration) {
+    m_batch.clear();
+    for (std::size_t i = 0; i < m_depth; i++) {
+      m_batch += m_request;
+    }
+    asio::io_context context(static_cast<int>(m_threads));
+    auto start = clock::now();
+    auto deadline = start + duration;
+    std::vector<std::shared_ptr<session<Stream>>> sessions;
+    for (std::size_t i = 0; i < m_connections; i++) {
+      sessions.emplace_back(
+          std::make_shared<session<Stream>>(context, *this, deadline));
+      sessions.back()->start();
+    }
+    std::vector<std::thread> workers;
+    for (std::size_t i = 1; i < m_threads; i++) {
+      workers.emplace_back([&context]() { context.run(); });
+    }
+    context.run();
+    for (auto &worker : workers) {
+      worker.join();
+    }
+    load_result result;
+    result.seconds =
+        std::chrono::duration<double>(clock::now() - start).count();
+    for (auto &s : sessions) {
+      result.requests += s->requests;
+      result.errors += s->errors;
+      result.latencies.insert(result.latencies.end(), s->latencies.begin(),
+                              s->latencies.end());
+    }
+    std::sort(result.latencies.begin(), result.latencies.end());
+    return result;
+  }
+
+  template <typename Stream>
+  struct session : std::enable_shared_from_this<session<Stream>> {
+    static constexpr bool is_ssl =
+        std::is_same_v<Stream, asio::ssl::stream<asio::ip::tcp::socket>>;
+
+    session(asio::io_context &context, const load_client &client,
+            clock::time_point deadline)
+        : executor(asio::make_strand(context)), client(client),
+          deadline(deadline) {}
+
+    auto &socket() {
+      if constexpr (is_ssl) {
+        return stream->lowest_layer();
+      } else {
+        return *stream;
+      }
+    }
+
+    void start() {
+      if constexpr (is_ssl) {
+        stream.emplace(executor, *client.m_ssl_context);
+      } else {
+        stream.emplace(executor);
+      }
+      auto self = this->shared_from_this();
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+      if constexpr (std::is_same_v<Stream,
+                                   asio::local::stream_protocol::socket>) {
+        stream->async_connect(
+            asio::local::stream_protocol::endpoint(client.m_unix_path),
+            [self](asio::error_code err) { self->on_connected(err); });
+        return;
+      } else
+#endif
+      {
+        asio::ip::tcp::resolver resolver(socket().get_executor());
+        auto endpoints = resolver.resolve(client.m_host, client.m_port);
+        asio::async_connect(
+            socket(), endpoints,
+            [self](asio::error_code err, const asio::ip::tcp::endpoint &) {
+              asio::error_code ignored;
+              self->socket().set_option(asio::ip::tcp::no_delay(true),
+                                        ignored);
+              self->on_connected(err);
+            });
+      }
+    }
+
+    void on_connected(asio::error_code err) {
+      if (err) {
+        errors++;
+        return;
+      }
+      if constexpr (is_ssl) {
+        stream->async_handshake(
+            asio::ssl::stream_base::client,
+            [self = this->shared_from_this()](asio::error_code err) {
+              if (err) {
+                self->errors++;
+                return;
+              }
+              self->send();
+            });
+      } else {
+        send();
+      }
+    }
+
+    void send() {
+      if (clock::now() >= deadline) {
+        asio::error_code err;
+        socket().close(err);
+        return;
+      }
+      sent_at = clock::now();
+      outstanding = client.m_depth;
+      asio::async_write(*stream, asio::buffer(client.m_batch),
+                        [self = this->shared_from_this()](
+                            asio::error_code err, std::size_t) {
+                          if (err) {
+                            self->errors++;
+                            return;
+                          }
+                          self->read_header();
+                        });
+    }
+
+    void read_header() {
+      asio::async_read_until(
+          *stream, buffer, "\r\n\r\n",
+          [self = this->shared_from_this()](asio::error_code err,
+                                            std::size_t header_size) {
+            if (err) {
+              self->errors++;
+              return;
+            }
+            self->read_body(header_size);
+          });
+    }
+
+    void read_body(std::size_t header_size) {
+      std::string_view header(
+          static_cast<const char *>(buffer.data().data()), header_size);
+      std::size_t content_length = 0;
+      for (std::string_view name : {"Content-Length:", "content-length:"}) {
+        auto pos = header.find(name);
+        if (pos != std::string_view::npos) {
+          pos += name.size();
+          while (pos < header.size() && header[pos] == ' ') {
+            pos++;
+          }
+          while (pos < header.size() && header[pos] >= '0' &&
+                 header[pos] <= '9') {
+            content_length = content_length * 10 + (header[pos++] - '0');
+          }
+          break;
+        }
+      }
+      std::size_t total = header_size + content_length;
+      std::size_t missing = buffer.size() >= total ? 0 : total - buffer.size();
+      asio::async_read(
+          *stream, buffer, asio::transfer_exactly(missing),
+          [self = this->shared_from_this(), total](asio::error_code err,
+                                                   std::size_t) {
+            if (err) {
+              self->errors++;
+              return;
+            }
+            self->buffer.consume(total);
+            self->requests++;
+            self->latencies.push_back(static_cast<std::uint32_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                    clock::now() - self->sent_at)
+                    .count()));
+            if (--self->outstanding > 0) {
+              self->read_header();
+              return;
+            }
+            if (self->client.m_reconnect) {
+              self->reconnect();
+              return;
+            }
+            self->send();
+          });
+    }
+
+    void reconnect() {
+      asio::error_code err;
+      socket().close(err);
+      buffer.consume(buffer.size());
+      if (clock::now() < deadline) {
+        start();
+      }
+    }
+
+    asio::strand<asio::io_context::executor_type> executor;
+    std::optional<Stream> stream;
+    const load_client &client;
+    clock::time_point deadline;
+    asio::streambuf buffer;
+    clock::time_point sent_at{};
+    std::size_t outstanding{};
+    std::uint64_t requests{};
+    std::uint64_t errors{};
+    std::vector<std::uint32_t> latencies{};
+  };
+
+  std::string m_host;
+  std::string m_port;
+  std::string m_request;
+  // m_depth copies of m_request
+  std::string m_batch;
+  std::size_t m_connections;
+  std::size_t m_threads;
+  asio::ssl::context *m_ssl_context{};
+  std::string m_unix_path{};
+  bool m_reconnect{};
+  std::size_t m_depth{1};
+};
+
+} // namespace bench
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+#include <stdexcept>
+#include <utility>
+
+namespace bench {
+
+/// Write a throwaway self-signed certificate and private key for localhost into
+/// `dir`, returns the paths of cert.pem and key.pem.
+inline std::pair<std::filesystem::path, std::filesystem::path>
+make_self_signed(const std::filesystem::path &dir) {
+  std::unique_ptr<EVP_PKEY_CTX, decltype(&EVP_PKEY_CTX_free)> key_ctx(
+      EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, nullptr), EVP_PKEY_CTX_free);
+  EVP_PKEY *raw_key = nullptr;
+  if (!key_ctx || EVP_PKEY_keygen_init(key_ctx.get()) <= 0 ||
+      EVP_PKEY_CTX_set_rsa_keygen_bits(key_ctx.get(), 2048) <= 0 ||
+      EVP_PKEY_keygen(key_ctx.get(), &raw_key) <= 0) {
+    throw std::runtime_error("failed to generate a rsa key");
+  }
+  std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> key(raw_key,
+                                                          EVP_PKEY_free);
+
+  std::unique_ptr<X509, decltype(&X509_free)> cert(X509_new(), X509_free);
+  X509_set_version(cert.get(), 2);
+  ASN1_INTEGER_set(X509_get_serialNumber(cert.get()), 1);
+  X509_gmtime_adj(X509_getm_notBefore(cert.get()), 0);
+  X509_gmtime_adj(X509_getm_notAfter(cert.get()), 24 * 3600);
+  X509_set_pubkey(cert.get(), key.get());
+  X509_NAME *name = X509_get_subject_name(cert.get());
+  X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                             reinterpret_cast<const unsigned char *>("localhost"),
+                             -1, -1, 0);
+  X509_set_issuer_name(cert.get(), name);
+  if (X509_sign(cert.get(), key.get(), EVP_sha256()) == 0) {
+    throw std::runtime_error("failed to sign the certificate");
+  }
+
+  auto cert_path = dir / "bench_cert.pem";
+  auto key_path = dir / "bench_key.pem";
+  std::unique_ptr<FILE, decltype(&std::fclose)> cert_file(
+      std::fopen(cert_path.string().c_str(), "wb"), std::fclose);
+  std::unique_ptr<FILE, decltype(&std::fclose)> key_file(
+      std::fopen(key_path.string().c_str(), "wb"), std::fclose);
+  if (!cert_file || !key_file ||
+      PEM_write_X509(cert_file.get(), cert.get()) == 0 ||
+      PEM_write_PrivateKey(key_file.get(), key.get(), nullptr, nullptr, 0,
+                           nullptr, nullptr) == 0) {
+    throw std::runtime_error("failed to write the certificate");
+  }
+  return {cert_path, key_path};
+}
+
+} // namespace bench
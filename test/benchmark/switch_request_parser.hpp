@@ -0,0 +1,314 @@
+#pragma once
+
+// request_parser as it was before the table driven DFA: a switch over the
+// states with char_scan runs in between, kept as the baseline of bench_dfa
+
+#include "char_scan.hpp"
+#include "request.hpp"
+#include "string_utils.hpp"
+
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <tuple>
+
+namespace http {
+namespace server {
+
+/// Parser for incoming requests, a switch over the states.
+class switch_request_parser {
+public:
+  /// Construct ready to parse the request method.
+  switch_request_parser() = default;
+
+  /// Reset to initial parser state.
+  void clear() {
+    m_state = parser_state::request_line;
+    m_token = nullptr;
+    m_field_name = {};
+  }
+
+  /// Result of parse.
+  enum parse_result { PASS, FAIL, CONTINUE };
+
+  /// Parse some data. The enum return value is good when a complete request has
+  /// been parsed, bad if the data is invalid, indeterminate when more data is
+  /// required. The InputIterator return value indicates how much of the input
+  /// has been consumed.
+  ///
+  /// Nothing is copied, the fields of `req` are views into `data`, which has
+  /// to follow the data of the previous call in memory until the request is
+  /// parsed, or be moved there with rebase(). Runs of method, request-target,
+  /// field name and field value characters are skipped by char_scan, the
+  /// state machine only sees the bytes in between.
+  std::tuple<parse_result, size_t> parse(request &req, std::string_view data);
+
+  /// The data parsed so far moved by `offset` bytes, move the views of the
+  /// parser and of `req` along.
+  void rebase(request &req, std::ptrdiff_t offset);
+
+private:
+  /// Handle the next character of input.
+  parse_result consume(request &req, const char *input);
+
+  /// Length of the run of characters at the start of `data` the current state
+  /// takes without a transition.
+  size_t scan(std::string_view data) const;
+
+  /// The current state of the parser.
+  enum parser_state {
+    request_line,
+    method,
+    request_target,
+    http_version_h,
+    http_version_t_0,
+    http_version_t_1,
+    http_version_p,
+    http_version_slash,
+    http_version_major,
+    http_version_dot,
+    http_version_minor,
+    request_line_cr,
+    request_line_lf,
+    field_line,
+    field_name,
+    field_value,
+    field_line_lf,
+    body_lf,
+  } m_state{request_line};
+
+  // start of the method, target, field name or value being parsed
+  const char *m_token{};
+  std::string_view m_field_name{};
+};
+
+inline constexpr uint8_t SWITCH_SP = ' ';
+inline constexpr uint8_t SWITCH_CR = '\r';
+inline constexpr uint8_t SWITCH_LF = '\n';
+
+inline bool switch_is_tchar(uint8_t ch) { return char_scan::is_tchar(ch); }
+
+inline bool switch_is_field_vchar(uint8_t ch) {
+  // VCHAR, obs-text or OWS
+  return (ch >= 0x20 && ch != 0x7f) || ch == '\t';
+}
+
+inline size_t switch_request_parser::scan(std::string_view data) const {
+  switch (m_state) {
+  case method:
+  case field_name:
+    return char_scan::token(data);
+  case request_target:
+    return char_scan::target(data);
+  case field_value:
+    return char_scan::field_value(data);
+  default:
+    return 0;
+  }
+}
+
+inline std::tuple<switch_request_parser::parse_result, size_t>
+switch_request_parser::parse(request &req, std::string_view data) {
+  parse_result result{CONTINUE};
+  size_t pos;
+  for (pos = 0; pos < data.size(); pos++) {
+    if (size_t run = scan(data.substr(pos)); run > 0) {
+      pos += run;
+      if (pos == data.size()) {
+        break;
+      }
+    }
+    result = consume(req, data.data() + pos);
+    if (result != CONTINUE) {
+      break;
+    }
+  }
+  return std::make_tuple(result, pos);
+}
+
+inline void switch_request_parser::rebase(request &req, std::ptrdiff_t offset) {
+  if (m_token) {
+    m_token += offset;
+  }
+  if (m_field_name.data()) {
+    m_field_name = std::string_view(m_field_name.data() + offset,
+                                    m_field_name.size());
+  }
+  req.rebase(offset);
+}
+
+inline std::string_view switch_token_view(const char *begin, const char *end) {
+  return std::string_view(begin, static_cast<size_t>(end - begin));
+}
+
+inline switch_request_parser::parse_result
+switch_request_parser::consume(request &req, const char *input) {
+  parse_result res{CONTINUE};
+  uint8_t ch = static_cast<uint8_t>(*input);
+  switch (m_state) {
+  case request_line: {
+    if (switch_is_tchar(ch)) {
+      m_token = input;
+      m_state = method;
+    } else {
+      res = FAIL;
+    }
+    break;
+  }
+  case method: {
+    if (ch == SWITCH_SP) {
+      req.method = switch_token_view(m_token, input);
+      m_token = input + 1;
+      m_state = request_target;
+    } else if (!switch_is_tchar(ch)) {
+      res = FAIL;
+    }
+    break;
+  }
+  case request_target: {
+    if (ch == SWITCH_SP) {
+      req.request_target = switch_token_view(m_token, input);
+      m_token = nullptr;
+      m_state = http_version_h;
+    } else if (std::iscntrl(ch)) {
+      res = FAIL;
+    }
+    break;
+  }
+  case http_version_h: {
+    if (ch == 'H') {
+      m_state = http_version_t_0;
+    } else {
+      res = FAIL;
+    }
+    break;
+  }
+  case http_version_t_0: {
+    if (ch == 'T') {
+      m_state = http_version_t_1;
+    } else {
+      res = FAIL;
+    }
+    break;
+  }
+  case http_version_t_1: {
+    if (ch == 'T') {
+      m_state = http_version_p;
+    } else {
+      res = FAIL;
+    }
+    break;
+  }
+  case http_version_p: {
+    if (ch == 'P') {
+      m_state = http_version_slash;
+    } else {
+      res = FAIL;
+    }
+    break;
+  }
+  case http_version_slash: {
+    if (ch == '/') {
+      m_state = http_version_major;
+      req.http_version_major = 0;
+      req.http_version_minor = 0;
+    } else {
+      res = FAIL;
+    }
+    break;
+  }
+  case http_version_major: {
+    if (std::isdigit(ch)) {
+      req.http_version_major = (ch - '0');
+      m_state = http_version_dot;
+    } else {
+      res = FAIL;
+    }
+    break;
+  }
+  case http_version_dot: {
+    if (ch == '.') {
+      m_state = http_version_minor;
+    } else {
+      res = FAIL;
+    }
+    break;
+  }
+  case http_version_minor: {
+    if (std::isdigit(ch)) {
+      req.http_version_minor = (ch - '0');
+      m_state = request_line_cr;
+    } else {
+      res = FAIL;
+    }
+    break;
+  }
+  case request_line_cr: {
+    if (ch == SWITCH_CR) {
+      m_state = request_line_lf;
+    } else {
+      res = FAIL;
+    }
+    break;
+  }
+  case request_line_lf: {
+    if (ch == SWITCH_LF) {
+      m_state = field_line;
+    } else {
+      res = FAIL;
+    }
+    break;
+  }
+  case field_line: {
+    if (ch == SWITCH_CR) {
+      m_state = body_lf;
+    } else if (switch_is_tchar(ch)) {
+      m_token = input;
+      m_state = field_name;
+    } else {
+      res = FAIL;
+    }
+    break;
+  }
+  case field_name: {
+    if (ch == ':') {
+      m_field_name = switch_token_view(m_token, input);
+      m_token = input + 1;
+      m_state = field_value;
+    } else if (!switch_is_tchar(ch)) {
+      res = FAIL;
+    }
+    break;
+  }
+  case field_value: {
+    if (ch == SWITCH_CR) {
+      // leading and trailing OWS are not part of the value
+      std::string_view value = switch_token_view(m_token, input);
+      req.add_header(m_field_name, string_utils::trim(value));
+      m_field_name = {};
+      m_token = nullptr;
+      m_state = field_line_lf;
+    } else if (!switch_is_field_vchar(ch)) {
+      res = FAIL;
+    }
+    break;
+  }
+  case field_line_lf: {
+    if (ch == SWITCH_LF) {
+      m_state = field_line;
+    } else {
+      res = FAIL;
+    }
+    break;
+  }
+  case body_lf: {
+    res = (ch == SWITCH_LF) ? PASS : FAIL;
+    break;
+  }
+  }
+  return res;
+}
+
+} // namespace server
+} // namespace http
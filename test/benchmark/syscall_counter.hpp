@@ -0,0 +1,161 @@
+#pragma once
+
+#include <atomic>
+#include <cstdarg>
+#include <cstdint>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// replacements of the libc wrappers of the syscalls a server thread makes,
+// which count the calls of the benchmarks and forward to libc. They are not
+// inline, include this in one translation unit of a program only. calls
+// answered by the vDSO (clock_gettime) and calls libc makes internally are
+// not seen, io_uring_enter(2) is counted through syscall()
+
+namespace syscall_counter {
+
+/// The calls of the calling thread are counted while set.
+inline thread_local bool counting = false;
+/// Calls of the replaced wrappers by the counting threads.
+inline std::atomic<std::uint64_t> calls{0};
+
+/// The definition of `name` the replacement hides.
+template <typename Function> Function next(const char *name) {
+  return reinterpret_cast<Function>(::dlsym(RTLD_NEXT, name));
+}
+
+inline void count() {
+  if (counting) {
+    calls.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+} // namespace syscall_counter
+
+// `noexcept` follows the declarations of glibc, which mark the wrappers that
+// are no cancellation points __THROW
+#define SYSCALL_COUNTER_REPLACE(except, ret, name, params, args)              \
+  extern "C" ret name params except {                                          \
+    static auto real = syscall_counter::next<decltype(&::name)>(#name);        \
+    syscall_counter::count();                                                  \
+    return real args;                                                          \
+  }
+
+SYSCALL_COUNTER_REPLACE(, ssize_t, read, (int fd, void *buf, size_t n),
+                        (fd, buf, n))
+SYSCALL_COUNTER_REPLACE(, ssize_t, write, (int fd, const void *buf, size_t n),
+                        (fd, buf, n))
+SYSCALL_COUNTER_REPLACE(, ssize_t, readv,
+                        (int fd, const iovec *iov, int count),
+                        (fd, iov, count))
+SYSCALL_COUNTER_REPLACE(, ssize_t, writev,
+                        (int fd, const iovec *iov, int count),
+                        (fd, iov, count))
+SYSCALL_COUNTER_REPLACE(, ssize_t, pread,
+                        (int fd, void *buf, size_t n, off_t offset),
+                        (fd, buf, n, offset))
+SYSCALL_COUNTER_REPLACE(, ssize_t, recv,
+                        (int fd, void *buf, size_t n, int flags),
+                        (fd, buf, n, flags))
+SYSCALL_COUNTER_REPLACE(, ssize_t, send,
+                        (int fd, const void *buf, size_t n, int flags),
+                        (fd, buf, n, flags))
+SYSCALL_COUNTER_REPLACE(, ssize_t, recvmsg, (int fd, msghdr *msg, int flags),
+                        (fd, msg, flags))
+SYSCALL_COUNTER_REPLACE(, ssize_t, sendmsg,
+                        (int fd, const msghdr *msg, int flags),
+                        (fd, msg, flags))
+SYSCALL_COUNTER_REPLACE(, int, accept,
+                        (int fd, sockaddr *addr, socklen_t *len),
+                        (fd, addr, len))
+SYSCALL_COUNTER_REPLACE(, int, accept4,
+                        (int fd, sockaddr *addr, socklen_t *len, int flags),
+                        (fd, addr, len, flags))
+SYSCALL_COUNTER_REPLACE(, int, close, (int fd), (fd))
+SYSCALL_COUNTER_REPLACE(noexcept, int, shutdown, (int fd, int how),
+                        (fd, how))
+SYSCALL_COUNTER_REPLACE(noexcept, int, getsockopt,
+                        (int fd, int level, int name, void *value,
+                         socklen_t *len),
+                        (fd, level, name, value, len))
+SYSCALL_COUNTER_REPLACE(noexcept, int, setsockopt,
+                        (int fd, int level, int name, const void *value,
+                         socklen_t len),
+                        (fd, level, name, value, len))
+SYSCALL_COUNTER_REPLACE(noexcept, int, getpeername,
+                        (int fd, sockaddr *addr, socklen_t *len),
+                        (fd, addr, len))
+SYSCALL_COUNTER_REPLACE(noexcept, ssize_t, sendfile,
+                        (int out, int in, off_t *offset, size_t n),
+                        (out, in, offset, n))
+SYSCALL_COUNTER_REPLACE(, int, epoll_wait,
+                        (int fd, epoll_event *events, int max, int timeout),
+                        (fd, events, max, timeout))
+SYSCALL_COUNTER_REPLACE(noexcept, int, epoll_ctl,
+                        (int fd, int op, int target, epoll_event *event),
+                        (fd, op, target, event))
+SYSCALL_COUNTER_REPLACE(noexcept, int, timerfd_settime,
+                        (int fd, int flags, const itimerspec *value,
+                         itimerspec *old),
+                        (fd, flags, value, old))
+SYSCALL_COUNTER_REPLACE(noexcept, int, fstat, (int fd, struct stat *buf),
+                        (fd, buf))
+SYSCALL_COUNTER_REPLACE(noexcept, int, stat,
+                        (const char *path, struct stat *buf), (path, buf))
+
+#undef SYSCALL_COUNTER_REPLACE
+
+// the variadic ones forward the arguments their requests take at most
+
+extern "C" int open(const char *path, int flags, ...) {
+  static auto real = syscall_counter::next<decltype(&::open)>("open");
+  va_list args;
+  va_start(args, flags);
+  mode_t mode = va_arg(args, mode_t);
+  va_end(args);
+  syscall_counter::count();
+  return real(path, flags, mode);
+}
+
+extern "C" int fcntl(int fd, int cmd, ...) {
+  static auto real = syscall_counter::next<decltype(&::fcntl)>("fcntl");
+  va_list args;
+  va_start(args, cmd);
+  void *arg = va_arg(args, void *);
+  va_end(args);
+  syscall_counter::count();
+  return real(fd, cmd, arg);
+}
+
+extern "C" int ioctl(int fd, unsigned long request, ...) noexcept {
+  static auto real = syscall_counter::next<decltype(&::ioctl)>("ioctl");
+  va_list args;
+  va_start(args, request);
+  void *arg = va_arg(args, void *);
+  va_end(args);
+  syscall_counter::count();
+  return real(fd, request, arg);
+}
+
+extern "C" long syscall(long number, ...) noexcept {
+  static auto real = syscall_counter::next<decltype(&::syscall)>("syscall");
+  va_list args;
+  va_start(args, number);
+  long a = va_arg(args, long);
+  long b = va_arg(args, long);
+  long c = va_arg(args, long);
+  long d = va_arg(args, long);
+  long e = va_arg(args, long);
+  long f = va_arg(args, long);
+  va_end(args);
+  syscall_counter::count();
+  return real(number, a, b, c, d, e, f);
+}
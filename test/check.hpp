@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdlib>
+#include <string_view>
+
+#include <spdlog/spdlog.h>
+
+/// Log `what` and exit with a failure unless `ok`.
+inline void check(bool ok, std::string_view what) {
+  if (!ok) {
+    spdlog::error("failed: {}", what);
+    std::exit(EXIT_FAILURE);
+  }
+}
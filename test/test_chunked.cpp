@@ -0,0 +1,152 @@
+#include "check.hpp"
+#include "chunked_decoder.hpp"
+
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <string_view>
+
+#include <spdlog/spdlog.h>
+
+// the chunked decoder yields the chunk data as views into its input, gives the
+// same result however the input is split and stops right after the trailer
+// section, where a pipelined request starts
+
+using namespace http::server;
+
+struct decoded {
+  chunked_decoder::decode_result result{chunked_decoder::CONTINUE};
+  // the chunk data
+  std::string data;
+  // position after DONE or of the offending byte
+  std::size_t pos{};
+};
+
+/// Decode `input` in pieces whose sizes come from `piece`.
+template <typename Piece>
+static decoded decode(std::string_view input, Piece piece) {
+  chunked_decoder decoder;
+  decoded out;
+  std::size_t begin = 0;
+  while (begin < input.size()) {
+    std::string_view data = input.substr(begin, piece());
+    while (!data.empty()) {
+      auto [result, pos, chunk] = decoder.decode(data);
+      if (result == chunked_decoder::DATA) {
+        check(chunk.data() + chunk.size() == data.data() + pos &&
+                  !chunk.empty(),
+              "chunk data is a view into the input");
+        out.data += chunk;
+      }
+      begin += pos;
+      data.remove_prefix(pos);
+      if (result == chunked_decoder::DONE ||
+          result == chunked_decoder::FAIL) {
+        check(decoder.size() == out.data.size(), "size()");
+        out.result = result;
+        out.pos = begin;
+        return out;
+      }
+    }
+  }
+  return out;
+}
+
+/// Decode `input` whole, byte by byte and in random pieces, all have to agree.
+static decoded decode_split(std::string_view input) {
+  decoded whole = decode(input, [&]() { return input.size(); });
+  std::mt19937 random(7);
+  for (int round = 0; round < 20; round++) {
+    std::uniform_int_distribution<std::size_t> size(1, round + 1);
+    decoded split = decode(input, [&]() { return size(random); });
+    check(split.result == whole.result && split.data == whole.data &&
+              split.pos == whole.pos,
+          "the split of the input does not matter");
+  }
+  return whole;
+}
+
+static void check_valid(std::string_view body, std::string_view data) {
+  const std::string_view next = "GET / HTTP/1.1\r\n\r\n";
+  std::string input = std::string(body) + std::string(next);
+  decoded out = decode_split(input);
+  check(out.result == chunked_decoder::DONE, body);
+  check(out.data == data, "chunk data");
+  check(out.pos == body.size(), "stops after the trailer section");
+}
+
+static void check_invalid(std::string_view body, std::size_t at) {
+  decoded out = decode_split(body);
+  check(out.result == chunked_decoder::FAIL, body);
+  check(out.pos == at, "position of the offending byte");
+}
+
+int main() {
+  check_valid("0\r\n\r\n", "");
+  check_valid("5\r\nhello\r\n0\r\n\r\n", "hello");
+  check_valid("5\r\nhello\r\n6\r\n world\r\n0\r\n\r\n", "hello world");
+  check_valid("a\r\n0123456789\r\nA\r\nabcdefghij\r\n0\r\n\r\n",
+              "0123456789abcdefghij");
+  check_valid("0005\r\nhello\r\n000\r\n\r\n", "hello");
+  check_valid("5;name=value\r\nhello\r\n0;last\r\n\r\n", "hello");
+  check_valid("5 ; name=\"quoted value\"\r\nhello\r\n0\r\n\r\n", "hello");
+  check_valid("5\r\nhello\r\n0\r\nExpires: never\r\nX-Sum:\tabc \r\n\r\n",
+              "hello");
+  check_valid("00000000000000000000001\r\nx\r\n0\r\n\r\n", "x");
+
+  check_invalid("\r\n", 0);
+  check_invalid("g\r\n", 0);
+  check_invalid("5x\r\n", 1);
+  check_invalid("5\nhello", 1);
+  check_invalid("5\r\r", 2);
+  check_invalid("5\r\nhelloX\r\n", 8);
+  check_invalid("5\r\nhello\r\r", 9);
+  check_invalid("5;a\x01\r\n", 3);
+  check_invalid("10000000000000000\r\n", 16);
+  check_invalid("0\r\nX\r\n\r\n", 4);
+  check_invalid("0\r\n: x\r\n\r\n", 3);
+  check_invalid("0\r\nX: a\nb\r\n\r\n", 7);
+  check_invalid("0\r\n\r\r", 4);
+  check_invalid("0\r\n\n", 3);
+  check_invalid(std::string(chunked_decoder::MAX_LINE, '0') + "\r\n",
+                chunked_decoder::MAX_LINE);
+  {
+    std::string trailer = "0\r\nX: " +
+                          std::string(chunked_decoder::MAX_TRAILER, 'x') +
+                          "\r\n\r\n";
+    check_invalid(trailer, 3 + chunked_decoder::MAX_TRAILER);
+  }
+
+  // chunks of random sizes up to 64 KiB
+  {
+    std::mt19937 random(42);
+    std::uniform_int_distribution<std::size_t> size(1, 1 << 16);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::string body;
+    std::string data;
+    for (int i = 0; i < 64; i++) {
+      std::string chunk(size(random), '\0');
+      for (char &ch : chunk) {
+        ch = static_cast<char>(byte(random));
+      }
+      body += fmt::format("{:x}\r\n", chunk.size()) + chunk + "\r\n";
+      data += chunk;
+    }
+    body += "0\r\n\r\n";
+    check_valid(body, data);
+  }
+
+  // DONE sticks until clear()
+  {
+    chunked_decoder decoder;
+    auto [result, pos, chunk] = decoder.decode("0\r\n\r\n0\r\n\r\n");
+    check(result == chunked_decoder::DONE && pos == 5, "first body");
+    check(std::get<0>(decoder.decode("0\r\n\r\n")) == chunked_decoder::DONE &&
+              std::get<1>(decoder.decode("0\r\n\r\n")) == 0,
+          "nothing is consumed after DONE");
+    decoder.clear();
+    check(std::get<1>(decoder.decode("0\r\n\r\n")) == 5, "after clear()");
+  }
+  spdlog::info("all chunked decoder tests passed");
+  return 0;
+}
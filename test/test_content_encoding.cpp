@@ -0,0 +1,556 @@
+#include "body_source.hpp"
+#include "check.hpp"
+#include "chunked_decoder.hpp"
+#include "content_encoding.hpp"
+#include "file_cache.hpp"
+#include "request.hpp"
+#include "response.hpp"
+#include "server.hpp"
+
+#include <algorithm>
+#include <asio.hpp>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+#include <zlib.h>
+
+#if defined(MY_SERVER_BROTLI)
+#include <brotli/decode.h>
+#endif
+#if defined(MY_SERVER_ZSTD)
+#include <zstd.h>
+#endif
+
+#include <spdlog/spdlog.h>
+
+// content codings: the fixtures of data/ decoded by the decoders the tests
+// check with, Accept-Encoding negotiation, every available coding round
+// tripped from content, a file and a source in pieces of any size, encoders
+// going back to the pool of the thread, the compression stage of a response
+// with cached variants of static files, and a live server sending compressed
+// static files and streams
+
+using namespace http::server;
+namespace fs = std::filesystem;
+
+static std::string read_file(const fs::path &path) {
+  std::ifstream in(path, std::ios::in | std::ios::binary);
+  return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+/// Decode as much of `data` as there is, `complete` is set when the end of
+/// the body was found.
+static std::string decode(content_coding coding, std::string_view data,
+                          bool &complete) {
+  std::string out;
+  std::vector<char> buffer(64 * 1024);
+  complete = false;
+  if (coding == content_coding::gzip || coding == content_coding::deflate) {
+    z_stream stream{};
+    inflateInit2(&stream, coding == content_coding::gzip ? 15 + 16 : 15);
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    int ret = Z_OK;
+    while (ret == Z_OK) {
+      stream.next_out = reinterpret_cast<Bytef *>(buffer.data());
+      stream.avail_out = static_cast<uInt>(buffer.size());
+      ret = inflate(&stream, Z_SYNC_FLUSH);
+      out.append(buffer.data(), buffer.size() - stream.avail_out);
+    }
+    complete = ret == Z_STREAM_END;
+    inflateEnd(&stream);
+  }
+#if defined(MY_SERVER_BROTLI)
+  if (coding == content_coding::br) {
+    BrotliDecoderState *state =
+        BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
+    std::size_t avail_in = data.size();
+    auto next_in = reinterpret_cast<const std::uint8_t *>(data.data());
+    BrotliDecoderResult ret = BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT;
+    while (ret == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT) {
+      std::size_t avail_out = buffer.size();
+      auto next_out = reinterpret_cast<std::uint8_t *>(buffer.data());
+      ret = BrotliDecoderDecompressStream(state, &avail_in, &next_in,
+                                          &avail_out, &next_out, nullptr);
+      out.append(buffer.data(), buffer.size() - avail_out);
+    }
+    complete = ret == BROTLI_DECODER_RESULT_SUCCESS;
+    BrotliDecoderDestroyInstance(state);
+  }
+#endif
+#if defined(MY_SERVER_ZSTD)
+  if (coding == content_coding::zstd) {
+    ZSTD_DStream *stream = ZSTD_createDStream();
+    ZSTD_inBuffer input{data.data(), data.size(), 0};
+    std::size_t ret = 1;
+    while (ret != 0 && !ZSTD_isError(ret)) {
+      ZSTD_outBuffer output{buffer.data(), buffer.size(), 0};
+      ret = ZSTD_decompressStream(stream, &output, &input);
+      out.append(buffer.data(), output.pos);
+      if (output.pos < output.size && input.pos == input.size) {
+        break;
+      }
+    }
+    complete = ret == 0;
+    ZSTD_freeDStream(stream);
+  }
+#endif
+  return out;
+}
+
+static std::string decode(content_coding coding, std::string_view data) {
+  bool complete = false;
+  std::string out = decode(coding, data, complete);
+  check(complete, "the encoded body is complete");
+  return out;
+}
+
+/// Read `source` to its end in pieces of `piece` bytes.
+static std::string drain(body_source &source, std::size_t piece,
+                         std::size_t *first = nullptr) {
+  asio::io_context context;
+  asio::error_code err;
+  std::string out;
+  asio::co_spawn(
+      context,
+      [&]() -> asio::awaitable<void> {
+        std::vector<char> buffer(piece);
+        for (;;) {
+          std::size_t n = co_await source.read(buffer, err);
+          if (err || n == 0) {
+            break;
+          }
+          if (first && out.empty()) {
+            *first = n;
+          }
+          out.append(buffer.data(), n);
+        }
+      },
+      asio::detached);
+  context.run();
+  check(!err, "the source does not fail");
+  return out;
+}
+
+/// `body` with the trace id of the echo service blanked out, the raw and the
+/// decoded fixtures come from two requests.
+static std::string without_trace_id(std::string body) {
+  std::size_t begin = body.find("Root=");
+  if (begin != std::string::npos) {
+    std::size_t end = body.find('"', begin);
+    body.replace(begin, end - begin, end - begin, 'x');
+  }
+  return body;
+}
+
+static void test_fixtures() {
+  fs::path data = DATA_PATH;
+  check(without_trace_id(
+            decode(content_coding::gzip, read_file(data / "gzip_raw.bin"))) ==
+            without_trace_id(read_file(data / "gzip_decoded.bin")),
+        "gzip fixture");
+  check(without_trace_id(decode(content_coding::deflate,
+                                read_file(data / "deflate_raw.bin"))) ==
+            without_trace_id(read_file(data / "deflate_decoded.bin")),
+        "deflate fixture");
+#if defined(MY_SERVER_BROTLI)
+  // the page differs between its two requests in nonces and image hosts,
+  // not in its length
+  std::string page = decode(content_coding::br, read_file(data / "br_raw.bin"));
+  std::string expected = read_file(data / "br_decoded.bin");
+  check(page.size() == expected.size() &&
+            page.compare(0, 3000, expected, 0, 3000) == 0,
+        "br fixture");
+#endif
+}
+
+static void test_negotiate() {
+  content_coding best = coding_available(content_coding::zstd)
+                            ? content_coding::zstd
+                        : coding_available(content_coding::br)
+                            ? content_coding::br
+                            : content_coding::gzip;
+  check(negotiate_coding("") == content_coding::identity, "nothing accepted");
+  check(negotiate_coding("gzip") == content_coding::gzip, "gzip");
+  check(negotiate_coding("gzip, deflate, br, zstd") == best,
+        "the preferred of equal weights");
+  check(negotiate_coding("deflate;q=0.5, gzip;q=0.4") ==
+            content_coding::deflate,
+        "the highest weight");
+  check(negotiate_coding("GZIP ; Q=1.000") == content_coding::gzip &&
+            negotiate_coding("x-gzip") == content_coding::gzip,
+        "case and alias");
+  check(negotiate_coding("gzip;q=0") == content_coding::identity,
+        "excluded");
+  check(negotiate_coding("gzip;q=2, deflate;q=0.0001") ==
+            content_coding::identity,
+        "malformed weights are ignored");
+  check(negotiate_coding("*") == best, "any coding");
+  check(negotiate_coding("identity;q=1, gzip;q=0.5") ==
+            content_coding::identity,
+        "identity preferred");
+  check(negotiate_coding("*;q=0, identity") == content_coding::identity &&
+            negotiate_coding("gzip;q=0.1, *;q=0") == content_coding::gzip,
+        "identity excluded through *");
+  check(negotiate_coding("compress, unknown") == content_coding::identity,
+        "codings this build lacks");
+  if (!coding_available(content_coding::br)) {
+    check(negotiate_coding("br;q=1, gzip;q=0.9") == content_coding::gzip,
+          "br is not built in");
+  }
+
+  check(compressible_type("text/html; charset=utf-8") &&
+            compressible_type("application/json") &&
+            compressible_type("image/svg+xml") &&
+            compressible_type("Application/JavaScript"),
+        "compressible types");
+  check(!compressible_type("image/png") && !compressible_type("image/x-icon") &&
+            !compressible_type("application/zip"),
+        "compressed already");
+}
+
+static void test_round_trip(content_coding coding) {
+  std::string_view name = coding_name(coding);
+  for (std::string_view fixture : {"gzip_decoded.bin", "deflate_decoded.bin"}) {
+    response rep;
+    std::string body = read_file(fs::path(DATA_PATH) / fixture);
+    rep.content = body;
+    compress_source source(
+        encoder_pool::local().acquire(coding, compression_options().level(coding)),
+        rep);
+    check(decode(coding, drain(source, 64)) == body,
+          fmt::format("{} {}", name, fixture));
+  }
+  fs::path html_path = fs::path(DATA_PATH) / "br_decoded.bin";
+  std::string html = read_file(html_path);
+  compression_options options;
+  int level = options.level(coding);
+
+  for (std::size_t piece : {std::size_t{37}, std::size_t{16 * 1024}}) {
+    response rep;
+    rep.content = html;
+    compress_source source(encoder_pool::local().acquire(coding, level), rep);
+    std::string encoded = drain(source, piece);
+    check(encoded.size() < html.size() / 3 &&
+              decode(coding, encoded) == html,
+          fmt::format("{} content in pieces of {}", name, piece));
+  }
+
+  response rep;
+  rep.content = "<!-- head -->";
+  check(rep.file.open(html_path), "open the file");
+  compress_source file_source(encoder_pool::local().acquire(coding, level),
+                              rep);
+  check(!rep.file.is_open() && rep.content.empty(),
+        "the content and the file are taken");
+  // the response moves when the queue of its connection grows, a short
+  // content lives inside the string and would move with it
+  rep.content = "<!-- overwritten -->";
+  response moved = std::move(rep);
+  check(decode(coding, drain(file_source, 1000)) == "<!-- head -->" + html,
+        fmt::format("{} content and file", name));
+
+  // a live source, every piece is flushed right away
+  response live;
+  live.source = std::make_unique<callback_source>(
+      [&html, pos = std::size_t{0}](std::span<char> out,
+                                    asio::error_code &) mutable {
+        std::size_t size = std::min({out.size(), html.size() - pos,
+                                     std::size_t{1000}});
+        std::copy_n(html.data() + pos, size, out.data());
+        pos += size;
+        return size;
+      });
+  compress_source live_source(encoder_pool::local().acquire(coding, level),
+                              live);
+  std::size_t first = 0;
+  std::string encoded = drain(live_source, 16 * 1024, &first);
+  bool complete = false;
+  check(decode(coding, std::string_view(encoded).substr(0, first), complete) ==
+                html.substr(0, 1000) &&
+            !complete,
+        fmt::format("{} first piece of a source flushed", name));
+  check(decode(coding, encoded) == html,
+        fmt::format("{} source", name));
+}
+
+static void test_pool() {
+  encoder_pool &pool = encoder_pool::local();
+  std::size_t idle = pool.idle(content_coding::gzip);
+  encoder *first = nullptr;
+  {
+    encoder_ptr e = pool.acquire(content_coding::gzip, 1);
+    first = e.get();
+    check(e && e->coding() == content_coding::gzip, "a gzip encoder");
+  }
+  check(pool.idle(content_coding::gzip) == std::max<std::size_t>(idle, 1),
+        "given back");
+  encoder_ptr again = pool.acquire(content_coding::gzip, 9);
+  check(again.get() == first, "the same encoder again");
+
+  response rep;
+  rep.content = std::string(5000, 'x');
+  idle = pool.idle(content_coding::gzip);
+  compress_source source(std::move(again), rep);
+  drain(source, 1000);
+  check(pool.idle(content_coding::gzip) == idle + 1,
+        "back once the body is complete");
+  check(!pool.acquire(content_coding::identity, 0), "no identity encoder");
+}
+
+/// A response of `type` streaming `body` from a source.
+static void stream(response &rep, const std::string &body,
+                   std::string_view type) {
+  rep.headers.set(header_id::content_type, type);
+  rep.source = std::make_unique<callback_source>(
+      [&body, pos = std::size_t{0}](std::span<char> out,
+                                    asio::error_code &) mutable {
+        std::size_t size = std::min(out.size(), body.size() - pos);
+        std::copy_n(body.data() + pos, size, out.data());
+        pos += size;
+        return size;
+      });
+}
+
+static void test_stage() {
+  std::string page(4000, 'p');
+  request req;
+  req.method = "GET";
+  req.add_header("Accept-Encoding", "deflate, gzip;q=0.5");
+
+  // a streamed body is compressed on the fly
+  response rep;
+  stream(rep, page, "text/html");
+  compress_response(req, rep, {});
+  rep.update(true);
+  check(rep.source &&
+            rep.headers.find(header_id::content_encoding) == "deflate" &&
+            rep.headers.find(header_id::vary) == "Accept-Encoding" &&
+            rep.head().find("Transfer-Encoding: chunked") != std::string::npos &&
+            rep.head().find("Content-Length") == std::string::npos,
+        "compressed and chunked");
+  check(decode(content_coding::deflate, drain(*rep.source, 512)) == page,
+        "the compressed body");
+
+  // a cached file is compressed once, the variant has a length
+  fs::path script_path = fs::path(STATIC_PATH) / "assets" / "index-888ab6c0.js";
+  std::string script = read_file(script_path);
+  file_cache cache(1 << 20, 1 << 20);
+  response file;
+  file.cached = cache.get(script_path);
+  file.headers.set(header_id::content_type, "application/javascript");
+  compress_response(req, file, {}, &cache, script_path);
+  file.update(true);
+  check(!file.source && file.cached &&
+            file.headers.find(header_id::content_encoding) == "deflate" &&
+            file.head().find(fmt::format("Content-Length: {}\r\n",
+                                         file.cached->size())) !=
+                std::string::npos &&
+            file.head().find("Transfer-Encoding") == std::string::npos,
+        "a cached file has a compressed variant with a length");
+  check(decode(content_coding::deflate, file.cached->data()) == script &&
+            cache.size() == script.size() + file.cached->size(),
+        "the variant decodes and is kept with the file");
+  response again;
+  again.cached = cache.get(script_path);
+  again.headers.set(header_id::content_type, "application/javascript");
+  compress_response(req, again, {}, &cache, script_path);
+  check(again.cached == file.cached, "compressed only once");
+
+  response small;
+  fs::path index_path = fs::path(STATIC_PATH) / "index.html";
+  small.cached = cache.get(index_path);
+  small.headers.set(header_id::content_type, "text/html");
+  small.headers.set(header_id::vary, "Cookie");
+  compress_response(req, small, {}, &cache, index_path);
+  check(!small.headers.find(header_id::content_encoding) &&
+            small.headers.find(header_id::vary) == "Cookie",
+        "too small");
+
+  // content of a route or an error page and a file which is not cached are
+  // compressed on the fly like a stream
+  response content;
+  content.content = page;
+  content.headers.set(header_id::content_type, "text/plain");
+  compress_response(req, content, {});
+  check(content.source &&
+            content.headers.find(header_id::content_encoding) == "deflate" &&
+            content.headers.find(header_id::vary) == "Accept-Encoding",
+        "content is compressed");
+  check(decode(content_coding::deflate, drain(*content.source, 512)) == page,
+        "the compressed content");
+
+  response uncached;
+  check(uncached.file.open(script_path), "open the script");
+  uncached.headers.set(header_id::content_type, "application/javascript");
+  compress_response(req, uncached, {});
+  check(uncached.source &&
+            uncached.headers.find(header_id::content_encoding) == "deflate",
+        "a file which is not cached is compressed");
+  check(decode(content_coding::deflate, drain(*uncached.source, 512)) ==
+            script,
+        "the compressed file");
+
+  response short_content;
+  short_content.content = "not found";
+  short_content.headers.set(header_id::content_type, "text/html");
+  compress_response(req, short_content, {});
+  check(!short_content.source && short_content.content == "not found" &&
+            !short_content.headers.find(header_id::vary),
+        "short content goes out as it is");
+
+  response image;
+  stream(image, page, "image/png");
+  compress_response(req, image, {});
+  check(!image.headers.find(header_id::content_encoding) &&
+            !image.headers.find(header_id::vary),
+        "compressed already");
+
+  response encoded;
+  stream(encoded, page, "text/plain");
+  encoded.headers.set(header_id::content_encoding, "gzip");
+  compress_response(req, encoded, {});
+  check(encoded.headers.find(header_id::content_encoding) == "gzip",
+        "encoded by the handler");
+
+  compression_options off;
+  off.enable = false;
+  response disabled;
+  stream(disabled, page, "text/plain");
+  compress_response(req, disabled, off);
+  check(!disabled.headers.find(header_id::content_encoding), "disabled");
+
+  request head;
+  head.method = "HEAD";
+  head.add_header("Accept-Encoding", "gzip");
+  response for_head;
+  stream(for_head, page, "text/plain");
+  compress_response(head, for_head, {});
+  check(!for_head.headers.find(header_id::content_encoding),
+        "no body for HEAD");
+
+  request plain;
+  plain.method = "GET";
+  response identity;
+  stream(identity, page, "text/plain");
+  compress_response(plain, identity, {});
+  check(!identity.headers.find(header_id::content_encoding) &&
+            identity.headers.find(header_id::vary),
+        "no Accept-Encoding");
+}
+
+/// The body of the response starting at `pos` of `received`, dechunked,
+/// `pos` is moved behind it.
+static std::string next_body(const std::string &received, std::size_t &pos,
+                             std::string_view &head) {
+  std::size_t body = received.find("\r\n\r\n", pos) + 4;
+  head = std::string_view(received).substr(pos, body - pos);
+  std::size_t length = head.find("Content-Length: ");
+  if (length != std::string_view::npos) {
+    std::size_t size = std::stoul(std::string(head.substr(length + 16)));
+    pos = body + size;
+    return received.substr(body, size);
+  }
+  chunked_decoder chunks;
+  std::string data;
+  pos = body;
+  for (;;) {
+    auto [result, consumed, chunk] =
+        chunks.decode(std::string_view(received).substr(pos));
+    pos += consumed;
+    if (result == chunked_decoder::DATA) {
+      data += chunk;
+    } else {
+      check(result == chunked_decoder::DONE, "chunked framing");
+      return data;
+    }
+  }
+}
+
+static void test_server() {
+  std::string script =
+      read_file(fs::path(STATIC_PATH) / "assets" / "index-888ab6c0.js");
+  std::string favicon = read_file(fs::path(STATIC_PATH) / "favicon.ico");
+  server_options options;
+  options.thread_count = 1;
+  options.enable_ssl = false;
+  options.routes["/script"] = [&script](const request &, response &rep) {
+    stream(rep, script, "application/javascript");
+  };
+  std::string page(4000, 'p');
+  options.routes["/page"] = [&page](const request &, response &rep) {
+    rep.content = page;
+    rep.headers.set(header_id::content_type, "text/html");
+  };
+  server s("127.0.0.1", "18114", STATIC_PATH, options);
+  std::thread server_thread([&s]() { s.run(); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  asio::io_context context;
+  asio::ip::tcp::socket socket(context);
+  socket.connect({asio::ip::make_address("127.0.0.1"),
+                  static_cast<unsigned short>(18114)});
+  std::string requests;
+  for (std::string_view target :
+       {"/assets/index-888ab6c0.js", "/assets/index-888ab6c0.js",
+        "/favicon.ico", "/script", "/page"}) {
+    requests += "GET " + std::string(target) +
+                " HTTP/1.1\r\n"
+                "Accept-Encoding: gzip\r\n"
+                "Connection: keep-alive\r\n\r\n";
+  }
+  requests += "GET /index.html HTTP/1.1\r\nConnection: close\r\n\r\n";
+  asio::write(socket, asio::buffer(requests));
+  std::string received;
+  asio::error_code err;
+  asio::read(socket, asio::dynamic_buffer(received), err);
+  s.stop();
+  server_thread.join();
+
+  std::size_t pos = 0;
+  std::string_view head;
+  for (int i = 0; i < 2; i++) {
+    std::string encoded = next_body(received, pos, head);
+    check(head.find("Content-Encoding: gzip\r\n") != std::string::npos &&
+              head.find("Transfer-Encoding") == std::string::npos &&
+              encoded.size() < script.size() / 2 &&
+              decode(content_coding::gzip, encoded) == script,
+          "a compressed static file with a length");
+  }
+  check(next_body(received, pos, head) == favicon &&
+            head.find("Content-Encoding") == std::string::npos,
+        "an icon goes out as it is");
+  std::string streamed = next_body(received, pos, head);
+  check(head.find("Content-Encoding: gzip\r\n") != std::string::npos &&
+            head.find("Transfer-Encoding: chunked\r\n") != std::string::npos &&
+            decode(content_coding::gzip, streamed) == script,
+        "a streamed body compressed on the fly");
+  std::string content = next_body(received, pos, head);
+  check(head.find("Content-Encoding: gzip\r\n") != std::string::npos &&
+            decode(content_coding::gzip, content) == page,
+        "the content of a route compressed on the fly");
+  check(next_body(received, pos, head) ==
+                read_file(fs::path(STATIC_PATH) / "index.html") &&
+            pos == received.size(),
+        "the last response");
+}
+
+int main() {
+  test_fixtures();
+  test_negotiate();
+  for (content_coding coding :
+       {content_coding::gzip, content_coding::deflate, content_coding::br,
+        content_coding::zstd}) {
+    if (coding_available(coding)) {
+      test_round_trip(coding);
+    }
+  }
+  test_pool();
+  test_stage();
+  test_server();
+  spdlog::info("all content encoding tests passed");
+  return 0;
+}
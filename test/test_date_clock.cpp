@@ -0,0 +1,178 @@
+#include "check.hpp"
+#include "date_clock.hpp"
+#include "response.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <functional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <tuple>
+
+#include <spdlog/spdlog.h>
+
+// the Date line as an IMF-fixdate, rendered again only once the second it
+// shows is over on the monotonic clock, across the end of a minute, a day, a
+// month, a leap day and a year
+
+using namespace http::server;
+using namespace std::chrono_literals;
+
+static std::string formatted(std::int64_t seconds) {
+  std::string line(date_clock::LINE_SIZE, '\0');
+  date_clock::format(seconds, line.data());
+  return line;
+}
+
+/// The same line through gmtime and strftime in the C locale.
+static std::string reference(std::int64_t seconds) {
+  std::time_t t = static_cast<std::time_t>(seconds);
+  std::tm tm{};
+#if defined(_WIN32)
+  gmtime_s(&tm, &t);
+#else
+  gmtime_r(&t, &tm);
+#endif
+  char buffer[64];
+  std::size_t size = std::strftime(buffer, sizeof(buffer),
+                                   "Date: %a, %d %b %Y %H:%M:%S GMT\r\n", &tm);
+  return std::string(buffer, size);
+}
+
+static void check_format() {
+  check(formatted(784111777) == "Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n",
+        "the example of RFC 9110");
+  check(formatted(0) == "Date: Thu, 01 Jan 1970 00:00:00 GMT\r\n", "epoch");
+  check(formatted(951782400) == "Date: Tue, 29 Feb 2000 00:00:00 GMT\r\n",
+        "leap day of a leap century");
+  check(formatted(4107542400) == "Date: Mon, 01 Mar 2100 00:00:00 GMT\r\n",
+        "no leap day in 2100");
+  check(formatted(253402300799) == "Date: Fri, 31 Dec 9999 23:59:59 GMT\r\n",
+        "last second with four digits");
+
+  std::mt19937_64 random(21);
+  std::uniform_int_distribution<std::int64_t> seconds(0, 4102444800);
+  for (int i = 0; i < 100000; i++) {
+    std::int64_t s = seconds(random);
+    if (formatted(s) != reference(s)) {
+      check(false, reference(s));
+    }
+  }
+}
+
+/// A wall clock under the control of the test, counts how often it is read.
+struct fake_wall {
+  std::chrono::system_clock::time_point now;
+  int reads{};
+
+  std::chrono::system_clock::time_point operator()() {
+    reads++;
+    return now;
+  }
+};
+
+static std::chrono::system_clock::time_point at(std::int64_t seconds) {
+  return std::chrono::system_clock::time_point(std::chrono::seconds(seconds));
+}
+
+static void check_rollover() {
+  date_clock clock;
+  fake_wall wall{at(946684799) + 600ms};
+  date_clock::tick tick = 5s;
+  auto line = [&](date_clock::tick elapsed) {
+    wall.now += elapsed;
+    tick += elapsed;
+    return std::string(clock.line(tick, std::ref(wall)));
+  };
+
+  check(line(0ms) == "Date: Fri, 31 Dec 1999 23:59:59 GMT\r\n" &&
+            wall.reads == 1,
+        "the first line is rendered");
+  check(line(100ms) == "Date: Fri, 31 Dec 1999 23:59:59 GMT\r\n" &&
+            line(299ms) == "Date: Fri, 31 Dec 1999 23:59:59 GMT\r\n" &&
+            wall.reads == 1,
+        "the same second is not rendered again");
+  check(line(1ms) == "Date: Sat, 01 Jan 2000 00:00:00 GMT\r\n" &&
+            wall.reads == 2,
+        "the end of the year rolls over on the dot");
+  check(line(999ms) == "Date: Sat, 01 Jan 2000 00:00:00 GMT\r\n" &&
+            line(1ms) == "Date: Sat, 01 Jan 2000 00:00:01 GMT\r\n" &&
+            wall.reads == 3,
+        "one render per second");
+  check(line(59s) == "Date: Sat, 01 Jan 2000 00:01:00 GMT\r\n" &&
+            wall.reads == 4,
+        "seconds skipped while idle are not rendered");
+
+  // the end of a day, a month and a leap day
+  for (auto [seconds, before, after] :
+       {std::tuple<std::int64_t, std::string_view, std::string_view>{
+            951868799, "Date: Tue, 29 Feb 2000 23:59:59 GMT\r\n",
+            "Date: Wed, 01 Mar 2000 00:00:00 GMT\r\n"},
+        {1709164799, "Date: Wed, 28 Feb 2024 23:59:59 GMT\r\n",
+         "Date: Thu, 29 Feb 2024 00:00:00 GMT\r\n"},
+        {1714521599, "Date: Tue, 30 Apr 2024 23:59:59 GMT\r\n",
+         "Date: Wed, 01 May 2024 00:00:00 GMT\r\n"}}) {
+    date_clock c;
+    fake_wall w{at(seconds) + 999ms};
+    check(c.line(10s, std::ref(w)) == before, before);
+    w.now += 1ms;
+    check(c.line(10s + 1ms, std::ref(w)) == after, after);
+  }
+
+  // a wall clock stepped back shows up at the end of the second
+  {
+    date_clock c;
+    fake_wall w{at(784111777)};
+    c.line(1s, std::ref(w));
+    w.now -= 1h;
+    check(c.line(1s + 999ms, std::ref(w)) ==
+                  "Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n" &&
+              c.line(2s, std::ref(w)) ==
+                  "Date: Sun, 06 Nov 1994 07:49:37 GMT\r\n",
+          "stepped wall clock");
+  }
+}
+
+static void check_response() {
+  date_clock clock;
+  std::string_view date = clock.line();
+  check(date.size() == date_clock::LINE_SIZE &&
+            date.substr(0, 6) == "Date: " && date.substr(date.size() - 6) == " GMT\r\n",
+        "the line of now");
+  check(clock.line().data() == date.data() &&
+            date_clock::local().line().size() == date_clock::LINE_SIZE,
+        "one buffer per clock");
+
+  response rep;
+  rep.headers.set(header_id::content_type, "text/plain");
+  rep.content = "hi";
+  rep.update(true, "Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n");
+  check(rep.head() == "HTTP/1.1 200 OK\r\n"
+                      "Content-Type: text/plain\r\n"
+                      "Server: TinyHttpServer\r\n"
+                      "Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n"
+                      "Content-Length: 2\r\n"
+                      "Connection: keep-alive\r\n\r\n",
+        "the Server and Date lines in the head");
+  rep.clear();
+  rep.content = "hi";
+  rep.headers.set(header_id::date, "Mon, 07 Nov 1994 08:49:37 GMT");
+  rep.headers.set(header_id::server, "other");
+  rep.update(false, "Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n");
+  check(rep.head() == "HTTP/1.1 200 OK\r\n"
+                      "Date: Mon, 07 Nov 1994 08:49:37 GMT\r\n"
+                      "Server: other\r\n"
+                      "Content-Length: 2\r\n"
+                      "Connection: close\r\n\r\n",
+        "a Server and Date set by the handler win");
+}
+
+int main() {
+  check_format();
+  check_rollover();
+  check_response();
+  spdlog::info("all date clock tests passed");
+  return 0;
+}
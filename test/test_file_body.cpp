@@ -0,0 +1,146 @@
+#include "check.hpp"
+#include "file_body.hpp"
+#include "send_queue.hpp"
+#include "server.hpp"
+
+#include <asio.hpp>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+
+#include <spdlog/spdlog.h>
+
+// static files as file bodies: only regular files open, the send queue hands
+// out the buffers in front of a file, then the file, then the rest, and a
+// live server sends files byte for byte between pipelined responses
+
+using namespace http::server;
+namespace fs = std::filesystem;
+
+static std::string read_file(const fs::path &path) {
+  std::ifstream in(path, std::ios::in | std::ios::binary);
+  return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+static void check_open() {
+  file_body file;
+  fs::path index = fs::path(STATIC_PATH) / "index.html";
+  check(file.open(index) && file.is_open() &&
+            file.size() == fs::file_size(index),
+        "open a regular file");
+  file_body moved = std::move(file);
+  check(!file.is_open() && file.size() == 0 && moved.is_open(),
+        "moved from");
+  check(!moved.open(fs::path(STATIC_PATH) / "assets") && !moved.is_open(),
+        "a directory is no file body");
+  check(!moved.open(fs::path(STATIC_PATH) / "missing.html"), "missing file");
+
+  check(moved.open(index), "open again");
+  std::string expected = read_file(index);
+  char buffer[16];
+  asio::error_code err;
+  std::size_t n = file_body::read(moved.native_handle(), 4, buffer,
+                                  sizeof(buffer), err);
+  check(!err && std::string_view(buffer, n) == expected.substr(4, n),
+        "read from an offset");
+  file_body::read(moved.native_handle(), moved.size(), buffer,
+                  sizeof(buffer), err);
+  check(err == asio::error::eof, "read past the end");
+}
+
+static void check_queue() {
+  std::string_view a = "head a\r\n\r\n";
+  std::string_view b = "head b\r\n\r\n";
+  send_queue queue;
+  queue.push_back(asio::buffer(a));
+  queue.push_file(7, 100, 50);
+  queue.push_back(asio::buffer(b));
+  queue.push_file(8, 0, 0);
+  check(queue.batch().size() == 1 && !queue.next_file(),
+        "the batch stops in front of the file");
+  queue.consume(4);
+  check(queue.batch().size() == 1 && queue.batch()[0].size() == a.size() - 4,
+        "partially written buffer");
+  queue.consume(a.size() - 4);
+  const send_queue::file_part *file = queue.next_file();
+  check(file && file->fd == 7 && file->offset == 100 && file->size == 50 &&
+            queue.batch().empty(),
+        "then the file");
+  queue.consume(30);
+  check(queue.next_file() && queue.next_file()->offset == 130 &&
+            queue.next_file()->size == 20,
+        "file progress");
+  queue.consume(20);
+  check(!queue.next_file() && queue.batch().size() == 1 &&
+            queue.batch()[0].data() == b.data(),
+        "then the buffers behind it, an empty file is skipped");
+  queue.consume(b.size());
+  check(queue.empty(), "drained");
+
+  // a file as the last thing queued, then buffers pushed while it is sent,
+  // the queue compacts around it
+  queue.push_back(asio::buffer(a));
+  queue.push_file(9, 0, 10);
+  queue.consume(a.size());
+  for (std::size_t i = 0; i < send_queue::INLINE_CAPACITY * 2; i++) {
+    queue.push_back(asio::buffer(b));
+  }
+  check(queue.next_file() && queue.next_file()->fd == 9, "file first");
+  queue.consume(10);
+  check(!queue.next_file() &&
+            queue.size() == send_queue::INLINE_CAPACITY * 2,
+        "buffers queued behind a file");
+  queue.clear();
+  check(queue.empty(), "clear() drops the files");
+}
+
+static void check_server() {
+  server_options options;
+  options.thread_count = 1;
+  options.enable_ssl = false;
+  server s("127.0.0.1", "18098", STATIC_PATH, options);
+  std::thread server_thread([&s]() { s.run(); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  std::string index = read_file(fs::path(STATIC_PATH) / "index.html");
+  std::string favicon = read_file(fs::path(STATIC_PATH) / "favicon.ico");
+  asio::io_context context;
+  asio::ip::tcp::socket socket(context);
+  socket.connect({asio::ip::make_address("127.0.0.1"),
+                  static_cast<unsigned short>(18098)});
+  std::string requests = "GET /index.html HTTP/1.1\r\n"
+                         "Connection: keep-alive\r\n\r\n"
+                         "GET /missing.html HTTP/1.1\r\n"
+                         "Connection: keep-alive\r\n\r\n"
+                         "GET /favicon.ico HTTP/1.1\r\n"
+                         "Connection: close\r\n\r\n";
+  asio::write(socket, asio::buffer(requests));
+  std::string received;
+  asio::error_code err;
+  asio::read(socket, asio::dynamic_buffer(received), err);
+  s.stop();
+  server_thread.join();
+
+  std::size_t first = received.find("\r\n\r\n") + 4;
+  std::size_t second = received.find("HTTP/1.1 404", first);
+  std::size_t third = received.find("HTTP/1.1 200", second);
+  std::size_t third_body = received.find("\r\n\r\n", third) + 4;
+  check(received.find("Content-Length: " + std::to_string(index.size())) <
+                first &&
+            received.compare(first, index.size(), index) == 0 &&
+            second == first + index.size(),
+        "a file between the head and the next response");
+  check(third != std::string::npos &&
+            received.substr(third_body) == favicon,
+        "the file of the last response");
+}
+
+int main() {
+  check_open();
+  check_queue();
+  check_server();
+  spdlog::info("all file body tests passed");
+  return 0;
+}
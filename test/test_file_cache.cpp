@@ -0,0 +1,136 @@
+#include "check.hpp"
+#include "file_cache.hpp"
+#include "response.hpp"
+#include "send_queue.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+
+#include <spdlog/spdlog.h>
+
+// static files read once and shared: the same copy for every request, a
+// replaced or modified file read again after the revalidation interval while
+// old responses keep theirs intact, even when the file is truncated in place,
+// the least recently used files dropped to stay within the capacity, variants
+// of a file kept with it and the copy sent straight from the send queue
+
+using namespace http::server;
+using namespace std::chrono_literals;
+namespace fs = std::filesystem;
+
+static void write_file(const fs::path &path, std::string_view data) {
+  std::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
+  out.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+int main() {
+  fs::path dir = fs::temp_directory_path() / "test_file_cache";
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+  write_file(dir / "a.css", "body { color: red; }");
+  write_file(dir / "b.js", std::string(300, 'b'));
+  write_file(dir / "c.js", std::string(300, 'c'));
+  write_file(dir / "large.bin", std::string(2000, 'l'));
+  write_file(dir / "empty.txt", "");
+
+  file_cache cache(700, 1000, 1s);
+  date_clock::tick now = 10s;
+  auto a = cache.get(dir / "a.css", now);
+  check(a && a->data() == "body { color: red; }", "read on first use");
+  check(cache.get(dir / "a.css", now + 1ms) == a && a.use_count() == 3,
+        "every response shares the copy");
+  check(!cache.get(dir / "large.bin", now) &&
+            !cache.get(dir / "empty.txt", now) &&
+            !cache.get(dir / "missing.txt", now) && !cache.get(dir, now),
+        "not cached: too large, empty, missing, a directory");
+  check(cache.count() == 1 && cache.size() == 20, "one file kept");
+
+  // a replaced file, the old copy is only seen until the next check
+  fs::remove(dir / "a.css");
+  write_file(dir / "a.css", "body { color: blue; }");
+  check(cache.get(dir / "a.css", now + 999ms) == a, "not checked again yet");
+  auto replaced = cache.get(dir / "a.css", now + 1s);
+  check(replaced && replaced != a &&
+            replaced->data() == "body { color: blue; }" &&
+            a->data() == "body { color: red; }" && cache.size() == 21,
+        "replaced file read again, the old copy stays intact");
+  fs::remove(dir / "a.css");
+  check(!cache.get(dir / "a.css", now + 2s) && cache.count() == 0 &&
+            cache.size() == 0,
+        "removed file dropped");
+
+  // rewritten in place, a response still sending the old copy is not torn
+  write_file(dir / "a.css", "body { color: red; }");
+  auto before = cache.get(dir / "a.css", now + 3s);
+  write_file(dir / "a.css", "");
+  check(before->data() == "body { color: red; }",
+        "a file truncated in place leaves the copy intact");
+  check(!cache.get(dir / "a.css", now + 4s) && cache.count() == 0,
+        "the truncated file is dropped");
+  before.reset();
+  write_file(dir / "a.css", "body { color: red; }");
+
+  // 20 + 300 + 300 fit, another 300 push out the least recently used
+  now = 20s;
+  cache.get(dir / "a.css", now);
+  auto b = cache.get(dir / "b.js", now + 1ms);
+  cache.get(dir / "c.js", now + 2ms);
+  cache.get(dir / "a.css", now + 3ms);
+  write_file(dir / "d.js", std::string(300, 'd'));
+  auto d = cache.get(dir / "d.js", now + 4ms);
+  check(d && cache.count() == 3 && cache.size() == 620,
+        "the least recently used file was dropped");
+  check(b->data() == std::string(300, 'b'), "a dropped copy stays valid");
+  check(cache.get(dir / "b.js", now + 5ms) != b, "dropped file read again");
+
+  // a variant is made once, counts against the capacity and goes with its file
+  {
+    file_cache variants(1000, 1000, 1s);
+    now = 30s;
+    write_file(dir / "v.txt", std::string(100, 'v'));
+    auto file = variants.get(dir / "v.txt", now);
+    int made = 0;
+    file_cache::variant_encoder halve = [&made](std::string_view data) {
+      made++;
+      return std::optional<std::string>(std::string(data.size() / 2, 'V'));
+    };
+    auto half = variants.variant(dir / "v.txt", file, 1, halve);
+    check(half && half->data() == std::string(50, 'V') &&
+              variants.variant(dir / "v.txt", file, 1, halve) == half &&
+              made == 1 && variants.size() == 150,
+          "a variant made once");
+    file_cache::variant_encoder none = [&made](std::string_view) {
+      made++;
+      return std::optional<std::string>();
+    };
+    check(!variants.variant(dir / "v.txt", file, 2, none) &&
+              !variants.variant(dir / "v.txt", file, 2, none) && made == 2,
+          "no variant is remembered as well");
+    fs::remove(dir / "v.txt");
+    write_file(dir / "v.txt", std::string(200, 'w'));
+    auto changed = variants.get(dir / "v.txt", now + 1s);
+    check(changed != file && variants.size() == 200 &&
+              variants.variant(dir / "v.txt", file, 1, halve) &&
+              variants.size() == 200 && made == 3,
+          "the variants go with the old file, its new ones are not kept");
+  }
+
+  // the copy goes to the send queue as it is
+  response rep;
+  rep.cached = d;
+  rep.update(true);
+  send_queue queue;
+  rep.to_buffers(queue);
+  check(queue.size() == 2 && queue.batch()[1].data() == d->data().data() &&
+            rep.head().find("Content-Length: 300\r\n") != std::string::npos,
+        "the copy is a buffer of the response");
+  rep.clear();
+  // held here and by the cache
+  check(d.use_count() == 2, "clear() drops the reference");
+
+  fs::remove_all(dir);
+  spdlog::info("all file cache tests passed");
+  return 0;
+}
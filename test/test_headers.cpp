@@ -0,0 +1,179 @@
+#include "alloc_counter.hpp"
+#include "check.hpp"
+#include "header_names.hpp"
+#include "request.hpp"
+#include "request_parser.hpp"
+#include "response.hpp"
+
+#include <cctype>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+
+#include <spdlog/spdlog.h>
+
+// well known header fields are resolved once by the perfect hash, found in
+// O(1) without regard to case and without touching the heap, for requests and
+// for responses
+
+using namespace http::server;
+
+static std::string with_case(std::string_view name, int (*convert)(int)) {
+  std::string out;
+  for (char ch : name) {
+    out.push_back(static_cast<char>(convert(static_cast<unsigned char>(ch))));
+  }
+  return out;
+}
+
+static void check_lookup() {
+  for (std::size_t i = 0; i < WELL_KNOWN_HEADERS; i++) {
+    auto id = static_cast<header_id>(i);
+    std::string_view name = header_name(id);
+    check(!name.empty(), "every id has a name");
+    check(lookup_header(name) == id, "canonical name");
+    check(lookup_header(with_case(name, ::tolower)) == id, "lower case name");
+    check(lookup_header(with_case(name, ::toupper)) == id, "upper case name");
+    check(lookup_header(name.substr(0, name.size() - 1)) == header_id::unknown,
+          "prefix of a name");
+    check(lookup_header(std::string(name) + "s") == header_id::unknown,
+          "name with a suffix");
+  }
+  for (std::string_view name :
+       {"", "X-Custom", "Content_Length", "Sec-Fetch-Mode", "Hos^",
+        "Connection\x0d"}) {
+    check(lookup_header(name) == header_id::unknown, "unknown name");
+  }
+  check(header_name(header_id::unknown).empty(), "unknown has no name");
+}
+
+static const std::string_view REQUEST = "POST /upload HTTP/1.1\r\n"
+                                        "host: 127.0.0.1:8080\r\n"
+                                        "connection: keep-alive\r\n"
+                                        "CONTENT-LENGTH: 5\r\n"
+                                        "X-Trace: a\r\n"
+                                        "Cookie: a=1\r\n"
+                                        "cookie: b=2\r\n"
+                                        "x-trace: b\r\n"
+                                        "\r\n";
+
+static void check_request() {
+  request req;
+  request_parser parser;
+  alloc_counter::counting = true;
+  alloc_counter::allocations = 0;
+  auto [result, pos] = parser.parse(req, REQUEST);
+  req.update();
+  bool found = req.find_header(header_id::host) == "127.0.0.1:8080" &&
+               req.find_header("Host") == "127.0.0.1:8080" &&
+               req.find_header(header_id::cookie) == "a=1" &&
+               req.find_header("X-TRACE") == "a" &&
+               !req.find_header(header_id::user_agent) &&
+               !req.find_header("X-Missing");
+  alloc_counter::counting = false;
+  check(result == request_parser::PASS && pos + 1 == REQUEST.size(), "parse");
+  check(req.keep_alive, "lower case connection: keep-alive");
+  check(req.content_length == 5, "upper case content-length");
+  check(found, "lookups, the first of repeated fields");
+  check(alloc_counter::allocations == 0,
+        "no allocation while parsing and looking up");
+  check(req.headers[0].id == header_id::host &&
+            req.headers[3].id == header_id::unknown,
+        "fields carry their id");
+
+  req.clear();
+  check(!req.find_header(header_id::host) && !req.find_header("cookie"),
+        "clear() empties the slots");
+}
+
+static void check_response() {
+  response rep;
+  rep.headers.set(header_id::content_type, "text/html");
+  rep.headers.set("X-Frame-Options", "DENY");
+  rep.headers.set("content-type", "text/plain");
+  rep.headers.set("x-frame-options", "SAMEORIGIN");
+  rep.headers.set(header_id::server, "TinyHttpServer");
+  check(rep.headers.size() == 3, "setting again replaces");
+  const response_headers &fields = rep.headers;
+  check(fields[0].name == "Content-Type" && fields[0].value == "text/plain",
+        "well known fields are sent with their canonical name");
+  check(fields[1].name == "X-Frame-Options" &&
+            fields[1].value == "SAMEORIGIN",
+        "other fields keep the name they were first set with");
+  check(fields[2].name == "Server", "in the order first set");
+  check(rep.headers.find("CONTENT-TYPE") == "text/plain" &&
+            rep.headers.find(header_id::server) == "TinyHttpServer" &&
+            rep.headers.find("X-FRAME-OPTIONS") == "SAMEORIGIN" &&
+            !rep.headers.find(header_id::connection),
+        "response lookups");
+
+  // a response reused for the next request keeps its strings
+  std::string long_value(64, 'v');
+  for (int round = 0; round < 3; round++) {
+    if (round == 2) {
+      alloc_counter::counting = true;
+      alloc_counter::allocations = 0;
+    }
+    rep.clear();
+    rep.headers.set(header_id::content_type, long_value);
+    rep.headers.set("X-Frame-Options", long_value);
+    rep.update(true);
+    alloc_counter::counting = false;
+  }
+  check(alloc_counter::allocations == 0, "a reused response does not allocate");
+  check(rep.head() == "HTTP/1.1 200 OK\r\n"
+                      "Content-Type: " +
+                          long_value +
+                          "\r\n"
+                          "X-Frame-Options: " +
+                          long_value +
+                          "\r\n"
+                          "Server: TinyHttpServer\r\n"
+                          "Content-Length: 0\r\n"
+                          "Connection: keep-alive\r\n\r\n",
+        "update() renders the head");
+
+  // Content-Length and Connection come from the content and keep_alive
+  rep.clear();
+  rep.status = response::not_found;
+  rep.content = "missing";
+  rep.headers.set(header_id::content_length, "1234");
+  rep.headers.set(header_id::connection, "keep-alive");
+  rep.update(false);
+  check(rep.head() == "HTTP/1.1 404 Not Found\r\n"
+                      "Server: TinyHttpServer\r\n"
+                      "Content-Length: 7\r\n"
+                      "Connection: close\r\n\r\n",
+        "update() writes its own fields");
+  // replacing a value moves the lines behind it
+  rep.clear();
+  rep.headers.set(header_id::content_type, "text/html");
+  rep.headers.set("X-Tag", "a");
+  rep.headers.set(header_id::etag, "\"1\"");
+  rep.headers.set("x-tag", "a longer value");
+  rep.headers.set(header_id::content_type, "text/css");
+  check(rep.headers.lines() == "Content-Type: text/css\r\n"
+                               "X-Tag: a longer value\r\n"
+                               "ETag: \"1\"\r\n" &&
+            rep.headers.find(header_id::etag) == "\"1\"",
+        "replaced values");
+  rep.headers.set(header_id::connection, "close");
+  rep.headers.set(header_id::vary, "Accept");
+  rep.headers.erase(header_id::connection);
+  check(rep.headers.size() == 4 &&
+            rep.headers.find(header_id::vary) == "Accept" &&
+            rep.headers.lines().substr(rep.headers.lines().size() - 14) ==
+                "Vary: Accept\r\n",
+        "erased field");
+  rep.status = static_cast<response::status_type>(799);
+  rep.update(false);
+  check(rep.head().substr(0, 14) == "HTTP/1.1 500 I", "unknown status");
+}
+
+int main() {
+  check_lookup();
+  check_request();
+  check_response();
+  spdlog::info("all header tests passed");
+  return 0;
+}
@@ -0,0 +1,260 @@
+#include "llhttp_parser.hpp"
+#include "request.hpp"
+#include "request_parser.hpp"
+#include "string_utils.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+// request_parser and llhttp_parser get the same byte streams, the captures in
+// data/test_*.txt and generated requests, valid and broken ones, each split
+// into random chunks. Both have to come to the same result and, for a
+// complete header, to the same request. Headers right at and just over each
+// of the header_limits get the same status code from both, and so do the
+// headers framing the body in valid and in smuggling ways.
+
+using namespace http::server;
+namespace fs = std::filesystem;
+
+static void check(bool ok, std::string_view what, std::string_view data) {
+  if (!ok) {
+    spdlog::error("failed: {}", what);
+    spdlog::error("request:\n{}", string_utils::escaped(data));
+    exit(EXIT_FAILURE);
+  }
+}
+
+struct outcome {
+  request_parser::parse_result result{request_parser::CONTINUE};
+  // bytes up to the end of the header
+  std::size_t size{};
+  request req{};
+};
+
+/// Feed `data` to `parser` in the chunks ending at `cuts`.
+template <typename Parser>
+static outcome feed(std::string_view data, const std::vector<std::size_t> &cuts,
+                    const header_limits &limits = {}) {
+  Parser parser(limits);
+  outcome out;
+  std::size_t begin = 0;
+  for (std::size_t end : cuts) {
+    auto [result, pos] = parser.parse(out.req, data.substr(begin, end - begin));
+    if (result != request_parser::CONTINUE) {
+      out.result = result;
+      out.size = begin + pos + 1;
+      return out;
+    }
+    begin = end;
+  }
+  return out;
+}
+
+static bool same_request(const request &a, const request &b) {
+  if (a.method != b.method || a.request_target != b.request_target ||
+      a.http_version_major != b.http_version_major ||
+      a.http_version_minor != b.http_version_minor ||
+      a.headers.size() != b.headers.size()) {
+    return false;
+  }
+  for (std::size_t i = 0; i < a.headers.size(); i++) {
+    if (a.headers[i].name != b.headers[i].name ||
+        a.headers[i].value != b.headers[i].value) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void compare(std::string_view data, std::mt19937 &rng,
+                    std::string_view what) {
+  for (int round = 0; round < 20; round++) {
+    std::vector<std::size_t> cuts;
+    std::uniform_int_distribution<std::size_t> piece(1, round < 10 ? 8 : 512);
+    for (std::size_t end = 0; end < data.size();) {
+      end = std::min(data.size(), end + piece(rng));
+      cuts.push_back(end);
+    }
+    outcome builtin = feed<request_parser>(data, cuts);
+    outcome llhttp = feed<llhttp_parser>(data, cuts);
+    check(builtin.result == llhttp.result, what, data);
+    if (builtin.result == request_parser::PASS) {
+      check(builtin.size == llhttp.size && same_request(builtin.req, llhttp.req),
+            what, data);
+    }
+  }
+}
+
+static std::string pick(std::mt19937 &rng, std::string_view chars,
+                        std::size_t min, std::size_t max) {
+  std::uniform_int_distribution<std::size_t> length(min, max);
+  std::uniform_int_distribution<std::size_t> index(0, chars.size() - 1);
+  std::string out(length(rng), '\0');
+  for (char &ch : out) {
+    ch = chars[index(rng)];
+  }
+  return out;
+}
+
+/// A valid request header, with OWS around some of the field values.
+static std::string generate(std::mt19937 &rng) {
+  static const char *methods[] = {"GET",    "HEAD",    "POST", "PUT",
+                                  "DELETE", "OPTIONS", "PATCH"};
+  static const std::string_view token_chars =
+      "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789"
+      "!#$%&'*+-.^_`|~";
+  static const std::string_view path_chars =
+      "abcdefghijklmnopqrstuvwxyz0123456789-._~%!$&'()*+,;=:@/?";
+  static const std::string_view value_chars =
+      "abcdefghijklmnopqrstuvwxyzABCDEFGHIJ0123456789 \t!\"#$%&'()*+,-./:;<=>?@[]{}";
+  std::string out = methods[rng() % std::size(methods)];
+  out += " /" + pick(rng, path_chars, 0, 64);
+  out += rng() % 2 ? " HTTP/1.1\r\n" : " HTTP/1.0\r\n";
+  std::size_t fields = rng() % 24;
+  for (std::size_t i = 0; i < fields; i++) {
+    out += pick(rng, token_chars, 1, 24) + ":";
+    out += pick(rng, " \t", 0, 2);
+    // a value neither starts nor ends with OWS once trimmed
+    out += pick(rng, "abcdefghij", 1, 1) + pick(rng, value_chars, 0, 80) +
+           pick(rng, "abcdefghij", 1, 1);
+    out += pick(rng, " \t", 0, 2) + "\r\n";
+  }
+  out += "\r\n";
+  return out;
+}
+
+/// `data` with one byte of its header replaced by a control character.
+static std::string corrupt(std::string data, std::mt19937 &rng) {
+  static const std::string_view controls = "\x01\x02\x03\x04\x05\x06\x07\x08"
+                                           "\x0b\x0c\x0e\x0f\x10\x1b\x1f";
+  std::size_t header_size = data.find("\r\n\r\n") + 2;
+  data[rng() % header_size] = controls[rng() % controls.size()];
+  return data;
+}
+
+/// Both parsers come to `expected` for `data` split in chunks of
+/// `chunk_size`.
+static void compare_limit(std::string_view data, const header_limits &limits,
+                          request_parser::parse_result expected,
+                          std::string_view what) {
+  for (std::size_t chunk_size : {std::size_t(1), std::size_t(7), data.size()}) {
+    std::vector<std::size_t> cuts;
+    for (std::size_t end = 0; end < data.size();) {
+      end = std::min(data.size(), end + chunk_size);
+      cuts.push_back(end);
+    }
+    check(feed<request_parser>(data, cuts, limits).result == expected, what,
+          data);
+    check(feed<llhttp_parser>(data, cuts, limits).result == expected, what,
+          data);
+  }
+}
+
+/// Whether a request is refused with 400 for its header, by the parser or
+/// by request::update().
+static bool refused(outcome &out) {
+  return out.result == request_parser::FAIL ||
+         (out.result == request_parser::PASS && !out.req.update());
+}
+
+static void compare_framing() {
+  for (std::string_view fields :
+       {"Content-Length: 5\r\n", "Content-Length: 007\r\n",
+        "Content-Length:  5 \r\n", "Content-Length: abc\r\n",
+        "Content-Length: 5x\r\n", "Content-Length: -1\r\n",
+        "Content-Length: \r\n", "Content-Length: 5 5\r\n",
+        "Content-Length: 5, 5\r\n",
+        "Content-Length: 5\r\nContent-Length: 5\r\n",
+        "Content-Length: 5\r\nContent-Length: 6\r\n",
+        "Content-Length: 99999999999999999999999\r\n",
+        "Transfer-Encoding: chunked\r\n", "Transfer-Encoding: gzip\r\n",
+        "Transfer-Encoding: gzip, chunked\r\n",
+        "Transfer-Encoding: chunked, gzip\r\n",
+        "Content-Length: 5\r\nTransfer-Encoding: chunked\r\n",
+        "Transfer-Encoding: chunked\r\nContent-Length: 5\r\n"}) {
+    std::string data = "POST /upload HTTP/1.1\r\nHost: a\r\n";
+    data += fields;
+    data += "\r\n";
+    std::vector<std::size_t> cuts{data.size()};
+    outcome builtin = feed<request_parser>(data, cuts);
+    outcome llhttp = feed<llhttp_parser>(data, cuts);
+    bool builtin_refused = refused(builtin);
+    check(builtin_refused == refused(llhttp), fields, data);
+    if (!builtin_refused) {
+      check(builtin.req.content_length == llhttp.req.content_length &&
+                builtin.req.chunked == llhttp.req.chunked &&
+                builtin.req.keep_alive == llhttp.req.keep_alive,
+            fields, data);
+    }
+  }
+}
+
+static void compare_limits() {
+  header_limits limits;
+  limits.max_request_line = 64;
+  limits.max_field_size = 32;
+  limits.max_field_count = 4;
+  limits.max_header_bytes = 160;
+  auto request_line = [](std::size_t length) {
+    std::string_view rest = " HTTP/1.1";
+    std::string line = "GET /";
+    line.append(length - line.size() - rest.size(), 'a');
+    line += rest;
+    return line + "\r\n";
+  };
+  auto field = [](std::size_t length) {
+    std::string line = "X-Field: ";
+    line.append(length - line.size(), 'v');
+    return line + "\r\n";
+  };
+  compare_limit(request_line(64) + "\r\n", limits, request_parser::PASS,
+                "request line at the limit");
+  compare_limit(request_line(65) + "\r\n", limits,
+                request_parser::URI_TOO_LONG, "request line over the limit");
+  std::string line = request_line(16);
+  compare_limit(line + field(32) + "\r\n", limits, request_parser::PASS,
+                "field at the limit");
+  compare_limit(line + field(33) + "\r\n", limits,
+                request_parser::HEADER_TOO_LARGE, "field over the limit");
+  std::string fields = line;
+  for (int i = 0; i < 4; i++) {
+    fields += field(16);
+  }
+  compare_limit(fields + "\r\n", limits, request_parser::PASS,
+                "field count at the limit");
+  compare_limit(fields + field(16) + "\r\n", limits,
+                request_parser::HEADER_TOO_LARGE, "field count over the limit");
+}
+
+int main() {
+  std::mt19937 rng(20231018);
+  fs::path data_path = fs::u8path(DATA_PATH);
+  for (auto name : {"test_header1.txt", "test_header2.txt", "test_header3.txt",
+                    "test_header4.txt", "test_post1.txt", "test_post2.txt",
+                    "test_post3.txt"}) {
+    std::ifstream in(data_path / name, std::ios::in | std::ios::binary);
+    std::string data{std::istreambuf_iterator<char>(in),
+                     std::istreambuf_iterator<char>()};
+    if (data.find("\r\n\r\n") == std::string::npos) {
+      // the header captures stop after the last field line
+      data += "\r\n\r\n";
+    }
+    compare(data, rng, name);
+    compare(corrupt(data, rng), rng, name);
+  }
+  for (int i = 0; i < 2000; i++) {
+    std::string data = generate(rng);
+    compare(data, rng, "generated request");
+    compare(corrupt(data, rng), rng, "corrupted request");
+  }
+  compare_limits();
+  compare_framing();
+  spdlog::info("request_parser and llhttp_parser agree");
+  return 0;
+}
@@ -0,0 +1,289 @@
+#include "body_sink.hpp"
+#include "check.hpp"
+#include "server.hpp"
+
+#include <asio.hpp>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+// request bodies from data/test_post*.txt go through every body_sink and
+// through a live server, split into small chunks and followed by a pipelined
+// request which only gets its response when the body was framed correctly
+
+using namespace http::server;
+namespace fs = std::filesystem;
+
+static std::string read_file(const fs::path &path) {
+  std::ifstream in(path, std::ios::in | std::ios::binary);
+  return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+/// Feed `body` into `sink` in chunks of `chunk_size`.
+static asio::error_code feed(body_sink &sink, std::string_view body,
+                             std::size_t chunk_size) {
+  asio::io_context context;
+  asio::error_code err;
+  asio::co_spawn(
+      context,
+      [&]() -> asio::awaitable<void> {
+        for (std::size_t pos = 0; pos < body.size() && !err;
+             pos += chunk_size) {
+          co_await sink.write(body.substr(pos, chunk_size), err);
+        }
+      },
+      asio::detached);
+  context.run();
+  return err;
+}
+
+static void test_sinks(std::string_view body) {
+  memory_sink memory(body.size());
+  check(!feed(memory, body, 7), "memory sink accepts the body");
+  check(memory.data() == body && memory.size() == body.size(),
+        "memory sink keeps the body");
+
+  memory_sink small(body.size() - 1);
+  check(feed(small, body, 7) == asio::error::message_size,
+        "memory sink rejects a body above its limit");
+
+  file_sink file;
+  check(!feed(file, body, 7), "file sink accepts the body");
+  std::rewind(file.file());
+  std::string spilled(body.size(), '\0');
+  check(std::fread(spilled.data(), 1, spilled.size(), file.file()) ==
+                body.size() &&
+            spilled == body && file.size() == body.size(),
+        "file sink keeps the body");
+
+  discard_sink discard;
+  check(!feed(discard, body, 7) && discard.size() == body.size(),
+        "discard sink counts the body");
+}
+
+/// Send `data` in chunks of `chunk_size`, read until the server closes and
+/// return the status codes of all responses.
+static std::vector<int> exchange(const asio::ip::tcp::endpoint &endpoint,
+                                 std::string_view data,
+                                 std::size_t chunk_size) {
+  asio::io_context context;
+  asio::ip::tcp::socket socket(context);
+  socket.connect(endpoint);
+  socket.set_option(asio::ip::tcp::no_delay(true));
+  asio::error_code err;
+  // the server may close before everything was written
+  for (std::size_t pos = 0; pos < data.size() && !err; pos += chunk_size) {
+    asio::write(socket, asio::buffer(data.substr(pos, chunk_size)), err);
+  }
+  std::string received;
+  asio::read(socket, asio::dynamic_buffer(received), err);
+  std::vector<int> statuses;
+  for (std::size_t pos = received.find("HTTP/1.1 "); pos != std::string::npos;
+       pos = received.find("HTTP/1.1 ", pos + 1)) {
+    statuses.push_back(std::stoi(received.substr(pos + 9, 3)));
+  }
+  return statuses;
+}
+
+int main() {
+  fs::path data_path = fs::u8path(DATA_PATH);
+  const std::string follow_up = "GET /index.html HTTP/1.1\r\n"
+                                "Host: 127.0.0.1\r\n"
+                                "Connection: close\r\n\r\n";
+
+  for (auto name : {"test_post1.txt", "test_post3.txt"}) {
+    std::string fixture = read_file(data_path / name);
+    std::string_view body = fixture;
+    body.remove_prefix(fixture.find("\r\n\r\n") + 4);
+    test_sinks(body);
+  }
+
+  server_options options;
+  options.thread_count = 1;
+  options.mode = execution_mode::thread_per_core;
+  options.enable_ssl = false;
+  server s("127.0.0.1", "18095", STATIC_PATH, options);
+  std::thread server_thread([&s]() { s.run(); });
+  asio::ip::tcp::endpoint endpoint(asio::ip::make_address("127.0.0.1"), 18095);
+
+  // POST /test does not exist. test_post3.txt asks for keep-alive, so the
+  // pipelined GET is answered too, which only parses when the body was consumed
+  // exactly. test_post2.txt has no Content-Length, so no body either.
+  const std::pair<const char *, std::vector<int>> posts[] = {
+      {"test_post1.txt", {404}},
+      {"test_post2.txt", {404}},
+      {"test_post3.txt", {404, 200}},
+  };
+  for (const auto &[name, expected] : posts) {
+    std::string data = read_file(data_path / name) + follow_up;
+    for (std::size_t chunk_size : {std::size_t(1), std::size_t(7),
+                                   data.size()}) {
+      check(exchange(endpoint, data, chunk_size) == expected, name);
+    }
+  }
+  // a body above the memory limit spills to disk
+  {
+    std::string body(1 << 20, 'x');
+    std::string data = "POST /upload HTTP/1.1\r\n"
+                       "Host: 127.0.0.1\r\n"
+                       "Connection: keep-alive\r\n"
+                       "Content-Length: " +
+                       std::to_string(body.size()) + "\r\n\r\n" + body +
+                       follow_up;
+    auto statuses = exchange(endpoint, data, 64 * 1024);
+    check(statuses == std::vector<int>{404, 200}, "large body");
+  }
+
+  // chunked bodies, small ones split byte by byte and a large one with
+  // trailer fields running through the receive buffer many times
+  {
+    const std::string head = "POST /upload HTTP/1.1\r\n"
+                             "Host: 127.0.0.1\r\n"
+                             "Connection: keep-alive\r\n"
+                             "Transfer-Encoding: chunked\r\n\r\n";
+    std::string data = head +
+                       "5\r\nhello\r\n6;ext=1\r\n world\r\n0\r\n\r\n" +
+                       follow_up;
+    for (std::size_t chunk_size : {std::size_t(1), std::size_t(7),
+                                   data.size()}) {
+      check(exchange(endpoint, data, chunk_size) ==
+                std::vector<int>{404, 200},
+            "chunked body");
+    }
+    std::string body;
+    for (int i = 0; i < 256; i++) {
+      body += "1000\r\n" + std::string(0x1000, 'x') + "\r\n";
+    }
+    body += "0\r\nX-Checksum: none\r\n\r\n";
+    check(exchange(endpoint, head + body + follow_up, 3000) ==
+              std::vector<int>{404, 200},
+          "large chunked body with trailer fields");
+  }
+  // broken chunked framing and transfer codings which are not implemented are
+  // refused, Transfer-Encoding next to Content-Length closes the connection
+  {
+    const std::string head = "POST /upload HTTP/1.1\r\n"
+                             "Host: 127.0.0.1\r\n"
+                             "Connection: keep-alive\r\n";
+    check(exchange(endpoint,
+                   head + "Transfer-Encoding: chunked\r\n\r\n"
+                          "5\r\nhello world\r\n0\r\n\r\n" + follow_up,
+                   7) == std::vector<int>{400},
+          "broken chunked framing");
+    check(exchange(endpoint,
+                   head + "Transfer-Encoding: gzip, chunked\r\n\r\n" +
+                       follow_up,
+                   7) == std::vector<int>{400},
+          "unknown transfer coding");
+    check(exchange(endpoint,
+                   head + "Transfer-Encoding: chunked\r\n"
+                          "Content-Length: 3\r\n\r\n"
+                          "0\r\n\r\n" + follow_up,
+                   7) == std::vector<int>{404},
+          "Transfer-Encoding and Content-Length");
+  }
+  // a Content-Length which is not a plain number or is repeated is refused and
+  // the connection closed, the rest is never taken for a request
+  {
+    const std::string head = "POST /upload HTTP/1.1\r\n"
+                             "Host: 127.0.0.1\r\n"
+                             "Connection: keep-alive\r\n";
+    for (std::string_view length :
+         {"abc", "5x", "-1", "+5", "0x5", "", "5 5", "1,,1",
+          "99999999999999999999999", "18446744073709551616"}) {
+      check(exchange(endpoint,
+                     head + "Content-Length: " + std::string(length) +
+                         "\r\n\r\nhello" + follow_up,
+                     7) == std::vector<int>{400},
+            length);
+    }
+    check(exchange(endpoint,
+                   head + "Content-Length: 5\r\nContent-Length: 6\r\n\r\n"
+                          "hello!" + follow_up,
+                   7) == std::vector<int>{400},
+          "conflicting Content-Length fields");
+    check(exchange(endpoint,
+                   head + "Content-Length: 5, 6\r\n\r\nhello!" + follow_up,
+                   7) == std::vector<int>{400},
+          "conflicting Content-Length list");
+    check(exchange(endpoint,
+                   head + "Content-Length: 5\r\nContent-Length: 5, 5\r\n\r\n"
+                          "hello" + follow_up,
+                   7) == std::vector<int>{400},
+          "repeated Content-Length");
+    check(exchange(endpoint,
+                   head + "Content-Length: 5, 5\r\n\r\nhello" + follow_up,
+                   7) == std::vector<int>{400},
+          "repeated Content-Length list");
+    check(exchange(endpoint,
+                   head + "Content-Length: 00005\r\n\r\nhello" + follow_up,
+                   7) == std::vector<int>{404, 200},
+          "leading zeros");
+  }
+
+  // pipelined requests run past the end of the receive buffer, the partial
+  // header there is moved to the front
+  {
+    const std::string get = "GET /index.html HTTP/1.1\r\n"
+                            "Host: 127.0.0.1\r\n"
+                            "Connection: keep-alive\r\n\r\n";
+    std::string data;
+    for (int i = 0; i < 300; i++) {
+      data += get;
+    }
+    data += follow_up;
+    auto statuses = exchange(endpoint, data, 5000);
+    check(statuses == std::vector<int>(301, 200), "pipelined past the buffer");
+  }
+  // a header over the header_limits is refused as soon as the limit is hit
+  {
+    std::string data = "GET /index.html HTTP/1.1\r\n"
+                       "X-Large: " +
+                       std::string(10000, 'x') + "\r\n\r\n";
+    check(exchange(endpoint, data, data.size()) == std::vector<int>{431},
+          "header larger than the buffer");
+    data = "GET /" + std::string(10000, 'x') + " HTTP/1.1\r\n\r\n";
+    check(exchange(endpoint, data, data.size()) == std::vector<int>{414},
+          "request line too long");
+    data = "GET /index.html HTTP/1.1\r\n";
+    for (int i = 0; i < 101; i++) {
+      data += "X-Field: " + std::to_string(i) + "\r\n";
+    }
+    data += "\r\n";
+    check(exchange(endpoint, data, data.size()) == std::vector<int>{431},
+          "too many fields");
+  }
+  // the limits belong to each server, a second one with tighter limits in the
+  // same process leaves those of the first alone
+  {
+    server_options strict_options = options;
+    strict_options.limits.max_field_count = 4;
+    server strict("127.0.0.1", "18096", STATIC_PATH, strict_options);
+    std::thread strict_thread([&strict]() { strict.run(); });
+    asio::ip::tcp::endpoint strict_endpoint(
+        asio::ip::make_address("127.0.0.1"), 18096);
+    std::string data = "GET /index.html HTTP/1.1\r\n";
+    for (int i = 0; i < 6; i++) {
+      data += "X-Field: " + std::to_string(i) + "\r\n";
+    }
+    data += "Connection: close\r\n\r\n";
+    check(exchange(strict_endpoint, data, data.size()) ==
+              std::vector<int>{431},
+          "fields over the limit of the second server");
+    check(exchange(endpoint, data, data.size()) == std::vector<int>{200},
+          "fields within the limit of the first server");
+    strict.stop();
+    strict_thread.join();
+  }
+
+  s.stop();
+  server_thread.join();
+  spdlog::info("all request body tests passed");
+  return 0;
+}
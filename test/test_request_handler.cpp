@@ -0,0 +1,75 @@
+#include "check.hpp"
+#include "request.hpp"
+#include "request_handler.hpp"
+#include "response.hpp"
+
+#include <filesystem>
+#include <string>
+
+#include <spdlog/spdlog.h>
+
+// static files by the request target: a file below the document root is
+// served from the file cache or opened, targets which would reach a file
+// outside the root through empty segments, an escaped '/' or ".." get 400 or
+// 404 and open nothing, handlers given the same file cache share its copies
+
+using namespace http::server;
+namespace fs = std::filesystem;
+
+static response get(request_handler &handler, std::string_view target) {
+  request req;
+  req.method = "GET";
+  req.request_target = target;
+  req.http_version_major = 1;
+  req.http_version_minor = 1;
+  req.update();
+  response rep;
+  handler.handle_request(req, rep);
+  return rep;
+}
+
+static bool served(const response &rep) {
+  return rep.status == response::ok && (rep.cached || rep.file.is_open());
+}
+
+static void check_root(request_handler &handler) {
+  check(served(get(handler, "/index.html")), "a file below the root");
+  check(served(get(handler, "/")), "index.html of the root");
+  check(served(get(handler, "//assets//index-efcb3133.css")),
+        "empty segments collapse");
+  check(served(get(handler, "/assets/../index.html")), "a dot segment");
+
+  for (std::string_view target :
+       {"//etc/passwd", "/%2Fetc/passwd", "/%2fetc%2fpasswd",
+        "/a/..//etc/hostname", "/../etc/passwd", "/%2e%2e/etc/passwd",
+        "/assets/../../etc/passwd", "http://host//etc/passwd"}) {
+    response rep = get(handler, target);
+    check((rep.status == response::bad_request ||
+           rep.status == response::not_found) &&
+              !rep.cached && !rep.file.is_open(),
+          target);
+  }
+}
+
+int main() {
+  {
+    request_handler handler(STATIC_PATH);
+    check_root(handler);
+  }
+  {
+    request_handler handler(fs::path(STATIC_PATH) / "", 1 << 20);
+    check_root(handler);
+  }
+  {
+    // the handlers of two shards hold one copy of a file
+    auto cache = request_handler::make_file_cache(1 << 20);
+    request_handler first(STATIC_PATH, cache);
+    request_handler second(STATIC_PATH, cache);
+    response a = get(first, "/index.html");
+    response b = get(second, "/index.html");
+    check(a.cached && a.cached == b.cached && cache->count() == 1,
+          "a shared file cache");
+  }
+  spdlog::info("all request handler tests passed");
+  return 0;
+}
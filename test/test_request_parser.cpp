@@ -1,10 +1,14 @@
+#include "char_scan.hpp"
+#include "check.hpp"
 #include "request.hpp"
 #include "request_parser.hpp"
 #include "string_utils.hpp"
 
+#include <algorithm>
 #include <array>
 #include <filesystem>
 #include <fstream>
+#include <iterator>
 #include <sstream>
 
 #include <spdlog/spdlog.h>
@@ -15,18 +19,193 @@ template <typename T> static std::string_view from_buffer(const T &t) {
 
 using namespace http::server;
 namespace fs = std::filesystem;
+
+/// Every scan agrees with the scalar one for each byte value at each position
+/// of a vector.
+static void check_scans() {
+  using char_scan::isa;
+  std::string data(80, 'a');
+  for (isa set : {isa::sse42, isa::avx2}) {
+    if (!char_scan::use(set)) {
+      spdlog::info("{} not supported", char_scan::name(set));
+      continue;
+    }
+    for (size_t pos = 0; pos < 70; pos++) {
+      for (int ch = 0; ch < 256; ch++) {
+        data.assign(80, 'a');
+        data[pos] = static_cast<char>(ch);
+        char_scan::use(set);
+        auto token = char_scan::token(data);
+        auto target = char_scan::target(data);
+        auto value = char_scan::field_value(data);
+        char_scan::use(isa::scalar);
+        check(token == char_scan::token(data) &&
+                  target == char_scan::target(data) &&
+                  value == char_scan::field_value(data),
+              char_scan::name(set));
+      }
+    }
+  }
+}
+
+static bool same_headers(const request &a, const request &b) {
+  return a.headers.size() == b.headers.size() &&
+         std::equal(a.headers.begin(), a.headers.end(), b.headers.begin(),
+                    [](const header &x, const header &y) {
+                      return x.name == y.name && x.value == y.value;
+                    });
+}
+
+/// Parse `data` fed in chunks of `chunk_size`, return the result and the
+/// number of bytes up to the end of the header.
+static std::tuple<request_parser::parse_result, size_t>
+parse_chunked(request &req, std::string_view data, size_t chunk_size,
+              const header_limits &limits = {}) {
+  request_parser parser(limits);
+  for (size_t begin = 0; begin < data.size(); begin += chunk_size) {
+    auto [result, pos] = parser.parse(req, data.substr(begin, chunk_size));
+    if (result != request_parser::CONTINUE) {
+      return {result, begin + pos + 1};
+    }
+  }
+  return {request_parser::CONTINUE, data.size()};
+}
+
+/// The corpora parse the same on every instruction set however they are split.
+static void check_corpora(const fs::path &data_path) {
+  using char_scan::isa;
+  for (auto name : {"test_header1.txt", "test_header2.txt", "test_header3.txt",
+                    "test_header4.txt", "test_post1.txt", "test_post2.txt",
+                    "test_post3.txt"}) {
+    std::ifstream in(data_path / name, std::ios::in | std::ios::binary);
+    std::string data{std::istreambuf_iterator<char>(in),
+                     std::istreambuf_iterator<char>()};
+    if (data.find("\r\n\r\n") == std::string::npos) {
+      // the header captures stop after the last field line
+      data += "\r\n\r\n";
+    }
+    char_scan::use(isa::scalar);
+    request expected;
+    auto [expected_result, expected_size] = parse_chunked(expected, data, 1);
+    check(expected_result == request_parser::PASS, name);
+    for (isa set : {isa::scalar, isa::sse42, isa::avx2}) {
+      if (!char_scan::use(set)) {
+        continue;
+      }
+      for (size_t chunk_size : {size_t(1), size_t(7), size_t(64), data.size()}) {
+        request req;
+        auto [result, size] = parse_chunked(req, data, chunk_size);
+        check(result == expected_result && size == expected_size &&
+                  req.method == expected.method &&
+                  req.request_target == expected.request_target &&
+                  same_headers(req, expected),
+              name);
+      }
+    }
+    // a control character in a field value is rejected wherever it is found
+    std::string broken = data;
+    broken[broken.find("\r\n") + 10] = '\x01';
+    for (isa set : {isa::scalar, isa::sse42, isa::avx2}) {
+      if (char_scan::use(set)) {
+        request req;
+        check(std::get<0>(parse_chunked(req, broken, broken.size())) ==
+                  request_parser::FAIL,
+              name);
+      }
+    }
+  }
+  spdlog::info("scans run on {}", char_scan::name(char_scan::active()));
+}
+
+/// Every limit lets a header right at it pass and rejects one byte or one
+/// field more, however the header is split.
+static void check_limits() {
+  header_limits limits;
+  limits.max_request_line = 64;
+  limits.max_field_size = 32;
+  limits.max_field_count = 4;
+  limits.max_header_bytes = 160;
+  auto parse = [&limits](std::string_view data, size_t chunk_size) {
+    request req;
+    return std::get<0>(parse_chunked(req, data, chunk_size, limits));
+  };
+  auto request_line = [](size_t length) {
+    std::string_view rest = " HTTP/1.1";
+    std::string line = "GET /";
+    line.append(length - line.size() - rest.size(), 'a');
+    line += rest;
+    return line + "\r\n";
+  };
+  auto field = [](size_t length) {
+    std::string line = "X-Field: ";
+    line.append(length - line.size(), 'v');
+    return line + "\r\n";
+  };
+  for (size_t chunk_size : {size_t(1), size_t(7), size_t(1024)}) {
+    check(parse(request_line(64) + "\r\n", chunk_size) == request_parser::PASS,
+          "request line at the limit");
+    check(parse(request_line(65) + "\r\n", chunk_size) ==
+              request_parser::URI_TOO_LONG,
+          "request line over the limit");
+    std::string line = request_line(16);
+    check(parse(line + field(32) + "\r\n", chunk_size) == request_parser::PASS,
+          "field at the limit");
+    check(parse(line + field(33) + "\r\n", chunk_size) ==
+              request_parser::HEADER_TOO_LARGE,
+          "field over the limit");
+    std::string fields = line;
+    for (int i = 0; i < 4; i++) {
+      fields += field(16);
+    }
+    check(parse(fields + "\r\n", chunk_size) == request_parser::PASS,
+          "field count at the limit");
+    check(parse(fields + field(16) + "\r\n", chunk_size) ==
+              request_parser::HEADER_TOO_LARGE,
+          "field count over the limit");
+    // the last field fills the header up to 160 bytes
+    std::string full = request_line(62) + field(32) + field(32);
+    full += field(160 - full.size() - 4) + "\r\n";
+    check(full.size() == 160 &&
+              parse(full, chunk_size) == request_parser::PASS,
+          "header at the limit");
+    full.insert(full.size() - 4, "v");
+    check(parse(full, chunk_size) == request_parser::HEADER_TOO_LARGE,
+          "header over the limit");
+  }
+  // a header which never ends is rejected once it reaches the limit
+  request_parser parser(limits);
+  request req;
+  std::string flood = request_line(16);
+  size_t parsed = 0;
+  request_parser::parse_result result = request_parser::CONTINUE;
+  while (result == request_parser::CONTINUE && parsed <= 4096) {
+    std::tie(result, std::ignore) = parser.parse(req, flood);
+    parsed += flood.size();
+    flood = field(20);
+  }
+  check(result == request_parser::HEADER_TOO_LARGE && parsed <= 160 + 22,
+        "endless header");
+}
+
 int main() {
   fs::path data_path = fs::u8path(DATA_PATH);
+  check_scans();
+  check_corpora(data_path);
+  check_limits();
   std::ifstream request_data(data_path / "test_post3.txt",
                              std::ios::in | std::ios::binary);
-  std::array<char, 64> buffer;
-  std::shared_ptr<request> req = std::make_shared<request>();
+  // reads of 64 bytes, one after the other in the buffer as the parser
+  // expects them
+  std::array<char, 4096> buffer;
+  size_t buffer_size = 0;
+  request req;
   request_parser parser;
   bool receive_body = false;
   size_t received_data_size = 0;
   while (!request_data.eof()) {
-    request_data.read(buffer.data(), buffer.size());
-    std::string_view data(buffer.data(), request_data.gcount());
+    request_data.read(buffer.data() + buffer_size, 64);
+    std::string_view data(buffer.data() + buffer_size, request_data.gcount());
+    buffer_size += data.size();
     spdlog::info("receive data: {}", string_utils::escaped(data));
     if (!receive_body) {
       auto [parse_result, pos] = parser.parse(req, data);
@@ -39,7 +218,9 @@ int main() {
         }
         break;
       }
-      case request_parser::FAIL: {
+      case request_parser::FAIL:
+      case request_parser::URI_TOO_LONG:
+      case request_parser::HEADER_TOO_LARGE: {
         spdlog::error("failed to parse!");
         exit(EXIT_FAILURE);
       }
@@ -50,8 +231,8 @@ int main() {
       received_data_size += data.size();
     }
   }
-  req->update();
+  req.update();
   spdlog::info("receive http body: {} bytes, expect size: {} bytes",
-               received_data_size, req->content_length);
+               received_data_size, req.content_length);
   return 0;
 }
\ No newline at end of file
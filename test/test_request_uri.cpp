@@ -0,0 +1,132 @@
+#include "check.hpp"
+#include "request_uri.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+// request targets split into path and query, the path percent-decoded and
+// without dot segments, a plain path stays a view into the target, the query
+// pairs are split while iterating
+
+using namespace http::server;
+
+static void check_path(std::string_view target, std::string_view path,
+                       std::string_view query = {}) {
+  request_uri uri;
+  check(uri.parse(target), target);
+  check(uri.path() == path, target);
+  check(uri.query() == query, target);
+}
+
+static void check_rejected(std::string_view target) {
+  request_uri uri;
+  check(!uri.parse(target) && uri.path().empty(), target);
+}
+
+int main() {
+  check_path("/", "/");
+  check_path("/index.html", "/index.html");
+  check_path("/assets/index-888ab6c0.js?v=3", "/assets/index-888ab6c0.js",
+             "v=3");
+  check_path("/search?", "/search", "");
+  check_path("/a%20b/c%3Fd", "/a b/c?d");
+  check_path("/%E4%B8%AD%e6%96%87.html", "/\xe4\xb8\xad\xe6\x96\x87.html");
+  check_path("/a+b", "/a+b");
+  check_path("/a/./b/../c", "/a/c");
+  check_path("/a/b/..", "/a/");
+  check_path("/a/b/.", "/a/b/");
+  check_path("/a/..", "/");
+  check_path("/./", "/");
+  check_path("/a/%2e%2E/b", "/b");
+  check_path("/a/.hidden/..b/...", "/a/.hidden/..b/...");
+  check_path("//a//b", "/a/b");
+  check_path("/a//", "/a/");
+  check_path("//etc/passwd", "/etc/passwd");
+  check_path("/a/..//etc/hostname", "/etc/hostname");
+  check_path("/a/.//b/", "/a/b/");
+  check_path("/a/../b?x=/../", "/b", "x=/../");
+  check_path("http://127.0.0.1:8080/index.html?v=1", "/index.html", "v=1");
+  check_path("HTTPS://example.com", "/");
+  check_path("http://example.com?q", "/", "q");
+
+  check_rejected("");
+  check_rejected("*");
+  check_rejected("index.html");
+  check_rejected("ftp://example.com/");
+  check_rejected("/..");
+  check_rejected("/a/../..");
+  check_rejected("/%2e%2e/etc/passwd");
+  check_rejected("/a%");
+  check_rejected("/a%2");
+  check_rejected("/a%zz");
+  check_rejected("/a%00b");
+  check_rejected("/%2Fetc/passwd");
+  check_rejected("/a/c%2fd");
+
+  // a plain path is a view into the target, and follows it when moved
+  {
+    char buffer[64] = "xxxx/static/app.js?debug";
+    request_uri uri;
+    check(uri.parse(std::string_view(buffer + 4)), "parse");
+    check(uri.path().data() == buffer + 4, "no copy of a plain path");
+    std::memmove(buffer, buffer + 4, std::strlen(buffer + 4) + 1);
+    uri.rebase(-4);
+    check(uri.path() == "/static/app.js" && uri.path().data() == buffer &&
+              uri.query() == "debug" && uri.query().data() == buffer + 15,
+          "rebase");
+  }
+  // a decoded path survives copies of the request_uri
+  {
+    request_uri uri;
+    check(uri.parse("/a%20b"), "parse");
+    request_uri copy = uri;
+    uri.parse("/other");
+    check(copy.path() == "/a b", "decoded path of a copy");
+  }
+
+  // query pairs
+  {
+    request_uri uri;
+    check(uri.parse("/s?q=c%2B%2B+function&&empty=&flag&q=second&=v"),
+          "parse");
+    std::vector<std::pair<std::string_view, std::string_view>> pairs;
+    for (const auto &[key, value] : uri.params()) {
+      pairs.emplace_back(key, value);
+    }
+    check(pairs == decltype(pairs){{"q", "c%2B%2B+function"},
+                                   {"empty", ""},
+                                   {"flag", ""},
+                                   {"q", "second"},
+                                   {"", "v"}},
+          "pairs in order, empty ones skipped");
+    check(uri.params().find("q") == "c%2B%2B+function" &&
+              uri.params().find("flag") == "" &&
+              !uri.params().find("missing"),
+          "find the first pair");
+    std::string value;
+    check(percent_decode(*uri.params().find("q"), value, true) &&
+              value == "c++ function",
+          "form decoding of a value");
+    check(query_view().begin() == query_view().end() &&
+              query_view("&&").begin() == query_view("&&").end(),
+          "no pairs");
+  }
+
+  // percent_decode on its own
+  {
+    std::string out;
+    check(percent_decode("plain", out) && out == "plain", "nothing to decode");
+    check(percent_decode("%41%42c", out) && out == "ABc", "escapes");
+    check(percent_decode("a+b", out) && out == "a+b", "plus stays");
+    check(percent_decode("a+b", out, true) && out == "a b", "plus as space");
+    check(!percent_decode("%4", out) && !percent_decode("%g1", out),
+          "broken escapes");
+  }
+  spdlog::info("all request uri tests passed");
+  return 0;
+}
@@ -0,0 +1,114 @@
+#include "alloc_counter.hpp"
+#include "check.hpp"
+#include "request.hpp"
+#include "request_parser.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include <spdlog/spdlog.h>
+
+// the request is a view into the receive buffer: parsing a typical GET does
+// not touch the heap, also when it arrives in pieces, and moving the buffered
+// header with rebase() keeps the views valid
+
+using namespace http::server;
+
+static const std::string_view GET =
+    "GET /assets/index-888ab6c0.js?v=3 HTTP/1.1\r\n"
+    "Host: 127.0.0.1:8080\r\n"
+    "Connection: keep-alive\r\n"
+    "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64) "
+    "AppleWebKit/537.36 (KHTML, like Gecko) Chrome/118.0.0.0 Safari/537.36\r\n"
+    "Accept: */*\r\n"
+    "Sec-Fetch-Site: same-origin\r\n"
+    "Sec-Fetch-Mode: no-cors\r\n"
+    "Sec-Fetch-Dest: script\r\n"
+    "Referer: http://127.0.0.1:8080/\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8,en-GB;q=0.7,en-US;q=0.6\r\n"
+    "If-None-Match: \"64e9a5c2-1d4b\"\r\n"
+    "\r\n";
+
+static void check_request(const request &req, std::string_view what) {
+  check(req.method == "GET" &&
+            req.request_target == "/assets/index-888ab6c0.js?v=3" &&
+            req.http_version_major == 1 && req.http_version_minor == 1 &&
+            req.headers.size() == 11 &&
+            req.find_header("accept-encoding") == "gzip, deflate, br" &&
+            req.find_header("If-None-Match") == "\"64e9a5c2-1d4b\"" &&
+            req.keep_alive && req.content_length == 0,
+        what);
+}
+
+/// Parse GET from `buffer` in pieces of `piece` bytes, count the allocations.
+static std::size_t parse_in_pieces(char *buffer, std::size_t piece) {
+  std::memcpy(buffer, GET.data(), GET.size());
+  request req;
+  request_parser parser;
+  alloc_counter::allocations = 0;
+  alloc_counter::counting = true;
+  request_parser::parse_result result = request_parser::CONTINUE;
+  for (std::size_t begin = 0;
+       begin < GET.size() && result == request_parser::CONTINUE;
+       begin += piece) {
+    std::string_view data(buffer + begin, std::min(piece, GET.size() - begin));
+    result = std::get<0>(parser.parse(req, data));
+  }
+  req.update();
+  alloc_counter::counting = false;
+  check(result == request_parser::PASS, "parse");
+  check_request(req, "request views");
+  return alloc_counter::allocations;
+}
+
+int main() {
+  check(GET.size() > 450 && GET.size() < 550, "a typical 500 byte GET");
+  static char buffer[8192];
+  for (std::size_t piece : {GET.size(), std::size_t(100), std::size_t(1)}) {
+    check(parse_in_pieces(buffer, piece) == 0, "no allocation while parsing");
+  }
+
+  // the first half arrives at the end of the buffer, then it is moved to the
+  // front like the connection does when the buffer runs full
+  {
+    std::size_t half = GET.size() / 2;
+    std::size_t at = sizeof(buffer) - half;
+    std::memset(buffer, 0, sizeof(buffer));
+    std::memcpy(buffer + at, GET.data(), half);
+    request req;
+    request_parser parser;
+    auto [result, pos] = parser.parse(req, std::string_view(buffer + at, half));
+    check(result == request_parser::CONTINUE && pos == half, "first half");
+    std::memmove(buffer, buffer + at, half);
+    std::memset(buffer + half, 0, at);
+    parser.rebase(req, -static_cast<std::ptrdiff_t>(at));
+    std::memcpy(buffer + half, GET.data() + half, GET.size() - half);
+    std::tie(result, pos) = parser.parse(
+        req, std::string_view(buffer + half, GET.size() - half));
+    check(result == request_parser::PASS && half + pos + 1 == GET.size(),
+          "second half");
+    req.update();
+    check_request(req, "views after rebase");
+  }
+
+  // more fields than fit inline still parse, only then the heap is used
+  {
+    std::string many(GET.substr(0, GET.size() - 2));
+    for (int i = 0; i < 32; i++) {
+      many += "X-Field-" + std::to_string(i) + ": " + std::to_string(i) + "\r\n";
+    }
+    many += "\r\n";
+    request req;
+    request_parser parser;
+    auto [result, pos] = parser.parse(req, many);
+    check(result == request_parser::PASS && pos + 1 == many.size() &&
+              req.headers.size() == 11 + 32 &&
+              req.find_header("x-field-31") == "31",
+          "many fields");
+  }
+  spdlog::info("all request view tests passed");
+  return 0;
+}
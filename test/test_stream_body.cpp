@@ -0,0 +1,230 @@
+#include "body_source.hpp"
+#include "check.hpp"
+#include "chunked_decoder.hpp"
+#include "response.hpp"
+#include "send_queue.hpp"
+#include "server.hpp"
+
+#include <asio.hpp>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <spdlog/spdlog.h>
+
+// streamed response bodies: the head announces the chunked coding instead of
+// a length, a live server frames the pieces of a source as chunks between
+// pipelined responses, sends an HTTP/1.0 client the bare body and closes,
+// pulls no further than the client reads and drops the connection when the
+// source fails
+
+using namespace http::server;
+namespace fs = std::filesystem;
+
+static std::string read_file(const fs::path &path) {
+  std::ifstream in(path, std::ios::in | std::ios::binary);
+  return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+static constexpr int LINES = 20000;
+
+static std::string line(int n) { return "line " + std::to_string(n) + "\n"; }
+
+/// The lines 0..LINES, as many whole lines as fit into each piece.
+static std::unique_ptr<body_source> count_source() {
+  return std::make_unique<callback_source>(
+      [n = 0](std::span<char> out, asio::error_code &) mutable {
+        std::size_t size = 0;
+        while (n < LINES) {
+          std::string next = line(n);
+          if (size + next.size() > out.size()) {
+            break;
+          }
+          std::memcpy(out.data() + size, next.data(), next.size());
+          size += next.size();
+          n++;
+        }
+        return size;
+      });
+}
+
+static std::string expected_lines() {
+  std::string lines;
+  for (int n = 0; n < LINES; n++) {
+    lines += line(n);
+  }
+  return lines;
+}
+
+/// Decode the chunked body at the front of `data`, returns the body and the
+/// number of bytes it took, 0 when it is incomplete.
+static std::pair<std::string, std::size_t> decode_chunked(std::string_view data) {
+  chunked_decoder decoder;
+  std::string body;
+  std::size_t pos = 0;
+  while (pos < data.size()) {
+    auto [result, consumed, chunk] = decoder.decode(data.substr(pos));
+    pos += consumed;
+    if (result == chunked_decoder::DATA) {
+      body += chunk;
+    } else if (result == chunked_decoder::DONE) {
+      return {body, pos};
+    } else if (result == chunked_decoder::FAIL) {
+      break;
+    }
+  }
+  return {body, 0};
+}
+
+static void check_head() {
+  response rep;
+  rep.source = count_source();
+  rep.content = "ignored";
+  rep.update(true);
+  check(rep.head().find("Transfer-Encoding: chunked\r\n") !=
+                std::string::npos &&
+            rep.head().find("Content-Length") == std::string::npos,
+        "chunked instead of a length");
+  send_queue queue;
+  rep.to_buffers(queue);
+  check(queue.size() == 1 && queue.batch()[0].data() == rep.head().data(),
+        "only the head is queued");
+  rep.chunked = false;
+  rep.headers.set(header_id::transfer_encoding, "gzip");
+  rep.update(false);
+  check(rep.head().find("Transfer-Encoding") == std::string::npos &&
+            rep.head().find("Content-Length") == std::string::npos,
+        "a bare body has no framing");
+  rep.clear();
+  check(!rep.source && rep.chunked, "clear() drops the source");
+}
+
+static std::atomic<std::size_t> endless_pulled{0};
+
+static void check_server() {
+  server_options options;
+  options.thread_count = 1;
+  options.enable_ssl = false;
+  options.routes["/count"] = [](const request &, response &rep) {
+    rep.headers.set(header_id::content_type, "text/plain");
+    rep.source = count_source();
+  };
+  options.routes["/endless"] = [](const request &, response &rep) {
+    rep.source = std::make_unique<callback_source>(
+        [](std::span<char> out, asio::error_code &) {
+          std::memset(out.data(), 'e', out.size());
+          endless_pulled += out.size();
+          return out.size();
+        });
+  };
+  options.routes["/fail"] = [](const request &, response &rep) {
+    rep.source = std::make_unique<callback_source>(
+        [n = 0](std::span<char> out, asio::error_code &err) mutable {
+          if (n++ > 0) {
+            err = asio::error::connection_aborted;
+            return std::size_t{0};
+          }
+          out[0] = 'x';
+          return std::size_t{1};
+        });
+  };
+  server s("127.0.0.1", "18112", STATIC_PATH, options);
+  std::thread server_thread([&s]() { s.run(); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  asio::io_context context;
+  asio::ip::tcp::endpoint endpoint(asio::ip::make_address("127.0.0.1"),
+                                   static_cast<unsigned short>(18112));
+
+  // a streamed body between pipelined responses, then one for HTTP/1.0
+  std::string lines = expected_lines();
+  std::string index = read_file(fs::path(STATIC_PATH) / "index.html");
+  {
+    asio::ip::tcp::socket socket(context);
+    socket.connect(endpoint);
+    std::string requests = "GET /count HTTP/1.1\r\n"
+                           "Connection: keep-alive\r\n\r\n"
+                           "GET /index.html HTTP/1.1\r\n"
+                           "Connection: keep-alive\r\n\r\n"
+                           "GET /count HTTP/1.0\r\n"
+                           "Connection: keep-alive\r\n\r\n";
+    asio::write(socket, asio::buffer(requests));
+    std::string received;
+    asio::error_code err;
+    asio::read(socket, asio::dynamic_buffer(received), err);
+
+    std::size_t first_body = received.find("\r\n\r\n") + 4;
+    check(received.substr(0, first_body).find("Transfer-Encoding: chunked") !=
+              std::string::npos,
+          "streamed head");
+    auto [body, size] =
+        decode_chunked(std::string_view(received).substr(first_body));
+    check(size > 0 && body == lines, "the lines as chunks");
+    std::size_t second = first_body + size;
+    std::size_t second_body = received.find("\r\n\r\n", second) + 4;
+    check(received.compare(second, 15, "HTTP/1.1 200 OK") == 0 &&
+              received.compare(second_body, index.size(), index) == 0,
+          "the next response right behind the last chunk");
+    std::size_t third = second_body + index.size();
+    std::size_t third_body = received.find("\r\n\r\n", third) + 4;
+    std::string_view third_head =
+        std::string_view(received).substr(third, third_body - third);
+    check(third_head.find("Transfer-Encoding") == std::string::npos &&
+              third_head.find("Connection: close") != std::string::npos &&
+              received.substr(third_body) == lines,
+          "HTTP/1.0 gets the bare body up to the end of the connection");
+  }
+
+  // a client that does not read stops the source once the socket is full
+  {
+    asio::ip::tcp::socket socket(context, asio::ip::tcp::v4());
+    socket.set_option(asio::socket_base::receive_buffer_size(64 * 1024));
+    socket.connect(endpoint);
+    asio::write(socket, asio::buffer(std::string_view(
+                            "GET /endless HTTP/1.1\r\n\r\n")));
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    std::size_t pulled = endless_pulled;
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    check(pulled > 0 && pulled < 16 * 1024 * 1024 && endless_pulled == pulled,
+          "pulled no further than the socket takes");
+    // read what is in flight and then some
+    std::string some(64 * 1024, '\0');
+    std::size_t read = 0;
+    while (endless_pulled == pulled && read < 64 * pulled) {
+      read += asio::read(socket, asio::buffer(some));
+    }
+    check(endless_pulled > pulled, "pulled on once the client reads");
+    spdlog::info("pulled {} bytes before the client read, {} in flight",
+                 pulled, read);
+  }
+
+  // a failing source drops the connection, the body never ends
+  {
+    asio::ip::tcp::socket socket(context);
+    socket.connect(endpoint);
+    asio::write(socket, asio::buffer(std::string_view(
+                            "GET /fail HTTP/1.1\r\n"
+                            "Connection: keep-alive\r\n\r\n")));
+    std::string received;
+    asio::error_code err;
+    asio::read(socket, asio::dynamic_buffer(received), err);
+    std::size_t body = received.find("\r\n\r\n") + 4;
+    check(err && decode_chunked(std::string_view(received).substr(body))
+                         .second == 0,
+          "cut off without the last chunk");
+  }
+
+  s.stop();
+  server_thread.join();
+}
+
+int main() {
+  check_head();
+  check_server();
+  spdlog::info("all stream body tests passed");
+  return 0;
+}